@@ -0,0 +1,82 @@
+//=============================================================================
+// BoundedQueue - Blocking FIFO with a fixed capacity
+//
+// Used to connect the stages of the frame pipeline. Push() blocks while the
+// queue is full, which is what gives the pipeline its backpressure: a fast
+// stage can never run more than the queue capacity ahead of a slow one.
+//=============================================================================
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Append an item, waiting while the queue is full
+     * @return false if the queue was closed (the item is dropped)
+     */
+    bool Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed)
+        {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Remove the oldest item, waiting while the queue is empty
+     * @return false once the queue is closed and fully drained
+     */
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty())
+        {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Mark the end of the stream; pending items can still be popped
+     */
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
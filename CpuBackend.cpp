@@ -0,0 +1,919 @@
+//=============================================================================
+// CpuBackend - In-tree ImagingBackend without the Ladybug SDK
+//
+// Reads the .pgr container with PgrStreamReader, unpacks each camera's
+// planes into a Bayer mosaic, debayers the six mosaics together with
+// DemosaicEngine, renders panoramas on the CPU and writes images with
+// ImageFile. Output only depends on the input and the options, so runs are
+// reproducible on any machine.
+//
+// Supported data formats: RAW8, RAW12, RAW16 and COLOR_SEP_JPEG8 (with
+// libjpeg), including their HALF_HEIGHT variants; COLOR_SEP_JPEG12 with
+// libjpeg-turbo 3 or later. Half-height images are debayered at half height
+// and each texture row is doubled. The downsampling methods build the
+// textures of JPEG streams straight from the decoded planes, Downsample16
+// with the 1/2 scaled IDCT, instead of reassembling and debayering mosaics.
+// With --jpeg-passthrough the planes of a camera are repacked into one RGB
+// JPEG at the coefficient level, without being decoded at all.
+//
+// Panoramas are rendered by PanoramaLut from a nominal head geometry rather
+// than the unit's calibration: cameras 0-4 look out horizontally 72 degrees
+// apart, camera 5 looks up, and every camera is an ideal pinhole with a 90
+// degree horizontal field of view. Directions no camera sees are black.
+//=============================================================================
+
+#include "ImagingBackend.h"
+#include "Demosaic.h"
+#include "ImageFile.h"
+#include "PanoramaLut.h"
+#include "PixelConvert.h"
+#include "RunStats.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <csetjmp>
+#include <string>
+
+#ifdef USE_LIBJPEG
+#include <jpeglib.h>
+#include "JpegSupport.h"
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER) && LIBJPEG_TURBO_VERSION_NUMBER >= 3000000
+#define CPU_JPEG12_SUPPORTED
+#endif
+#endif
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+// Calibration key of cached nominal-geometry tables (change it when the
+// nominal model changes)
+static const char NOMINAL_MODEL_NAME[] = "nominal-pinhole-90";
+
+// JPEG planes of a colour-separated frame
+constexpr unsigned int NUM_PLANES = NUM_CAMERAS * PGR_PLANES_PER_CAMERA;
+
+//=============================================================================
+// Stream Format
+//=============================================================================
+
+/**
+ * @brief How the camera images of a stream are stored
+ */
+struct CpuStreamFormat
+{
+    uint32_t dataFormat = 0;
+    unsigned int cols = 0;
+    unsigned int rows = 0;              // Full image height
+    unsigned int storedRows = 0;        // Rows in the stream (rows / 2 for half height)
+    unsigned int bits = 8;              // Sample precision: 8, 12 or 16
+    bool colorSeparated = false;        // Four JPEG planes per camera
+    BayerPattern pattern = BayerPattern::RGGB;
+};
+
+static bool DescribeStreamFormat(const PgrStreamHeader& header, CpuStreamFormat& format)
+{
+    format.dataFormat = header.dataFormat;
+
+    bool halfHeight = false;
+    switch (header.dataFormat)
+    {
+    case PGR_DATAFORMAT_RAW8:
+        break;
+    case PGR_DATAFORMAT_HALF_HEIGHT_RAW8:
+        halfHeight = true;
+        break;
+    case PGR_DATAFORMAT_RAW12:
+        format.bits = 12;
+        break;
+    case PGR_DATAFORMAT_HALF_HEIGHT_RAW12:
+        format.bits = 12;
+        halfHeight = true;
+        break;
+    case PGR_DATAFORMAT_RAW16:
+        format.bits = 16;
+        break;
+    case PGR_DATAFORMAT_HALF_HEIGHT_RAW16:
+        format.bits = 16;
+        halfHeight = true;
+        break;
+#ifdef USE_LIBJPEG
+    case PGR_DATAFORMAT_COLOR_SEP_JPEG8:
+        format.colorSeparated = true;
+        break;
+    case PGR_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG8:
+        format.colorSeparated = true;
+        halfHeight = true;
+        break;
+#endif
+#ifdef CPU_JPEG12_SUPPORTED
+    case PGR_DATAFORMAT_COLOR_SEP_JPEG12:
+        format.colorSeparated = true;
+        format.bits = 12;
+        break;
+    case PGR_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG12:
+        format.colorSeparated = true;
+        format.bits = 12;
+        halfHeight = true;
+        break;
+#endif
+    default:
+        printf("Error: The CPU backend does not support data format %u\n", header.dataFormat);
+        return false;
+    }
+
+    if (!GetPgrResolutionSize(header.resolution, format.cols, format.rows))
+    {
+        printf("Error: Unknown stream resolution %u\n", header.resolution);
+        return false;
+    }
+    format.storedRows = halfHeight ? format.rows / 2 : format.rows;
+
+    switch (header.stippledFormat)
+    {
+    case PGR_STIPPLED_BGGR: format.pattern = BayerPattern::BGGR; break;
+    case PGR_STIPPLED_GBRG: format.pattern = BayerPattern::GBRG; break;
+    case PGR_STIPPLED_GRBG: format.pattern = BayerPattern::GRBG; break;
+    default:                format.pattern = BayerPattern::RGGB; break;
+    }
+    return true;
+}
+
+//=============================================================================
+// JPEG Plane Decoder
+//=============================================================================
+
+#ifdef USE_LIBJPEG
+
+/**
+ * @brief Decodes greyscale plane JPEGs, reusing one decompressor
+ */
+class JpegPlaneDecoder
+{
+public:
+    JpegPlaneDecoder()
+    {
+        cinfo.err = InitJpegErrorManager(errorManager);
+        jpeg_create_decompress(&cinfo);
+    }
+
+    ~JpegPlaneDecoder()
+    {
+        jpeg_destroy_decompress(&cinfo);
+    }
+
+    JpegPlaneDecoder(const JpegPlaneDecoder&) = delete;
+    JpegPlaneDecoder& operator=(const JpegPlaneDecoder&) = delete;
+
+    /**
+     * @brief Decode a plane of cols x rows samples into 16-bit values
+     *        (8-bit planes keep their value, 12-bit planes are scaled to 16)
+     * @param scale 1, or 2, 4 or 8 to reconstruct only every scale x scale
+     *              block with the scaled IDCT; out then holds
+     *              ceil(cols / scale) x ceil(rows / scale) samples
+     */
+    bool Decode(const PgrPlaneView& plane, unsigned int cols, unsigned int rows, uint16_t* out,
+                unsigned int scale = 1)
+    {
+        if (setjmp(errorManager.jump))
+        {
+            jpeg_abort_decompress(&cinfo);
+            return false;
+        }
+
+        jpeg_mem_src(&cinfo, const_cast<unsigned char*>(plane.data), plane.size);
+        jpeg_read_header(&cinfo, TRUE);
+        if (cinfo.image_width != cols || cinfo.image_height != rows || cinfo.num_components != 1)
+        {
+            jpeg_abort_decompress(&cinfo);
+            return false;
+        }
+
+        cinfo.out_color_space = JCS_GRAYSCALE;
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = scale;
+        jpeg_start_decompress(&cinfo);
+        const unsigned int outCols = cinfo.output_width;
+
+#ifdef CPU_JPEG12_SUPPORTED
+        if (cinfo.data_precision == 12)
+        {
+            row12.resize(outCols);
+            while (cinfo.output_scanline < cinfo.output_height)
+            {
+                J12SAMPROW rowPointer = row12.data();
+                uint16_t* outRow = out + static_cast<size_t>(cinfo.output_scanline) * outCols;
+                jpeg12_read_scanlines(&cinfo, &rowPointer, 1);
+                for (unsigned int x = 0; x < outCols; x++)
+                {
+                    outRow[x] = static_cast<uint16_t>(row12[x] << 4);
+                }
+            }
+            jpeg_finish_decompress(&cinfo);
+            return true;
+        }
+#endif
+
+        row8.resize(outCols);
+        while (cinfo.output_scanline < cinfo.output_height)
+        {
+            JSAMPROW rowPointer = row8.data();
+            uint16_t* outRow = out + static_cast<size_t>(cinfo.output_scanline) * outCols;
+            jpeg_read_scanlines(&cinfo, &rowPointer, 1);
+            for (unsigned int x = 0; x < outCols; x++)
+            {
+                outRow[x] = row8[x];
+            }
+        }
+        jpeg_finish_decompress(&cinfo);
+        return true;
+    }
+
+private:
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager errorManager;
+    std::vector<JSAMPLE> row8;
+#ifdef CPU_JPEG12_SUPPORTED
+    std::vector<J12SAMPLE> row12;
+#endif
+};
+
+// Bytes a repacked JPEG starts with before it grows
+constexpr size_t REPACK_BUFFER_BYTES = 256 * 1024;
+
+/**
+ * @brief Repacks the red, green and blue plane JPEGs of a camera into one
+ *        RGB JPEG without decoding them
+ *
+ * The quantized DCT coefficients of the planes become the three components
+ * of the output, each with its own quantization table, so the image is the
+ * one the planes decode to; only the entropy coding is redone. The file is
+ * marked as RGB (Adobe transform 0), so readers apply no colour conversion.
+ */
+class JpegRepacker
+{
+public:
+    JpegRepacker()
+    {
+        InitJpegErrorManager(errorManager);
+        for (jpeg_decompress_struct& source : sources)
+        {
+            source.err = &errorManager.base;
+            jpeg_create_decompress(&source);
+        }
+        output.err = &errorManager.base;
+        jpeg_create_compress(&output);
+
+        SetJpegVectorDestination(output, destination, REPACK_BUFFER_BYTES);
+    }
+
+    ~JpegRepacker()
+    {
+        jpeg_destroy_compress(&output);
+        for (jpeg_decompress_struct& source : sources)
+        {
+            jpeg_destroy_decompress(&source);
+        }
+    }
+
+    JpegRepacker(const JpegRepacker&) = delete;
+    JpegRepacker& operator=(const JpegRepacker&) = delete;
+
+    /**
+     * @brief Repack three cols x rows 8-bit planes (red, green, blue)
+     * @param error Receives why the planes could not be repacked
+     */
+    bool Repack(const PgrPlaneView* const planes[3], unsigned int cols, unsigned int rows,
+                std::vector<unsigned char>& jpeg, std::string& error)
+    {
+        if (setjmp(errorManager.jump))
+        {
+            char message[JMSG_LENGTH_MAX];
+            (*errorManager.base.format_message)(reinterpret_cast<j_common_ptr>(&output), message);
+            error = message;
+            Abort();
+            return false;
+        }
+
+        jvirt_barray_ptr coefficients[3];
+        for (int c = 0; c < 3; c++)
+        {
+            jpeg_decompress_struct& source = sources[c];
+            jpeg_mem_src(&source, const_cast<unsigned char*>(planes[c]->data), planes[c]->size);
+            jpeg_read_header(&source, TRUE);
+            if (source.image_width != cols || source.image_height != rows || source.num_components != 1 ||
+                source.data_precision != 8)
+            {
+                error = "unexpected plane size or precision";
+                Abort();
+                return false;
+            }
+            coefficients[c] = jpeg_read_coefficients(&source)[0];
+        }
+
+        destination.out = &jpeg;
+        output.image_width = cols;
+        output.image_height = rows;
+        output.input_components = 3;
+        output.in_color_space = JCS_RGB;
+        jpeg_set_defaults(&output);
+        jpeg_set_colorspace(&output, JCS_RGB);
+        for (int c = 0; c < 3; c++)
+        {
+            JQUANT_TBL*& table = output.quant_tbl_ptrs[c];
+            if (table == nullptr)
+            {
+                table = jpeg_alloc_quant_table(reinterpret_cast<j_common_ptr>(&output));
+            }
+            memcpy(table->quantval, sources[c].comp_info[0].quant_table->quantval, sizeof(table->quantval));
+            output.comp_info[c].quant_tbl_no = c;
+        }
+
+        jpeg_write_coefficients(&output, coefficients);
+        jpeg_finish_compress(&output);
+        for (jpeg_decompress_struct& source : sources)
+        {
+            jpeg_finish_decompress(&source);
+        }
+        return true;
+    }
+
+private:
+    void Abort()
+    {
+        jpeg_abort_compress(&output);
+        for (jpeg_decompress_struct& source : sources)
+        {
+            jpeg_abort_decompress(&source);
+        }
+    }
+
+    jpeg_decompress_struct sources[3];
+    jpeg_compress_struct output;
+    JpegErrorManager errorManager;
+    JpegVectorDestination destination;
+};
+
+#endif
+
+//=============================================================================
+// CpuFrameConverter
+//=============================================================================
+
+class CpuFrameConverter : public FrameConverter
+{
+public:
+    CpuFrameConverter(const CpuStreamFormat& format, const BackendOptions& options)
+        : format(format), colorMethod(options.colorMethod), planeScale(GetPlaneScale(format, options.colorMethod)),
+          stats(options.stats), demosaicEngine(options.demosaicThreads), pixelConverter(options.convertThreads, options.toneCurve)
+#ifdef USE_LIBJPEG
+          , decodePool(format.colorSeparated ? options.decodeThreads : 1)
+#endif
+    {
+#ifdef USE_LIBJPEG
+        for (unsigned int i = 0; i < decodePool.NumThreads(); i++)
+        {
+            planeDecoders.emplace_back(new PlaneDecoder());
+        }
+#endif
+    }
+
+    bool Convert(const RawFrame& raw, unsigned char* const textures[NUM_CAMERAS], PixelFormat pixelFormat) override
+    {
+        // The JPEG planes of all cameras are decoded at once; other formats
+        // are unpacked camera by camera
+        int badCamera;
+        {
+            StageTimer decodeTimer(stats, Stage::Decode, raw.frameNum);
+            if (planeScale != 0)
+            {
+                badCamera = DecodeScaledPlanes(raw);
+            }
+            else
+            {
+                badCamera = format.colorSeparated ? DecodePlanes(raw) : UnpackCameras(raw);
+            }
+        }
+        if (badCamera >= 0)
+        {
+            printf("Warning: Could not convert frame %u: Camera %d data is invalid\n", raw.frameNum, badCamera);
+            return false;
+        }
+
+        // All six cameras at once; half-height images are debayered at half
+        // height and every texture row is written twice
+        const unsigned int rowRepeat = (format.storedRows != format.rows) ? 2 : 1;
+        bool converted;
+        if (planeScale != 0)
+        {
+            converted = demosaicEngine.Run(bayerPlanes, textures, NUM_CAMERAS, pixelFormat, rowRepeat);
+        }
+        else
+        {
+            const BayerImage* images[NUM_CAMERAS];
+            for (int cam = 0; cam < NUM_CAMERAS; cam++)
+            {
+                mosaics[cam].FillBorder();
+                images[cam] = &mosaics[cam];
+            }
+            converted = demosaicEngine.Run(images, textures, NUM_CAMERAS, colorMethod, pixelFormat, rowRepeat);
+        }
+        if (!converted)
+        {
+            printf("Warning: Could not convert frame %u: Unsupported texture format\n", raw.frameNum);
+            return false;
+        }
+        return true;
+    }
+
+    bool ReduceTo8Bit(unsigned char* const textures[NUM_CAMERAS], unsigned int cols, unsigned int rows) override
+    {
+        pixelConverter.ReduceTo8Bit(textures, cols, rows);
+        return true;
+    }
+
+    bool PassThrough(const RawFrame& raw, std::vector<unsigned char> jpegs[NUM_CAMERAS], std::string& reason) override
+    {
+#ifdef USE_LIBJPEG
+        if (!format.colorSeparated)
+        {
+            reason = "the stream holds raw images, not JPEG planes";
+            return false;
+        }
+        if (format.bits > 8)
+        {
+            reason = "12-bit JPEG planes cannot be written as baseline JPEG";
+            return false;
+        }
+        if (format.storedRows != format.rows)
+        {
+            reason = "half-height images need their rows doubled";
+            return false;
+        }
+
+        // The six cameras are repacked in parallel; green comes from the
+        // first green plane of the pattern
+        int red;
+        int green;
+        int blue;
+        GetColorPlanes(format.pattern, red, green, blue);
+        bool repacked[NUM_CAMERAS];
+        std::string errors[NUM_CAMERAS];
+        decodePool.RunIndexed(NUM_CAMERAS, [&](unsigned int cam, unsigned int thread) {
+            const PgrPlaneView* planes = raw.planes + cam * PGR_PLANES_PER_CAMERA;
+            const PgrPlaneView* colorPlanes[3] = { &planes[red], &planes[green], &planes[blue] };
+            if (planes[red].data == nullptr || planes[green].data == nullptr || planes[blue].data == nullptr)
+            {
+                errors[cam] = "plane missing";
+                repacked[cam] = false;
+                return;
+            }
+            repacked[cam] = planeDecoders[thread]->repacker.Repack(colorPlanes, format.cols / 2, format.storedRows / 2,
+                                                                   jpegs[cam], errors[cam]);
+        });
+
+        for (int cam = 0; cam < NUM_CAMERAS; cam++)
+        {
+            if (!repacked[cam])
+            {
+                reason = "camera " + std::to_string(cam) + ": " + errors[cam];
+                return false;
+            }
+        }
+        return true;
+#else
+        return FrameConverter::PassThrough(raw, jpegs, reason);
+#endif
+    }
+
+private:
+#ifdef USE_LIBJPEG
+    /**
+     * @brief Decompressor and plane buffer of one decode thread
+     */
+    struct PlaneDecoder
+    {
+        JpegPlaneDecoder decoder;
+        JpegRepacker repacker;
+        std::vector<uint16_t> planeBuffer;
+    };
+
+    /**
+     * @brief Plane index of the red, the first green and the blue samples
+     *        (plane k holds Bayer position x = k & 1, y = k >> 1)
+     */
+    static void GetColorPlanes(BayerPattern pattern, int& red, int& green, int& blue)
+    {
+        switch (pattern)
+        {
+        case BayerPattern::BGGR:
+            blue = 0;
+            green = 1;
+            red = 3;
+            break;
+        case BayerPattern::GBRG:
+            green = 0;
+            blue = 1;
+            red = 2;
+            break;
+        case BayerPattern::GRBG:
+            green = 0;
+            red = 1;
+            blue = 2;
+            break;
+        case BayerPattern::RGGB:
+        default:
+            red = 0;
+            green = 1;
+            blue = 3;
+            break;
+        }
+    }
+#endif
+
+    /**
+     * @brief IDCT scale at which the JPEG planes of a stream already are the
+     *        method's texture, or 0 if the method needs the full mosaic
+     *
+     * A plane sample covers a 2x2 cell, so Downsample4 takes the planes as
+     * they are and Downsample16 decodes them at half size.
+     */
+    static unsigned int GetPlaneScale(const CpuStreamFormat& format, ColorMethod method)
+    {
+#ifdef USE_LIBJPEG
+        if (format.colorSeparated && method == ColorMethod::Downsample4)
+        {
+            return 1;
+        }
+        if (format.colorSeparated && method == ColorMethod::Downsample16)
+        {
+            return 2;
+        }
+#else
+        (void)format;
+        (void)method;
+#endif
+        return 0;
+    }
+
+    /**
+     * @brief Unpack the raw image of every camera
+     * @return The first camera whose data is invalid, or -1
+     */
+    int UnpackCameras(const RawFrame& raw)
+    {
+        for (int cam = 0; cam < NUM_CAMERAS; cam++)
+        {
+            if (!UnpackCamera(raw, cam))
+            {
+                return cam;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * @brief Unpack one camera's raw image into its mosaic
+     */
+    bool UnpackCamera(const RawFrame& raw, int cam)
+    {
+        const unsigned int cols = format.cols;
+        const unsigned int rows = format.storedRows;
+        const PgrPlaneView& plane = raw.planes[cam * PGR_PLANES_PER_CAMERA];
+        BayerImage& mosaic = mosaics[cam];
+        mosaic.Resize(cols, rows, format.bits > 8, format.pattern);
+
+        if (format.bits == 8)
+        {
+            if (plane.size < static_cast<size_t>(cols) * rows)
+            {
+                return false;
+            }
+            for (unsigned int y = 0; y < rows; y++)
+            {
+                memcpy(mosaic.Row8(y), plane.data + static_cast<size_t>(y) * cols, cols);
+            }
+        }
+        else if (format.bits == 16)
+        {
+            if (plane.size < static_cast<size_t>(cols) * rows * 2)
+            {
+                return false;
+            }
+            const unsigned char* in = plane.data;
+            for (unsigned int y = 0; y < rows; y++)
+            {
+                uint16_t* out = mosaic.Row16(y);
+                for (unsigned int x = 0; x < cols; x++, in += 2)
+                {
+                    out[x] = static_cast<uint16_t>((in[0] << 8) | in[1]);
+                }
+            }
+        }
+        else
+        {
+            // 12-bit, two samples in three bytes
+            if (cols % 2 != 0 || plane.size < static_cast<size_t>(cols) * rows * 3 / 2)
+            {
+                return false;
+            }
+            const unsigned char* in = plane.data;
+            for (unsigned int y = 0; y < rows; y++)
+            {
+                uint16_t* out = mosaic.Row16(y);
+                for (unsigned int x = 0; x < cols; x += 2, in += 3)
+                {
+                    out[x] = static_cast<uint16_t>(((in[0] << 4) | (in[1] & 0x0F)) << 4);
+                    out[x + 1] = static_cast<uint16_t>(((in[2] << 4) | (in[1] >> 4)) << 4);
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Decode the four Bayer-position JPEGs of every camera, the 24
+     *        planes in parallel, and interleave them into the mosaics
+     * @return The first camera with an invalid plane, or -1
+     */
+    int DecodePlanes(const RawFrame& raw)
+    {
+#ifdef USE_LIBJPEG
+        for (int cam = 0; cam < NUM_CAMERAS; cam++)
+        {
+            mosaics[cam].Resize(format.cols, format.storedRows, format.bits > 8, format.pattern);
+        }
+
+        // Each plane fills its own Bayer position, so no two tasks write the
+        // same sample
+        bool decoded[NUM_PLANES];
+        decodePool.RunIndexed(NUM_PLANES, [&](unsigned int index, unsigned int thread) {
+            decoded[index] = DecodePlane(raw, index, *planeDecoders[thread]);
+        });
+
+        for (unsigned int index = 0; index < NUM_PLANES; index++)
+        {
+            if (!decoded[index])
+            {
+                return static_cast<int>(index / PGR_PLANES_PER_CAMERA);
+            }
+        }
+        return -1;
+#else
+        (void)raw;
+        return 0;
+#endif
+    }
+
+    /**
+     * @brief Decode the 24 planes in parallel at 1 / planeScale of their
+     *        size, straight into the planes the textures are built from
+     * @return The first camera with an invalid plane, or -1
+     */
+    int DecodeScaledPlanes(const RawFrame& raw)
+    {
+#ifdef USE_LIBJPEG
+        const unsigned int planeCols = format.cols / 2;
+        const unsigned int planeRows = format.storedRows / 2;
+        const unsigned int scaledCols = (planeCols + planeScale - 1) / planeScale;
+        const unsigned int scaledRows = (planeRows + planeScale - 1) / planeScale;
+        for (unsigned int index = 0; index < NUM_PLANES; index++)
+        {
+            scaledPlanes[index].resize(static_cast<size_t>(scaledCols) * scaledRows);
+        }
+        for (int cam = 0; cam < NUM_CAMERAS; cam++)
+        {
+            BayerPlanes& planes = bayerPlanes[cam];
+            for (int k = 0; k < PGR_PLANES_PER_CAMERA; k++)
+            {
+                planes.planes[k] = scaledPlanes[cam * PGR_PLANES_PER_CAMERA + k].data();
+            }
+            planes.stride = scaledCols;
+            planes.cols = planeCols / planeScale;
+            planes.rows = planeRows / planeScale;
+            planes.is16Bit = format.bits > 8;
+            planes.pattern = format.pattern;
+        }
+
+        bool decoded[NUM_PLANES];
+        decodePool.RunIndexed(NUM_PLANES, [&](unsigned int index, unsigned int thread) {
+            const PgrPlaneView& plane = raw.planes[index];
+            decoded[index] = plane.data != nullptr &&
+                             planeDecoders[thread]->decoder.Decode(plane, planeCols, planeRows,
+                                                                   scaledPlanes[index].data(), planeScale);
+        });
+
+        for (unsigned int index = 0; index < NUM_PLANES; index++)
+        {
+            if (!decoded[index])
+            {
+                return static_cast<int>(index / PGR_PLANES_PER_CAMERA);
+            }
+        }
+        return -1;
+#else
+        (void)raw;
+        return 0;
+#endif
+    }
+
+#ifdef USE_LIBJPEG
+    /**
+     * @brief Decode one Bayer-position JPEG into its camera's mosaic
+     */
+    bool DecodePlane(const RawFrame& raw, unsigned int index, PlaneDecoder& worker)
+    {
+        const unsigned int planeCols = format.cols / 2;
+        const unsigned int planeRows = format.storedRows / 2;
+        const PgrPlaneView& plane = raw.planes[index];
+        worker.planeBuffer.resize(static_cast<size_t>(planeCols) * planeRows);
+        if (plane.data == nullptr || !worker.decoder.Decode(plane, planeCols, planeRows, worker.planeBuffer.data()))
+        {
+            return false;
+        }
+
+        BayerImage& mosaic = mosaics[index / PGR_PLANES_PER_CAMERA];
+        const unsigned int k = index % PGR_PLANES_PER_CAMERA;
+        const unsigned int dx = k & 1;
+        const unsigned int dy = k >> 1;
+        for (unsigned int y = 0; y < planeRows; y++)
+        {
+            const uint16_t* in = worker.planeBuffer.data() + static_cast<size_t>(y) * planeCols;
+            if (format.bits > 8)
+            {
+                uint16_t* out = mosaic.Row16(2 * y + dy) + dx;
+                for (unsigned int x = 0; x < planeCols; x++)
+                {
+                    out[2 * x] = in[x];
+                }
+            }
+            else
+            {
+                uint8_t* out = mosaic.Row8(2 * y + dy) + dx;
+                for (unsigned int x = 0; x < planeCols; x++)
+                {
+                    out[2 * x] = static_cast<uint8_t>(in[x]);
+                }
+            }
+        }
+        return true;
+    }
+#endif
+
+    CpuStreamFormat format;
+    ColorMethod colorMethod;
+    unsigned int planeScale;            // Textures built from the JPEG planes unless 0
+    RunStats* stats;                    // Decode timer (--report), may be null
+    DemosaicEngine demosaicEngine;
+    PixelConverter pixelConverter;
+    BayerImage mosaics[NUM_CAMERAS];    // Unpacked before the cameras are debayered together
+    BayerPlanes bayerPlanes[NUM_CAMERAS];
+#ifdef USE_LIBJPEG
+    WorkerPool decodePool;              // Color-separated streams only
+    std::vector<std::unique_ptr<PlaneDecoder>> planeDecoders;   // One per decode thread
+    std::vector<uint16_t> scaledPlanes[NUM_PLANES];             // Decoded planes when planeScale != 0
+#endif
+};
+
+//=============================================================================
+// CpuImageWriter
+//=============================================================================
+
+class CpuImageWriter : public ImageWriter
+{
+public:
+    CpuImageWriter(const JpegOptions& jpegOptions, const LosslessOptions& losslessOptions)
+        : jpegEncoder(jpegOptions), losslessEncoder(losslessOptions)
+    {
+    }
+
+    bool Save(const ImageView& image, const std::string& path, ImageFileFormat format) override
+    {
+        return Encode(image, path, format, encoded) && WriteEncodedFile(encoded, path);
+    }
+
+    bool Encode(const ImageView& image, const std::string& name, ImageFileFormat format,
+                std::vector<unsigned char>& data) override
+    {
+        switch (format)
+        {
+        case ImageFileFormat::JPG:  return jpegEncoder.Encode(image, name, data);
+        case ImageFileFormat::PNG:  return losslessEncoder.EncodePng(image, name, data);
+        case ImageFileFormat::TIFF: return losslessEncoder.EncodeTiff(image, name, data);
+        default:                    return EncodeImage(image, name, format, data);
+        }
+    }
+
+private:
+    // One of each per encoder thread
+    JpegEncoder jpegEncoder;
+    LosslessEncoder losslessEncoder;
+    std::vector<unsigned char> encoded;     // Output of Save, reused
+};
+
+//=============================================================================
+// CpuBackend
+//=============================================================================
+
+class CpuBackend : public ImagingBackend
+{
+public:
+    const char* Name() const override { return "cpu"; }
+
+    bool Initialize(std::vector<StreamSegment>& streamSegments, const BackendOptions& backendOptions,
+                    StreamInfo& info) override
+    {
+        options = backendOptions;
+
+        printf("Initializing CPU backend...\n");
+        stream.reset(new NativeFrameStream());
+        if (!stream->Open(streamSegments))
+        {
+            return false;
+        }
+
+        const PgrStreamHeader& header = stream->Reader(0).Header();
+        if (!DescribeStreamFormat(header, format))
+        {
+            return false;
+        }
+
+        info.serialBase = header.serialBase;
+        info.serialHead = header.serialHead;
+        info.frameRate = header.frameRate;
+        info.dataFormat = header.dataFormat;
+        info.resolution = header.resolution;
+        info.streamVersion = header.version;
+        info.imageCols = format.cols;
+        info.imageRows = format.rows;
+        info.highBitDepth = format.bits > 8;
+        GetTextureSize(options.colorMethod, info.imageCols, info.imageRows, info.textureWidth, info.textureHeight);
+
+        textureWidth = info.textureWidth;
+        textureHeight = info.textureHeight;
+        serialHead = info.serialHead;
+        return true;
+    }
+
+    std::unique_ptr<FrameStream> CreateStream() override
+    {
+        return std::move(stream);
+    }
+
+    std::unique_ptr<FrameConverter> CreateConverter() override
+    {
+        return std::unique_ptr<FrameConverter>(new CpuFrameConverter(format, options));
+    }
+
+    std::unique_ptr<PanoramaRenderer> CreateRenderer() override
+    {
+        // The table only depends on the options, so it is built once
+        if (panoramaLut == nullptr)
+        {
+            PanoramaLutParams params;
+            params.panoWidth = static_cast<unsigned int>(options.panoWidth);
+            params.panoHeight = static_cast<unsigned int>(options.panoHeight);
+            params.textureWidth = textureWidth;
+            params.textureHeight = textureHeight;
+            params.rotFront = options.rotFront;
+            params.rotDown = options.rotDown;
+            params.blendingWidth = static_cast<double>(options.blendingWidth) * textureWidth / format.cols;
+
+            // The nominal geometry ignores the stream's calibration
+            PanoramaLutKey key;
+            key.serialHead = serialHead;
+            key.calibrationHash = HashCalibration(NOMINAL_MODEL_NAME, strlen(NOMINAL_MODEL_NAME));
+
+            printf("Rendering panoramas on the CPU (nominal head geometry)\n");
+            panoramaLut = LoadCachedPanoramaLut(options.cacheDir, key, params);
+            if (panoramaLut == nullptr)
+            {
+                panoramaLut = BuildPanoramaLut(NominalCameraModel(textureWidth, textureHeight), params,
+                                               options.renderThreads);
+                SaveCachedPanoramaLut(options.cacheDir, key, *panoramaLut);
+            }
+        }
+        return std::unique_ptr<PanoramaRenderer>(new LutPanoramaRenderer(panoramaLut, options.renderThreads));
+    }
+
+    std::unique_ptr<ImageWriter> CreateWriter() override
+    {
+        return std::unique_ptr<ImageWriter>(new CpuImageWriter(options.jpeg, options.lossless));
+    }
+
+private:
+    BackendOptions options;
+    CpuStreamFormat format;
+    unsigned int textureWidth = 0;
+    unsigned int textureHeight = 0;
+    unsigned int serialHead = 0;
+    std::unique_ptr<NativeFrameStream> stream;     // Until CreateStream takes it
+    std::shared_ptr<const PanoramaLut> panoramaLut;
+};
+
+std::unique_ptr<ImagingBackend> CreateCpuBackend()
+{
+    return std::unique_ptr<ImagingBackend>(new CpuBackend());
+}
@@ -0,0 +1,161 @@
+//=============================================================================
+// CpuFeatures - Instruction set levels for the CPU pixel kernels
+//=============================================================================
+
+#include "CpuFeatures.h"
+
+#include <atomic>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define CPU_FEATURES_X86
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define CPU_FEATURES_X86
+#endif
+
+//=============================================================================
+// Detection
+//=============================================================================
+
+#ifdef CPU_FEATURES_X86
+
+/**
+ * @brief Run cpuid for a leaf and sub-leaf: eax, ebx, ecx, edx
+ */
+static void Cpuid(unsigned int leaf, unsigned int subLeaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (int i = 0; i < 4; i++)
+    {
+        regs[i] = static_cast<unsigned int>(info[i]);
+    }
+#else
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    __get_cpuid_count(leaf, subLeaf, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+}
+
+/**
+ * @brief Register state the operating system saves on context switches (XCR0)
+ */
+static uint64_t ReadXcr0()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax;
+    unsigned int edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+static IsaLevel DetectIsaLevel()
+{
+    unsigned int regs[4];
+    Cpuid(0, 0, regs);
+    const unsigned int maxLeaf = regs[0];
+    if (maxLeaf < 1)
+    {
+        return IsaLevel::Scalar;
+    }
+
+    Cpuid(1, 0, regs);
+    const bool ssse3 = (regs[2] & (1u << 9)) != 0;
+    const bool sse41 = (regs[2] & (1u << 19)) != 0;
+    const bool fma = (regs[2] & (1u << 12)) != 0;
+    const bool osxsave = (regs[2] & (1u << 27)) != 0;
+    const bool avx = (regs[2] & (1u << 28)) != 0;
+    if (!ssse3 || !sse41)
+    {
+        return IsaLevel::Scalar;
+    }
+
+    // AVX needs the OS to save the YMM registers, AVX-512 also the opmask and ZMM ones
+    const uint64_t xcr0 = osxsave ? ReadXcr0() : 0;
+    const bool ymmState = (xcr0 & 0x06) == 0x06;
+    const bool zmmState = (xcr0 & 0xE6) == 0xE6;
+    if (!avx || !fma || !ymmState || maxLeaf < 7)
+    {
+        return IsaLevel::SSE4;
+    }
+
+    Cpuid(7, 0, regs);
+    const bool avx2 = (regs[1] & (1u << 5)) != 0;
+    const bool avx512f = (regs[1] & (1u << 16)) != 0;
+    const bool avx512dq = (regs[1] & (1u << 17)) != 0;
+    const bool avx512bw = (regs[1] & (1u << 30)) != 0;
+    const bool avx512vl = (regs[1] & (1u << 31)) != 0;
+    if (!avx2)
+    {
+        return IsaLevel::SSE4;
+    }
+    if (!avx512f || !avx512dq || !avx512bw || !avx512vl || !zmmState)
+    {
+        return IsaLevel::AVX2;
+    }
+    return IsaLevel::AVX512;
+}
+
+#else
+
+static IsaLevel DetectIsaLevel()
+{
+    return IsaLevel::Scalar;
+}
+
+#endif
+
+//=============================================================================
+// Levels
+//=============================================================================
+
+static std::atomic<int> isaLimit{NUM_ISA_LEVELS - 1};
+
+const char* GetIsaName(IsaLevel level)
+{
+    switch (level)
+    {
+    case IsaLevel::Scalar:  return "scalar";
+    case IsaLevel::SSE4:    return "sse4";
+    case IsaLevel::AVX2:    return "avx2";
+    case IsaLevel::AVX512:  return "avx512";
+    case IsaLevel::Count:   break;
+    }
+    return "unknown";
+}
+
+bool ParseIsaName(const std::string& name, IsaLevel& level)
+{
+    for (int i = 0; i < NUM_ISA_LEVELS; i++)
+    {
+        if (name == GetIsaName(static_cast<IsaLevel>(i)))
+        {
+            level = static_cast<IsaLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+IsaLevel GetSupportedIsaLevel()
+{
+    static const IsaLevel supported = DetectIsaLevel();
+    return supported;
+}
+
+IsaLevel GetIsaLevel()
+{
+    const int supported = static_cast<int>(GetSupportedIsaLevel());
+    const int limit = isaLimit.load(std::memory_order_relaxed);
+    return static_cast<IsaLevel>(supported < limit ? supported : limit);
+}
+
+void SetIsaLimit(IsaLevel level)
+{
+    isaLimit.store(static_cast<int>(level), std::memory_order_relaxed);
+}
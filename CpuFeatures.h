@@ -0,0 +1,49 @@
+//=============================================================================
+// CpuFeatures - Instruction set levels for the CPU pixel kernels
+//
+// Kernels with vectorized code paths pick one with GetIsaLevel(): the best
+// level the processor supports, capped by SetIsaLimit. The cap lets the
+// microbenchmarks (and bit-exactness checks) run every path on one machine.
+// Processors other than x86 report Scalar.
+//=============================================================================
+
+#pragma once
+
+#include <string>
+
+enum class IsaLevel
+{
+    Scalar,         // Plain C++ (the compiler's baseline, SSE2 on x64)
+    SSE4,           // SSE4.1 and SSSE3
+    AVX2,           // AVX2 and FMA
+    AVX512,         // AVX-512 F, BW, DQ and VL
+    Count
+};
+
+constexpr int NUM_ISA_LEVELS = static_cast<int>(IsaLevel::Count);
+
+/**
+ * @brief Name of a level ("scalar", "sse4", "avx2", "avx512")
+ */
+const char* GetIsaName(IsaLevel level);
+
+/**
+ * @brief Level of a name returned by GetIsaName
+ * @return false for unknown names
+ */
+bool ParseIsaName(const std::string& name, IsaLevel& level);
+
+/**
+ * @brief Best level the processor and operating system support
+ */
+IsaLevel GetSupportedIsaLevel();
+
+/**
+ * @brief Level kernels should use: the supported level, capped by SetIsaLimit
+ */
+IsaLevel GetIsaLevel();
+
+/**
+ * @brief Cap the level kernels use (not thread-safe against running kernels)
+ */
+void SetIsaLimit(IsaLevel level);
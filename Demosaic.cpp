@@ -0,0 +1,1118 @@
+//=============================================================================
+// Demosaic - CPU debayering of Ladybug camera images
+//=============================================================================
+
+#include "Demosaic.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define DEMOSAIC_AVX2
+#define DEMOSAIC_SIMD
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define DEMOSAIC_NEON
+#define DEMOSAIC_SIMD
+#endif
+
+// GCC and Clang compile the AVX2 code for its own instruction set; MSVC
+// accepts the intrinsics anywhere and NEON is always available on AArch64
+#if defined(DEMOSAIC_AVX2) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET
+#endif
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+// Texture rows per DemosaicEngine task
+constexpr unsigned int ROWS_PER_TASK = 32;
+
+enum BayerColor
+{
+    RED = 0,
+    GREEN = 1,
+    BLUE = 2
+};
+
+// Colour at (x & 1, y & 1), indexed [pattern][y & 1][x & 1]
+static const int PATTERN_COLORS[4][2][2] =
+{
+    { { BLUE, GREEN }, { GREEN, RED } },    // BGGR
+    { { GREEN, BLUE }, { RED, GREEN } },    // GBRG
+    { { GREEN, RED }, { BLUE, GREEN } },    // GRBG
+    { { RED, GREEN }, { GREEN, BLUE } },    // RGGB
+};
+
+//=============================================================================
+// BayerImage
+//=============================================================================
+
+void BayerImage::Resize(unsigned int newCols, unsigned int newRows, bool newIs16Bit, BayerPattern newPattern)
+{
+    cols = newCols;
+    rows = newRows;
+    is16Bit = newIs16Bit;
+    pattern = newPattern;
+
+    // Stride in samples of the stored type; 8-bit mosaics pack two samples
+    // per uint16_t of storage
+    stride = static_cast<size_t>(cols) + 2 * BAYER_BORDER;
+    const size_t samples = stride * (static_cast<size_t>(rows) + 2 * BAYER_BORDER);
+    const size_t elements = is16Bit ? samples : (samples + 1) / 2;
+    if (storage.size() < elements)
+    {
+        storage.resize(elements);
+    }
+}
+
+template <typename T>
+static T* GetRow(BayerImage& image, int y);
+
+template <>
+uint8_t* GetRow<uint8_t>(BayerImage& image, int y) { return image.Row8(y); }
+
+template <>
+uint16_t* GetRow<uint16_t>(BayerImage& image, int y) { return image.Row16(y); }
+
+template <typename T>
+static const T* GetRow(const BayerImage& image, int y);
+
+template <>
+const uint8_t* GetRow<uint8_t>(const BayerImage& image, int y) { return image.Row8(y); }
+
+template <>
+const uint16_t* GetRow<uint16_t>(const BayerImage& image, int y) { return image.Row16(y); }
+
+/**
+ * @brief Mirror about the first/last row and column (x[-i] = x[i]), which
+ *        keeps the colour of every border sample
+ */
+template <typename T>
+static void FillBorderT(BayerImage& image)
+{
+    const int cols = static_cast<int>(image.Cols());
+    const int rows = static_cast<int>(image.Rows());
+    const int border = static_cast<int>(BAYER_BORDER);
+
+    for (int y = 0; y < rows; y++)
+    {
+        T* row = GetRow<T>(image, y);
+        for (int i = 1; i <= border; i++)
+        {
+            row[-i] = row[std::min(i, cols - 1)];
+            row[cols - 1 + i] = row[std::max(cols - 1 - i, 0)];
+        }
+    }
+
+    const size_t rowBytes = image.Stride() * sizeof(T);
+    for (int i = 1; i <= border; i++)
+    {
+        memcpy(GetRow<T>(image, -i) - border, GetRow<T>(image, std::min(i, rows - 1)) - border, rowBytes);
+        memcpy(GetRow<T>(image, rows - 1 + i) - border, GetRow<T>(image, std::max(rows - 1 - i, 0)) - border, rowBytes);
+    }
+}
+
+void BayerImage::FillBorder()
+{
+    if (cols == 0 || rows == 0)
+    {
+        return;
+    }
+    if (is16Bit)
+    {
+        FillBorderT<uint16_t>(*this);
+    }
+    else
+    {
+        FillBorderT<uint8_t>(*this);
+    }
+}
+
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+template <typename T>
+static inline void StorePixel(T* out, int red, int green, int blue)
+{
+    const int maxValue = static_cast<int>(static_cast<T>(~0));
+    out[0] = static_cast<T>(std::min(std::max(blue, 0), maxValue));
+    out[1] = static_cast<T>(std::min(std::max(green, 0), maxValue));
+    out[2] = static_cast<T>(std::min(std::max(red, 0), maxValue));
+    out[3] = static_cast<T>(maxValue);
+}
+
+/**
+ * @brief Output rows of a texture; rowStep is larger than a row when every
+ *        row is written more than once (half-height images)
+ */
+template <typename T>
+struct TextureRows
+{
+    T* texture;
+    size_t rowStep;                     // Samples from one output row to the next
+
+    T* Row(int y) const { return texture + static_cast<size_t>(y) * rowStep; }
+};
+
+/**
+ * @brief Column (0 or 1) of green in a row of the pattern
+ */
+static inline int GetGreenColumn(const int rowColors[2])
+{
+    return rowColors[0] == GREEN ? 0 : 1;
+}
+
+//=============================================================================
+// Vector Operations
+//=============================================================================
+//
+// The vector row kernels are written once against Simd, a handful of
+// operations on LANES 32-bit lanes: AVX2 on x86 (when GetIsaLevel allows
+// it) and NEON on AArch64 (always present). Samples are widened to 32 bits,
+// so the same kernels serve 8 and 16-bit mosaics and give exactly the
+// results of the scalar code, which finishes each row.
+
+#ifdef DEMOSAIC_AVX2
+
+struct Simd
+{
+    typedef __m256i V;
+    typedef __m256i Mask;
+    static constexpr int LANES = 8;
+
+    SIMD_TARGET static V Load(const uint8_t* p)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    }
+    SIMD_TARGET static V Load(const uint16_t* p)
+    {
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    SIMD_TARGET static V Load(const int* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    SIMD_TARGET static void Store(int* p, V a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a); }
+
+    SIMD_TARGET static V Set(int value) { return _mm256_set1_epi32(value); }
+    SIMD_TARGET static V Add(V a, V b) { return _mm256_add_epi32(a, b); }
+    SIMD_TARGET static V Sub(V a, V b) { return _mm256_sub_epi32(a, b); }
+    SIMD_TARGET static V Mul(V a, int factor) { return _mm256_mullo_epi32(a, _mm256_set1_epi32(factor)); }
+    SIMD_TARGET static V Abs(V a) { return _mm256_abs_epi32(a); }
+    SIMD_TARGET static V Min(V a, V b) { return _mm256_min_epi32(a, b); }
+    SIMD_TARGET static V Max(V a, V b) { return _mm256_max_epi32(a, b); }
+    template <int N>
+    SIMD_TARGET static V Shl(V a) { return _mm256_slli_epi32(a, N); }
+    template <int N>
+    SIMD_TARGET static V Shr(V a) { return _mm256_srai_epi32(a, N); }     // Arithmetic, as >> on int
+
+    SIMD_TARGET static Mask Less(V a, V b) { return _mm256_cmpgt_epi32(b, a); }
+    SIMD_TARGET static V Select(Mask mask, V a, V b) { return _mm256_blendv_epi8(b, a, mask); }
+
+    /**
+     * @brief Lanes of the even (column 0) or odd (column 1) pixels
+     */
+    SIMD_TARGET static Mask ColumnLanes(int column)
+    {
+        const __m256i odd = _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+        return column != 0 ? odd : _mm256_xor_si256(odd, _mm256_set1_epi32(-1));
+    }
+
+    // a0 a0 a2 a2 ...
+    SIMD_TARGET static V DuplicateEven(V a) { return _mm256_shuffle_epi32(a, _MM_SHUFFLE(2, 2, 0, 0)); }
+
+    // a0 a2 ... b0 b2 ... and a1 a3 ... b1 b3 ... (shuffle_ps works per
+    // 128-bit half, the permute puts the halves in order)
+    SIMD_TARGET static V Evens(V a, V b)
+    {
+        const __m256 mixed = _mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+        return _mm256_permute4x64_epi64(_mm256_castps_si256(mixed), 0xD8);
+    }
+    SIMD_TARGET static V Odds(V a, V b)
+    {
+        const __m256 mixed = _mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(3, 1, 3, 1));
+        return _mm256_permute4x64_epi64(_mm256_castps_si256(mixed), 0xD8);
+    }
+
+    // a0+a1 a2+a3 ... b0+b1 b2+b3 ...
+    SIMD_TARGET static V PairSums(V a, V b) { return _mm256_permute4x64_epi64(_mm256_hadd_epi32(a, b), 0xD8); }
+
+    /**
+     * @brief Clamp and store LANES BGRU pixels
+     */
+    SIMD_TARGET static void StorePixels(uint8_t* out, V blue, V green, V red)
+    {
+        const V zero = _mm256_setzero_si256();
+        const V maxValue = Set(0xFF);
+        blue = Min(Max(blue, zero), maxValue);
+        green = Min(Max(green, zero), maxValue);
+        red = Min(Max(red, zero), maxValue);
+        const V pixels = _mm256_or_si256(_mm256_or_si256(blue, Shl<8>(green)),
+                                         _mm256_or_si256(Shl<16>(red), Set(static_cast<int>(0xFF000000u))));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), pixels);
+    }
+
+    /**
+     * @brief Clamp and store LANES BGRU16 pixels
+     */
+    SIMD_TARGET static void StorePixels(uint16_t* out, V blue, V green, V red)
+    {
+        const V zero = _mm256_setzero_si256();
+        const V maxValue = Set(0xFFFF);
+        blue = Min(Max(blue, zero), maxValue);
+        green = Min(Max(green, zero), maxValue);
+        red = Min(Max(red, zero), maxValue);
+        const V blueGreen = _mm256_or_si256(blue, Shl<16>(green));
+        const V redUnused = _mm256_or_si256(red, Set(static_cast<int>(0xFFFF0000u)));
+        const V low = _mm256_unpacklo_epi32(blueGreen, redUnused);     // Pixels 0 1 4 5
+        const V high = _mm256_unpackhi_epi32(blueGreen, redUnused);    // Pixels 2 3 6 7
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permute2x128_si256(low, high, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 16), _mm256_permute2x128_si256(low, high, 0x31));
+    }
+};
+
+static bool UseSimd()
+{
+    return GetIsaLevel() >= IsaLevel::AVX2;
+}
+
+#endif
+
+#ifdef DEMOSAIC_NEON
+
+struct Simd
+{
+    typedef int32x4_t V;
+    typedef uint32x4_t Mask;
+    static constexpr int LANES = 4;
+
+    static V Load(const uint8_t* p)
+    {
+        uint32_t bytes;
+        memcpy(&bytes, p, sizeof(bytes));
+        const uint8x8_t samples = vreinterpret_u8_u32(vdup_n_u32(bytes));
+        return vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(vmovl_u8(samples))));
+    }
+    static V Load(const uint16_t* p) { return vreinterpretq_s32_u32(vmovl_u16(vld1_u16(p))); }
+    static V Load(const int* p) { return vld1q_s32(p); }
+    static void Store(int* p, V a) { vst1q_s32(p, a); }
+
+    static V Set(int value) { return vdupq_n_s32(value); }
+    static V Add(V a, V b) { return vaddq_s32(a, b); }
+    static V Sub(V a, V b) { return vsubq_s32(a, b); }
+    static V Mul(V a, int factor) { return vmulq_n_s32(a, factor); }
+    static V Abs(V a) { return vabsq_s32(a); }
+    static V Min(V a, V b) { return vminq_s32(a, b); }
+    static V Max(V a, V b) { return vmaxq_s32(a, b); }
+    template <int N>
+    static V Shl(V a) { return vshlq_s32(a, vdupq_n_s32(N)); }
+    template <int N>
+    static V Shr(V a) { return vshlq_s32(a, vdupq_n_s32(-N)); }          // Arithmetic, as >> on int
+
+    static Mask Less(V a, V b) { return vcltq_s32(a, b); }
+    static V Select(Mask mask, V a, V b) { return vbslq_s32(mask, a, b); }
+
+    static Mask ColumnLanes(int column)
+    {
+        static const uint32_t LANE_MASKS[2][4] = { { ~0u, 0, ~0u, 0 }, { 0, ~0u, 0, ~0u } };
+        return vld1q_u32(LANE_MASKS[column != 0 ? 1 : 0]);
+    }
+
+    static V DuplicateEven(V a) { return vtrn1q_s32(a, a); }
+    static V Evens(V a, V b) { return vuzp1q_s32(a, b); }
+    static V Odds(V a, V b) { return vuzp2q_s32(a, b); }
+    static V PairSums(V a, V b) { return vpaddq_s32(a, b); }
+
+    static void StorePixels(uint8_t* out, V blue, V green, V red)
+    {
+        const V zero = Set(0);
+        const V maxValue = Set(0xFF);
+        blue = Min(Max(blue, zero), maxValue);
+        green = Min(Max(green, zero), maxValue);
+        red = Min(Max(red, zero), maxValue);
+        const V pixels = vorrq_s32(vorrq_s32(blue, Shl<8>(green)),
+                                   vorrq_s32(Shl<16>(red), Set(static_cast<int>(0xFF000000u))));
+        vst1q_u8(out, vreinterpretq_u8_s32(pixels));
+    }
+
+    static void StorePixels(uint16_t* out, V blue, V green, V red)
+    {
+        const V zero = Set(0);
+        const V maxValue = Set(0xFFFF);
+        blue = Min(Max(blue, zero), maxValue);
+        green = Min(Max(green, zero), maxValue);
+        red = Min(Max(red, zero), maxValue);
+        const V blueGreen = vorrq_s32(blue, Shl<16>(green));
+        const V redUnused = vorrq_s32(red, Set(static_cast<int>(0xFFFF0000u)));
+        vst1q_u16(out, vreinterpretq_u16_s32(vzip1q_s32(blueGreen, redUnused)));
+        vst1q_u16(out + 8, vreinterpretq_u16_s32(vzip2q_s32(blueGreen, redUnused)));
+    }
+};
+
+static bool UseSimd()
+{
+    return true;
+}
+
+#endif
+
+//=============================================================================
+// Vector Row Kernels
+//=============================================================================
+//
+// Each kernel converts the longest prefix of a row that is a multiple of
+// LANES pixels and returns its length. Row starts are even, so the lanes of
+// column 0 and 1 of the pattern are fixed; where the scalar code branches
+// on a pixel's colour, the kernels compute both results and select.
+
+#ifdef DEMOSAIC_SIMD
+
+template <typename T>
+SIMD_TARGET static int HqLinearRowSimd(const T* p, ptrdiff_t s, T* out, int cols, int greenColumn, bool redRow)
+{
+    typedef Simd::V V;
+    const Simd::Mask green = Simd::ColumnLanes(greenColumn);
+    const V round = Simd::Set(8);
+
+    int x = 0;
+    for (; x + Simd::LANES <= cols; x += Simd::LANES, p += Simd::LANES, out += 4 * Simd::LANES)
+    {
+        const V c = Simd::Load(p);
+        const V horizontal1 = Simd::Add(Simd::Load(p - 1), Simd::Load(p + 1));
+        const V vertical1 = Simd::Add(Simd::Load(p - s), Simd::Load(p + s));
+        const V horizontal2 = Simd::Add(Simd::Load(p - 2), Simd::Load(p + 2));
+        const V vertical2 = Simd::Add(Simd::Load(p - 2 * s), Simd::Load(p + 2 * s));
+        const V diagonal = Simd::Add(Simd::Add(Simd::Load(p - s - 1), Simd::Load(p - s + 1)),
+                                     Simd::Add(Simd::Load(p + s - 1), Simd::Load(p + s + 1)));
+        const V axial2 = Simd::Add(horizontal2, vertical2);
+
+        // Green pixels: the row's other colour and the column's
+        const V greenBase = Simd::Sub(Simd::Add(Simd::Mul(c, 10), round), Simd::Mul(diagonal, 2));
+        const V horizontal = Simd::Shr<4>(Simd::Add(
+            Simd::Sub(Simd::Add(greenBase, Simd::Mul(horizontal1, 8)), Simd::Mul(horizontal2, 2)), vertical2));
+        const V vertical = Simd::Shr<4>(Simd::Add(
+            Simd::Sub(Simd::Add(greenBase, Simd::Mul(vertical1, 8)), Simd::Mul(vertical2, 2)), horizontal2));
+
+        // Red and blue pixels: green and the diagonal colour
+        const V cross = Simd::Shr<4>(Simd::Sub(
+            Simd::Add(Simd::Add(Simd::Mul(c, 8), Simd::Mul(Simd::Add(horizontal1, vertical1), 4)), round),
+            Simd::Mul(axial2, 2)));
+        const V opposite = Simd::Shr<4>(Simd::Sub(
+            Simd::Add(Simd::Add(Simd::Mul(c, 12), Simd::Mul(diagonal, 4)), round), Simd::Mul(axial2, 3)));
+
+        const V rowColor = Simd::Select(green, horizontal, c);
+        const V greenValue = Simd::Select(green, c, cross);
+        const V otherColor = Simd::Select(green, vertical, opposite);
+        if (redRow)
+        {
+            Simd::StorePixels(out, otherColor, greenValue, rowColor);
+        }
+        else
+        {
+            Simd::StorePixels(out, rowColor, greenValue, otherColor);
+        }
+    }
+    return x;
+}
+
+template <typename T>
+SIMD_TARGET static int EdgeSensingGreenRowSimd(const T* p, ptrdiff_t s, int* g, int cols, int greenColumn)
+{
+    typedef Simd::V V;
+    const Simd::Mask green = Simd::ColumnLanes(greenColumn);
+    const V two = Simd::Set(2);
+    const V four = Simd::Set(4);
+
+    int x = 0;
+    for (; x + Simd::LANES <= cols; x += Simd::LANES, p += Simd::LANES, g += Simd::LANES)
+    {
+        const V c = Simd::Load(p);
+        const V c2 = Simd::Shl<1>(c);
+        const V left = Simd::Load(p - 1);
+        const V right = Simd::Load(p + 1);
+        const V up = Simd::Load(p - s);
+        const V down = Simd::Load(p + s);
+        const V outerH = Simd::Add(Simd::Load(p - 2), Simd::Load(p + 2));
+        const V outerV = Simd::Add(Simd::Load(p - 2 * s), Simd::Load(p + 2 * s));
+
+        const V gradientH = Simd::Add(Simd::Abs(Simd::Sub(left, right)), Simd::Abs(Simd::Sub(c2, outerH)));
+        const V gradientV = Simd::Add(Simd::Abs(Simd::Sub(up, down)), Simd::Abs(Simd::Sub(c2, outerV)));
+        const V estimateH = Simd::Sub(Simd::Add(Simd::Shl<1>(Simd::Add(left, right)), c2), outerH);
+        const V estimateV = Simd::Sub(Simd::Add(Simd::Shl<1>(Simd::Add(up, down)), c2), outerV);
+
+        V value = Simd::Shr<3>(Simd::Add(Simd::Add(estimateH, estimateV), four));
+        value = Simd::Select(Simd::Less(gradientV, gradientH), Simd::Shr<2>(Simd::Add(estimateV, two)), value);
+        value = Simd::Select(Simd::Less(gradientH, gradientV), Simd::Shr<2>(Simd::Add(estimateH, two)), value);
+        Simd::Store(g, Simd::Select(green, c, value));
+    }
+    return x;
+}
+
+template <typename T>
+SIMD_TARGET static int EdgeSensingColorRowSimd(const T* p, ptrdiff_t s, const int* g, ptrdiff_t gs, T* out,
+                                               int cols, int greenColumn, bool redRow)
+{
+    typedef Simd::V V;
+    const Simd::Mask green = Simd::ColumnLanes(greenColumn);
+
+    int x = 0;
+    for (; x + Simd::LANES <= cols;
+         x += Simd::LANES, p += Simd::LANES, g += Simd::LANES, out += 4 * Simd::LANES)
+    {
+        const V c = Simd::Load(p);
+        const V g0 = Simd::Load(g);
+        const V horizontal = Simd::Add(g0, Simd::Shr<1>(Simd::Add(Simd::Sub(Simd::Load(p - 1), Simd::Load(g - 1)),
+                                                                  Simd::Sub(Simd::Load(p + 1), Simd::Load(g + 1)))));
+        const V vertical = Simd::Add(g0, Simd::Shr<1>(Simd::Add(Simd::Sub(Simd::Load(p - s), Simd::Load(g - gs)),
+                                                                Simd::Sub(Simd::Load(p + s), Simd::Load(g + gs)))));
+        const V difference = Simd::Add(
+            Simd::Add(Simd::Sub(Simd::Load(p - s - 1), Simd::Load(g - gs - 1)),
+                      Simd::Sub(Simd::Load(p - s + 1), Simd::Load(g - gs + 1))),
+            Simd::Add(Simd::Sub(Simd::Load(p + s - 1), Simd::Load(g + gs - 1)),
+                      Simd::Sub(Simd::Load(p + s + 1), Simd::Load(g + gs + 1))));
+
+        const V rowColor = Simd::Select(green, horizontal, c);
+        const V otherColor = Simd::Select(green, vertical, Simd::Add(g0, Simd::Shr<2>(difference)));
+        if (redRow)
+        {
+            Simd::StorePixels(out, otherColor, g0, rowColor);
+        }
+        else
+        {
+            Simd::StorePixels(out, rowColor, g0, otherColor);
+        }
+    }
+    return x;
+}
+
+/**
+ * @brief red, green and blue point at the sample of each colour in the
+ *        first cell of the row; every pixel of a cell gets the cell's values
+ */
+template <typename T>
+SIMD_TARGET static int NearestRowSimd(const T* red, const T* green, const T* blue, T* out, int cols)
+{
+    int x = 0;
+    for (; x + Simd::LANES <= cols; x += Simd::LANES, out += 4 * Simd::LANES)
+    {
+        Simd::StorePixels(out, Simd::DuplicateEven(Simd::Load(blue + x)), Simd::DuplicateEven(Simd::Load(green + x)),
+                          Simd::DuplicateEven(Simd::Load(red + x)));
+    }
+    return x;
+}
+
+/**
+ * @brief rows holds the 2 * BLOCKS mosaic rows of the output row
+ */
+template <int BLOCKS, typename T>
+SIMD_TARGET static int DownsampleRowSimd(const T* const rows[], T* out, int cols, const int (*colors)[2])
+{
+    typedef Simd::V V;
+    constexpr int SIZE = 2 * BLOCKS;
+    constexpr int CELLS = BLOCKS * BLOCKS;
+    constexpr int CELL_SHIFT = BLOCKS == 1 ? 0 : 2;     // log2(CELLS)
+    const int L = Simd::LANES;
+
+    int x = 0;
+    for (; x + L <= cols; x += L, out += 4 * L)
+    {
+        V sums[3] = { Simd::Set(0), Simd::Set(0), Simd::Set(0) };
+        for (int dy = 0; dy < SIZE; dy++)
+        {
+            const T* row = rows[dy] + x * SIZE;
+            V even;
+            V odd;
+            if (BLOCKS == 1)
+            {
+                const V a = Simd::Load(row);
+                const V b = Simd::Load(row + L);
+                even = Simd::Evens(a, b);
+                odd = Simd::Odds(a, b);
+            }
+            else
+            {
+                const V a = Simd::Load(row);
+                const V b = Simd::Load(row + L);
+                const V c = Simd::Load(row + 2 * L);
+                const V d = Simd::Load(row + 3 * L);
+                even = Simd::PairSums(Simd::Evens(a, b), Simd::Evens(c, d));
+                odd = Simd::PairSums(Simd::Odds(a, b), Simd::Odds(c, d));
+            }
+            sums[colors[dy & 1][0]] = Simd::Add(sums[colors[dy & 1][0]], even);
+            sums[colors[dy & 1][1]] = Simd::Add(sums[colors[dy & 1][1]], odd);
+        }
+        Simd::StorePixels(out, Simd::Shr<CELL_SHIFT>(Simd::Add(sums[BLUE], Simd::Set(CELLS / 2))),
+                          Simd::Shr<CELL_SHIFT + 1>(Simd::Add(sums[GREEN], Simd::Set(CELLS))),
+                          Simd::Shr<CELL_SHIFT>(Simd::Add(sums[RED], Simd::Set(CELLS / 2))));
+    }
+    return x;
+}
+
+template <typename T>
+SIMD_TARGET static int MonoRowSimd(const T* row, T* out, int cols)
+{
+    int x = 0;
+    for (; x + Simd::LANES <= cols; x += Simd::LANES, out += 4 * Simd::LANES)
+    {
+        const Simd::V value = Simd::Load(row + x);
+        Simd::StorePixels(out, value, value, value);
+    }
+    return x;
+}
+
+/**
+ * @brief One texture row from the rows of the red, green and blue planes
+ */
+template <typename T>
+SIMD_TARGET static int PlanesRowSimd(const uint16_t* red, const uint16_t* green1, const uint16_t* green2,
+                                     const uint16_t* blue, T* out, int cols)
+{
+    int x = 0;
+    for (; x + Simd::LANES <= cols; x += Simd::LANES, out += 4 * Simd::LANES)
+    {
+        const Simd::V green = Simd::Add(Simd::Load(green1 + x), Simd::Load(green2 + x));
+        Simd::StorePixels(out, Simd::Load(blue + x), Simd::Shr<1>(Simd::Add(green, Simd::Set(1))), Simd::Load(red + x));
+    }
+    return x;
+}
+
+#endif
+
+//=============================================================================
+// Methods
+//=============================================================================
+//
+// Each method converts the output rows [firstRow, endRow), so an image can
+// be split into bands that are debayered independently.
+
+/**
+ * @brief Malvar-He-Cutler: bilinear plus a Laplacian correction from the
+ *        centre sample (5x5 kernels, weights in sixteenths)
+ */
+template <typename T>
+static void DemosaicHqLinear(const BayerImage& mosaic, const TextureRows<T>& target, int firstRow, int endRow)
+{
+    const int cols = static_cast<int>(mosaic.Cols());
+    const ptrdiff_t s = static_cast<ptrdiff_t>(mosaic.Stride());
+    const int (*colors)[2] = PATTERN_COLORS[static_cast<int>(mosaic.Pattern())];
+
+    for (int y = firstRow; y < endRow; y++)
+    {
+        const T* p = GetRow<T>(mosaic, y);
+        T* out = target.Row(y);
+        int x = 0;
+#ifdef DEMOSAIC_SIMD
+        if (UseSimd())
+        {
+            const int greenColumn = GetGreenColumn(colors[y & 1]);
+            x = HqLinearRowSimd(p, s, out, cols, greenColumn, colors[y & 1][1 - greenColumn] == RED);
+            p += x;
+            out += 4 * x;
+        }
+#endif
+
+        for (; x < cols; x++, p++, out += 4)
+        {
+            const int color = colors[y & 1][x & 1];
+            const int c = p[0];
+            const int axial = p[-s] + p[s] + p[-1] + p[1];
+            const int axial2 = p[-2 * s] + p[2 * s] + p[-2] + p[2];
+            const int diagonal = p[-s - 1] + p[-s + 1] + p[s - 1] + p[s + 1];
+            int rgb[3];
+
+            if (color == GREEN)
+            {
+                const int horizontal = (10 * c + 8 * (p[-1] + p[1]) - 2 * diagonal - 2 * (p[-2] + p[2]) +
+                                        (p[-2 * s] + p[2 * s]) + 8) >> 4;
+                const int vertical = (10 * c + 8 * (p[-s] + p[s]) - 2 * diagonal - 2 * (p[-2 * s] + p[2 * s]) +
+                                      (p[-2] + p[2]) + 8) >> 4;
+                rgb[GREEN] = c;
+                rgb[colors[y & 1][(x + 1) & 1]] = horizontal;
+                rgb[colors[(y + 1) & 1][x & 1]] = vertical;
+            }
+            else
+            {
+                rgb[color] = c;
+                rgb[GREEN] = (8 * c + 4 * axial - 2 * axial2 + 8) >> 4;
+                rgb[2 - color] = (12 * c + 4 * diagonal - 3 * axial2 + 8) >> 4;
+            }
+
+            StorePixel(out, rgb[RED], rgb[GREEN], rgb[BLUE]);
+        }
+    }
+}
+
+/**
+ * @brief Edge-directed green (Hamilton-Adams), then red and blue from the
+ *        interpolated colour difference to green
+ */
+template <typename T>
+static void DemosaicEdgeSensing(const BayerImage& mosaic, const TextureRows<T>& target, int firstRow, int endRow)
+{
+    const int cols = static_cast<int>(mosaic.Cols());
+    const int rows = static_cast<int>(mosaic.Rows());
+    const ptrdiff_t s = static_cast<ptrdiff_t>(mosaic.Stride());
+    const int (*colors)[2] = PATTERN_COLORS[static_cast<int>(mosaic.Pattern())];
+
+    // Green plane of the band and the row above and below it, with a one
+    // pixel mirrored border; kept per thread between calls
+    const ptrdiff_t gs = cols + 2;
+    thread_local std::vector<int> greenPlane;
+    greenPlane.resize(static_cast<size_t>(gs) * (endRow - firstRow + 2));
+    auto greenRow = [&](int y) { return greenPlane.data() + (y - firstRow + 1) * gs + 1; };
+
+    const int endGreen = std::min(endRow + 1, rows);
+    for (int y = std::max(firstRow - 1, 0); y < endGreen; y++)
+    {
+        const T* p = GetRow<T>(mosaic, y);
+        int* g = greenRow(y);
+        int x = 0;
+#ifdef DEMOSAIC_SIMD
+        if (UseSimd())
+        {
+            x = EdgeSensingGreenRowSimd(p, s, g, cols, GetGreenColumn(colors[y & 1]));
+            p += x;
+            g += x;
+        }
+#endif
+
+        for (; x < cols; x++, p++, g++)
+        {
+            const int c = p[0];
+            if (colors[y & 1][x & 1] == GREEN)
+            {
+                *g = c;
+                continue;
+            }
+
+            const int gradientH = abs(p[-1] - p[1]) + abs(2 * c - p[-2] - p[2]);
+            const int gradientV = abs(p[-s] - p[s]) + abs(2 * c - p[-2 * s] - p[2 * s]);
+            const int estimateH = 2 * (p[-1] + p[1]) + 2 * c - p[-2] - p[2];
+            const int estimateV = 2 * (p[-s] + p[s]) + 2 * c - p[-2 * s] - p[2 * s];
+
+            if (gradientH < gradientV)
+            {
+                *g = (estimateH + 2) >> 2;
+            }
+            else if (gradientV < gradientH)
+            {
+                *g = (estimateV + 2) >> 2;
+            }
+            else
+            {
+                *g = (estimateH + estimateV + 4) >> 3;
+            }
+        }
+        g[0] = g[-2];
+        greenRow(y)[-1] = greenRow(y)[1];
+    }
+    if (firstRow == 0)
+    {
+        memcpy(greenRow(-1) - 1, greenRow(1) - 1, gs * sizeof(int));
+    }
+    if (endRow == rows)
+    {
+        memcpy(greenRow(rows) - 1, greenRow(rows - 2) - 1, gs * sizeof(int));
+    }
+
+    for (int y = firstRow; y < endRow; y++)
+    {
+        const T* p = GetRow<T>(mosaic, y);
+        const int* g = greenRow(y);
+        T* out = target.Row(y);
+        int x = 0;
+#ifdef DEMOSAIC_SIMD
+        if (UseSimd())
+        {
+            const int greenColumn = GetGreenColumn(colors[y & 1]);
+            x = EdgeSensingColorRowSimd(p, s, g, gs, out, cols, greenColumn, colors[y & 1][1 - greenColumn] == RED);
+            p += x;
+            g += x;
+            out += 4 * x;
+        }
+#endif
+
+        for (; x < cols; x++, p++, g++, out += 4)
+        {
+            const int color = colors[y & 1][x & 1];
+            int rgb[3];
+            rgb[GREEN] = g[0];
+
+            if (color == GREEN)
+            {
+                const int horizontal = g[0] + (((p[-1] - g[-1]) + (p[1] - g[1])) >> 1);
+                const int vertical = g[0] + (((p[-s] - g[-gs]) + (p[s] - g[gs])) >> 1);
+                rgb[colors[y & 1][(x + 1) & 1]] = horizontal;
+                rgb[colors[(y + 1) & 1][x & 1]] = vertical;
+            }
+            else
+            {
+                const int difference = (p[-s - 1] - g[-gs - 1]) + (p[-s + 1] - g[-gs + 1]) +
+                                       (p[s - 1] - g[gs - 1]) + (p[s + 1] - g[gs + 1]);
+                rgb[color] = p[0];
+                rgb[2 - color] = g[0] + (difference >> 2);
+            }
+
+            StorePixel(out, rgb[RED], rgb[GREEN], rgb[BLUE]);
+        }
+    }
+}
+
+/**
+ * @brief Every pixel of a 2x2 cell gets the cell's red and blue and the
+ *        green of its own row
+ */
+template <typename T>
+static void DemosaicNearest(const BayerImage& mosaic, const TextureRows<T>& target, int firstRow, int endRow)
+{
+    const int cols = static_cast<int>(mosaic.Cols());
+    const int (*colors)[2] = PATTERN_COLORS[static_cast<int>(mosaic.Pattern())];
+
+    for (int y = firstRow; y < endRow; y++)
+    {
+        const int cellY = y & ~1;
+        const T* cellRows[2] = { GetRow<T>(mosaic, cellY), GetRow<T>(mosaic, cellY + 1) };
+        const T* row = GetRow<T>(mosaic, y);
+        T* out = target.Row(y);
+        int x = 0;
+#ifdef DEMOSAIC_SIMD
+        if (UseSimd())
+        {
+            // Sample of each colour in the first cell
+            const T* samples[3] = { nullptr, nullptr, nullptr };
+            for (int dy = 0; dy < 2; dy++)
+            {
+                for (int dx = 0; dx < 2; dx++)
+                {
+                    const int color = colors[dy][dx];
+                    if (color != GREEN)
+                    {
+                        samples[color] = cellRows[dy] + dx;
+                    }
+                    else if (dy == (y & 1))
+                    {
+                        samples[GREEN] = row + dx;
+                    }
+                }
+            }
+            x = NearestRowSimd(samples[RED], samples[GREEN], samples[BLUE], out, cols);
+            out += 4 * x;
+        }
+#endif
+
+        for (; x < cols; x++, out += 4)
+        {
+            const int cellX = x & ~1;
+            int rgb[3] = { 0, 0, 0 };
+            for (int dy = 0; dy < 2; dy++)
+            {
+                for (int dx = 0; dx < 2; dx++)
+                {
+                    const int color = colors[dy][dx];
+                    if (color != GREEN)
+                    {
+                        rgb[color] = cellRows[dy][cellX + dx];
+                    }
+                    else if (dy == (y & 1))
+                    {
+                        rgb[GREEN] = row[cellX + dx];
+                    }
+                }
+            }
+            StorePixel(out, rgb[RED], rgb[GREEN], rgb[BLUE]);
+        }
+    }
+}
+
+/**
+ * @brief One output pixel per (2 * BLOCKS) x (2 * BLOCKS) area, averaging
+ *        each colour (Downsample4: BLOCKS = 1, Downsample16: BLOCKS = 2)
+ */
+template <int BLOCKS, typename T>
+static void DemosaicDownsample(const BayerImage& mosaic, const TextureRows<T>& target, int firstRow, int endRow)
+{
+    const int size = 2 * BLOCKS;
+    const int cols = static_cast<int>(mosaic.Cols()) / size;
+    const int (*colors)[2] = PATTERN_COLORS[static_cast<int>(mosaic.Pattern())];
+    const int cells = BLOCKS * BLOCKS;
+
+    for (int y = firstRow; y < endRow; y++)
+    {
+        const T* rows[2 * BLOCKS];
+        for (int dy = 0; dy < size; dy++)
+        {
+            rows[dy] = GetRow<T>(mosaic, y * size + dy);
+        }
+        T* out = target.Row(y);
+        int x = 0;
+#ifdef DEMOSAIC_SIMD
+        if (UseSimd())
+        {
+            x = DownsampleRowSimd<BLOCKS>(rows, out, cols, colors);
+            out += 4 * x;
+        }
+#endif
+
+        for (; x < cols; x++, out += 4)
+        {
+            int sums[3] = { 0, 0, 0 };
+            for (int dy = 0; dy < size; dy++)
+            {
+                const T* row = rows[dy] + x * size;
+                for (int dx = 0; dx < size; dx++)
+                {
+                    sums[colors[dy & 1][dx & 1]] += row[dx];
+                }
+            }
+            StorePixel(out, (sums[RED] + cells / 2) / cells, (sums[GREEN] + cells) / (2 * cells),
+                       (sums[BLUE] + cells / 2) / cells);
+        }
+    }
+}
+
+template <typename T>
+static void DemosaicMono(const BayerImage& mosaic, const TextureRows<T>& target, int firstRow, int endRow)
+{
+    const int cols = static_cast<int>(mosaic.Cols());
+
+    for (int y = firstRow; y < endRow; y++)
+    {
+        const T* row = GetRow<T>(mosaic, y);
+        T* out = target.Row(y);
+        int x = 0;
+#ifdef DEMOSAIC_SIMD
+        if (UseSimd())
+        {
+            x = MonoRowSimd(row, out, cols);
+            out += 4 * x;
+        }
+#endif
+
+        for (; x < cols; x++, out += 4)
+        {
+            StorePixel(out, row[x], row[x], row[x]);
+        }
+    }
+}
+
+template <typename T>
+static void DemosaicT(const BayerImage& mosaic, ColorMethod method, const TextureRows<T>& target, int firstRow,
+                      int endRow)
+{
+    switch (method)
+    {
+    case ColorMethod::HqLinear:
+        DemosaicHqLinear(mosaic, target, firstRow, endRow);
+        break;
+    case ColorMethod::EdgeSensing:
+        DemosaicEdgeSensing(mosaic, target, firstRow, endRow);
+        break;
+    case ColorMethod::NearestNeighbor:
+        DemosaicNearest(mosaic, target, firstRow, endRow);
+        break;
+    case ColorMethod::Downsample4:
+        DemosaicDownsample<1>(mosaic, target, firstRow, endRow);
+        break;
+    case ColorMethod::Downsample16:
+        DemosaicDownsample<2>(mosaic, target, firstRow, endRow);
+        break;
+    case ColorMethod::Mono:
+        DemosaicMono(mosaic, target, firstRow, endRow);
+        break;
+    }
+}
+
+/**
+ * @brief Copy each of the texture rows [firstRow, endRow), written at every
+ *        rowRepeat'th row, into the rows after it
+ */
+static void RepeatRows(unsigned char* texture, size_t rowBytes, int firstRow, int endRow, unsigned int rowRepeat)
+{
+    for (int y = firstRow; rowRepeat > 1 && y < endRow; y++)
+    {
+        const unsigned char* source = texture + y * rowRepeat * rowBytes;
+        for (unsigned int i = 1; i < rowRepeat; i++)
+        {
+            memcpy(texture + (y * rowRepeat + i) * rowBytes, source, rowBytes);
+        }
+    }
+}
+
+/**
+ * @brief Debayer the texture rows [firstRow, endRow), writing each of them
+ *        rowRepeat times
+ */
+static bool DemosaicRows(const BayerImage& mosaic, ColorMethod method, unsigned char* texture, PixelFormat format,
+                         int firstRow, int endRow, unsigned int rowRepeat)
+{
+    if (format != (mosaic.Is16Bit() ? PixelFormat::BGRU16 : PixelFormat::BGRU))
+    {
+        return false;
+    }
+
+    unsigned int textureWidth = 0;
+    unsigned int textureHeight = 0;
+    GetTextureSize(method, mosaic.Cols(), mosaic.Rows(), textureWidth, textureHeight);
+    const size_t rowSamples = static_cast<size_t>(textureWidth) * 4;
+
+    if (mosaic.Is16Bit())
+    {
+        const TextureRows<uint16_t> target = { reinterpret_cast<uint16_t*>(texture), rowSamples * rowRepeat };
+        DemosaicT(mosaic, method, target, firstRow, endRow);
+    }
+    else
+    {
+        const TextureRows<uint8_t> target = { reinterpret_cast<uint8_t*>(texture), rowSamples * rowRepeat };
+        DemosaicT(mosaic, method, target, firstRow, endRow);
+    }
+
+    RepeatRows(texture, static_cast<size_t>(textureWidth) * GetBytesPerPixel(format), firstRow, endRow, rowRepeat);
+    return true;
+}
+
+/**
+ * @brief Texture rows [firstRow, endRow) of a camera from its Bayer planes
+ */
+template <typename T>
+static void AssemblePlanes(const BayerPlanes& planes, const TextureRows<T>& target, int firstRow, int endRow)
+{
+    const int (*colors)[2] = PATTERN_COLORS[static_cast<int>(planes.pattern)];
+    const uint16_t* red = nullptr;
+    const uint16_t* blue = nullptr;
+    const uint16_t* greens[2] = { nullptr, nullptr };
+    int numGreens = 0;
+    for (int k = 0; k < 4; k++)
+    {
+        switch (colors[k >> 1][k & 1])
+        {
+        case RED:
+            red = planes.planes[k];
+            break;
+        case BLUE:
+            blue = planes.planes[k];
+            break;
+        default:
+            greens[numGreens++] = planes.planes[k];
+            break;
+        }
+    }
+
+    const int cols = static_cast<int>(planes.cols);
+    for (int y = firstRow; y < endRow; y++)
+    {
+        const size_t offset = static_cast<size_t>(y) * planes.stride;
+        const uint16_t* r = red + offset;
+        const uint16_t* g1 = greens[0] + offset;
+        const uint16_t* g2 = greens[1] + offset;
+        const uint16_t* b = blue + offset;
+        T* out = target.Row(y);
+        int x = 0;
+#ifdef DEMOSAIC_SIMD
+        if (UseSimd())
+        {
+            x = PlanesRowSimd(r, g1, g2, b, out, cols);
+            out += 4 * x;
+        }
+#endif
+
+        for (; x < cols; x++, out += 4)
+        {
+            StorePixel(out, r[x], (g1[x] + g2[x] + 1) >> 1, b[x]);
+        }
+    }
+}
+
+//=============================================================================
+// Public Interface
+//=============================================================================
+
+bool Demosaic(const BayerImage& mosaic, ColorMethod method, unsigned char* texture, PixelFormat format)
+{
+    unsigned int textureWidth = 0;
+    unsigned int textureHeight = 0;
+    GetTextureSize(method, mosaic.Cols(), mosaic.Rows(), textureWidth, textureHeight);
+    return DemosaicRows(mosaic, method, texture, format, 0, static_cast<int>(textureHeight), 1);
+}
+
+//=============================================================================
+// DemosaicEngine
+//=============================================================================
+
+DemosaicEngine::DemosaicEngine(unsigned int numThreads)
+    : pool(numThreads)
+{
+}
+
+bool DemosaicEngine::Run(const BayerImage* const mosaics[], unsigned char* const textures[], int count,
+                         ColorMethod method, PixelFormat format, unsigned int rowRepeat)
+{
+    bands.clear();
+    for (int image = 0; image < count; image++)
+    {
+        if (format != (mosaics[image]->Is16Bit() ? PixelFormat::BGRU16 : PixelFormat::BGRU))
+        {
+            return false;
+        }
+
+        unsigned int textureWidth = 0;
+        unsigned int textureHeight = 0;
+        GetTextureSize(method, mosaics[image]->Cols(), mosaics[image]->Rows(), textureWidth, textureHeight);
+        for (unsigned int row = 0; row < textureHeight; row += ROWS_PER_TASK)
+        {
+            const unsigned int endRow = std::min(row + ROWS_PER_TASK, textureHeight);
+            bands.push_back({ image, static_cast<int>(row), static_cast<int>(endRow) });
+        }
+    }
+
+    pool.Run(static_cast<unsigned int>(bands.size()), [&](unsigned int task) {
+        const Band& band = bands[task];
+        DemosaicRows(*mosaics[band.image], method, textures[band.image], format, band.firstRow, band.endRow,
+                     rowRepeat);
+    });
+    return true;
+}
+
+bool DemosaicEngine::Run(const BayerPlanes planes[], unsigned char* const textures[], int count, PixelFormat format,
+                         unsigned int rowRepeat)
+{
+    bands.clear();
+    for (int image = 0; image < count; image++)
+    {
+        if (format != (planes[image].is16Bit ? PixelFormat::BGRU16 : PixelFormat::BGRU))
+        {
+            return false;
+        }
+        for (unsigned int row = 0; row < planes[image].rows; row += ROWS_PER_TASK)
+        {
+            const unsigned int endRow = std::min(row + ROWS_PER_TASK, planes[image].rows);
+            bands.push_back({ image, static_cast<int>(row), static_cast<int>(endRow) });
+        }
+    }
+
+    pool.Run(static_cast<unsigned int>(bands.size()), [&](unsigned int task) {
+        const Band& band = bands[task];
+        const BayerPlanes& image = planes[band.image];
+        const size_t rowSamples = static_cast<size_t>(image.cols) * 4;
+        if (image.is16Bit)
+        {
+            const TextureRows<uint16_t> target = { reinterpret_cast<uint16_t*>(textures[band.image]),
+                                                   rowSamples * rowRepeat };
+            AssemblePlanes(image, target, band.firstRow, band.endRow);
+        }
+        else
+        {
+            const TextureRows<uint8_t> target = { reinterpret_cast<uint8_t*>(textures[band.image]),
+                                                  rowSamples * rowRepeat };
+            AssemblePlanes(image, target, band.firstRow, band.endRow);
+        }
+        RepeatRows(textures[band.image], static_cast<size_t>(image.cols) * GetBytesPerPixel(format), band.firstRow,
+                   band.endRow, rowRepeat);
+    });
+    return true;
+}
@@ -0,0 +1,156 @@
+//=============================================================================
+// Demosaic - CPU debayering of Ladybug camera images
+//
+// Converts one camera's Bayer mosaic into a BGRU (8-bit) or BGRU16 (16-bit)
+// texture for every colour processing method of -c:
+//
+//   HqLinear         Malvar-He-Cutler gradient-corrected linear interpolation
+//   EdgeSensing      Edge-directed green, colour-difference red/blue
+//   NearestNeighbor  Each 2x2 cell copies its own red, green and blue
+//   Downsample4      One pixel per 2x2 cell (half width and height)
+//   Downsample16     One pixel per 4x4 block (quarter width and height)
+//   Mono             The raw sample as grey
+//
+// The mosaic carries a BAYER_BORDER pixel border on every side so the
+// interpolation kernels never need to clamp; FillBorder mirrors the image
+// into it without changing the Bayer phase. The unused channel is set to
+// full scale (opaque).
+//
+// Every method has a vectorized path, AVX2 on x86 when GetIsaLevel() allows
+// it (see CpuFeatures.h) and NEON on AArch64, with exactly the output of the
+// scalar code. DemosaicEngine splits the images of a frame into bands of
+// rows and debayers all of them on a pool of threads. For the downsampling
+// methods it can also build the textures from per-position BayerPlanes,
+// which skips the mosaic altogether.
+//=============================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ImagingBackend.h"
+#include "WorkerPool.h"
+
+// Pixels of border around a BayerImage
+constexpr unsigned int BAYER_BORDER = 2;
+
+/**
+ * @brief Colours of the top-left 2x2 cell, row by row
+ */
+enum class BayerPattern
+{
+    BGGR,
+    GBRG,
+    GRBG,
+    RGGB
+};
+
+/**
+ * @brief One camera's Bayer mosaic (8 or 16-bit samples) with a border
+ */
+class BayerImage
+{
+public:
+    /**
+     * @brief Size the mosaic; keeps the allocation when it is large enough
+     */
+    void Resize(unsigned int cols, unsigned int rows, bool is16Bit, BayerPattern pattern);
+
+    unsigned int Cols() const { return cols; }
+    unsigned int Rows() const { return rows; }
+    bool Is16Bit() const { return is16Bit; }
+    BayerPattern Pattern() const { return pattern; }
+    size_t Stride() const { return stride; }    // Samples per row, border included
+
+    uint8_t* Row8(int y) { return reinterpret_cast<uint8_t*>(storage.data()) + Offset(y); }
+    const uint8_t* Row8(int y) const { return reinterpret_cast<const uint8_t*>(storage.data()) + Offset(y); }
+    uint16_t* Row16(int y) { return storage.data() + Offset(y); }
+    const uint16_t* Row16(int y) const { return storage.data() + Offset(y); }
+
+    /**
+     * @brief Mirror the image into the border (call after filling the rows)
+     */
+    void FillBorder();
+
+private:
+    size_t Offset(int y) const { return (static_cast<ptrdiff_t>(y) + BAYER_BORDER) * stride + BAYER_BORDER; }
+
+    unsigned int cols = 0;
+    unsigned int rows = 0;
+    bool is16Bit = false;
+    BayerPattern pattern = BayerPattern::RGGB;
+    size_t stride = 0;
+    std::vector<uint16_t> storage;      // 8-bit mosaics use the first half
+};
+
+/**
+ * @brief The four Bayer-position planes of one camera, as decoded from a
+ *        colour-separated JPEG stream (plane k holds the samples at
+ *        x = 2 * i + (k & 1), y = 2 * j + (k >> 1))
+ *
+ * Every plane sample is one 2x2 cell of the mosaic, so the planes already
+ * are the Downsample4 image; decoded with a 1/2 scaled IDCT they are the
+ * Downsample16 image.
+ */
+struct BayerPlanes
+{
+    const uint16_t* planes[4];
+    size_t stride;                      // Samples per plane row
+    unsigned int cols;                  // Texture size
+    unsigned int rows;
+    bool is16Bit;                       // 8-bit planes hold values up to 255
+    BayerPattern pattern;
+};
+
+/**
+ * @brief Debayer a mosaic into a tightly packed texture
+ *
+ * The texture size is GetTextureSize(method, cols, rows). 8-bit mosaics
+ * produce BGRU and 16-bit mosaics BGRU16.
+ * @return false if format does not match the mosaic's sample size
+ */
+bool Demosaic(const BayerImage& mosaic, ColorMethod method, unsigned char* texture, PixelFormat format);
+
+/**
+ * @brief Debayers the camera images of a frame on a pool of threads
+ */
+class DemosaicEngine
+{
+public:
+    /**
+     * @param numThreads Threads debayering at once (0 = one per logical processor)
+     */
+    explicit DemosaicEngine(unsigned int numThreads);
+
+    /**
+     * @brief Debayer count mosaics into their textures, with the bands of
+     *        all images shared out between the threads
+     * @param rowRepeat Times every texture row is written (2 for half-height
+     *                  images, whose texture has twice the debayered rows)
+     * @return false if format does not match a mosaic's sample size
+     */
+    bool Run(const BayerImage* const mosaics[], unsigned char* const textures[], int count, ColorMethod method,
+             PixelFormat format, unsigned int rowRepeat = 1);
+
+    /**
+     * @brief Build the textures of count cameras straight from their
+     *        planes: red and blue come from their plane, green averages the
+     *        two green planes
+     * @return false if format does not match the planes' sample size
+     */
+    bool Run(const BayerPlanes planes[], unsigned char* const textures[], int count, PixelFormat format,
+             unsigned int rowRepeat = 1);
+
+private:
+    struct Band
+    {
+        int image;
+        int firstRow;
+        int endRow;
+    };
+
+    WorkerPool pool;
+    std::vector<Band> bands;
+};
@@ -0,0 +1,332 @@
+//=============================================================================
+// ImageArchive - Single-file output of the exported images (--archive)
+//=============================================================================
+
+#include "ImageArchive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+constexpr size_t TAR_BLOCK_SIZE = 512;
+constexpr size_t TAR_NAME_SIZE = 100;
+constexpr unsigned int TAR_END_BLOCKS = 2;
+
+static const char INDEX_MAGIC[] = "LBXARIDX";
+constexpr size_t INDEX_MAGIC_SIZE = 8;
+constexpr uint32_t INDEX_VERSION = 1;
+constexpr size_t INDEX_ENTRY_SIZE = 32;
+constexpr size_t INDEX_FOOTER_SIZE = 32;
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+static void PutLE(std::vector<unsigned char>& out, uint64_t value, unsigned int bytes)
+{
+    for (unsigned int i = 0; i < bytes; i++)
+    {
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+static uint64_t GetLE(const unsigned char* in, unsigned int bytes)
+{
+    uint64_t value = 0;
+    for (unsigned int i = bytes; i-- > 0;)
+    {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Octal number field of a tar header, NUL terminated
+ */
+static void PutTarNumber(unsigned char* field, size_t fieldSize, uint64_t value)
+{
+    snprintf(reinterpret_cast<char*>(field), fieldSize, "%0*llo", static_cast<int>(fieldSize - 1),
+             static_cast<unsigned long long>(value));
+}
+
+/**
+ * @brief One ustar header block (regular file or pax extended header)
+ */
+static void PutTarHeader(std::vector<unsigned char>& out, const std::string& name, uint64_t size, char type,
+                         uint64_t modifiedTime)
+{
+    const size_t start = out.size();
+    out.resize(start + TAR_BLOCK_SIZE, 0);
+    unsigned char* header = out.data() + start;
+
+    memcpy(header, name.data(), std::min(name.size(), TAR_NAME_SIZE));
+    PutTarNumber(header + 100, 8, 0644);            // Mode
+    PutTarNumber(header + 108, 8, 0);               // Owner
+    PutTarNumber(header + 116, 8, 0);               // Group
+    PutTarNumber(header + 124, 12, size);
+    PutTarNumber(header + 136, 12, modifiedTime);
+    header[156] = static_cast<unsigned char>(type);
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+
+    // The checksum is taken with its own field as spaces
+    memset(header + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++)
+    {
+        checksum += header[i];
+    }
+    snprintf(reinterpret_cast<char*>(header + 148), 8, "%06o", checksum);
+    header[155] = ' ';
+}
+
+/**
+ * @brief Zero bytes that fill a member up to the next block
+ */
+static size_t GetTarPadding(uint64_t size)
+{
+    return static_cast<size_t>((TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE);
+}
+
+//=============================================================================
+// ArchiveWriter
+//=============================================================================
+
+ArchiveWriter::~ArchiveWriter()
+{
+    if (file != nullptr)
+    {
+        Close();
+    }
+}
+
+bool ArchiveWriter::Open(const std::string& archivePath)
+{
+    file = fopen(archivePath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        printf("Error: Could not create archive %s\n", archivePath.c_str());
+        return false;
+    }
+    path = archivePath;
+    offset = 0;
+    modifiedTime = static_cast<uint64_t>(time(nullptr));
+    failed = false;
+    entries.clear();
+    return true;
+}
+
+bool ArchiveWriter::Put(const void* data, size_t size)
+{
+    if (!failed && size > 0 && fwrite(data, 1, size, file) != size)
+    {
+        printf("Error: Could not write archive %s\n", path.c_str());
+        failed = true;
+    }
+    offset += size;
+    return !failed;
+}
+
+bool ArchiveWriter::Add(uint64_t, const std::string& name, unsigned int frameNum, int camera,
+                        const std::vector<unsigned char>& data)
+{
+    // Header and padding are built outside the lock
+    std::vector<unsigned char> header;
+    if (name.size() > TAR_NAME_SIZE)
+    {
+        // Longer names go into a pax extended header ("LEN path=NAME\n",
+        // LEN counting itself)
+        const std::string record = " path=" + name + "\n";
+        size_t length = record.size() + 1;
+        while (std::to_string(length).size() + record.size() != length)
+        {
+            length++;
+        }
+        const std::string pax = std::to_string(length) + record;
+        PutTarHeader(header, "PaxHeader", pax.size(), 'x', modifiedTime);
+        header.insert(header.end(), pax.begin(), pax.end());
+        header.resize(header.size() + GetTarPadding(pax.size()), 0);
+    }
+    PutTarHeader(header, name, data.size(), '0', modifiedTime);
+    static const unsigned char zeros[TAR_BLOCK_SIZE] = {};
+    const size_t padding = GetTarPadding(data.size());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file == nullptr || failed)
+    {
+        return false;
+    }
+    if (!Put(header.data(), header.size()))
+    {
+        return false;
+    }
+
+    ArchiveEntry entry;
+    entry.name = name;
+    entry.frameNum = frameNum;
+    entry.camera = camera;
+    entry.offset = offset;
+    entry.size = data.size();
+    if (!Put(data.data(), data.size()) || !Put(zeros, padding))
+    {
+        return false;
+    }
+    entries.push_back(entry);
+    return true;
+}
+
+bool ArchiveWriter::Close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    // End of the tar file
+    const std::vector<unsigned char> end(TAR_BLOCK_SIZE * TAR_END_BLOCKS, 0);
+    Put(end.data(), end.size());
+
+    // Index entries, names and footer
+    const uint64_t indexOffset = offset;
+    std::vector<unsigned char> index;
+    std::string names;
+    for (const ArchiveEntry& entry : entries)
+    {
+        PutLE(index, entry.offset, 8);
+        PutLE(index, entry.size, 8);
+        PutLE(index, entry.frameNum, 4);
+        PutLE(index, static_cast<uint32_t>(entry.camera), 4);
+        PutLE(index, names.size(), 4);
+        PutLE(index, entry.name.size(), 4);
+        names += entry.name;
+    }
+    index.insert(index.end(), names.begin(), names.end());
+    const uint64_t indexSize = index.size();
+    index.insert(index.end(), INDEX_MAGIC, INDEX_MAGIC + INDEX_MAGIC_SIZE);
+    PutLE(index, INDEX_VERSION, 4);
+    PutLE(index, entries.size(), 4);
+    PutLE(index, indexOffset, 8);
+    PutLE(index, indexSize, 8);
+    Put(index.data(), index.size());
+
+    if (fclose(file) != 0 && !failed)
+    {
+        printf("Error: Could not write archive %s\n", path.c_str());
+        failed = true;
+    }
+    file = nullptr;
+    if (failed)
+    {
+        return false;
+    }
+    printf("Archive: %zu image(s) written to %s\n", entries.size(), path.c_str());
+    return true;
+}
+
+bool ArchiveWriter::Failed() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
+
+//=============================================================================
+// ArchiveReader
+//=============================================================================
+
+static bool IsBefore(const ArchiveEntry& a, const ArchiveEntry& b)
+{
+    return a.frameNum != b.frameNum ? a.frameNum < b.frameNum : a.camera < b.camera;
+}
+
+bool ArchiveReader::Open(const std::string& path)
+{
+    Close();
+    if (!mapping.Open(path))
+    {
+        printf("Error: Could not open archive %s\n", path.c_str());
+        return false;
+    }
+
+    const unsigned char* data = mapping.Data();
+    const size_t size = mapping.Size();
+    const unsigned char* footer = (size >= INDEX_FOOTER_SIZE) ? data + size - INDEX_FOOTER_SIZE : nullptr;
+    if (footer == nullptr || memcmp(footer, INDEX_MAGIC, INDEX_MAGIC_SIZE) != 0 ||
+        GetLE(footer + 8, 4) != INDEX_VERSION)
+    {
+        printf("Error: %s has no archive index (the export did not finish?)\n", path.c_str());
+        Close();
+        return false;
+    }
+
+    const uint64_t count = GetLE(footer + 12, 4);
+    const uint64_t indexOffset = GetLE(footer + 16, 8);
+    const uint64_t indexSize = GetLE(footer + 24, 8);
+    const uint64_t indexEnd = size - INDEX_FOOTER_SIZE;
+    bool valid = indexOffset <= indexEnd && indexSize == indexEnd - indexOffset && indexSize >= count * INDEX_ENTRY_SIZE;
+    const uint64_t namesSize = valid ? indexSize - count * INDEX_ENTRY_SIZE : 0;
+
+    const unsigned char* index = data + indexOffset;
+    const char* names = reinterpret_cast<const char*>(index + count * INDEX_ENTRY_SIZE);
+    for (uint64_t i = 0; i < count && valid; i++)
+    {
+        const unsigned char* in = index + i * INDEX_ENTRY_SIZE;
+        ArchiveEntry entry;
+        entry.offset = GetLE(in, 8);
+        entry.size = GetLE(in + 8, 8);
+        entry.frameNum = static_cast<unsigned int>(GetLE(in + 16, 4));
+        entry.camera = static_cast<int32_t>(GetLE(in + 20, 4));
+        const uint64_t nameOffset = GetLE(in + 24, 4);
+        const uint64_t nameSize = GetLE(in + 28, 4);
+        valid = entry.offset + entry.size <= indexOffset && nameOffset + nameSize <= namesSize;
+        if (valid)
+        {
+            entry.name.assign(names + nameOffset, static_cast<size_t>(nameSize));
+            entries.push_back(entry);
+        }
+    }
+    if (!valid)
+    {
+        printf("Error: The archive index of %s is damaged\n", path.c_str());
+        Close();
+        return false;
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), IsBefore);
+    return true;
+}
+
+void ArchiveReader::Close()
+{
+    entries.clear();
+    mapping.Close();
+}
+
+const ArchiveEntry* ArchiveReader::Find(unsigned int frameNum, int camera) const
+{
+    ArchiveEntry key;
+    key.frameNum = frameNum;
+    key.camera = camera;
+    auto found = std::lower_bound(entries.begin(), entries.end(), key, IsBefore);
+    if (found == entries.end() || found->frameNum != frameNum || found->camera != camera)
+    {
+        return nullptr;
+    }
+    return &*found;
+}
+
+const ArchiveEntry* ArchiveReader::Find(const std::string& name) const
+{
+    for (const ArchiveEntry& entry : entries)
+    {
+        if (entry.name == name)
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,127 @@
+//=============================================================================
+// ImageArchive - Single-file output of the exported images (--archive)
+//
+// Millions of small image files are slow to create, copy and delete. With
+// --archive every image goes into one uncompressed POSIX (ustar) tar file
+// instead, under the file name it would have had in the output directory,
+// so `tar -xf FILE -C DIR` gives the usual layout. Images are appended as
+// the encoder threads finish them; nothing is seeked back to.
+//
+// After the tar end-of-archive blocks, where tar stops reading, the writer
+// appends an index of the members and a fixed-size footer:
+//
+//   entry[count]   uint64 data offset, uint64 size, uint32 frame,
+//                  int32 camera (-1 = panorama), uint32 name offset,
+//                  uint32 name size (32 bytes, little-endian)
+//   names          member names, not terminated
+//   footer         char[8] "LBXARIDX", uint32 version, uint32 count,
+//                  uint64 index offset, uint64 index size (32 bytes)
+//
+// ArchiveReader maps the file and hands out images by frame and camera or by
+// name, as views into the mapping. An archive whose export did not finish
+// has no footer; tar still reads the members that were completed.
+//=============================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ImageSink.h"
+#include "PgrStreamReader.h"
+
+/**
+ * @brief One image of an archive
+ */
+struct ArchiveEntry
+{
+    std::string name;
+    unsigned int frameNum = 0;
+    int camera = -1;                    // Camera index, or -1 for a panorama
+    uint64_t offset = 0;                // First byte of the image in the archive
+    uint64_t size = 0;
+};
+
+/**
+ * @brief Appends encoded images to a tar file in the order they come;
+ *        thread safe
+ */
+class ArchiveWriter : public ImageSink
+{
+public:
+    ArchiveWriter() = default;
+    ~ArchiveWriter() override;
+
+    ArchiveWriter(const ArchiveWriter&) = delete;
+    ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+    /**
+     * @return false (with a message) if the file cannot be created
+     */
+    bool Open(const std::string& path);
+
+    /**
+     * @brief Append an image as a tar member; the archive takes no more
+     *        images after a failed write
+     */
+    bool Add(uint64_t sequence, const std::string& name, unsigned int frameNum, int camera,
+             const std::vector<unsigned char>& data) override;
+
+    void Skip(uint64_t, int) override {}
+
+    /**
+     * @brief End the tar file and write the index
+     */
+    bool Close() override;
+
+    bool Failed() const override;
+
+private:
+    bool Put(const void* data, size_t size);
+
+    mutable std::mutex mutex;
+    FILE* file = nullptr;
+    std::string path;
+    uint64_t offset = 0;                // End of the file
+    uint64_t modifiedTime = 0;          // Member time stamp (when the archive was opened)
+    bool failed = false;
+    std::vector<ArchiveEntry> entries;
+};
+
+/**
+ * @brief Memory-mapped archive with its index
+ */
+class ArchiveReader
+{
+public:
+    /**
+     * @return false (with a message) if the file cannot be mapped or has no
+     *         valid index
+     */
+    bool Open(const std::string& path);
+    void Close();
+
+    /**
+     * @return The image, or null if the archive does not hold it
+     */
+    const ArchiveEntry* Find(unsigned int frameNum, int camera) const;
+    const ArchiveEntry* Find(const std::string& name) const;
+
+    /**
+     * @brief Bytes of an image (valid while the reader is open)
+     */
+    const unsigned char* Data(const ArchiveEntry& entry) const { return mapping.Data() + entry.offset; }
+
+    /**
+     * @brief Every image, by frame and camera
+     */
+    const std::vector<ArchiveEntry>& Entries() const { return entries; }
+
+private:
+    MappedFile mapping;
+    std::vector<ArchiveEntry> entries;
+};
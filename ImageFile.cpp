@@ -0,0 +1,1153 @@
+//=============================================================================
+// ImageFile - Native image file writers (BMP, TIFF, PNG, JPEG)
+//=============================================================================
+
+#include "ImageFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csetjmp>
+#include <functional>
+#include <vector>
+
+#include "WorkerPool.h"
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef USE_LIBJPEG
+#include <jpeglib.h>
+#include "JpegSupport.h"
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+static void PutLE16(std::vector<unsigned char>& out, uint32_t value)
+{
+    out.push_back(static_cast<unsigned char>(value));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+static void PutLE32(std::vector<unsigned char>& out, uint32_t value)
+{
+    PutLE16(out, value & 0xFFFF);
+    PutLE16(out, value >> 16);
+}
+
+static void PutBE32(std::vector<unsigned char>& out, uint32_t value)
+{
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+/**
+ * @brief BMP and JPEG only take 8-bit input; BGRU16 has to be reduced first
+ */
+static bool CheckInput(const ImageView& image, const std::string& path)
+{
+    if (image.format == PixelFormat::BGRU16)
+    {
+        printf("Warning: Could not save %s: 16-bit images can only be saved as PNG or TIFF\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Copy one row as 3-byte pixels, in BGR or RGB order
+ */
+static void PackRow(const ImageView& image, unsigned int y, unsigned char* out, bool rgb)
+{
+    const unsigned int inStep = GetBytesPerPixel(image.format);
+    const unsigned char* in = image.data + static_cast<size_t>(y) * image.cols * inStep;
+    const int blue = rgb ? 2 : 0;
+    const int red = rgb ? 0 : 2;
+
+    for (unsigned int x = 0; x < image.cols; x++, in += inStep, out += 3)
+    {
+        out[blue] = in[0];
+        out[1] = in[1];
+        out[red] = in[2];
+    }
+}
+
+/**
+ * @brief Copy one BGRU16 row as 6-byte RGB pixels, samples in big or
+ *        little-endian byte order
+ */
+static void PackRow16(const ImageView& image, unsigned int y, unsigned char* out, bool bigEndian)
+{
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(image.data) + static_cast<size_t>(y) * image.cols * 4;
+    const int high = bigEndian ? 0 : 1;
+    const int low = 1 - high;
+
+    for (unsigned int x = 0; x < image.cols; x++, in += 4, out += 6)
+    {
+        const uint16_t rgb[3] = { in[2], in[1], in[0] };
+        for (int c = 0; c < 3; c++)
+        {
+            out[2 * c + high] = static_cast<unsigned char>(rgb[c] >> 8);
+            out[2 * c + low] = static_cast<unsigned char>(rgb[c]);
+        }
+    }
+}
+
+static FILE* OpenOutputFile(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        printf("Warning: Could not create %s\n", path.c_str());
+    }
+    return file;
+}
+
+static bool CloseOutputFile(FILE* file, bool written, const std::string& path)
+{
+    if (fclose(file) != 0 || !written)
+    {
+        printf("Warning: Could not write %s\n", path.c_str());
+        remove(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+//=============================================================================
+// BMP
+//=============================================================================
+
+bool EncodeBmp(const ImageView& image, const std::string& name, std::vector<unsigned char>& out)
+{
+    if (!CheckInput(image, name))
+    {
+        return false;
+    }
+
+    const uint32_t rowBytes = (image.cols * 3 + 3) & ~3u;
+    const uint32_t dataBytes = rowBytes * image.rows;
+
+    out.clear();
+    out.push_back('B');
+    out.push_back('M');
+    PutLE32(out, 54 + dataBytes);       // File size
+    PutLE32(out, 0);                    // Reserved
+    PutLE32(out, 54);                   // Pixel data offset
+    PutLE32(out, 40);                   // BITMAPINFOHEADER
+    PutLE32(out, image.cols);
+    PutLE32(out, image.rows);           // Positive: bottom-up rows
+    PutLE16(out, 1);                    // Planes
+    PutLE16(out, 24);                   // Bits per pixel
+    PutLE32(out, 0);                    // BI_RGB
+    PutLE32(out, dataBytes);
+    PutLE32(out, 2835);                 // 72 DPI
+    PutLE32(out, 2835);
+    PutLE32(out, 0);
+    PutLE32(out, 0);
+
+    // Row padding stays zero
+    const size_t headerBytes = out.size();
+    out.resize(headerBytes + dataBytes, 0);
+    for (unsigned int y = 0; y < image.rows; y++)
+    {
+        PackRow(image, y, out.data() + headerBytes + static_cast<size_t>(image.rows - 1 - y) * rowBytes, false);
+    }
+    return true;
+}
+
+bool WriteBmpFile(const ImageView& image, const std::string& path)
+{
+    std::vector<unsigned char> data;
+    return EncodeBmp(image, path, data) && WriteEncodedFile(data, path);
+}
+
+//=============================================================================
+// Strip Compression
+//=============================================================================
+
+// Rows per PNG strip when strips are compressed in parallel (one strip
+// otherwise, so the output does not depend on the number of threads above 1)
+constexpr unsigned int PNG_STRIP_ROWS = 256;
+
+// Rows per strip of a compressed TIFF
+constexpr unsigned int TIFF_STRIP_ROWS = 64;
+
+// A PNG strip is primed with this much of the data before it (the deflate window)
+constexpr size_t DEFLATE_WINDOW_BYTES = 32768;
+
+// Room for the empty stored block of a sync flush beyond deflateBound
+constexpr size_t DEFLATE_FLUSH_BYTES = 16;
+
+// LZW codes (TIFF 6.0 section 13)
+constexpr unsigned int LZW_CLEAR = 256;
+constexpr unsigned int LZW_EOI = 257;
+constexpr unsigned int LZW_FIRST = 258;
+constexpr unsigned int LZW_MIN_BITS = 9;
+constexpr unsigned int LZW_TABLE_FULL = 4094;   // Clear before the 12-bit codes run out, as libtiff does
+constexpr unsigned int LZW_HASH_BITS = 13;      // Twice the table, so probes stay short
+
+#ifdef USE_ZSTD
+// zstd level of ZSTD TIFF strips (its default)
+constexpr int ZSTD_TIFF_LEVEL = 3;
+#endif
+
+struct LosslessEncoder::ThreadState
+{
+    std::vector<unsigned char> rows;        // Packed rows: PNG previous, current and zero row; TIFF strip
+    std::vector<unsigned char> candidate;   // Trial row of the adaptive PNG filter
+    std::vector<uint32_t> lzwTable;         // (prefix, byte) + 1 << 12 | code
+#ifdef USE_ZLIB
+    z_stream deflater;
+    bool deflaterReady = false;
+#endif
+#ifdef USE_ZSTD
+    ZSTD_CCtx* zstd = nullptr;
+#endif
+
+    ~ThreadState()
+    {
+#ifdef USE_ZLIB
+        if (deflaterReady)
+        {
+            deflateEnd(&deflater);
+        }
+#endif
+#ifdef USE_ZSTD
+        ZSTD_freeCCtx(zstd);
+#endif
+    }
+};
+
+LosslessEncoder::LosslessEncoder(const LosslessOptions& options)
+    : options(options)
+{
+}
+
+LosslessEncoder::~LosslessEncoder() = default;
+
+void LosslessEncoder::Prepare()
+{
+    if (!threadStates.empty())
+    {
+        return;
+    }
+    if (options.stripThreads != 1)
+    {
+        pool.reset(new WorkerPool(options.stripThreads));
+    }
+    const unsigned int numThreads = pool ? pool->NumThreads() : 1;
+    for (unsigned int i = 0; i < numThreads; i++)
+    {
+        threadStates.emplace_back(new ThreadState());
+    }
+}
+
+void LosslessEncoder::RunStrips(unsigned int numStrips, const std::function<void(unsigned int, ThreadState&)>& task)
+{
+    if (pool)
+    {
+        pool->RunIndexed(numStrips, [&](unsigned int strip, unsigned int thread)
+        {
+            task(strip, *threadStates[thread]);
+        });
+        return;
+    }
+    for (unsigned int strip = 0; strip < numStrips; strip++)
+    {
+        task(strip, *threadStates[0]);
+    }
+}
+
+/**
+ * @brief Copy one row as RGB, 8 bits or (BGRU16) 16 bits per sample
+ */
+static void PackRgbRow(const ImageView& image, unsigned int y, unsigned char* out, bool bigEndian)
+{
+    if (image.format == PixelFormat::BGRU16)
+    {
+        PackRow16(image, y, out, bigEndian);
+    }
+    else
+    {
+        PackRow(image, y, out, true);
+    }
+}
+
+#ifdef USE_ZLIB
+
+static int GetZlibStrategy(ZlibStrategy strategy)
+{
+    switch (strategy)
+    {
+    case ZlibStrategy::Default:     return Z_DEFAULT_STRATEGY;
+    case ZlibStrategy::Filtered:    return Z_FILTERED;
+    case ZlibStrategy::Rle:         return Z_RLE;
+    case ZlibStrategy::HuffmanOnly: return Z_HUFFMAN_ONLY;
+    }
+    return Z_DEFAULT_STRATEGY;
+}
+
+/**
+ * @brief The two bytes deflateInit would start a zlib stream with
+ */
+static void PutZlibHeader(std::vector<unsigned char>& out, const LosslessOptions& options)
+{
+    unsigned int levelFlags = 3;
+    if (options.zlibStrategy == ZlibStrategy::Rle || options.zlibStrategy == ZlibStrategy::HuffmanOnly ||
+        options.zlibLevel < 2)
+    {
+        levelFlags = 0;
+    }
+    else if (options.zlibLevel < 6)
+    {
+        levelFlags = 1;
+    }
+    else if (options.zlibLevel == 6)
+    {
+        levelFlags = 2;
+    }
+    unsigned int header = (0x78 << 8) | (levelFlags << 6);
+    header += 31 - header % 31;
+    out.push_back(static_cast<unsigned char>(header >> 8));
+    out.push_back(static_cast<unsigned char>(header));
+}
+
+/**
+ * @brief Append a raw deflate stream of one strip to out
+ * @param dictionary Data before the strip, or null
+ * @param last Finish the stream; otherwise end on a sync flush so the next
+ *             strip can follow it
+ */
+static bool DeflateStrip(z_stream& stream, const unsigned char* dictionary, size_t dictionaryBytes,
+                         const unsigned char* in, size_t size, bool last, std::vector<unsigned char>& out)
+{
+    deflateReset(&stream);
+    if (dictionaryBytes > 0)
+    {
+        deflateSetDictionary(&stream, dictionary, static_cast<uInt>(dictionaryBytes));
+    }
+
+    const size_t start = out.size();
+    out.resize(start + deflateBound(&stream, static_cast<uLong>(size)) + DEFLATE_FLUSH_BYTES);
+    stream.next_in = const_cast<Bytef*>(in);
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = out.data() + start;
+    stream.avail_out = static_cast<uInt>(out.size() - start);
+
+    const int result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    const bool ok = last ? (result == Z_STREAM_END) : (result == Z_OK && stream.avail_in == 0 && stream.avail_out > 0);
+    out.resize(start + stream.total_out);
+    return ok;
+}
+
+static bool PrepareDeflater(z_stream& stream, bool& ready, const LosslessOptions& options)
+{
+    if (!ready)
+    {
+        memset(&stream, 0, sizeof(stream));
+        ready = deflateInit2(&stream, options.zlibLevel, Z_DEFLATED, -MAX_WBITS, 8,
+                             GetZlibStrategy(options.zlibStrategy)) == Z_OK;
+    }
+    return ready;
+}
+
+#endif
+
+/**
+ * @brief TIFF LZW of one strip: MSB-first codes of 9 to 12 bits, a clear
+ *        code first and whenever the table fills, widened one code early
+ */
+static void CompressLzw(const unsigned char* in, size_t size, std::vector<uint32_t>& table,
+                        std::vector<unsigned char>& out)
+{
+    constexpr uint32_t HASH_MASK = (1u << LZW_HASH_BITS) - 1;
+    table.assign(HASH_MASK + 1, 0);
+
+    uint32_t buffer = 0;
+    unsigned int bufferBits = 0;
+    unsigned int width = LZW_MIN_BITS;
+    auto put = [&](unsigned int code)
+    {
+        buffer = (buffer << width) | code;
+        bufferBits += width;
+        while (bufferBits >= 8)
+        {
+            bufferBits -= 8;
+            out.push_back(static_cast<unsigned char>(buffer >> bufferBits));
+        }
+    };
+
+    // Counts the code just added; the decoder widens when it adds it
+    unsigned int nextCode = LZW_FIRST;
+    auto added = [&]()
+    {
+        if (++nextCode == LZW_TABLE_FULL)
+        {
+            put(LZW_CLEAR);
+            table.assign(HASH_MASK + 1, 0);
+            nextCode = LZW_FIRST;
+            width = LZW_MIN_BITS;
+        }
+        else if (nextCode > (1u << width) - 1)
+        {
+            width++;
+        }
+    };
+
+    put(LZW_CLEAR);
+    if (size > 0)
+    {
+        uint32_t prefix = in[0];
+        for (size_t i = 1; i < size; i++)
+        {
+            const uint32_t key = ((prefix << 8) | in[i]) + 1;
+            uint32_t slot = (key * 2654435761u) >> (32 - LZW_HASH_BITS);
+            while (table[slot] != 0 && (table[slot] >> 12) != key)
+            {
+                slot = (slot + 1) & HASH_MASK;
+            }
+            if (table[slot] != 0)
+            {
+                prefix = table[slot] & 0xFFF;
+                continue;
+            }
+
+            put(prefix);
+            table[slot] = (key << 12) | nextCode;
+            added();
+            prefix = in[i];
+        }
+        put(prefix);
+        added();
+    }
+    put(LZW_EOI);
+    if (bufferBits > 0)
+    {
+        out.push_back(static_cast<unsigned char>(buffer << (8 - bufferBits)));
+    }
+}
+
+/**
+ * @brief TIFF predictor 2: each sample minus the same sample of the pixel
+ *        on its left (16-bit samples little-endian)
+ */
+static void ApplyHorizontalPredictor(unsigned char* row, size_t rowBytes, bool is16Bit)
+{
+    if (!is16Bit)
+    {
+        for (size_t i = rowBytes; i-- > 3;)
+        {
+            row[i] = static_cast<unsigned char>(row[i] - row[i - 3]);
+        }
+        return;
+    }
+    for (size_t i = rowBytes / 2; i-- > 3;)
+    {
+        const unsigned int sample = row[2 * i] | (row[2 * i + 1] << 8);
+        const unsigned int left = row[2 * i - 6] | (row[2 * i - 5] << 8);
+        const unsigned int difference = (sample - left) & 0xFFFF;
+        row[2 * i] = static_cast<unsigned char>(difference);
+        row[2 * i + 1] = static_cast<unsigned char>(difference >> 8);
+    }
+}
+
+//=============================================================================
+// TIFF (baseline RGB, 8 or 16 bits per sample; uncompressed in one strip,
+// or LZW, Deflate or ZSTD strips with the horizontal predictor)
+//=============================================================================
+
+static void PutTiffEntry(std::vector<unsigned char>& out, uint16_t tag, uint16_t type, uint32_t count, uint32_t value)
+{
+    PutLE16(out, tag);
+    PutLE16(out, type);
+    PutLE32(out, count);
+    if (type == 3 && count == 1)
+    {
+        // SHORT values are left-justified in the value field
+        PutLE16(out, value);
+        PutLE16(out, 0);
+    }
+    else
+    {
+        PutLE32(out, value);
+    }
+}
+
+/**
+ * @brief Header and IFD of a TIFF whose strips follow it in order
+ */
+static std::vector<unsigned char> MakeTiffHeader(const ImageView& image, uint16_t compression, uint32_t rowsPerStrip,
+                                                 const std::vector<uint32_t>& stripBytes)
+{
+    constexpr uint16_t TIFF_SHORT = 3;
+    constexpr uint16_t TIFF_LONG = 4;
+    constexpr uint32_t IFD_OFFSET = 8;
+
+    // Compressed strips are predicted; several strips need offset and size arrays
+    const bool predicted = compression != 1;
+    const uint32_t numEntries = predicted ? 11 : 10;
+    const uint32_t numStrips = static_cast<uint32_t>(stripBytes.size());
+    const uint32_t arrayBytes = (numStrips > 1) ? numStrips * 4 : 0;
+    const uint32_t bitsOffset = IFD_OFFSET + 2 + numEntries * 12 + 4;
+    const uint32_t offsetsOffset = bitsOffset + 6;
+    const uint32_t countsOffset = offsetsOffset + arrayBytes;
+    const uint32_t dataOffset = countsOffset + arrayBytes;
+
+    const uint16_t bitsPerSample = (image.format == PixelFormat::BGRU16) ? 16 : 8;
+
+    std::vector<unsigned char> header;
+    header.push_back('I');
+    header.push_back('I');
+    PutLE16(header, 42);
+    PutLE32(header, IFD_OFFSET);
+
+    PutLE16(header, numEntries);
+    PutTiffEntry(header, 256, TIFF_LONG, 1, image.cols);        // ImageWidth
+    PutTiffEntry(header, 257, TIFF_LONG, 1, image.rows);        // ImageLength
+    PutTiffEntry(header, 258, TIFF_SHORT, 3, bitsOffset);       // BitsPerSample
+    PutTiffEntry(header, 259, TIFF_SHORT, 1, compression);      // Compression
+    PutTiffEntry(header, 262, TIFF_SHORT, 1, 2);                // Photometric: RGB
+    PutTiffEntry(header, 273, TIFF_LONG, numStrips,             // StripOffsets
+                 (numStrips > 1) ? offsetsOffset : dataOffset);
+    PutTiffEntry(header, 277, TIFF_SHORT, 1, 3);                // SamplesPerPixel
+    PutTiffEntry(header, 278, TIFF_LONG, 1, rowsPerStrip);      // RowsPerStrip
+    PutTiffEntry(header, 279, TIFF_LONG, numStrips,             // StripByteCounts
+                 (numStrips > 1) ? countsOffset : stripBytes[0]);
+    PutTiffEntry(header, 284, TIFF_SHORT, 1, 1);                // PlanarConfiguration: chunky
+    if (predicted)
+    {
+        PutTiffEntry(header, 317, TIFF_SHORT, 1, 2);            // Predictor: horizontal differencing
+    }
+    PutLE32(header, 0);                                         // No next IFD
+    PutLE16(header, bitsPerSample);
+    PutLE16(header, bitsPerSample);
+    PutLE16(header, bitsPerSample);
+
+    if (numStrips > 1)
+    {
+        uint32_t offset = dataOffset;
+        for (uint32_t bytes : stripBytes)
+        {
+            PutLE32(header, offset);
+            offset += bytes;
+        }
+        for (uint32_t bytes : stripBytes)
+        {
+            PutLE32(header, bytes);
+        }
+    }
+    return header;
+}
+
+static uint16_t GetTiffCompressionCode(TiffCompression compression)
+{
+    switch (compression)
+    {
+    case TiffCompression::None:    return 1;
+    case TiffCompression::Lzw:     return 5;
+    case TiffCompression::Deflate: return 8;        // Adobe Deflate
+    case TiffCompression::Zstd:    return 50000;    // As registered by libtiff
+    }
+    return 1;
+}
+
+bool LosslessEncoder::EncodeTiff(const ImageView& image, const std::string& name, std::vector<unsigned char>& out)
+{
+    const bool is16Bit = image.format == PixelFormat::BGRU16;
+    const size_t rowBytes = static_cast<size_t>(image.cols) * 3 * (is16Bit ? 2 : 1);
+
+    if (options.tiffCompression == TiffCompression::None)
+    {
+        out = MakeTiffHeader(image, 1, image.rows, { static_cast<uint32_t>(rowBytes * image.rows) });
+        const size_t headerBytes = out.size();
+        out.resize(headerBytes + rowBytes * image.rows);
+        for (unsigned int y = 0; y < image.rows; y++)
+        {
+            // 16-bit samples in the file's byte order (II: little-endian)
+            PackRgbRow(image, y, out.data() + headerBytes + y * rowBytes, false);
+        }
+        return true;
+    }
+
+#ifndef USE_ZLIB
+    if (options.tiffCompression == TiffCompression::Deflate)
+    {
+        printf("Warning: Could not save %s: Deflate TIFF needs a build with zlib\n", name.c_str());
+        return false;
+    }
+#endif
+#ifndef USE_ZSTD
+    if (options.tiffCompression == TiffCompression::Zstd)
+    {
+        printf("Warning: Could not save %s: ZSTD TIFF needs a build with libzstd\n", name.c_str());
+        return false;
+    }
+#endif
+
+    Prepare();
+    const unsigned int numStrips = std::max(1u, (image.rows + TIFF_STRIP_ROWS - 1) / TIFF_STRIP_ROWS);
+    strips.resize(numStrips);
+    std::atomic<bool> failed(false);
+    RunStrips(numStrips, [&](unsigned int strip, ThreadState& state)
+    {
+        const unsigned int first = strip * TIFF_STRIP_ROWS;
+        const unsigned int last = std::min(image.rows, first + TIFF_STRIP_ROWS);
+        const size_t size = (last - first) * rowBytes;
+        state.rows.resize(size);
+        for (unsigned int y = first; y < last; y++)
+        {
+            unsigned char* row = state.rows.data() + (y - first) * rowBytes;
+            PackRgbRow(image, y, row, false);
+            ApplyHorizontalPredictor(row, rowBytes, is16Bit);
+        }
+
+        std::vector<unsigned char>& out = strips[strip];
+        out.clear();
+        switch (options.tiffCompression)
+        {
+        case TiffCompression::Lzw:
+            CompressLzw(state.rows.data(), size, state.lzwTable, out);
+            break;
+#ifdef USE_ZLIB
+        case TiffCompression::Deflate:
+        {
+            // Each strip is a zlib stream of its own
+            if (!PrepareDeflater(state.deflater, state.deflaterReady, options))
+            {
+                failed = true;
+                break;
+            }
+            PutZlibHeader(out, options);
+            if (!DeflateStrip(state.deflater, nullptr, 0, state.rows.data(), size, true, out))
+            {
+                failed = true;
+            }
+            PutBE32(out, static_cast<uint32_t>(adler32(adler32(0L, Z_NULL, 0), state.rows.data(),
+                                                       static_cast<uInt>(size))));
+            break;
+        }
+#endif
+#ifdef USE_ZSTD
+        case TiffCompression::Zstd:
+        {
+            if (state.zstd == nullptr)
+            {
+                state.zstd = ZSTD_createCCtx();
+            }
+            out.resize(ZSTD_compressBound(size));
+            const size_t compressed = ZSTD_compressCCtx(state.zstd, out.data(), out.size(), state.rows.data(), size,
+                                                        ZSTD_TIFF_LEVEL);
+            if (ZSTD_isError(compressed))
+            {
+                failed = true;
+                break;
+            }
+            out.resize(compressed);
+            break;
+        }
+#endif
+        default:
+            failed = true;
+            break;
+        }
+    });
+    if (failed)
+    {
+        printf("Warning: Could not compress %s\n", name.c_str());
+        return false;
+    }
+
+    std::vector<uint32_t> stripBytes;
+    for (const std::vector<unsigned char>& strip : strips)
+    {
+        stripBytes.push_back(static_cast<uint32_t>(strip.size()));
+    }
+    out = MakeTiffHeader(image, GetTiffCompressionCode(options.tiffCompression), TIFF_STRIP_ROWS, stripBytes);
+    for (const std::vector<unsigned char>& strip : strips)
+    {
+        out.insert(out.end(), strip.begin(), strip.end());
+    }
+    return true;
+}
+
+bool LosslessEncoder::WriteTiff(const ImageView& image, const std::string& path)
+{
+    return EncodeTiff(image, path, encoded) && WriteEncodedFile(encoded, path);
+}
+
+bool WriteTiffFile(const ImageView& image, const std::string& path, const LosslessOptions& options)
+{
+    LosslessEncoder encoder(options);
+    return encoder.WriteTiff(image, path);
+}
+
+//=============================================================================
+// PNG (8 or 16-bit RGB, any filter; strips joined into one zlib stream)
+//=============================================================================
+
+#ifdef USE_ZLIB
+
+static void PutPngChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size)
+{
+    PutBE32(out, static_cast<uint32_t>(size));
+    const size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    const uLong crc = crc32(0L, out.data() + typeStart, static_cast<uInt>(size + 4));
+    PutBE32(out, static_cast<uint32_t>(crc));
+}
+
+static unsigned char PaethPredictor(int left, int up, int upLeft)
+{
+    const int estimate = left + up - upLeft;
+    const int toLeft = abs(estimate - left);
+    const int toUp = abs(estimate - up);
+    const int toUpLeft = abs(estimate - upLeft);
+    if (toLeft <= toUp && toLeft <= toUpLeft)
+    {
+        return static_cast<unsigned char>(left);
+    }
+    return static_cast<unsigned char>((toUp <= toUpLeft) ? up : upLeft);
+}
+
+/**
+ * @brief Filter type byte and filtered bytes of one row
+ * @param up The unfiltered row above (zeros for the first row)
+ */
+static void FilterPngRow(PngFilter filter, const unsigned char* row, const unsigned char* up, size_t rowBytes,
+                         size_t pixelBytes, unsigned char* out)
+{
+    out[0] = static_cast<unsigned char>(filter);
+    unsigned char* filtered = out + 1;
+    switch (filter)
+    {
+    case PngFilter::None:
+        memcpy(filtered, row, rowBytes);
+        break;
+    case PngFilter::Sub:
+        memcpy(filtered, row, pixelBytes);
+        for (size_t i = pixelBytes; i < rowBytes; i++)
+        {
+            filtered[i] = static_cast<unsigned char>(row[i] - row[i - pixelBytes]);
+        }
+        break;
+    case PngFilter::Up:
+        for (size_t i = 0; i < rowBytes; i++)
+        {
+            filtered[i] = static_cast<unsigned char>(row[i] - up[i]);
+        }
+        break;
+    case PngFilter::Average:
+        for (size_t i = 0; i < rowBytes; i++)
+        {
+            const unsigned int left = (i >= pixelBytes) ? row[i - pixelBytes] : 0;
+            filtered[i] = static_cast<unsigned char>(row[i] - ((left + up[i]) >> 1));
+        }
+        break;
+    case PngFilter::Paeth:
+        for (size_t i = 0; i < rowBytes; i++)
+        {
+            const int left = (i >= pixelBytes) ? row[i - pixelBytes] : 0;
+            const int upLeft = (i >= pixelBytes) ? up[i - pixelBytes] : 0;
+            filtered[i] = static_cast<unsigned char>(row[i] - PaethPredictor(left, up[i], upLeft));
+        }
+        break;
+    case PngFilter::Adaptive:
+        break;
+    }
+}
+
+/**
+ * @brief Sum of the filtered bytes taken as signed, the usual measure of
+ *        how well a row will compress
+ */
+static size_t GetFilterCost(const unsigned char* filtered, size_t rowBytes)
+{
+    size_t cost = 0;
+    for (size_t i = 1; i <= rowBytes; i++)
+    {
+        cost += static_cast<size_t>(abs(static_cast<signed char>(filtered[i])));
+    }
+    return cost;
+}
+
+bool LosslessEncoder::EncodePng(const ImageView& image, const std::string& name, std::vector<unsigned char>& out)
+{
+    // Filtered rows: a filter type byte followed by the differences, byte
+    // by byte (16-bit samples are big-endian)
+    const bool is16Bit = image.format == PixelFormat::BGRU16;
+    const size_t pixelBytes = is16Bit ? 6 : 3;
+    const size_t rowBytes = static_cast<size_t>(image.cols) * pixelBytes;
+    const size_t filteredRowBytes = rowBytes + 1;
+
+    Prepare();
+    const unsigned int stripRows = pool ? PNG_STRIP_ROWS : std::max(1u, image.rows);
+    const unsigned int numStrips = std::max(1u, (image.rows + stripRows - 1) / stripRows);
+
+    filtered.resize(filteredRowBytes * image.rows);
+    RunStrips(numStrips, [&](unsigned int strip, ThreadState& state)
+    {
+        const unsigned int first = strip * stripRows;
+        const unsigned int last = std::min(image.rows, first + stripRows);
+
+        // Previous row, current row and the zero row above the first
+        state.rows.assign(rowBytes * 3, 0);
+        unsigned char* up = state.rows.data();
+        unsigned char* row = up + rowBytes;
+        const unsigned char* zero = row + rowBytes;
+        if (first > 0)
+        {
+            PackRgbRow(image, first - 1, up, true);
+        }
+
+        for (unsigned int y = first; y < last; y++)
+        {
+            PackRgbRow(image, y, row, true);
+            const unsigned char* above = (y > 0) ? up : zero;
+            unsigned char* out = filtered.data() + y * filteredRowBytes;
+            if (options.pngFilter != PngFilter::Adaptive)
+            {
+                FilterPngRow(options.pngFilter, row, above, rowBytes, pixelBytes, out);
+            }
+            else
+            {
+                state.candidate.resize(filteredRowBytes);
+                size_t bestCost = SIZE_MAX;
+                for (PngFilter filter : { PngFilter::None, PngFilter::Sub, PngFilter::Up, PngFilter::Average,
+                                          PngFilter::Paeth })
+                {
+                    FilterPngRow(filter, row, above, rowBytes, pixelBytes, state.candidate.data());
+                    const size_t cost = GetFilterCost(state.candidate.data(), rowBytes);
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        memcpy(out, state.candidate.data(), filteredRowBytes);
+                    }
+                }
+            }
+            std::swap(up, row);
+        }
+    });
+
+    // Each strip continues the deflate stream of the one before
+    strips.resize(numStrips);
+    stripChecks.resize(numStrips);
+    std::atomic<bool> failed(false);
+    RunStrips(numStrips, [&](unsigned int strip, ThreadState& state)
+    {
+        const size_t start = static_cast<size_t>(strip) * stripRows * filteredRowBytes;
+        const size_t end = std::min(filtered.size(), start + static_cast<size_t>(stripRows) * filteredRowBytes);
+        const unsigned char* in = filtered.data() + start;
+        const size_t dictionaryBytes = std::min(start, DEFLATE_WINDOW_BYTES);
+
+        stripChecks[strip] = static_cast<uint32_t>(adler32(adler32(0L, Z_NULL, 0), in, static_cast<uInt>(end - start)));
+        strips[strip].clear();
+        if (!PrepareDeflater(state.deflater, state.deflaterReady, options) ||
+            !DeflateStrip(state.deflater, in - dictionaryBytes, dictionaryBytes, in, end - start,
+                          strip + 1 == numStrips, strips[strip]))
+        {
+            failed = true;
+        }
+    });
+    if (failed)
+    {
+        printf("Warning: Could not compress %s\n", name.c_str());
+        return false;
+    }
+
+    std::vector<unsigned char> zlibHeader;
+    PutZlibHeader(zlibHeader, options);
+    uLong check = stripChecks[0];
+    size_t idatBytes = zlibHeader.size() + 4;
+    for (unsigned int strip = 0; strip < numStrips; strip++)
+    {
+        if (strip > 0)
+        {
+            const size_t start = static_cast<size_t>(strip) * stripRows * filteredRowBytes;
+            const size_t end = std::min(filtered.size(), start + static_cast<size_t>(stripRows) * filteredRowBytes);
+            check = adler32_combine(check, stripChecks[strip], static_cast<z_off_t>(end - start));
+        }
+        idatBytes += strips[strip].size();
+    }
+
+    static const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.assign(PNG_SIGNATURE, PNG_SIGNATURE + 8);
+
+    std::vector<unsigned char> header;
+    PutBE32(header, image.cols);
+    PutBE32(header, image.rows);
+    header.push_back(is16Bit ? 16 : 8);     // Bit depth
+    header.push_back(2);        // Colour type: RGB
+    header.push_back(0);        // Deflate
+    header.push_back(0);        // Adaptive filtering
+    header.push_back(0);        // No interlace
+    PutPngChunk(out, "IHDR", header.data(), header.size());
+
+    // The IDAT chunk is put together from the strips, its CRC taken as it goes
+    PutBE32(out, static_cast<uint32_t>(idatBytes));
+    const size_t idatStart = out.size();
+    out.reserve(idatStart + 4 + idatBytes + 4 + 12);
+    const unsigned char IDAT[4] = { 'I', 'D', 'A', 'T' };
+    out.insert(out.end(), IDAT, IDAT + 4);
+    out.insert(out.end(), zlibHeader.begin(), zlibHeader.end());
+    for (const std::vector<unsigned char>& strip : strips)
+    {
+        out.insert(out.end(), strip.begin(), strip.end());
+    }
+    PutBE32(out, static_cast<uint32_t>(check));
+    const uLong crc = crc32(0L, out.data() + idatStart, static_cast<uInt>(out.size() - idatStart));
+    PutBE32(out, static_cast<uint32_t>(crc));
+    PutPngChunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+#else
+
+bool LosslessEncoder::EncodePng(const ImageView&, const std::string& name, std::vector<unsigned char>&)
+{
+    printf("Warning: Could not save %s: PNG output needs a build with zlib\n", name.c_str());
+    return false;
+}
+
+#endif
+
+bool LosslessEncoder::WritePng(const ImageView& image, const std::string& path)
+{
+    return EncodePng(image, path, encoded) && WriteEncodedFile(encoded, path);
+}
+
+bool WritePngFile(const ImageView& image, const std::string& path, const LosslessOptions& options)
+{
+    LosslessEncoder encoder(options);
+    return encoder.WritePng(image, path);
+}
+
+//=============================================================================
+// JPEG
+//=============================================================================
+
+#ifdef USE_LIBJPEG
+
+// Bytes an encoded JPEG starts with before it grows
+constexpr size_t JPEG_BUFFER_BYTES = 1024 * 1024;
+
+struct JpegEncoder::Compressor
+{
+    jpeg_compress_struct cinfo;
+    JpegErrorManager errorManager;
+    JpegVectorDestination destination;
+    std::vector<JSAMPROW> rows;         // Row pointers of the image being encoded
+    std::vector<unsigned char> packed;  // RGB copy when libjpeg cannot read BGRU/BGR
+    std::vector<unsigned char> encoded; // Output of Write
+
+    Compressor()
+    {
+        cinfo.err = InitJpegErrorManager(errorManager);
+        jpeg_create_compress(&cinfo);
+        SetJpegVectorDestination(cinfo, destination, JPEG_BUFFER_BYTES);
+    }
+
+    ~Compressor()
+    {
+        jpeg_destroy_compress(&cinfo);
+    }
+};
+
+/**
+ * @brief Set the chroma resolution through the luma sampling factors
+ *
+ * jpeg_set_defaults gives luma 2x2 and both chroma components 1x1 (4:2:0).
+ */
+static void SetSubsampling(jpeg_compress_struct& cinfo, JpegSubsampling subsampling)
+{
+    jpeg_component_info& luma = cinfo.comp_info[0];
+    luma.h_samp_factor = (subsampling == JpegSubsampling::S444) ? 1 : 2;
+    luma.v_samp_factor = (subsampling == JpegSubsampling::S420) ? 2 : 1;
+}
+
+JpegEncoder::JpegEncoder(const JpegOptions& options)
+    : options(options)
+{
+}
+
+JpegEncoder::~JpegEncoder() = default;
+
+bool JpegEncoder::Encode(const ImageView& image, const std::string& name, std::vector<unsigned char>& out)
+{
+    if (!CheckInput(image, name))
+    {
+        return false;
+    }
+
+    if (!compressor)
+    {
+        compressor.reset(new Compressor());
+    }
+    jpeg_compress_struct& cinfo = compressor->cinfo;
+
+    if (setjmp(compressor->errorManager.jump))
+    {
+        char message[JMSG_LENGTH_MAX];
+        (*cinfo.err->format_message)(reinterpret_cast<j_common_ptr>(&cinfo), message);
+        printf("Warning: Could not encode %s: %s\n", name.c_str(), message);
+        // Aborting keeps the compressor usable for the next image
+        jpeg_abort_compress(&cinfo);
+        return false;
+    }
+
+    compressor->destination.out = &out;
+    cinfo.image_width = image.cols;
+    cinfo.image_height = image.rows;
+
+    // libjpeg-turbo reads BGRU/BGR rows directly
+    const unsigned int inStep = GetBytesPerPixel(image.format);
+#ifdef JCS_EXTENSIONS
+    cinfo.input_components = static_cast<int>(inStep);
+    cinfo.in_color_space = (image.format == PixelFormat::BGR) ? JCS_EXT_BGR : JCS_EXT_BGRX;
+#else
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+#endif
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, options.quality, TRUE);
+    SetSubsampling(cinfo, options.subsampling);
+    cinfo.dct_method = options.fastDct ? JDCT_IFAST : JDCT_ISLOW;
+    cinfo.optimize_coding = options.optimizeCoding ? TRUE : FALSE;
+    jpeg_start_compress(&cinfo, TRUE);
+
+    // Hand over every row at once; libjpeg takes as many per call as its
+    // buffers hold
+    std::vector<JSAMPROW>& rows = compressor->rows;
+    rows.resize(image.rows);
+#ifdef JCS_EXTENSIONS
+    const size_t rowBytes = static_cast<size_t>(image.cols) * inStep;
+    for (unsigned int y = 0; y < image.rows; y++)
+    {
+        rows[y] = const_cast<JSAMPROW>(image.data + y * rowBytes);
+    }
+#else
+    const size_t rowBytes = static_cast<size_t>(image.cols) * 3;
+    compressor->packed.resize(rowBytes * image.rows);
+    for (unsigned int y = 0; y < image.rows; y++)
+    {
+        rows[y] = compressor->packed.data() + y * rowBytes;
+        PackRow(image, y, rows[y], true);
+    }
+#endif
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        jpeg_write_scanlines(&cinfo, rows.data() + cinfo.next_scanline, cinfo.image_height - cinfo.next_scanline);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    return true;
+}
+
+bool JpegEncoder::Write(const ImageView& image, const std::string& path)
+{
+    if (!compressor)
+    {
+        compressor.reset(new Compressor());
+    }
+    std::vector<unsigned char>& encoded = compressor->encoded;
+    return Encode(image, path, encoded) && WriteEncodedFile(encoded, path);
+}
+
+#else
+
+struct JpegEncoder::Compressor
+{
+};
+
+JpegEncoder::JpegEncoder(const JpegOptions& options)
+    : options(options)
+{
+}
+
+JpegEncoder::~JpegEncoder() = default;
+
+bool JpegEncoder::Encode(const ImageView&, const std::string& name, std::vector<unsigned char>&)
+{
+    printf("Warning: Could not save %s: JPEG output needs a build with libjpeg\n", name.c_str());
+    return false;
+}
+
+bool JpegEncoder::Write(const ImageView& image, const std::string& path)
+{
+    std::vector<unsigned char> encoded;
+    return Encode(image, path, encoded);
+}
+
+#endif
+
+bool WriteJpegFile(const ImageView& image, const std::string& path, const JpegOptions& options)
+{
+    JpegEncoder encoder(options);
+    return encoder.Write(image, path);
+}
+
+//=============================================================================
+// Format Dispatch
+//=============================================================================
+
+bool WriteImageFile(const ImageView& image, const std::string& path, ImageFileFormat format)
+{
+    switch (format)
+    {
+    case ImageFileFormat::BMP:  return WriteBmpFile(image, path);
+    case ImageFileFormat::JPG:  return WriteJpegFile(image, path);
+    case ImageFileFormat::TIFF: return WriteTiffFile(image, path);
+    case ImageFileFormat::PNG:  return WritePngFile(image, path);
+    }
+    return false;
+}
+
+bool EncodeImage(const ImageView& image, const std::string& name, ImageFileFormat format,
+                 std::vector<unsigned char>& out)
+{
+    switch (format)
+    {
+    case ImageFileFormat::BMP:
+        return EncodeBmp(image, name, out);
+    case ImageFileFormat::JPG:
+    {
+        JpegEncoder encoder;
+        return encoder.Encode(image, name, out);
+    }
+    case ImageFileFormat::TIFF:
+    {
+        LosslessEncoder encoder;
+        return encoder.EncodeTiff(image, name, out);
+    }
+    case ImageFileFormat::PNG:
+    {
+        LosslessEncoder encoder;
+        return encoder.EncodePng(image, name, out);
+    }
+    }
+    return false;
+}
+
+bool WriteEncodedFile(const std::vector<unsigned char>& data, const std::string& path)
+{
+    FILE* file = OpenOutputFile(path);
+    if (file == nullptr)
+    {
+        return false;
+    }
+    const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return CloseOutputFile(file, written, path);
+}
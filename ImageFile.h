@@ -0,0 +1,151 @@
+//=============================================================================
+// ImageFile - Native image file writers (BMP, TIFF, PNG, JPEG)
+//
+// Used by the CPU backend in place of ladybugSaveImage, and by the SDK
+// backend for formats whose encoder options were given. BMP and TIFF are
+// written by hand and always available; PNG needs zlib (USE_ZLIB) and JPEG
+// needs libjpeg or libjpeg-turbo (USE_LIBJPEG). Input is BGRU or BGR; the
+// unused channel is dropped. PNG and TIFF also take BGRU16 and then write
+// 16 bits per sample.
+//
+// TIFF is uncompressed unless LosslessOptions asks for LZW, Deflate (zlib)
+// or ZSTD (USE_ZSTD); compressed TIFFs use the horizontal predictor.
+//
+// Every format is encoded in memory first; the Encode functions hand the
+// file's bytes to the caller (e.g. to put them into an archive) and the
+// Write functions save them under the given path.
+//=============================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ImagingBackend.h"
+
+class WorkerPool;
+
+bool EncodeBmp(const ImageView& image, const std::string& name, std::vector<unsigned char>& out);
+bool WriteBmpFile(const ImageView& image, const std::string& path);
+bool WriteTiffFile(const ImageView& image, const std::string& path, const LosslessOptions& options = LosslessOptions());
+bool WritePngFile(const ImageView& image, const std::string& path, const LosslessOptions& options = LosslessOptions());
+bool WriteJpegFile(const ImageView& image, const std::string& path, const JpegOptions& options = JpegOptions());
+
+/**
+ * @brief Write an image in the given format
+ * @return false (with a message) if the format is not built in or the
+ *         file cannot be written
+ */
+bool WriteImageFile(const ImageView& image, const std::string& path, ImageFileFormat format);
+
+/**
+ * @brief Encode an image in the given format, with default options
+ * @param name Only used in messages
+ * @param out Replaced by the bytes of the file
+ * @return false (with a message) if the format is not built in
+ */
+bool EncodeImage(const ImageView& image, const std::string& name, ImageFileFormat format,
+                 std::vector<unsigned char>& out);
+
+/**
+ * @brief Write an image file that is already encoded, as it is
+ */
+bool WriteEncodedFile(const std::vector<unsigned char>& data, const std::string& path);
+
+/**
+ * @brief JPEG compressor kept from image to image
+ *
+ * Setting up a libjpeg compressor allocates its memory pools and tables;
+ * an encoder thread keeps one and reuses it for every image it saves.
+ * BGRU and BGR rows are handed to libjpeg-turbo where they are, without a
+ * packed copy. Not thread safe: one per thread.
+ */
+class JpegEncoder
+{
+public:
+    explicit JpegEncoder(const JpegOptions& options = JpegOptions());
+    ~JpegEncoder();
+
+    JpegEncoder(const JpegEncoder&) = delete;
+    JpegEncoder& operator=(const JpegEncoder&) = delete;
+
+    /**
+     * @brief Encode into memory
+     * @param name Only used in messages
+     * @param out Replaced by the JPEG file; its capacity is reused
+     * @return false (with a message) if libjpeg is not built in
+     */
+    bool Encode(const ImageView& image, const std::string& name, std::vector<unsigned char>& out);
+
+    /**
+     * @return false (with a message) if libjpeg is not built in or the file
+     *         cannot be written
+     */
+    bool Write(const ImageView& image, const std::string& path);
+
+private:
+    struct Compressor;                  // libjpeg state (jpeglib.h stays out of this header)
+
+    JpegOptions options;
+    std::unique_ptr<Compressor> compressor;     // Created by the first Write
+};
+
+/**
+ * @brief PNG and TIFF writer kept from image to image
+ *
+ * Images are compressed in strips of rows. With more than one strip thread
+ * the strips of one image are compressed at once: PNG strips are deflate
+ * streams joined with a sync flush, each primed with the end of the strip
+ * before it, and TIFF strips are the file's own strips. The threads, row
+ * buffers and compressors stay from image to image. Not thread safe: one per
+ * encoder thread.
+ */
+class LosslessEncoder
+{
+public:
+    explicit LosslessEncoder(const LosslessOptions& options = LosslessOptions());
+    ~LosslessEncoder();
+
+    LosslessEncoder(const LosslessEncoder&) = delete;
+    LosslessEncoder& operator=(const LosslessEncoder&) = delete;
+
+    /**
+     * @return false (with a message) if the codec is not built in or the
+     *         file cannot be written
+     */
+    bool WritePng(const ImageView& image, const std::string& path);
+    bool WriteTiff(const ImageView& image, const std::string& path);
+
+    /**
+     * @brief Encode into memory
+     * @param name Only used in messages
+     * @param out Replaced by the PNG or TIFF file
+     * @return false (with a message) if the codec is not built in
+     */
+    bool EncodePng(const ImageView& image, const std::string& name, std::vector<unsigned char>& out);
+    bool EncodeTiff(const ImageView& image, const std::string& name, std::vector<unsigned char>& out);
+
+private:
+    struct ThreadState;                 // Row buffers and compressors of one strip thread
+
+    /**
+     * @brief Start the strip threads and their state (first image only)
+     */
+    void Prepare();
+
+    /**
+     * @brief Run task(strip, state of the thread running it) for every strip
+     */
+    void RunStrips(unsigned int numStrips, const std::function<void(unsigned int, ThreadState&)>& task);
+
+    LosslessOptions options;
+    std::unique_ptr<WorkerPool> pool;   // Null with one strip thread
+    std::vector<std::unique_ptr<ThreadState>> threadStates;
+    std::vector<unsigned char> filtered;                // Filtered PNG rows of the whole image
+    std::vector<std::vector<unsigned char>> strips;     // Compressed strips
+    std::vector<uint32_t> stripChecks;                  // Adler-32 of each PNG strip
+    std::vector<unsigned char> encoded;                 // Output of WritePng and WriteTiff
+};
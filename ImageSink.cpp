@@ -0,0 +1,104 @@
+//=============================================================================
+// ImageSink - Destination of encoded images other than one file each
+//=============================================================================
+
+#include "ImageSink.h"
+
+//=============================================================================
+// OrderedImageSink
+//=============================================================================
+
+bool OrderedImageSink::Add(uint64_t sequence, const std::string& name, unsigned int frameNum, int camera,
+                           const std::vector<unsigned char>& data)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!IsOpen() || failed)
+    {
+        return false;
+    }
+
+    // The next image goes straight out; later ones wait for it
+    if (sequence != nextSequence)
+    {
+        PendingImage& image = pending[sequence];
+        image.name = name;
+        image.frameNum = frameNum;
+        image.camera = camera;
+        image.data = data;
+        return true;
+    }
+    WriteImage(name, frameNum, camera, data);
+    nextSequence++;
+    WritePending();
+    return !failed;
+}
+
+void OrderedImageSink::Skip(uint64_t sequence, int camera)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (sequence != nextSequence)
+    {
+        PendingImage& image = pending[sequence];
+        image.skipped = true;
+        image.camera = camera;
+        return;
+    }
+    if (IsOpen() && !failed)
+    {
+        SkipImage(camera);
+    }
+    nextSequence++;
+    WritePending();
+}
+
+bool OrderedImageSink::Failed() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
+
+void OrderedImageSink::SkipImage(int)
+{
+}
+
+void OrderedImageSink::ResetOrder()
+{
+    nextSequence = 0;
+    pending.clear();
+    failed = false;
+}
+
+void OrderedImageSink::WriteHeldImages()
+{
+    for (const auto& entry : pending)
+    {
+        Release(entry.second);
+    }
+    pending.clear();
+}
+
+void OrderedImageSink::Release(const PendingImage& image)
+{
+    if (!IsOpen() || failed)
+    {
+        return;
+    }
+    if (image.skipped)
+    {
+        SkipImage(image.camera);
+    }
+    else
+    {
+        WriteImage(image.name, image.frameNum, image.camera, image.data);
+    }
+}
+
+void OrderedImageSink::WritePending()
+{
+    while (!pending.empty() && pending.begin()->first == nextSequence)
+    {
+        Release(pending.begin()->second);
+        pending.erase(pending.begin());
+        nextSequence++;
+    }
+}
@@ -0,0 +1,130 @@
+//=============================================================================
+// ImageSink - Destination of encoded images other than one file each
+//
+// The encoder threads hand a sink every image they encode (--archive,
+// --output-pipe, --video). Images are numbered by the write stage in frame
+// order, camera by camera, without gaps; a sink that has to keep that order
+// uses the number to put the images finished out of order back in place. An
+// image that could not be encoded is skipped with its number, so the ones
+// after it are not held back.
+//
+// OrderedImageSink does that reordering for the sinks that need it
+// (--output-pipe, --video); they only write the images in order.
+//=============================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ImageSink
+{
+public:
+    virtual ~ImageSink() = default;
+
+    /**
+     * @brief Take one encoded image; called from any encoder thread
+     * @param sequence Position of the image in the output, from 0
+     * @param name File name the image would have had
+     * @param camera Camera index, or -1 for a panorama
+     * @return false (with a message) if the image could not be written
+     */
+    virtual bool Add(uint64_t sequence, const std::string& name, unsigned int frameNum, int camera,
+                     const std::vector<unsigned char>& data) = 0;
+
+    /**
+     * @brief Give up on an image that could not be encoded
+     * @param camera Camera index, or -1 for a panorama
+     */
+    virtual void Skip(uint64_t sequence, int camera) = 0;
+
+    /**
+     * @brief Write what is left and close the output
+     * @return false (with a message) if anything could not be written
+     */
+    virtual bool Close() = 0;
+
+    /**
+     * @brief The output cannot take any more images (e.g. the reader of a
+     *        pipe went away)
+     */
+    virtual bool Failed() const = 0;
+};
+
+/**
+ * @brief Sink that writes its images one at a time in sequence order;
+ *        thread safe
+ *
+ * Add and Skip hold the images that finish early until the ones in front of
+ * them are in. The derived class sees the images in order, with the lock
+ * held, and sets failed when it cannot write any more.
+ */
+class OrderedImageSink : public ImageSink
+{
+public:
+    bool Add(uint64_t sequence, const std::string& name, unsigned int frameNum, int camera,
+             const std::vector<unsigned char>& data) override;
+    void Skip(uint64_t sequence, int camera) override;
+    bool Failed() const override;
+
+protected:
+    /**
+     * @brief The output is open (lock held)
+     */
+    virtual bool IsOpen() const = 0;
+
+    /**
+     * @brief Write the next image (lock held)
+     */
+    virtual void WriteImage(const std::string& name, unsigned int frameNum, int camera,
+                            const std::vector<unsigned char>& data) = 0;
+
+    /**
+     * @brief The next image was skipped (lock held); the output leaves it
+     *        out unless it overrides this
+     */
+    virtual void SkipImage(int camera);
+
+    /**
+     * @brief Start at sequence 0 with nothing held (output opened)
+     */
+    void ResetOrder();
+
+    /**
+     * @brief Write the images still held, in order, past the ones that never
+     *        came because the export stopped early (lock held, for Close)
+     */
+    void WriteHeldImages();
+
+    mutable std::mutex mutex;
+    bool failed = false;
+
+private:
+    /**
+     * @brief An image finished before the ones in front of it
+     */
+    struct PendingImage
+    {
+        bool skipped = false;
+        std::string name;
+        unsigned int frameNum = 0;
+        int camera = -1;
+        std::vector<unsigned char> data;
+    };
+
+    /**
+     * @brief Write or skip one held image, unless the output failed
+     */
+    void Release(const PendingImage& image);
+
+    /**
+     * @brief Write the held images that are now next in line
+     */
+    void WritePending();
+
+    uint64_t nextSequence = 0;
+    std::map<uint64_t, PendingImage> pending;
+};
@@ -0,0 +1,151 @@
+//=============================================================================
+// ImagingBackend - Read/convert/render/save interface of the frame pipeline
+//=============================================================================
+
+#include "ImagingBackend.h"
+
+#include <cstdio>
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+unsigned int GetBytesPerPixel(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::BGRU:   return 4;
+    case PixelFormat::BGRU16: return 8;
+    case PixelFormat::BGR:    return 3;
+    }
+    return 4;
+}
+
+void GetTextureSize(ColorMethod method, unsigned int imageCols, unsigned int imageRows,
+                    unsigned int& textureWidth, unsigned int& textureHeight)
+{
+    unsigned int divisor = 1;
+    if (method == ColorMethod::Downsample4)
+    {
+        divisor = 2;
+    }
+    else if (method == ColorMethod::Downsample16)
+    {
+        divisor = 4;
+    }
+
+    textureWidth = imageCols / divisor;
+    textureHeight = imageRows / divisor;
+}
+
+std::unique_ptr<RawFrame> FrameStream::CreateFrame() const
+{
+    return std::unique_ptr<RawFrame>(new RawFrame());
+}
+
+bool FrameConverter::PassThrough(const RawFrame& raw, std::vector<unsigned char> jpegs[NUM_CAMERAS],
+                                 std::string& reason)
+{
+    (void)raw;
+    (void)jpegs;
+    reason = "the backend always decodes frames";
+    return false;
+}
+
+//=============================================================================
+// Backend Selection
+//=============================================================================
+
+const char* GetDefaultBackendName()
+{
+#ifdef USE_LADYBUG_SDK
+    return "sdk";
+#else
+    return "cpu";
+#endif
+}
+
+std::unique_ptr<ImagingBackend> CreateImagingBackend(const std::string& name)
+{
+    if (name == "cpu")
+    {
+        return CreateCpuBackend();
+    }
+    if (name == "sdk")
+    {
+#ifdef USE_LADYBUG_SDK
+        return CreateSdkBackend();
+#else
+        printf("Error: This build does not include the Ladybug SDK backend\n");
+        return nullptr;
+#endif
+    }
+
+    printf("Error: Unknown imaging backend '%s'\n", name.c_str());
+    return nullptr;
+}
+
+//=============================================================================
+// NativeFrameStream
+//=============================================================================
+
+bool NativeFrameStream::Open(std::vector<StreamSegment>& streamSegments)
+{
+    readers.clear();
+    for (StreamSegment& segment : streamSegments)
+    {
+        std::unique_ptr<PgrStreamReader> reader(new PgrStreamReader());
+        if (!reader->Open(segment.path))
+        {
+            return false;
+        }
+        segment.frameCount = reader->GetFrameCount();
+        printf("Native reader: %s: %u frames (%s)\n", segment.path.c_str(), segment.frameCount,
+               reader->IndexLoadedFromSidecar() ? "index loaded" : "index built");
+        readers.push_back(std::move(reader));
+    }
+
+    NumberStreamSegments(streamSegments);
+    segments = streamSegments;
+    prefetchedSegment = 0;
+    return true;
+}
+
+bool NativeFrameStream::Seek(unsigned int frame)
+{
+    // Every frame is reachable through the index; just check the range
+    return FindSegmentForFrame(segments, frame) != segments.size();
+}
+
+bool NativeFrameStream::Read(unsigned int frame, RawFrame& raw)
+{
+    const size_t segment = FindSegmentForFrame(segments, frame);
+    PgrFrameView view;
+    if (segment == segments.size() ||
+        !readers[segment]->GetFrame(frame - segments[segment].firstFrame, view))
+    {
+        printf("Warning: Could not read frame %u: Frame is outside the stream index\n", frame);
+        return false;
+    }
+
+    raw.frameNum = frame;
+    raw.data = view.data;
+    raw.size = view.size;
+    for (int i = 0; i < PGR_NUM_PLANES; i++)
+    {
+        raw.planes[i] = view.planes[i];
+    }
+
+    // Near the end of a segment, pull the first frames of the next one into
+    // the page cache (it is already mapped)
+    const size_t nextSegment = segment + 1;
+    const StreamSegment& current = segments[segment];
+    if (nextSegment < segments.size() && prefetchedSegment != nextSegment &&
+        frame - current.firstFrame + SEGMENT_PREFETCH_FRAMES >= current.frameCount)
+    {
+        readers[nextSegment]->Prefetch(0, SEGMENT_PREFETCH_FRAMES);
+        prefetchedSegment = nextSegment;
+    }
+
+    return true;
+}
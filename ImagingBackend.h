@@ -0,0 +1,389 @@
+//=============================================================================
+// ImagingBackend - Read/convert/render/save interface of the frame pipeline
+//
+// The pipeline in main.cpp never calls an imaging library directly; every
+// stage goes through one of the objects below, created by an ImagingBackend:
+//
+//   read     FrameStream        Raw frames of the recording set
+//   convert  FrameConverter     Debayers a raw frame into six camera textures
+//   render   PanoramaRenderer   Stitches the textures into a panorama
+//   write    ImageWriter        Encodes and saves an image file
+//
+// Each object is used by one thread only and is created on that thread, so
+// an implementation can keep per-thread state (SDK contexts, OpenGL
+// resources, codec state) without locking.
+//
+// Implementations:
+//   sdk  Teledyne FLIR Ladybug SDK (built with USE_LADYBUG_SDK)
+//   cpu  In-tree CPU code on top of PgrStreamReader. No SDK, no GPU and
+//        deterministic output, so the whole pipeline builds and runs
+//        headless on Linux.
+//=============================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PgrStreamReader.h"
+#include "StreamSegments.h"
+
+class RunStats;
+class ToneCurve;
+
+// Cameras in a Ladybug head (5 around, 1 pointing up)
+constexpr int NUM_CAMERAS = PGR_NUM_CAMERAS;
+
+// Frames before the end of a segment at which the next segment is opened
+constexpr unsigned int SEGMENT_PREFETCH_FRAMES = 8;
+
+// JPEG quality used when none is given
+constexpr int DEFAULT_JPEG_QUALITY = 85;
+
+// zlib level used when none is given (Z_DEFAULT_COMPRESSION)
+constexpr int DEFAULT_ZLIB_LEVEL = 6;
+
+//=============================================================================
+// Image Types
+//=============================================================================
+
+enum class PixelFormat
+{
+    BGRU,       // 8-bit blue, green, red, unused
+    BGRU16,     // 16-bit per channel, native byte order
+    BGR         // 8-bit, no padding (rendered panoramas)
+};
+
+enum class ImageFileFormat
+{
+    BMP,
+    JPG,
+    TIFF,
+    PNG
+};
+
+enum class JpegSubsampling
+{
+    S444,       // Full resolution chroma
+    S422,       // Half width chroma
+    S420        // Half width and height chroma (the libjpeg default)
+};
+
+/**
+ * @brief Settings of the native JPEG encoder (--jpeg-* options)
+ */
+struct JpegOptions
+{
+    int quality = DEFAULT_JPEG_QUALITY;     // 1-100
+    JpegSubsampling subsampling = JpegSubsampling::S420;
+    bool fastDct = false;               // Fast integer DCT (faster, slightly less accurate)
+    bool optimizeCoding = false;        // Huffman tables fitted to each image (smaller, slower)
+};
+
+enum class ZlibStrategy
+{
+    Default,
+    Filtered,
+    Rle,            // Run lengths only: fast, for level 1 exports
+    HuffmanOnly
+};
+
+enum class PngFilter
+{
+    None,
+    Sub,            // Difference to the pixel on the left (the default)
+    Up,
+    Average,
+    Paeth,
+    Adaptive        // Per row, the filter with the smallest sum of differences
+};
+
+enum class TiffCompression
+{
+    None,
+    Lzw,
+    Deflate,        // Needs zlib (USE_ZLIB)
+    Zstd            // Needs libzstd (USE_ZSTD)
+};
+
+/**
+ * @brief Settings of the native PNG and TIFF writers (--zlib-*, --png-filter,
+ *        --tiff-compression, --strip-threads)
+ */
+struct LosslessOptions
+{
+    int zlibLevel = DEFAULT_ZLIB_LEVEL;     // 0-9, PNG and Deflate TIFF
+    ZlibStrategy zlibStrategy = ZlibStrategy::Default;
+    PngFilter pngFilter = PngFilter::Sub;
+    TiffCompression tiffCompression = TiffCompression::None;
+    unsigned int stripThreads = 1;      // Threads compressing the row strips of one image (0 = all)
+};
+
+enum class ColorMethod
+{
+    HqLinear,
+    EdgeSensing,
+    NearestNeighbor,
+    Downsample4,    // Half width and height
+    Downsample16,   // Quarter width and height
+    Mono
+};
+
+/**
+ * @brief Bytes per pixel of a pixel format
+ */
+unsigned int GetBytesPerPixel(PixelFormat format);
+
+/**
+ * @brief Converted texture size for a colour processing method
+ *
+ * Downsample4 halves and Downsample16 quarters both dimensions.
+ */
+void GetTextureSize(ColorMethod method, unsigned int imageCols, unsigned int imageRows,
+                    unsigned int& textureWidth, unsigned int& textureHeight);
+
+/**
+ * @brief Non-owning view of an image in memory (rows are tightly packed)
+ */
+struct ImageView
+{
+    const unsigned char* data = nullptr;
+    unsigned int cols = 0;
+    unsigned int rows = 0;
+    PixelFormat format = PixelFormat::BGRU;
+};
+
+//=============================================================================
+// Backend Configuration
+//=============================================================================
+
+struct BackendOptions
+{
+    ColorMethod colorMethod = ColorMethod::HqLinear;
+    int blendingWidth = 100;
+    bool nativeReader = false;          // Read frames with PgrStreamReader
+
+    // Panorama rendering
+    int panoWidth = 2048;
+    int panoHeight = 1024;
+    double rotFront = 0.0;              // Degrees (pitch)
+    double rotDown = 0.0;               // Degrees (yaw)
+    bool cpuRenderer = false;           // Render with PanoramaLut instead of the GPU (sdk backend)
+    unsigned int renderThreads = 0;     // Threads per panorama for CPU rendering (0 = all)
+    unsigned int decodeThreads = 0;     // Threads decoding a frame's JPEG planes (cpu backend, 0 = all)
+    unsigned int demosaicThreads = 0;   // Threads debayering a frame's cameras (cpu backend, 0 = all)
+    std::string cacheDir;               // Remap table cache directory (empty = no cache)
+    bool alphaMasks = true;             // SDK alpha masks in the render context (sdk backend, GPU panoramas)
+    bool cameraAlphaMasks = false;      // SDK alpha masks in the converted camera images (sdk backend)
+    RunStats* stats = nullptr;          // Timers for steps inside the stages (--report, --trace), null = off
+
+    // BGRU16 to BGRU reduction (6 camera export of high bit depth streams)
+    unsigned int convertThreads = 0;    // Cameras converted at once (0 = all logical processors, up to 6)
+    std::shared_ptr<const ToneCurve> toneCurve;     // Null = high byte (linear)
+
+    // JPEG encoding. The sdk backend keeps ladybugSaveImage unless a --jpeg-*
+    // option was given (nativeJpeg) and it was built with libjpeg.
+    JpegOptions jpeg;
+    bool nativeJpeg = false;
+
+    // PNG and TIFF encoding; likewise for the sdk backend with nativeLossless
+    LosslessOptions lossless;
+    bool nativeLossless = false;
+};
+
+/**
+ * @brief What the backend found in the stream, filled in by Initialize
+ */
+struct StreamInfo
+{
+    unsigned int serialBase = 0;
+    unsigned int serialHead = 0;
+    float frameRate = 0.0f;
+    unsigned int dataFormat = 0;
+    unsigned int resolution = 0;
+    unsigned int streamVersion = 0;
+
+    unsigned int imageCols = 0;         // Raw camera image size
+    unsigned int imageRows = 0;
+    unsigned int textureWidth = 0;      // Converted camera image size
+    unsigned int textureHeight = 0;
+    bool highBitDepth = false;          // 12/16-bit formats (BGRU16 textures)
+};
+
+//=============================================================================
+// Stage Interfaces
+//=============================================================================
+
+/**
+ * @brief One raw frame as read from the stream
+ *
+ * Backends that need more per-frame state derive from it and hand out their
+ * own type from FrameStream::CreateFrame.
+ */
+struct RawFrame
+{
+    virtual ~RawFrame() = default;
+
+    unsigned int frameNum = 0;
+    const unsigned char* data = nullptr;    // Frame as stored in the stream
+    size_t size = 0;
+    PgrPlaneView planes[PGR_NUM_PLANES];    // Camera/channel planes (native reader only)
+    std::vector<unsigned char> storage;     // Private copy if the reader reuses its buffer
+};
+
+class FrameStream
+{
+public:
+    virtual ~FrameStream() = default;
+
+    /**
+     * @brief Allocate a frame this stream can read into
+     */
+    virtual std::unique_ptr<RawFrame> CreateFrame() const;
+
+    /**
+     * @brief Position the stream so the next Read returns a global frame number
+     */
+    virtual bool Seek(unsigned int frame) = 0;
+
+    /**
+     * @brief Read a frame; frames are read in increasing order after a Seek
+     */
+    virtual bool Read(unsigned int frame, RawFrame& raw) = 0;
+};
+
+class FrameConverter
+{
+public:
+    virtual ~FrameConverter() = default;
+
+    /**
+     * @brief Debayer a frame into six textures of the stream's texture size
+     */
+    virtual bool Convert(const RawFrame& raw, unsigned char* const textures[NUM_CAMERAS], PixelFormat format) = 0;
+
+    /**
+     * @brief Convert six BGRU16 textures to BGRU in place
+     */
+    virtual bool ReduceTo8Bit(unsigned char* const textures[NUM_CAMERAS], unsigned int cols, unsigned int rows) = 0;
+
+    /**
+     * @brief Repack the camera images of a frame into JPEG files without
+     *        decoding them (--jpeg-passthrough)
+     *
+     * Each file holds a camera image of the Downsample4 texture size. The
+     * default implementation passes no frame through.
+     * @param jpegs Receives one JPEG file per camera
+     * @param reason Receives why the frame has to be converted instead
+     * @return false if the frame must take the Convert path
+     */
+    virtual bool PassThrough(const RawFrame& raw, std::vector<unsigned char> jpegs[NUM_CAMERAS], std::string& reason);
+};
+
+class PanoramaRenderer
+{
+public:
+    virtual ~PanoramaRenderer() = default;
+
+    /**
+     * @brief Stitch six textures into a BGR panorama
+     * @param panoBuffer Receives the pixels; panoImage points into it
+     */
+    virtual bool Render(const unsigned char* const textures[NUM_CAMERAS], PixelFormat format,
+                        std::vector<unsigned char>& panoBuffer, ImageView& panoImage) = 0;
+};
+
+class ImageWriter
+{
+public:
+    virtual ~ImageWriter() = default;
+
+    virtual bool Save(const ImageView& image, const std::string& path, ImageFileFormat format) = 0;
+
+    /**
+     * @brief Encode an image into memory instead of a file of its own
+     * @param name Only used in messages
+     * @param data Replaced by the bytes Save would have written
+     */
+    virtual bool Encode(const ImageView& image, const std::string& name, ImageFileFormat format,
+                        std::vector<unsigned char>& data) = 0;
+};
+
+//=============================================================================
+// Backend
+//=============================================================================
+
+class ImagingBackend
+{
+public:
+    virtual ~ImagingBackend() = default;
+
+    virtual const char* Name() const = 0;
+
+    /**
+     * @brief Open the recording set and prepare conversion
+     *
+     * Counts the frames of every segment and numbers them globally (see
+     * NumberStreamSegments). Called once, before any Create* call.
+     */
+    virtual bool Initialize(std::vector<StreamSegment>& segments, const BackendOptions& options,
+                            StreamInfo& info) = 0;
+
+    /**
+     * @brief Objects for the pipeline stages
+     *
+     * There is one stream and one converter per backend. Renderers and
+     * writers may be created any number of times, on the thread using them.
+     */
+    virtual std::unique_ptr<FrameStream> CreateStream() = 0;
+    virtual std::unique_ptr<FrameConverter> CreateConverter() = 0;
+    virtual std::unique_ptr<PanoramaRenderer> CreateRenderer() = 0;
+    virtual std::unique_ptr<ImageWriter> CreateWriter() = 0;
+};
+
+/**
+ * @brief Name of the backend used when none is requested
+ */
+const char* GetDefaultBackendName();
+
+/**
+ * @brief Create a backend by name ("sdk" or "cpu")
+ * @return nullptr if the backend is unknown or not built in
+ */
+std::unique_ptr<ImagingBackend> CreateImagingBackend(const std::string& name);
+
+std::unique_ptr<ImagingBackend> CreateCpuBackend();
+#ifdef USE_LADYBUG_SDK
+std::unique_ptr<ImagingBackend> CreateSdkBackend();
+#endif
+
+//=============================================================================
+// Native Frame Stream
+//=============================================================================
+
+/**
+ * @brief FrameStream over PgrStreamReader, one reader per segment
+ *
+ * Frames are zero-copy views into the memory-mapped files. Used by the CPU
+ * backend and by the SDK backend with --reader native.
+ */
+class NativeFrameStream : public FrameStream
+{
+public:
+    /**
+     * @brief Map and index every segment and number the frames globally
+     */
+    bool Open(std::vector<StreamSegment>& segments);
+
+    const PgrStreamReader& Reader(size_t segment) const { return *readers[segment]; }
+
+    bool Seek(unsigned int frame) override;
+    bool Read(unsigned int frame, RawFrame& raw) override;
+
+private:
+    std::vector<StreamSegment> segments;
+    std::vector<std::unique_ptr<PgrStreamReader>> readers;
+    size_t prefetchedSegment = 0;
+};
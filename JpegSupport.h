@@ -0,0 +1,103 @@
+//=============================================================================
+// JpegSupport - libjpeg glue shared by the code that calls libjpeg directly
+//
+// An error manager that jumps back instead of exiting the process, and a
+// compression destination that writes into a std::vector. Internal: used by
+// ImageFile.cpp, CpuBackend.cpp and the benchmark's stream generator, and
+// only with USE_LIBJPEG.
+//=============================================================================
+
+#pragma once
+
+#ifdef USE_LIBJPEG
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include <jpeglib.h>
+
+/**
+ * @brief libjpeg error manager that returns instead of exiting
+ *
+ * Callers setjmp(jump) around the libjpeg calls; an error longjmps there.
+ */
+struct JpegErrorManager
+{
+    jpeg_error_mgr base;
+    jmp_buf jump;
+};
+
+inline void JpegErrorExit(j_common_ptr info)
+{
+    JpegErrorManager* manager = reinterpret_cast<JpegErrorManager*>(info->err);
+    longjmp(manager->jump, 1);
+}
+
+/**
+ * @brief Fill in @p manager with libjpeg's defaults and the jumping exit
+ * @return The jpeg_error_mgr to set as a (de)compressor's err
+ */
+inline jpeg_error_mgr* InitJpegErrorManager(JpegErrorManager& manager)
+{
+    jpeg_error_mgr* base = jpeg_std_error(&manager.base);
+    manager.base.error_exit = JpegErrorExit;
+    return base;
+}
+
+/**
+ * @brief libjpeg destination that writes into a std::vector
+ *
+ * Set out before each image; it holds exactly the encoded bytes afterwards.
+ */
+struct JpegVectorDestination
+{
+    jpeg_destination_mgr base;
+    std::vector<unsigned char>* out;
+    size_t initialBytes;                // Size the buffer starts at before it grows
+};
+
+inline void InitJpegVectorDestination(j_compress_ptr cinfo)
+{
+    JpegVectorDestination* dest = reinterpret_cast<JpegVectorDestination*>(cinfo->dest);
+    dest->out->resize(std::max(dest->out->capacity(), dest->initialBytes));
+    dest->base.next_output_byte = dest->out->data();
+    dest->base.free_in_buffer = dest->out->size();
+}
+
+inline boolean GrowJpegVectorDestination(j_compress_ptr cinfo)
+{
+    // Called when the whole buffer is full
+    JpegVectorDestination* dest = reinterpret_cast<JpegVectorDestination*>(cinfo->dest);
+    const size_t used = dest->out->size();
+    dest->out->resize(used * 2);
+    dest->base.next_output_byte = dest->out->data() + used;
+    dest->base.free_in_buffer = dest->out->size() - used;
+    return TRUE;
+}
+
+inline void TermJpegVectorDestination(j_compress_ptr cinfo)
+{
+    JpegVectorDestination* dest = reinterpret_cast<JpegVectorDestination*>(cinfo->dest);
+    dest->out->resize(dest->out->size() - dest->base.free_in_buffer);
+}
+
+/**
+ * @brief Make @p destination the output of @p cinfo
+ * @param initialBytes Buffer size an image starts with (a reused vector
+ *        keeps its larger capacity)
+ */
+inline void SetJpegVectorDestination(jpeg_compress_struct& cinfo, JpegVectorDestination& destination,
+                                     size_t initialBytes)
+{
+    destination.base.init_destination = InitJpegVectorDestination;
+    destination.base.empty_output_buffer = GrowJpegVectorDestination;
+    destination.base.term_destination = TermJpegVectorDestination;
+    destination.out = nullptr;
+    destination.initialBytes = initialBytes;
+    cinfo.dest = &destination.base;
+}
+
+#endif
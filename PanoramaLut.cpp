@@ -0,0 +1,584 @@
+//=============================================================================
+// PanoramaLut - CPU equirectangular panorama rendering through a remap table
+//=============================================================================
+
+#include "PanoramaLut.h"
+#include "PgrStreamReader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PANORAMA_LUT_SSE2
+#endif
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+// Pi constant for angle conversions
+constexpr double PI = 3.14159265358979323846;
+
+// Nominal head geometry
+constexpr int NUM_SIDE_CAMERAS = 5;
+constexpr double NOMINAL_FOV_DEGREES = 90.0;
+
+// Panorama rows handed to a worker at a time
+constexpr unsigned int ROWS_PER_TASK = 8;
+
+// Weight of a sample right at the texture edge (keeps it usable when no
+// other camera sees the direction)
+constexpr double MIN_SAMPLE_WEIGHT = 1e-6;
+
+// Cached table files (native byte order, like the sidecar frame index).
+// Bump LUT_FILE_VERSION whenever BuildRow computes different samples.
+static const char LUT_MAGIC[] = "LBPANLUT";
+constexpr size_t LUT_MAGIC_SIZE = 8;
+constexpr uint32_t LUT_FILE_VERSION = 1;
+
+/**
+ * @brief Header of a cached table file, followed by the samples
+ */
+struct LutFileHeader
+{
+    char magic[LUT_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t sampleSize;
+    uint32_t samplesPerPixel;
+    uint32_t serialHead;
+    uint64_t calibrationHash;
+    uint32_t panoWidth;
+    uint32_t panoHeight;
+    uint32_t textureWidth;
+    uint32_t textureHeight;
+    double rotFront;
+    double rotDown;
+    double blendingWidth;
+    uint64_t sampleCount;
+};
+
+static_assert(sizeof(LutFileHeader) == 80, "LutFileHeader must not contain padding");
+static_assert(sizeof(PanoramaSample) == 8, "PanoramaSample is stored as is in cache files");
+
+//=============================================================================
+// Nominal Camera Model
+//=============================================================================
+
+static double Dot(const double a[3], const double b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+NominalCameraModel::NominalCameraModel(unsigned int textureWidth, unsigned int textureHeight)
+{
+    for (int cam = 0; cam < NUM_CAMERAS; cam++)
+    {
+        CameraAxes& axes = cameras[cam];
+        if (cam < NUM_SIDE_CAMERAS)
+        {
+            const double yaw = cam * 2.0 * PI / NUM_SIDE_CAMERAS;
+            axes = { { cos(yaw), sin(yaw), 0.0 }, { sin(yaw), -cos(yaw), 0.0 }, { 0.0, 0.0, -1.0 } };
+        }
+        else
+        {
+            axes = { { 0.0, 0.0, 1.0 }, { 0.0, -1.0, 0.0 }, { 1.0, 0.0, 0.0 } };
+        }
+    }
+
+    focalLength = textureWidth / 2.0 / tan(NOMINAL_FOV_DEGREES * PI / 360.0);
+    centreCol = (textureWidth - 1) / 2.0;
+    centreRow = (textureHeight - 1) / 2.0;
+}
+
+bool NominalCameraModel::Project(int camera, const double direction[3], double& col, double& row) const
+{
+    const CameraAxes& axes = cameras[camera];
+    const double forward = Dot(direction, axes.forward);
+    if (forward <= 0.0)
+    {
+        return false;
+    }
+
+    col = centreCol + focalLength * Dot(direction, axes.right) / forward;
+    row = centreRow + focalLength * Dot(direction, axes.down) / forward;
+    return true;
+}
+
+//=============================================================================
+// Table Construction
+//=============================================================================
+
+PanoramaLut::PanoramaLut() = default;
+
+PanoramaLut::~PanoramaLut() = default;
+
+void PanoramaLut::Build(const CameraModel& model, const PanoramaLutParams& lutParams, unsigned int numThreads)
+{
+    params = lutParams;
+    mapping.reset();
+    numSamples = static_cast<size_t>(params.panoWidth) * params.panoHeight * PANORAMA_SAMPLES_PER_PIXEL;
+    samples.assign(numSamples, PanoramaSample());
+    data = samples.data();
+
+    // Panorama direction -> head direction: pitch (X towards Z), then yaw
+    // (positive turns right, towards -Y)
+    const double pitch = params.rotFront * PI / 180.0;
+    const double yaw = params.rotDown * PI / 180.0;
+    const double rotation[3][3] = {
+        { cos(yaw) * cos(pitch), sin(yaw), -cos(yaw) * sin(pitch) },
+        { -sin(yaw) * cos(pitch), cos(yaw), sin(yaw) * sin(pitch) },
+        { sin(pitch), 0.0, cos(pitch) }
+    };
+
+    WorkerPool pool(model.IsThreadSafe() ? numThreads : 1);
+    const unsigned int numTasks = (params.panoHeight + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    pool.Run(numTasks, [&](unsigned int task) {
+        const unsigned int lastRow = std::min(params.panoHeight, (task + 1) * ROWS_PER_TASK);
+        for (unsigned int y = task * ROWS_PER_TASK; y < lastRow; y++)
+        {
+            BuildRow(model, rotation, y);
+        }
+    });
+}
+
+void PanoramaLut::BuildRow(const CameraModel& model, const double rotation[3][3], unsigned int y)
+{
+    const double lastCol = params.textureWidth - 1.0;
+    const double lastRow = params.textureHeight - 1.0;
+    const double latitude = PI / 2.0 - (y + 0.5) * PI / params.panoHeight;
+    PanoramaSample* out = samples.data() + static_cast<size_t>(y) * params.panoWidth * PANORAMA_SAMPLES_PER_PIXEL;
+
+    for (unsigned int x = 0; x < params.panoWidth; x++, out += PANORAMA_SAMPLES_PER_PIXEL)
+    {
+        const double longitude = (x + 0.5) * 2.0 * PI / params.panoWidth - PI;
+        const double view[3] = { cos(latitude) * cos(longitude), -cos(latitude) * sin(longitude), sin(latitude) };
+        double direction[3];
+        for (int i = 0; i < 3; i++)
+        {
+            direction[i] = rotation[i][0] * view[0] + rotation[i][1] * view[1] + rotation[i][2] * view[2];
+        }
+
+        // Keep the two cameras that see the direction furthest from their edges
+        int bestCamera[PANORAMA_SAMPLES_PER_PIXEL] = { -1, -1 };
+        double bestWeight[PANORAMA_SAMPLES_PER_PIXEL] = { 0.0, 0.0 };
+        double bestCol[PANORAMA_SAMPLES_PER_PIXEL] = { 0.0, 0.0 };
+        double bestRow[PANORAMA_SAMPLES_PER_PIXEL] = { 0.0, 0.0 };
+
+        for (int cam = 0; cam < NUM_CAMERAS; cam++)
+        {
+            double col = 0.0;
+            double row = 0.0;
+            if (!model.Project(cam, direction, col, row) ||
+                col < 0.0 || row < 0.0 || col > lastCol || row > lastRow)
+            {
+                continue;
+            }
+
+            double weight = 1.0;
+            if (params.blendingWidth > 0.0)
+            {
+                const double edgeDistance = std::min(std::min(col, lastCol - col), std::min(row, lastRow - row));
+                weight = std::min(1.0, edgeDistance / params.blendingWidth);
+            }
+            weight = std::max(weight, MIN_SAMPLE_WEIGHT);
+
+            int slot = -1;
+            if (weight > bestWeight[0])
+            {
+                bestCamera[1] = bestCamera[0];
+                bestWeight[1] = bestWeight[0];
+                bestCol[1] = bestCol[0];
+                bestRow[1] = bestRow[0];
+                slot = 0;
+            }
+            else if (weight > bestWeight[1])
+            {
+                slot = 1;
+            }
+            if (slot >= 0)
+            {
+                bestCamera[slot] = cam;
+                bestWeight[slot] = weight;
+                bestCol[slot] = col;
+                bestRow[slot] = row;
+            }
+        }
+
+        const double totalWeight = bestWeight[0] + bestWeight[1];
+        unsigned int remainingWeight = 255;
+        for (int i = 0; i < PANORAMA_SAMPLES_PER_PIXEL && bestCamera[i] >= 0; i++)
+        {
+            // The bilinear neighbourhood must stay inside the texture
+            const unsigned int x0 = std::min(static_cast<unsigned int>(bestCol[i]), params.textureWidth - 2);
+            const unsigned int y0 = std::min(static_cast<unsigned int>(bestRow[i]), params.textureHeight - 2);
+            const double fx = std::min(255.0, std::floor((bestCol[i] - x0) * 256.0 + 0.5));
+            const double fy = std::min(255.0, std::floor((bestRow[i] - y0) * 256.0 + 0.5));
+
+            PanoramaSample& sample = out[i];
+            sample.camera = static_cast<uint8_t>(bestCamera[i]);
+            sample.offset = y0 * params.textureWidth + x0;
+            sample.fx = static_cast<uint8_t>(fx);
+            sample.fy = static_cast<uint8_t>(fy);
+            sample.weight = (i == 0)
+                ? static_cast<uint8_t>(std::floor(255.0 * bestWeight[0] / totalWeight + 0.5))
+                : static_cast<uint8_t>(remainingWeight);
+            remainingWeight -= sample.weight;
+        }
+    }
+}
+
+std::shared_ptr<const PanoramaLut> BuildPanoramaLut(const CameraModel& model, const PanoramaLutParams& params,
+                                                    unsigned int numThreads)
+{
+    printf("Building %ux%u panorama remap table...\n", params.panoWidth, params.panoHeight);
+    const auto start = std::chrono::steady_clock::now();
+
+    std::shared_ptr<PanoramaLut> lut(new PanoramaLut());
+    lut->Build(model, params, numThreads);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Panorama remap table: %.1f MB, built in %.2f s\n", lut->SizeBytes() / (1024.0 * 1024.0), seconds);
+    return lut;
+}
+
+//=============================================================================
+// Cache Files
+//=============================================================================
+
+static bool SameParams(const PanoramaLutParams& a, const PanoramaLutParams& b)
+{
+    return a.panoWidth == b.panoWidth && a.panoHeight == b.panoHeight &&
+           a.textureWidth == b.textureWidth && a.textureHeight == b.textureHeight &&
+           a.rotFront == b.rotFront && a.rotDown == b.rotDown && a.blendingWidth == b.blendingWidth;
+}
+
+bool PanoramaLut::Load(const std::string& path, const PanoramaLutKey& key, const PanoramaLutParams& expectedParams)
+{
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    if (!file->Open(path) || file->Size() < sizeof(LutFileHeader))
+    {
+        return false;
+    }
+
+    LutFileHeader header;
+    memcpy(&header, file->Data(), sizeof(header));
+
+    PanoramaLutParams fileParams;
+    fileParams.panoWidth = header.panoWidth;
+    fileParams.panoHeight = header.panoHeight;
+    fileParams.textureWidth = header.textureWidth;
+    fileParams.textureHeight = header.textureHeight;
+    fileParams.rotFront = header.rotFront;
+    fileParams.rotDown = header.rotDown;
+    fileParams.blendingWidth = header.blendingWidth;
+
+    const uint64_t expectedSamples = static_cast<uint64_t>(expectedParams.panoWidth) * expectedParams.panoHeight *
+                                     PANORAMA_SAMPLES_PER_PIXEL;
+    const bool ok = memcmp(header.magic, LUT_MAGIC, LUT_MAGIC_SIZE) == 0 &&
+                    header.version == LUT_FILE_VERSION &&
+                    header.sampleSize == sizeof(PanoramaSample) &&
+                    header.samplesPerPixel == PANORAMA_SAMPLES_PER_PIXEL &&
+                    header.serialHead == key.serialHead &&
+                    header.calibrationHash == key.calibrationHash &&
+                    SameParams(fileParams, expectedParams) &&
+                    header.sampleCount == expectedSamples &&
+                    file->Size() == sizeof(LutFileHeader) + expectedSamples * sizeof(PanoramaSample);
+    if (!ok)
+    {
+        return false;
+    }
+
+    // Every frame reads the whole table, so fault it in up front
+    file->Prefetch(0, file->Size());
+
+    params = fileParams;
+    samples.clear();
+    numSamples = static_cast<size_t>(expectedSamples);
+    data = reinterpret_cast<const PanoramaSample*>(file->Data() + sizeof(LutFileHeader));
+    mapping = std::move(file);
+    return true;
+}
+
+bool PanoramaLut::Save(const std::string& path, const PanoramaLutKey& key) const
+{
+    LutFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LUT_MAGIC, LUT_MAGIC_SIZE);
+    header.version = LUT_FILE_VERSION;
+    header.sampleSize = sizeof(PanoramaSample);
+    header.samplesPerPixel = PANORAMA_SAMPLES_PER_PIXEL;
+    header.serialHead = key.serialHead;
+    header.calibrationHash = key.calibrationHash;
+    header.panoWidth = params.panoWidth;
+    header.panoHeight = params.panoHeight;
+    header.textureWidth = params.textureWidth;
+    header.textureHeight = params.textureHeight;
+    header.rotFront = params.rotFront;
+    header.rotDown = params.rotDown;
+    header.blendingWidth = params.blendingWidth;
+    header.sampleCount = numSamples;
+
+    // Sessions and shard workers may save the same table at once, so each
+    // writes its own temporary file
+    const std::string tempPath = path + "." +
+        std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    FILE* fp = fopen(tempPath.c_str(), "wb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(data, sizeof(PanoramaSample), numSamples, fp) == numSamples;
+    if (fclose(fp) != 0 || !ok)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    // rename does not replace an existing file on Windows; another process
+    // saving the same table first is fine
+    if (rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        remove(tempPath.c_str());
+        FILE* existing = fopen(path.c_str(), "rb");
+        if (existing == nullptr)
+        {
+            return false;
+        }
+        fclose(existing);
+    }
+    return true;
+}
+
+uint64_t HashCalibration(const void* bytes, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char* p = static_cast<const unsigned char*>(bytes);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ p[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Cache file of a table, e.g. remap_13124_<hash>_1024x768_b100_2048x1024_f0_d0.lut
+ */
+static std::string GetCachePath(const std::string& cacheDir, const PanoramaLutKey& key,
+                                const PanoramaLutParams& params)
+{
+    char name[256];
+    snprintf(name, sizeof(name), "remap_%u_%016llx_%ux%u_b%g_%ux%u_f%g_d%g.lut",
+             key.serialHead, static_cast<unsigned long long>(key.calibrationHash),
+             params.textureWidth, params.textureHeight, params.blendingWidth,
+             params.panoWidth, params.panoHeight, params.rotFront, params.rotDown);
+
+    const char last = cacheDir.back();
+    return (last == '/' || last == '\\') ? cacheDir + name : cacheDir + "/" + name;
+}
+
+std::shared_ptr<const PanoramaLut> LoadCachedPanoramaLut(const std::string& cacheDir, const PanoramaLutKey& key,
+                                                         const PanoramaLutParams& params)
+{
+    if (cacheDir.empty())
+    {
+        return nullptr;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::string path = GetCachePath(cacheDir, key, params);
+
+    std::shared_ptr<PanoramaLut> lut(new PanoramaLut());
+    if (!lut->Load(path, key, params))
+    {
+        return nullptr;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Panorama remap table: %.1f MB, mapped from cache in %.3f s (%s)\n",
+           lut->SizeBytes() / (1024.0 * 1024.0), seconds, path.c_str());
+    return lut;
+}
+
+void SaveCachedPanoramaLut(const std::string& cacheDir, const PanoramaLutKey& key, const PanoramaLut& lut)
+{
+    if (cacheDir.empty())
+    {
+        return;
+    }
+
+    const std::string path = GetCachePath(cacheDir, key, lut.Params());
+    if (!lut.Save(path, key))
+    {
+        printf("Warning: Could not save panorama remap table to %s\n", path.c_str());
+    }
+}
+
+//=============================================================================
+// Sampling
+//=============================================================================
+
+/**
+ * @brief Bilinear sample of a BGRU texture, returned as BGRU
+ */
+static inline uint32_t SampleBgru(const uint32_t* texture, unsigned int width, const PanoramaSample& sample)
+{
+    const uint32_t* p = texture + sample.offset;
+
+#ifdef PANORAMA_LUT_SSE2
+    // Both neighbours of a row in one register, one 16-bit lane per channel
+    const __m128i zero = _mm_setzero_si128();
+    const short fx = sample.fx;
+    const short fy = sample.fy;
+    const __m128i weightX = _mm_set_epi16(fx, fx, fx, fx, 256 - fx, 256 - fx, 256 - fx, 256 - fx);
+
+    __m128i top = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero), weightX);
+    __m128i bottom = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + width)), zero), weightX);
+    const __m128i round = _mm_set1_epi16(128);
+    top = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(top, _mm_srli_si128(top, 8)), round), 8);
+    bottom = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(bottom, _mm_srli_si128(bottom, 8)), round), 8);
+
+    __m128i value = _mm_add_epi16(_mm_mullo_epi16(top, _mm_set1_epi16(static_cast<short>(256 - fy))),
+                                  _mm_mullo_epi16(bottom, _mm_set1_epi16(fy)));
+    value = _mm_srli_epi16(_mm_add_epi16(value, round), 8);
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(value, value)));
+#else
+    const uint32_t neighbours[4] = { p[0], p[1], p[width], p[width + 1] };
+    const unsigned int fx = sample.fx;
+    const unsigned int fy = sample.fy;
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        const unsigned int top = (((neighbours[0] >> shift) & 0xFF) * (256 - fx) +
+                                  ((neighbours[1] >> shift) & 0xFF) * fx + 128) >> 8;
+        const unsigned int bottom = (((neighbours[2] >> shift) & 0xFF) * (256 - fx) +
+                                     ((neighbours[3] >> shift) & 0xFF) * fx + 128) >> 8;
+        result |= ((top * (256 - fy) + bottom * fy + 128) >> 8) << shift;
+    }
+    return result;
+#endif
+}
+
+/**
+ * @brief Bilinear sample of one channel of a BGRU16 texture, reduced to 8 bits
+ */
+static inline unsigned int SampleBgru16Channel(const uint16_t* texture, unsigned int width,
+                                               const PanoramaSample& sample, int channel)
+{
+    const uint16_t* p = texture + static_cast<size_t>(sample.offset) * 4 + channel;
+    const size_t rowStride = static_cast<size_t>(width) * 4;
+    const unsigned int fx = sample.fx;
+    const unsigned int fy = sample.fy;
+
+    const unsigned int top = (p[0] * (256 - fx) + p[4] * fx) >> 8;
+    const unsigned int bottom = (p[rowStride] * (256 - fx) + p[rowStride + 4] * fx) >> 8;
+    return ((top * (256 - fy) + bottom * fy) >> 8) >> 8;
+}
+
+/**
+ * @brief Weighted mix of two 8-bit values (weight in 1/255)
+ */
+static inline unsigned char Blend(unsigned int a, unsigned int b, unsigned int weight)
+{
+    const unsigned int mixed = a * weight + b * (255 - weight) + 128;
+    return static_cast<unsigned char>((mixed + (mixed >> 8)) >> 8);
+}
+
+/**
+ * @brief Render one panorama row from BGRU textures
+ */
+static void RenderRowBgru(const unsigned char* const textures[NUM_CAMERAS], unsigned int textureWidth,
+                          const PanoramaSample* sample, unsigned int width, unsigned char* out)
+{
+    for (unsigned int x = 0; x < width; x++, sample += PANORAMA_SAMPLES_PER_PIXEL, out += 3)
+    {
+        const PanoramaSample& first = sample[0];
+        const PanoramaSample& second = sample[1];
+        if (first.camera == PANORAMA_NO_CAMERA)
+        {
+            out[0] = out[1] = out[2] = 0;
+            continue;
+        }
+
+        const uint32_t colorA = SampleBgru(reinterpret_cast<const uint32_t*>(textures[first.camera]),
+                                           textureWidth, first);
+        const uint32_t colorB = (second.camera == PANORAMA_NO_CAMERA) ? 0 :
+            SampleBgru(reinterpret_cast<const uint32_t*>(textures[second.camera]), textureWidth, second);
+        for (int c = 0; c < 3; c++)
+        {
+            out[c] = Blend((colorA >> (8 * c)) & 0xFF, (colorB >> (8 * c)) & 0xFF, first.weight);
+        }
+    }
+}
+
+/**
+ * @brief Render one panorama row from BGRU16 textures
+ */
+static void RenderRowBgru16(const unsigned char* const textures[NUM_CAMERAS], unsigned int textureWidth,
+                            const PanoramaSample* sample, unsigned int width, unsigned char* out)
+{
+    for (unsigned int x = 0; x < width; x++, sample += PANORAMA_SAMPLES_PER_PIXEL, out += 3)
+    {
+        const PanoramaSample& first = sample[0];
+        const PanoramaSample& second = sample[1];
+        if (first.camera == PANORAMA_NO_CAMERA)
+        {
+            out[0] = out[1] = out[2] = 0;
+            continue;
+        }
+
+        const uint16_t* textureA = reinterpret_cast<const uint16_t*>(textures[first.camera]);
+        for (int c = 0; c < 3; c++)
+        {
+            const unsigned int a = SampleBgru16Channel(textureA, textureWidth, first, c);
+            const unsigned int b = (second.camera == PANORAMA_NO_CAMERA) ? 0 :
+                SampleBgru16Channel(reinterpret_cast<const uint16_t*>(textures[second.camera]), textureWidth, second, c);
+            out[c] = Blend(a, b, first.weight);
+        }
+    }
+}
+
+//=============================================================================
+// LutPanoramaRenderer
+//=============================================================================
+
+LutPanoramaRenderer::LutPanoramaRenderer(std::shared_ptr<const PanoramaLut> panoramaLut, unsigned int numThreads)
+    : lut(std::move(panoramaLut)), pool(numThreads)
+{
+}
+
+bool LutPanoramaRenderer::Render(const unsigned char* const textures[NUM_CAMERAS], PixelFormat format,
+                                 std::vector<unsigned char>& panoBuffer, ImageView& panoImage)
+{
+    if (format != PixelFormat::BGRU && format != PixelFormat::BGRU16)
+    {
+        printf("Warning: The panorama renderer needs BGRU or BGRU16 textures\n");
+        return false;
+    }
+
+    const PanoramaLutParams& params = lut->Params();
+    const unsigned int width = params.panoWidth;
+    panoBuffer.resize(static_cast<size_t>(width) * params.panoHeight * 3);
+
+    const auto renderRow = (format == PixelFormat::BGRU) ? RenderRowBgru : RenderRowBgru16;
+    const unsigned int numTasks = (params.panoHeight + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    pool.Run(numTasks, [&](unsigned int task) {
+        const unsigned int lastRow = std::min(params.panoHeight, (task + 1) * ROWS_PER_TASK);
+        for (unsigned int y = task * ROWS_PER_TASK; y < lastRow; y++)
+        {
+            renderRow(textures, params.textureWidth, lut->Row(y), width,
+                      panoBuffer.data() + static_cast<size_t>(y) * width * 3);
+        }
+    });
+
+    panoImage.data = panoBuffer.data();
+    panoImage.cols = width;
+    panoImage.rows = params.panoHeight;
+    panoImage.format = PixelFormat::BGR;
+    return true;
+}
@@ -0,0 +1,211 @@
+//=============================================================================
+// PanoramaLut - CPU equirectangular panorama rendering through a remap table
+//
+// For a given calibration, output size and rotation, every panorama pixel
+// always samples the same texture positions. PanoramaLut computes them once:
+// up to two (camera, x, y, blend weight) samples per output pixel.
+// LutPanoramaRenderer then stitches each frame by bilinear sampling and
+// blending those positions, with the rows split across a WorkerPool. No GPU
+// is involved, so panoramas can be rendered on headless nodes.
+//
+// Tables can be saved to a cache directory and memory-mapped back on later
+// runs, so a warm start renders its first panorama without rebuilding them.
+//
+// Head coordinates follow the Ladybug convention: X points at camera 0 and
+// Z up through camera 5. The panorama centre looks along +X, its left edge
+// is longitude -180 degrees and its top row looks straight up.
+//=============================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ImagingBackend.h"
+#include "WorkerPool.h"
+
+// Samples stored per panorama pixel (the two most weighted cameras)
+constexpr int PANORAMA_SAMPLES_PER_PIXEL = 2;
+
+// Camera index of an unused sample
+constexpr uint8_t PANORAMA_NO_CAMERA = 0xFF;
+
+/**
+ * @brief Maps directions in head coordinates into camera textures
+ */
+class CameraModel
+{
+public:
+    virtual ~CameraModel() = default;
+
+    /**
+     * @brief Texture position (pixel centres at integers) a direction lands on
+     * @return false if the camera does not look towards the direction; the
+     *         position may still fall outside the texture
+     */
+    virtual bool Project(int camera, const double direction[3], double& col, double& row) const = 0;
+
+    /**
+     * @brief Whether Project may be called from several threads at once
+     */
+    virtual bool IsThreadSafe() const { return true; }
+};
+
+/**
+ * @brief Ideal pinhole cameras in the nominal head layout
+ *
+ * Head coordinates as in PanoramaLut: X towards camera 0, Z up. Side
+ * cameras look out horizontally 72 degrees apart with the image upright;
+ * camera 5 looks up with the top of its image towards the back. Used when
+ * no calibration is available (cpu backend, benchmarks).
+ */
+class NominalCameraModel : public CameraModel
+{
+public:
+    NominalCameraModel(unsigned int textureWidth, unsigned int textureHeight);
+
+    bool Project(int camera, const double direction[3], double& col, double& row) const override;
+
+private:
+    struct CameraAxes
+    {
+        double forward[3];
+        double right[3];
+        double down[3];
+    };
+
+    CameraAxes cameras[NUM_CAMERAS];
+    double focalLength = 0.0;
+    double centreCol = 0.0;
+    double centreRow = 0.0;
+};
+
+struct PanoramaLutParams
+{
+    unsigned int panoWidth = 0;
+    unsigned int panoHeight = 0;
+    unsigned int textureWidth = 0;
+    unsigned int textureHeight = 0;
+    double rotFront = 0.0;              // Degrees (pitch, positive = look up)
+    double rotDown = 0.0;               // Degrees (yaw, positive = rotate right)
+    double blendingWidth = 0.0;         // Feather width at texture edges, texture pixels
+};
+
+/**
+ * @brief What a table depends on besides its params (checked when loading a cached table)
+ */
+struct PanoramaLutKey
+{
+    uint32_t serialHead = 0;
+    uint64_t calibrationHash = 0;       // HashCalibration of the camera model's inputs
+};
+
+/**
+ * @brief One texture sample of a panorama pixel (8 bytes)
+ */
+struct PanoramaSample
+{
+    uint32_t offset = 0;                // Texture pixel of the top-left bilinear neighbour
+    uint8_t camera = PANORAMA_NO_CAMERA;
+    uint8_t fx = 0;                     // Bilinear fractions in 1/256
+    uint8_t fy = 0;
+    uint8_t weight = 0;                 // Blend weight in 1/255 (the samples of a pixel add up to 255)
+};
+
+class MappedFile;
+
+class PanoramaLut
+{
+public:
+    PanoramaLut();
+    ~PanoramaLut();
+
+    PanoramaLut(const PanoramaLut&) = delete;
+    PanoramaLut& operator=(const PanoramaLut&) = delete;
+
+    /**
+     * @brief Compute the samples of every panorama pixel
+     * @param numThreads Threads to build with (0 = all); one if the model
+     *                   is not thread-safe
+     */
+    void Build(const CameraModel& model, const PanoramaLutParams& params, unsigned int numThreads);
+
+    /**
+     * @brief Map a table saved by Save
+     * @return false if the file is missing, damaged or was built for another
+     *         key, params or table version
+     */
+    bool Load(const std::string& path, const PanoramaLutKey& key, const PanoramaLutParams& expectedParams);
+
+    /**
+     * @brief Write the table to path (through a temporary file, so readers
+     *        never see a partial table)
+     */
+    bool Save(const std::string& path, const PanoramaLutKey& key) const;
+
+    const PanoramaLutParams& Params() const { return params; }
+
+    const PanoramaSample* Row(unsigned int y) const
+    {
+        return data + static_cast<size_t>(y) * params.panoWidth * PANORAMA_SAMPLES_PER_PIXEL;
+    }
+
+    size_t SizeBytes() const { return numSamples * sizeof(PanoramaSample); }
+
+private:
+    void BuildRow(const CameraModel& model, const double rotation[3][3], unsigned int y);
+
+    PanoramaLutParams params;
+    std::vector<PanoramaSample> samples;        // Built tables
+    std::unique_ptr<MappedFile> mapping;        // Loaded tables
+    const PanoramaSample* data = nullptr;       // Into samples or mapping
+    size_t numSamples = 0;
+};
+
+/**
+ * @brief Build a table and report its size and build time
+ */
+std::shared_ptr<const PanoramaLut> BuildPanoramaLut(const CameraModel& model, const PanoramaLutParams& params,
+                                                    unsigned int numThreads);
+
+/**
+ * @brief 64-bit FNV-1a hash of calibration data, for PanoramaLutKey
+ */
+uint64_t HashCalibration(const void* bytes, size_t size);
+
+/**
+ * @brief Load a table from the cache directory (empty = no cache)
+ * @return nullptr on a cache miss
+ */
+std::shared_ptr<const PanoramaLut> LoadCachedPanoramaLut(const std::string& cacheDir, const PanoramaLutKey& key,
+                                                         const PanoramaLutParams& params);
+
+/**
+ * @brief Store a table in the cache directory (empty = no cache); failures
+ *        only print a warning
+ */
+void SaveCachedPanoramaLut(const std::string& cacheDir, const PanoramaLutKey& key, const PanoramaLut& lut);
+
+/**
+ * @brief PanoramaRenderer that applies a PanoramaLut
+ *
+ * Takes BGRU or BGRU16 textures of the table's texture size and produces a
+ * BGR panorama. The table is shared, so renderers of one backend reuse it.
+ */
+class LutPanoramaRenderer : public PanoramaRenderer
+{
+public:
+    /**
+     * @param numThreads Threads per panorama (0 = one per logical processor)
+     */
+    LutPanoramaRenderer(std::shared_ptr<const PanoramaLut> lut, unsigned int numThreads);
+
+    bool Render(const unsigned char* const textures[NUM_CAMERAS], PixelFormat format,
+                std::vector<unsigned char>& panoBuffer, ImageView& panoImage) override;
+
+private:
+    std::shared_ptr<const PanoramaLut> lut;
+    WorkerPool pool;
+};
@@ -0,0 +1,548 @@
+//=============================================================================
+// PgrStreamReader - Native memory-mapped reader for Ladybug .pgr streams
+//=============================================================================
+
+#include "PgrStreamReader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+static const char PGR_SIGNATURE[] = "PGRLADYBUGSTREAM";
+constexpr size_t PGR_SIGNATURE_SIZE = 16;
+
+// Header field offsets (see PgrStreamReader.h)
+constexpr size_t PGR_OFFSET_VERSION = 0x0010;
+constexpr size_t PGR_OFFSET_FRAME_RATE_INT = 0x0014;
+constexpr size_t PGR_OFFSET_SERIAL_BASE = 0x0018;
+constexpr size_t PGR_OFFSET_SERIAL_HEAD = 0x001C;
+constexpr size_t PGR_OFFSET_PADDING_BLOCK = 0x0084;
+constexpr size_t PGR_OFFSET_DATA_FORMAT = 0x0088;
+constexpr size_t PGR_OFFSET_RESOLUTION = 0x008C;
+constexpr size_t PGR_OFFSET_STIPPLED_FORMAT = 0x0090;
+constexpr size_t PGR_OFFSET_CONFIG_SIZE = 0x0094;
+constexpr size_t PGR_OFFSET_NUM_IMAGES = 0x0098;
+constexpr size_t PGR_OFFSET_STREAM_DATA = 0x00A4;
+constexpr size_t PGR_OFFSET_FRAME_RATE = 0x00C0;
+constexpr size_t PGR_HEADER_MIN_SIZE = 0x00C4;
+
+// Sidecar index file
+static const char INDEX_MAGIC[] = "LBPGRIDX";
+constexpr size_t INDEX_MAGIC_SIZE = 8;
+constexpr uint32_t INDEX_VERSION = 1;
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+static uint32_t ReadLE32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t ReadBE32(const unsigned char* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint64_t RoundUp(uint64_t value, uint64_t block)
+{
+    return block > 1 ? ((value + block - 1) / block) * block : value;
+}
+
+bool GetPgrResolutionSize(uint32_t resolution, unsigned int& cols, unsigned int& rows)
+{
+    // Indexed by LadybugResolution
+    static const unsigned int RESOLUTION_SIZES[][2] =
+    {
+        { 128, 96 },
+        { 256, 192 },
+        { 512, 384 },
+        { 640, 480 },
+        { 1024, 768 },
+        { 1216, 1216 },
+        { 1616, 1216 },
+        { 1600, 1200 },
+        { 2448, 2048 },
+        { 2048, 2448 },
+    };
+
+    if (resolution >= sizeof(RESOLUTION_SIZES) / sizeof(RESOLUTION_SIZES[0]))
+    {
+        return false;
+    }
+    cols = RESOLUTION_SIZES[resolution][0];
+    rows = RESOLUTION_SIZES[resolution][1];
+    return true;
+}
+
+bool ParsePgrImageInfo(const unsigned char* frame, size_t size, PgrImageInfo& info)
+{
+    if (frame == nullptr || size < PGR_IMAGE_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    const unsigned char* p = frame;
+    auto next = [&p]() { const uint32_t value = ReadBE32(p); p += 4; return value; };
+    info.fingerprint = next();
+    info.version = next();
+    info.timeSeconds = next();
+    info.timeMicroSeconds = next();
+    info.sequenceId = next();
+    info.refreshRate = next();
+    for (uint32_t& gain : info.gainAdjust)
+    {
+        gain = next();
+    }
+    info.whiteBalance = next();
+    info.bayerGain = next();
+    info.bayerMap = next();
+    info.brightness = next();
+    info.gamma = next();
+    info.serialNum = next();
+    for (uint32_t& shutter : info.shutter)
+    {
+        shutter = next();
+    }
+    return true;
+}
+
+//=============================================================================
+// MappedFile
+//=============================================================================
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& filePath)
+{
+    Close();
+
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    FILETIME writeTime;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 ||
+        !GetFileTime(file, NULL, NULL, &writeTime))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const unsigned char*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+    modifiedTime = ((int64_t)writeTime.dwHighDateTime << 32) | writeTime.dwLowDateTime;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+        data = nullptr;
+    }
+    if (mappingHandle != nullptr)
+    {
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+    }
+    if (fileHandle != nullptr)
+    {
+        CloseHandle(fileHandle);
+        fileHandle = nullptr;
+    }
+    size = 0;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t length) const
+{
+    if (data == nullptr || offset >= size)
+    {
+        return;
+    }
+
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<unsigned char*>(data + offset);
+    range.NumberOfBytes = std::min(length, size - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filePath)
+{
+    Close();
+
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+
+    madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    data = static_cast<const unsigned char*>(view);
+    size = static_cast<size_t>(st.st_size);
+    modifiedTime = static_cast<int64_t>(st.st_mtime);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<unsigned char*>(data), size);
+        data = nullptr;
+    }
+    size = 0;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t length) const
+{
+    if (data == nullptr || offset >= size)
+    {
+        return;
+    }
+
+    // madvise needs a page-aligned start address
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t alignedOffset = offset - (offset % pageSize);
+    const size_t alignedLength = std::min(length + (offset - alignedOffset), size - alignedOffset);
+    madvise(const_cast<unsigned char*>(data + alignedOffset), alignedLength, MADV_WILLNEED);
+}
+
+#endif
+
+//=============================================================================
+// PgrStreamReader
+//=============================================================================
+
+bool PgrStreamReader::Open(const std::string& streamPath, bool useSidecarIndex)
+{
+    Close();
+    path = streamPath;
+
+    if (!file.Open(path))
+    {
+        printf("Error: Could not map stream file %s\n", path.c_str());
+        return false;
+    }
+
+    if (!ParseHeader())
+    {
+        Close();
+        return false;
+    }
+
+    const std::string indexPath = path + ".idx";
+    if (useSidecarIndex && LoadSidecarIndex(indexPath))
+    {
+        indexFromSidecar = true;
+        return true;
+    }
+
+    if (!BuildIndex())
+    {
+        Close();
+        return false;
+    }
+
+    if (useSidecarIndex && !SaveSidecarIndex(indexPath))
+    {
+        printf("Warning: Could not write frame index %s\n", indexPath.c_str());
+    }
+
+    return true;
+}
+
+void PgrStreamReader::Close()
+{
+    file.Close();
+    header = PgrStreamHeader();
+    frameOffsets.clear();
+    frameSizes.clear();
+    indexFromSidecar = false;
+}
+
+bool PgrStreamReader::GetFrame(unsigned int frameNum, PgrFrameView& view) const
+{
+    if (frameNum >= frameOffsets.size())
+    {
+        return false;
+    }
+
+    view.frameNum = frameNum;
+    return ParsePlaneTable(static_cast<size_t>(frameOffsets[frameNum]), view);
+}
+
+void PgrStreamReader::Prefetch(unsigned int first, unsigned int count) const
+{
+    if (first >= frameOffsets.size() || count == 0)
+    {
+        return;
+    }
+
+    const unsigned int last = std::min<unsigned int>(first + count, GetFrameCount()) - 1;
+    const uint64_t begin = frameOffsets[first];
+    const uint64_t end = frameOffsets[last] + frameSizes[last];
+    file.Prefetch(static_cast<size_t>(begin), static_cast<size_t>(end - begin));
+}
+
+bool PgrStreamReader::ParseHeader()
+{
+    const unsigned char* p = file.Data();
+    if (file.Size() < PGR_HEADER_MIN_SIZE || memcmp(p, PGR_SIGNATURE, PGR_SIGNATURE_SIZE) != 0)
+    {
+        printf("Error: %s is not a Ladybug stream file\n", path.c_str());
+        return false;
+    }
+
+    header.version = ReadLE32(p + PGR_OFFSET_VERSION);
+    header.serialBase = ReadLE32(p + PGR_OFFSET_SERIAL_BASE);
+    header.serialHead = ReadLE32(p + PGR_OFFSET_SERIAL_HEAD);
+    header.paddingBlock = ReadLE32(p + PGR_OFFSET_PADDING_BLOCK);
+    header.dataFormat = ReadLE32(p + PGR_OFFSET_DATA_FORMAT);
+    header.resolution = ReadLE32(p + PGR_OFFSET_RESOLUTION);
+    header.stippledFormat = ReadLE32(p + PGR_OFFSET_STIPPLED_FORMAT);
+    header.configDataSize = ReadLE32(p + PGR_OFFSET_CONFIG_SIZE);
+    header.numImages = ReadLE32(p + PGR_OFFSET_NUM_IMAGES);
+    header.streamDataOffset = ReadLE32(p + PGR_OFFSET_STREAM_DATA);
+
+    if (header.version < 7)
+    {
+        header.frameRate = (float)ReadLE32(p + PGR_OFFSET_FRAME_RATE_INT);
+    }
+    else
+    {
+        uint32_t bits = ReadLE32(p + PGR_OFFSET_FRAME_RATE);
+        memcpy(&header.frameRate, &bits, sizeof(bits));
+    }
+
+    if (header.streamDataOffset >= file.Size())
+    {
+        printf("Error: Invalid stream data offset in %s\n", path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool PgrStreamReader::ParsePlaneTable(size_t frameOffset, PgrFrameView& view) const
+{
+    const size_t fileSize = file.Size();
+    if (frameOffset + PGR_IMAGE_HEADER_SIZE > fileSize)
+    {
+        return false;
+    }
+
+    const unsigned char* frame = file.Data() + frameOffset;
+    const unsigned char* table = frame + PGR_PLANE_TABLE_OFFSET;
+    size_t frameEnd = PGR_IMAGE_HEADER_SIZE;
+
+    for (int i = 0; i < PGR_NUM_PLANES; i++)
+    {
+        const uint32_t planeOffset = ReadBE32(table + i * 8);
+        const uint32_t planeSize = ReadBE32(table + i * 8 + 4);
+
+        if (planeSize == 0)
+        {
+            view.planes[i] = PgrPlaneView();
+            continue;
+        }
+
+        const size_t planeEnd = static_cast<size_t>(planeOffset) + planeSize;
+        if (frameOffset + planeEnd > fileSize)
+        {
+            return false;
+        }
+
+        view.planes[i].data = frame + planeOffset;
+        view.planes[i].size = planeSize;
+        frameEnd = std::max(frameEnd, planeEnd);
+    }
+
+    view.data = frame;
+    view.size = frameEnd;
+    return true;
+}
+
+bool PgrStreamReader::BuildIndex()
+{
+    frameOffsets.clear();
+    frameSizes.clear();
+    frameOffsets.reserve(header.numImages);
+    frameSizes.reserve(header.numImages);
+
+    // Walk the frames; each one's plane table gives its length
+    uint64_t offset = header.streamDataOffset;
+    while (header.numImages == 0 || frameOffsets.size() < header.numImages)
+    {
+        PgrFrameView view;
+        if (!ParsePlaneTable(static_cast<size_t>(offset), view))
+        {
+            break;
+        }
+
+        frameOffsets.push_back(offset);
+        frameSizes.push_back(static_cast<uint32_t>(view.size));
+        offset += RoundUp(view.size, header.paddingBlock);
+    }
+
+    if (frameOffsets.empty())
+    {
+        printf("Error: No frames found in %s\n", path.c_str());
+        return false;
+    }
+
+    if (header.numImages != 0 && frameOffsets.size() < header.numImages)
+    {
+        printf("Warning: %s is truncated; indexed %zu of %u frames\n",
+               path.c_str(), frameOffsets.size(), header.numImages);
+    }
+
+    return true;
+}
+
+bool PgrStreamReader::LoadSidecarIndex(const std::string& indexPath)
+{
+    FILE* fp = fopen(indexPath.c_str(), "rb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+
+    char magic[INDEX_MAGIC_SIZE];
+    uint32_t version = 0;
+    uint32_t frameCount = 0;
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+
+    bool ok = fread(magic, 1, INDEX_MAGIC_SIZE, fp) == INDEX_MAGIC_SIZE &&
+              fread(&version, sizeof(version), 1, fp) == 1 &&
+              fread(&frameCount, sizeof(frameCount), 1, fp) == 1 &&
+              fread(&sourceSize, sizeof(sourceSize), 1, fp) == 1 &&
+              fread(&sourceTime, sizeof(sourceTime), 1, fp) == 1;
+
+    // A stale index (stream rewritten or still being recorded) is rebuilt
+    ok = ok && memcmp(magic, INDEX_MAGIC, INDEX_MAGIC_SIZE) == 0 &&
+         version == INDEX_VERSION &&
+         frameCount > 0 &&
+         sourceSize == file.Size() &&
+         sourceTime == file.ModifiedTime();
+
+    // Bound the count before allocating for it: the sidecar must hold
+    // exactly that many entries, and every frame takes at least an image
+    // header in the stream
+    if (ok)
+    {
+        const long entriesStart = ftell(fp);
+        ok = entriesStart >= 0 && fseek(fp, 0, SEEK_END) == 0;
+        const long indexSize = ok ? ftell(fp) : -1;
+        ok = ok && indexSize >= entriesStart &&
+             static_cast<uint64_t>(indexSize - entriesStart) ==
+                 static_cast<uint64_t>(frameCount) * (sizeof(uint64_t) + sizeof(uint32_t)) &&
+             frameCount <= file.Size() / PGR_IMAGE_HEADER_SIZE &&
+             fseek(fp, entriesStart, SEEK_SET) == 0;
+    }
+
+    if (ok)
+    {
+        frameOffsets.resize(frameCount);
+        frameSizes.resize(frameCount);
+        ok = fread(frameOffsets.data(), sizeof(uint64_t), frameCount, fp) == frameCount &&
+             fread(frameSizes.data(), sizeof(uint32_t), frameCount, fp) == frameCount;
+    }
+    fclose(fp);
+
+    // Sanity check the last entry against the mapping
+    ok = ok && frameOffsets.back() + frameSizes.back() <= file.Size();
+    if (!ok)
+    {
+        frameOffsets.clear();
+        frameSizes.clear();
+    }
+    return ok;
+}
+
+bool PgrStreamReader::SaveSidecarIndex(const std::string& indexPath) const
+{
+    FILE* fp = fopen(indexPath.c_str(), "wb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+
+    const uint32_t frameCount = GetFrameCount();
+    const uint64_t sourceSize = file.Size();
+    const int64_t sourceTime = file.ModifiedTime();
+
+    bool ok = fwrite(INDEX_MAGIC, 1, INDEX_MAGIC_SIZE, fp) == INDEX_MAGIC_SIZE &&
+              fwrite(&INDEX_VERSION, sizeof(INDEX_VERSION), 1, fp) == 1 &&
+              fwrite(&frameCount, sizeof(frameCount), 1, fp) == 1 &&
+              fwrite(&sourceSize, sizeof(sourceSize), 1, fp) == 1 &&
+              fwrite(&sourceTime, sizeof(sourceTime), 1, fp) == 1 &&
+              fwrite(frameOffsets.data(), sizeof(uint64_t), frameCount, fp) == frameCount &&
+              fwrite(frameSizes.data(), sizeof(uint32_t), frameCount, fp) == frameCount;
+
+    if (fclose(fp) != 0 || !ok)
+    {
+        remove(indexPath.c_str());
+        return false;
+    }
+    return true;
+}
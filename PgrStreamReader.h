@@ -0,0 +1,257 @@
+//=============================================================================
+// PgrStreamReader - Native memory-mapped reader for Ladybug .pgr streams
+//
+// Reads the stream container directly instead of going through
+// ladybugReadImageFromStream/ladybugGoToImage. The file is memory-mapped,
+// a frame-offset index is built once and persisted next to the stream as a
+// sidecar (<stream>.pgr.idx), and frames are handed out as zero-copy views
+// into the mapping, so seeking to any frame is O(1).
+//
+// Does not depend on the Ladybug SDK and builds on Windows and Linux.
+//
+// Container layout (all header fields little-endian uint32):
+//
+//   0x0000  char[16]   "PGRLADYBUGSTREAM"
+//   0x0010             stream version
+//   0x0014             frame rate (integer, stream version < 7)
+//   0x0018             base unit serial number
+//   0x001C             head unit serial number
+//   0x0020             reserved[25]
+//   0x0084             padding block size (frames start on this boundary)
+//   0x0088             data format (LadybugDataFormat)
+//   0x008C             resolution (LadybugResolution)
+//   0x0090             stippled (Bayer) format
+//   0x0094             configuration data size
+//   0x0098             number of images
+//   0x009C             number of key index entries
+//   0x00A0             key index increment
+//   0x00A4             stream data offset (first frame)
+//   0x00C0  float32    frame rate (stream version >= 7)
+//
+// Each frame starts with a 1024-byte image header. It opens with the frame's
+// image information as big-endian uint32 (the leading LadybugImageInfo
+// fields):
+//
+//   0x000              fingerprint (0xCAFEBABE)
+//   0x004              version
+//   0x008              timestamp, seconds since the epoch
+//   0x00C              timestamp, microseconds
+//   0x010              sequence id
+//   0x014              horizontal refresh rate
+//   0x018              gain adjust[6]
+//   0x030              white balance
+//   0x034              Bayer gain
+//   0x038              Bayer map
+//   0x03C              brightness
+//   0x040              gamma
+//   0x044              head unit serial number
+//   0x048              shutter[6]
+//
+// At offset 0x340 it holds
+// 24 big-endian uint32 (offset, size) pairs, relative to the frame start:
+// one per camera and Bayer channel (camera c, channel k at index c*4+k).
+// Formats that are not colour separated only use the first entry of each
+// camera. Frames are padded up to the padding block size.
+//
+// Plane contents, for a camera image of cols x rows (rows / 2 for the
+// HALF_HEIGHT formats):
+//   RAW8      one plane, 8-bit Bayer mosaic, row by row
+//   RAW16     one plane, 16-bit big-endian samples
+//   RAW12     one plane, 12-bit samples packed two per three bytes:
+//             a[11:4], a[3:0] | b[3:0] << 4, b[11:4]
+//   COLOR_SEP_JPEG8/12
+//             four greyscale JPEGs of cols/2 x rows/2, one per position of
+//             the 2x2 Bayer tile (k = 0 top-left, 1 top-right, 2 bottom-left,
+//             3 bottom-right)
+//=============================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr int PGR_NUM_CAMERAS = 6;
+constexpr int PGR_PLANES_PER_CAMERA = 4;
+constexpr int PGR_NUM_PLANES = PGR_NUM_CAMERAS * PGR_PLANES_PER_CAMERA;
+
+constexpr uint32_t PGR_IMAGE_HEADER_SIZE = 1024;
+constexpr uint32_t PGR_PLANE_TABLE_OFFSET = 0x340;
+
+// Data formats (values of LadybugDataFormat in the stream header)
+enum PgrDataFormat : uint32_t
+{
+    PGR_DATAFORMAT_RAW8 = 7,
+    PGR_DATAFORMAT_JPEG8 = 8,
+    PGR_DATAFORMAT_COLOR_SEP_JPEG8 = 9,
+    PGR_DATAFORMAT_HALF_HEIGHT_RAW8 = 10,
+    PGR_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG8 = 11,
+    PGR_DATAFORMAT_RAW16 = 12,
+    PGR_DATAFORMAT_JPEG12 = 13,
+    PGR_DATAFORMAT_COLOR_SEP_JPEG12 = 14,
+    PGR_DATAFORMAT_HALF_HEIGHT_RAW16 = 15,
+    PGR_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG12 = 16,
+    PGR_DATAFORMAT_RAW12 = 17,
+    PGR_DATAFORMAT_HALF_HEIGHT_RAW12 = 18
+};
+
+// Bayer tile of the sensors (values of LadybugStippledFormat)
+enum PgrStippledFormat : uint32_t
+{
+    PGR_STIPPLED_BGGR = 0,
+    PGR_STIPPLED_GBRG = 1,
+    PGR_STIPPLED_GRBG = 2,
+    PGR_STIPPLED_RGGB = 3
+};
+
+/**
+ * @brief Camera image size (columns x rows) of a LadybugResolution value
+ * @return false for unknown values
+ */
+bool GetPgrResolutionSize(uint32_t resolution, unsigned int& cols, unsigned int& rows);
+
+/**
+ * @brief Per-frame fields of an image header
+ */
+struct PgrImageInfo
+{
+    uint32_t fingerprint = 0;
+    uint32_t version = 0;
+    uint32_t timeSeconds = 0;
+    uint32_t timeMicroSeconds = 0;
+    uint32_t sequenceId = 0;
+    uint32_t refreshRate = 0;
+    uint32_t gainAdjust[PGR_NUM_CAMERAS] = {};
+    uint32_t whiteBalance = 0;
+    uint32_t bayerGain = 0;
+    uint32_t bayerMap = 0;
+    uint32_t brightness = 0;
+    uint32_t gamma = 0;
+    uint32_t serialNum = 0;
+    uint32_t shutter[PGR_NUM_CAMERAS] = {};
+};
+
+/**
+ * @brief Parse the image information at the start of a frame
+ * @param frame Frame start (image header)
+ * @return false if the frame is shorter than an image header
+ */
+bool ParsePgrImageInfo(const unsigned char* frame, size_t size, PgrImageInfo& info);
+
+/**
+ * @brief Stream header fields used by the exporter
+ */
+struct PgrStreamHeader
+{
+    uint32_t version = 0;
+    uint32_t serialBase = 0;
+    uint32_t serialHead = 0;
+    uint32_t paddingBlock = 0;
+    uint32_t dataFormat = 0;
+    uint32_t resolution = 0;
+    uint32_t stippledFormat = 0;
+    uint32_t configDataSize = 0;
+    uint32_t numImages = 0;
+    uint32_t streamDataOffset = 0;
+    float frameRate = 0.0f;
+};
+
+/**
+ * @brief Zero-copy view of one compressed camera/channel plane
+ */
+struct PgrPlaneView
+{
+    const unsigned char* data = nullptr;
+    uint32_t size = 0;
+};
+
+/**
+ * @brief Zero-copy view of one frame (valid while the reader is open)
+ */
+struct PgrFrameView
+{
+    unsigned int frameNum = 0;
+    const unsigned char* data = nullptr;    // Frame start (image header)
+    size_t size = 0;                        // Header + payload, without padding
+    PgrPlaneView planes[PGR_NUM_PLANES];
+};
+
+/**
+ * @brief Read-only memory mapping of a whole file
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const unsigned char* Data() const { return data; }
+    size_t Size() const { return size; }
+    int64_t ModifiedTime() const { return modifiedTime; }
+
+    /**
+     * @brief Hint the OS to start reading a byte range into the page cache
+     */
+    void Prefetch(size_t offset, size_t length) const;
+
+private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    int64_t modifiedTime = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+class PgrStreamReader
+{
+public:
+    /**
+     * @brief Map a stream file and load or build its frame index
+     * @param useSidecarIndex Load/save the index from <path>.idx
+     */
+    bool Open(const std::string& path, bool useSidecarIndex = true);
+    void Close();
+
+    bool IsOpen() const { return file.Data() != nullptr; }
+    const std::string& Path() const { return path; }
+    const PgrStreamHeader& Header() const { return header; }
+    unsigned int GetFrameCount() const { return static_cast<unsigned int>(frameOffsets.size()); }
+
+    /**
+     * @brief Get a zero-copy view of a frame and its plane table
+     */
+    bool GetFrame(unsigned int frameNum, PgrFrameView& view) const;
+
+    /**
+     * @brief Ask the OS to read frames [first, first + count) ahead of use
+     */
+    void Prefetch(unsigned int first, unsigned int count) const;
+
+    /**
+     * @brief True if the index came from an up-to-date sidecar file
+     */
+    bool IndexLoadedFromSidecar() const { return indexFromSidecar; }
+
+private:
+    bool ParseHeader();
+    bool ParsePlaneTable(size_t frameOffset, PgrFrameView& view) const;
+    bool BuildIndex();
+    bool LoadSidecarIndex(const std::string& indexPath);
+    bool SaveSidecarIndex(const std::string& indexPath) const;
+
+    std::string path;
+    MappedFile file;
+    PgrStreamHeader header;
+    std::vector<uint64_t> frameOffsets;
+    std::vector<uint32_t> frameSizes;
+    bool indexFromSidecar = false;
+};
@@ -0,0 +1,146 @@
+//=============================================================================
+// PipeOutput - Stream of encoded images to stdout or a FIFO (--output-pipe)
+//=============================================================================
+
+#include "PipeOutput.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#include <unistd.h>
+#endif
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+static const char RECORD_MAGIC[] = "LBXI";
+constexpr size_t RECORD_HEADER_SIZE = 24;
+constexpr size_t RECORD_EXTENSION_SIZE = 4;
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+static void PutLE(unsigned char* out, uint64_t value, unsigned int bytes)
+{
+    for (unsigned int i = 0; i < bytes; i++)
+    {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+/**
+ * @brief Take over stdout for the stream; messages printed afterwards go to
+ *        stderr
+ */
+static FILE* OpenStandardOutput()
+{
+    // Whatever printf still buffers is flushed to the new stdout (stderr),
+    // so no message ends up in the stream
+#ifdef _WIN32
+    const int fd = _dup(_fileno(stdout));
+    if (fd < 0 || _dup2(_fileno(stderr), _fileno(stdout)) != 0)
+    {
+        return nullptr;
+    }
+    _setmode(fd, _O_BINARY);
+    return _fdopen(fd, "wb");
+#else
+    const int fd = dup(STDOUT_FILENO);
+    if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+    {
+        return nullptr;
+    }
+    return fdopen(fd, "wb");
+#endif
+}
+
+//=============================================================================
+// PipeWriter
+//=============================================================================
+
+PipeWriter::~PipeWriter()
+{
+    if (file != nullptr)
+    {
+        Close();
+    }
+}
+
+bool PipeWriter::Open(const std::string& pipePath)
+{
+#ifndef _WIN32
+    // A reader that goes away shows up as a failed write instead of
+    // SIGPIPE ending the process
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    file = (pipePath == "-") ? OpenStandardOutput() : fopen(pipePath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        printf("Error: Could not open output pipe %s\n", pipePath.c_str());
+        return false;
+    }
+    path = (pipePath == "-") ? "stdout" : pipePath;
+    ResetOrder();
+    imagesWritten = 0;
+    return true;
+}
+
+void PipeWriter::WriteImage(const std::string& name, unsigned int frameNum, int camera,
+                            const std::vector<unsigned char>& data)
+{
+    unsigned char header[RECORD_HEADER_SIZE] = {};
+    memcpy(header, RECORD_MAGIC, 4);
+    PutLE(header + 4, frameNum, 4);
+    PutLE(header + 8, static_cast<uint32_t>(camera), 4);
+    const size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos)
+    {
+        const std::string extension = name.substr(dot + 1, RECORD_EXTENSION_SIZE);
+        memcpy(header + 12, extension.data(), extension.size());
+    }
+    PutLE(header + 16, data.size(), 8);
+
+    // Flushed per image, so the reader gets each one as soon as it is complete
+    if (fwrite(header, 1, RECORD_HEADER_SIZE, file) != RECORD_HEADER_SIZE ||
+        fwrite(data.data(), 1, data.size(), file) != data.size() || fflush(file) != 0)
+    {
+        printf("Error: Could not write %s to output pipe %s (reader closed?)\n", name.c_str(), path.c_str());
+        failed = true;
+        return;
+    }
+    imagesWritten++;
+}
+
+bool PipeWriter::Close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    // Images still held wait for one that never came (the export stopped
+    // early); they go out in order all the same
+    WriteHeldImages();
+
+    if (fclose(file) != 0 && !failed)
+    {
+        printf("Error: Could not write output pipe %s\n", path.c_str());
+        failed = true;
+    }
+    file = nullptr;
+    if (failed)
+    {
+        return false;
+    }
+    printf("Output pipe: %llu image(s) written to %s\n", static_cast<unsigned long long>(imagesWritten),
+           path.c_str());
+    return true;
+}
@@ -0,0 +1,62 @@
+//=============================================================================
+// PipeOutput - Stream of encoded images to stdout or a FIFO (--output-pipe)
+//
+// Instead of files, every image is written to one byte stream that another
+// process reads as the export runs: stdout (-o - or --output-pipe -), a
+// named pipe or any other file. Images come in frame order, and within a
+// frame in camera order, whatever order the encoder threads finish them in.
+// Each image is one record, all numbers little-endian:
+//
+//   0   char[4]   "LBXI"
+//   4   uint32    frame number
+//   8   int32     camera (0-5), or -1 for a panorama
+//   12  char[4]   file extension, NUL padded ("jpg", "png", "bmp", "tiff")
+//   16  uint64    image size N
+//   24  N bytes   the image file
+//
+// The stream ends when the export does. Images that could not be encoded
+// are left out. When the stream is stdout, the exporter's messages go to
+// stderr instead.
+//=============================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ImageSink.h"
+
+class PipeWriter : public OrderedImageSink
+{
+public:
+    PipeWriter() = default;
+    ~PipeWriter() override;
+
+    PipeWriter(const PipeWriter&) = delete;
+    PipeWriter& operator=(const PipeWriter&) = delete;
+
+    /**
+     * @brief Open the stream; "-" is stdout (which then stops taking
+     *        messages). Opening a FIFO waits for its reader.
+     * @return false (with a message) if the file cannot be opened
+     */
+    bool Open(const std::string& path);
+
+    bool Close() override;
+
+protected:
+    bool IsOpen() const override { return file != nullptr; }
+
+    /**
+     * @brief Write one record
+     */
+    void WriteImage(const std::string& name, unsigned int frameNum, int camera,
+                    const std::vector<unsigned char>& data) override;
+
+private:
+    FILE* file = nullptr;
+    std::string path;
+    uint64_t imagesWritten = 0;
+};
@@ -0,0 +1,281 @@
+//=============================================================================
+// PixelConvert - Pixel format conversion of camera textures
+//=============================================================================
+
+#include "PixelConvert.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define PIXEL_CONVERT_X86
+#endif
+
+// GCC and Clang compile each vector function for its own instruction set;
+// MSVC accepts the intrinsics anywhere
+#if defined(__GNUC__) || defined(__clang__)
+#define PIXEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PIXEL_TARGET(isa)
+#endif
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+constexpr size_t TONE_TABLE_SIZE = 65536;
+
+// Points a tone curve file may give
+constexpr size_t MIN_CURVE_POINTS = 2;
+constexpr size_t MAX_CURVE_POINTS = TONE_TABLE_SIZE;
+
+//=============================================================================
+// ToneCurve
+//=============================================================================
+
+/**
+ * @brief Read the output values of a tone curve file (whitespace or comma separated)
+ */
+static bool ReadCurveFile(const std::string& path, std::vector<double>& points)
+{
+    FILE* fp = fopen(path.c_str(), "r");
+    if (fp == nullptr)
+    {
+        printf("Error: Could not open tone curve %s\n", path.c_str());
+        return false;
+    }
+
+    bool ok = true;
+    double value;
+    int matched;
+    while ((matched = fscanf(fp, " %lf ,", &value)) == 1)
+    {
+        if (value < 0.0 || value > 255.0 || points.size() == MAX_CURVE_POINTS)
+        {
+            ok = false;
+            break;
+        }
+        points.push_back(value);
+    }
+    if (matched != EOF)
+    {
+        ok = false;
+    }
+    fclose(fp);
+
+    if (!ok || points.size() < MIN_CURVE_POINTS)
+    {
+        printf("Error: %s must hold %zu to %zu values from 0 to 255\n", path.c_str(), MIN_CURVE_POINTS,
+               MAX_CURVE_POINTS);
+        return false;
+    }
+    return true;
+}
+
+bool ToneCurve::Create(const std::string& spec, std::shared_ptr<const ToneCurve>& curve)
+{
+    curve.reset();
+    if (spec == "linear")
+    {
+        return true;
+    }
+
+    std::shared_ptr<ToneCurve> created(new ToneCurve());
+    created->table.resize(TONE_TABLE_SIZE);
+    uint8_t* table = created->table.data();
+
+    if (spec.compare(0, 6, "gamma:") == 0)
+    {
+        const double gamma = atof(spec.c_str() + 6);
+        if (!(gamma > 0.0))
+        {
+            printf("Error: Invalid tone curve %s (expected gamma:G with G > 0)\n", spec.c_str());
+            return false;
+        }
+        for (size_t i = 0; i < TONE_TABLE_SIZE; i++)
+        {
+            const double encoded = pow(i / 65535.0, 1.0 / gamma);
+            table[i] = static_cast<uint8_t>(lround(encoded * 255.0));
+        }
+        created->description = "gamma " + spec.substr(6);
+    }
+    else if (spec == "srgb")
+    {
+        for (size_t i = 0; i < TONE_TABLE_SIZE; i++)
+        {
+            const double linear = i / 65535.0;
+            const double encoded = (linear <= 0.0031308) ? 12.92 * linear : 1.055 * pow(linear, 1.0 / 2.4) - 0.055;
+            table[i] = static_cast<uint8_t>(lround(encoded * 255.0));
+        }
+        created->description = "sRGB";
+    }
+    else
+    {
+        std::vector<double> points;
+        if (!ReadCurveFile(spec, points))
+        {
+            return false;
+        }
+
+        // Input i falls between two of the points spread over 0..65535
+        const double scale = static_cast<double>(points.size() - 1) / 65535.0;
+        for (size_t i = 0; i < TONE_TABLE_SIZE; i++)
+        {
+            const double position = i * scale;
+            const size_t index = std::min(static_cast<size_t>(position), points.size() - 2);
+            const double fraction = position - index;
+            const double value = points[index] + (points[index + 1] - points[index]) * fraction;
+            table[i] = static_cast<uint8_t>(lround(value));
+        }
+        created->description = spec + " (" + std::to_string(points.size()) + " points)";
+    }
+
+    curve = created;
+    return true;
+}
+
+//=============================================================================
+// Conversion Kernels
+//=============================================================================
+//
+// Each kernel converts a prefix of the samples and returns its length; the
+// rest is left to the scalar loop. Loads of a block happen before its store
+// and the output trails the input, so converting in place is safe.
+
+static void ConvertHighByte(const uint16_t* in, unsigned char* out, size_t samples)
+{
+    for (size_t i = 0; i < samples; i++)
+    {
+        out[i] = static_cast<unsigned char>(in[i] >> 8);
+    }
+}
+
+#ifdef PIXEL_CONVERT_X86
+
+PIXEL_TARGET("sse4.1")
+static size_t ConvertHighByteSse4(const uint16_t* in, unsigned char* out, size_t samples)
+{
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16)
+    {
+        const __m128i a = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), 8);
+        const __m128i b = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8)), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(a, b));
+    }
+    return i;
+}
+
+PIXEL_TARGET("avx2")
+static size_t ConvertHighByteAvx2(const uint16_t* in, unsigned char* out, size_t samples)
+{
+    size_t i = 0;
+    for (; i + 32 <= samples; i += 32)
+    {
+        const __m256i a = _mm256_srli_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)), 8);
+        const __m256i b = _mm256_srli_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 16)), 8);
+
+        // packus works per 128-bit lane; put the quarters back in order
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+    }
+    return i;
+}
+
+PIXEL_TARGET("avx512f,avx512bw")
+static size_t ConvertHighByteAvx512(const uint16_t* in, unsigned char* out, size_t samples)
+{
+    const __m512i order = _mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0);
+    size_t i = 0;
+    for (; i + 64 <= samples; i += 64)
+    {
+        const __m512i a = _mm512_srli_epi16(_mm512_loadu_si512(in + i), 8);
+        const __m512i b = _mm512_srli_epi16(_mm512_loadu_si512(in + i + 32), 8);
+
+        // As with AVX2, packus leaves the 64-bit quarters interleaved per lane
+        // (the zero-masked permute avoids a GCC 12 uninitialized warning)
+        const __m512i packed = _mm512_maskz_permutexvar_epi64(0xFF, order, _mm512_packus_epi16(a, b));
+        _mm512_storeu_si512(out + i, packed);
+    }
+    return i;
+}
+
+#endif
+
+static void ConvertWithCurve(const uint16_t* in, unsigned char* out, size_t numPixels, const uint8_t* table)
+{
+    for (size_t p = 0; p < numPixels; p++, in += 4, out += 4)
+    {
+        const uint16_t b = in[0];
+        const uint16_t g = in[1];
+        const uint16_t r = in[2];
+        const uint16_t u = in[3];
+        out[0] = table[b];
+        out[1] = table[g];
+        out[2] = table[r];
+        out[3] = static_cast<unsigned char>(u >> 8);
+    }
+}
+
+void ConvertBgru16ToBgru(const uint16_t* in, unsigned char* out, size_t numPixels, const ToneCurve* curve)
+{
+    if (curve != nullptr)
+    {
+        ConvertWithCurve(in, out, numPixels, curve->Table());
+        return;
+    }
+
+    const size_t samples = numPixels * 4;
+    size_t done = 0;
+#ifdef PIXEL_CONVERT_X86
+    switch (GetIsaLevel())
+    {
+    case IsaLevel::AVX512:
+        done = ConvertHighByteAvx512(in, out, samples);
+        break;
+    case IsaLevel::AVX2:
+        done = ConvertHighByteAvx2(in, out, samples);
+        break;
+    case IsaLevel::SSE4:
+        done = ConvertHighByteSse4(in, out, samples);
+        break;
+    default:
+        break;
+    }
+#endif
+    ConvertHighByte(in + done, out + done, samples - done);
+}
+
+//=============================================================================
+// PixelConverter
+//=============================================================================
+
+static unsigned int GetConvertThreads(unsigned int numThreads)
+{
+    if (numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::min(numThreads, static_cast<unsigned int>(NUM_CAMERAS));
+}
+
+PixelConverter::PixelConverter(unsigned int numThreads, std::shared_ptr<const ToneCurve> curve)
+    : curve(std::move(curve)), pool(GetConvertThreads(numThreads))
+{
+}
+
+void PixelConverter::ReduceTo8Bit(unsigned char* const textures[NUM_CAMERAS], unsigned int cols, unsigned int rows)
+{
+    // A texture is converted in place front to back, so it is not split
+    // between threads; the cameras run in parallel
+    const size_t numPixels = static_cast<size_t>(cols) * rows;
+    pool.Run(NUM_CAMERAS, [&](unsigned int cam)
+    {
+        ConvertBgru16ToBgru(reinterpret_cast<const uint16_t*>(textures[cam]), textures[cam], numPixels,
+                            curve.get());
+    });
+}
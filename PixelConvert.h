@@ -0,0 +1,84 @@
+//=============================================================================
+// PixelConvert - Pixel format conversion of camera textures
+//
+// BGRU16 textures of high bit depth streams are reduced to BGRU before
+// they are saved as 8-bit images. By default the conversion keeps the high
+// byte of every sample, bit-exact with ladybugConvertImageBuffersPixelFormat,
+// using SSE, AVX2 or AVX-512 code as the processor allows (see
+// CpuFeatures.h). A ToneCurve maps the full 16-bit range through a table
+// instead, so the headroom of 12-bit exposures is not simply cut off.
+//
+// Conversions work in place: the output may start at the same address as
+// the input. PixelConverter converts the six textures of a frame in
+// parallel.
+//=============================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ImagingBackend.h"
+#include "WorkerPool.h"
+
+/**
+ * @brief 16-bit to 8-bit lookup table applied to the B, G and R samples
+ */
+class ToneCurve
+{
+public:
+    /**
+     * @brief Create a curve from a --tone-curve value
+     *
+     * "linear" gives no curve (null, the plain high-byte conversion);
+     * "gamma:G" encodes with exponent 1/G; "srgb" uses the sRGB transfer
+     * function; anything else is a text file of 2 to 65536 output values
+     * (0-255) spread evenly over the input range and interpolated linearly.
+     * @return false (with a message) if the value or file is invalid
+     */
+    static bool Create(const std::string& spec, std::shared_ptr<const ToneCurve>& curve);
+
+    /**
+     * @brief Output value of every 16-bit input
+     */
+    const uint8_t* Table() const { return table.data(); }
+
+    const std::string& Description() const { return description; }
+
+private:
+    ToneCurve() = default;
+
+    std::vector<uint8_t> table;         // 65536 entries
+    std::string description;
+};
+
+/**
+ * @brief Reduce BGRU16 pixels to BGRU
+ * @param out May equal in (the output is half the size of the input)
+ * @param curve Table for B, G and R, or null for the high byte; U always
+ *              keeps its high byte
+ */
+void ConvertBgru16ToBgru(const uint16_t* in, unsigned char* out, size_t numPixels,
+                         const ToneCurve* curve = nullptr);
+
+/**
+ * @brief Reduces the six camera textures of a frame in place, in parallel
+ */
+class PixelConverter
+{
+public:
+    /**
+     * @param numThreads Threads converting cameras at once (0 = one per
+     *                   logical processor, at most one per camera)
+     */
+    PixelConverter(unsigned int numThreads, std::shared_ptr<const ToneCurve> curve);
+
+    void ReduceTo8Bit(unsigned char* const textures[NUM_CAMERAS], unsigned int cols, unsigned int rows);
+
+private:
+    std::shared_ptr<const ToneCurve> curve;
+    WorkerPool pool;
+};
@@ -0,0 +1,283 @@
+//=============================================================================
+// RunStats - Per-stage timing and the --report run summary
+//=============================================================================
+
+#include "RunStats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+//=============================================================================
+// Stage Names
+//=============================================================================
+
+const char* GetStageName(Stage stage)
+{
+    switch (stage)
+    {
+    case Stage::Read:           return "read";
+    case Stage::Decode:         return "decode";
+    case Stage::Convert:        return "convert";
+    case Stage::PixelConvert:   return "pixel-convert";
+    case Stage::Upload:         return "upload";
+    case Stage::Render:         return "render";
+    case Stage::Encode:         return "encode";
+    case Stage::Publish:        return "publish";
+    case Stage::Count:          break;
+    }
+    return "unknown";
+}
+
+//=============================================================================
+// LatencyHistogram
+//=============================================================================
+
+LatencyHistogram::LatencyHistogram()
+{
+    for (std::atomic<uint64_t>& bucket : buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+unsigned int LatencyHistogram::BucketIndex(uint64_t value)
+{
+    // Values below SUB_BUCKETS get a bucket each; above that, each power of
+    // two is split into SUB_BUCKETS buckets by the bits below the top one
+    if (value < SUB_BUCKETS)
+    {
+        return static_cast<unsigned int>(value);
+    }
+
+    unsigned int topBit = 0;
+    for (uint64_t rest = value >> 1; rest != 0; rest >>= 1)
+    {
+        topBit++;
+    }
+    const unsigned int shift = topBit - SUB_BUCKET_BITS;
+    const unsigned int subBucket = static_cast<unsigned int>(value >> shift) & (SUB_BUCKETS - 1);
+    return SUB_BUCKETS + shift * SUB_BUCKETS + subBucket;
+}
+
+uint64_t LatencyHistogram::BucketMidpoint(unsigned int index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    const unsigned int shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    const uint64_t subBucket = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    const uint64_t lower = (SUB_BUCKETS + subBucket) << shift;
+    return lower + ((1ull << shift) >> 1);
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds)
+{
+    buckets[BucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t current = maximum.load(std::memory_order_relaxed);
+    while (nanoseconds > current &&
+           !maximum.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+uint64_t LatencyHistogram::Percentile(double fraction) const
+{
+    const uint64_t samples = Count();
+    if (samples == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the sample sought, counted from 1
+    uint64_t rank = static_cast<uint64_t>(fraction * samples + 0.999999);
+    rank = rank < 1 ? 1 : (rank > samples ? samples : rank);
+
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < NUM_BUCKETS; i++)
+    {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            const uint64_t midpoint = BucketMidpoint(i);
+            return midpoint < MaxNanoseconds() ? midpoint : MaxNanoseconds();
+        }
+    }
+    return MaxNanoseconds();
+}
+
+//=============================================================================
+// RunStats
+//=============================================================================
+
+RunStats::RunStats()
+    : created(Clock::now())
+{
+}
+
+void RunStats::StartProcessing()
+{
+    // At least one tick, so 0 keeps meaning "not started"
+    const int64_t ticks = std::max<int64_t>(1, (Clock::now() - created).count());
+    int64_t expected = 0;
+    processingStart.compare_exchange_strong(expected, ticks);
+}
+
+void RunStats::AddFrames(unsigned int exported, unsigned int failed)
+{
+    framesExported.fetch_add(exported, std::memory_order_relaxed);
+    framesFailed.fetch_add(failed, std::memory_order_relaxed);
+}
+
+void RunStats::AddPassthroughFrames(unsigned int passedThrough, unsigned int fellBack)
+{
+    framesPassedThrough.fetch_add(passedThrough, std::memory_order_relaxed);
+    passthroughFallbacks.fetch_add(fellBack, std::memory_order_relaxed);
+}
+
+double RunStats::SetupSeconds() const
+{
+    const int64_t start = processingStart.load();
+    const Clock::duration setup = (start != 0) ? Clock::duration(start) : Clock::now() - created;
+    return std::chrono::duration<double>(setup).count();
+}
+
+double RunStats::ProcessingSeconds() const
+{
+    const int64_t start = processingStart.load();
+    if (start == 0)
+    {
+        return 0.0;
+    }
+    return std::chrono::duration<double>(Clock::now() - (created + Clock::duration(start))).count();
+}
+
+void RunStats::PrintSummary() const
+{
+    const double seconds = ProcessingSeconds();
+    const double frameRate = seconds > 0.0 ? FramesExported() / seconds : 0.0;
+
+    printf("\n--- Stage Timing (ms) ---\n");
+    printf("%-14s %8s %9s %9s %9s %9s %9s\n", "stage", "calls", "mean", "p50", "p95", "p99", "max");
+    for (int i = 0; i < NUM_STAGES; i++)
+    {
+        const LatencyHistogram& histogram = stages[i];
+        const uint64_t calls = histogram.Count();
+        if (calls == 0)
+        {
+            continue;
+        }
+        printf("%-14s %8llu %9.2f %9.2f %9.2f %9.2f %9.2f\n", GetStageName(static_cast<Stage>(i)),
+               static_cast<unsigned long long>(calls),
+               histogram.TotalNanoseconds() / 1e6 / calls,
+               histogram.Percentile(0.50) / 1e6, histogram.Percentile(0.95) / 1e6,
+               histogram.Percentile(0.99) / 1e6, histogram.MaxNanoseconds() / 1e6);
+    }
+    printf("Setup: %.2f s, processing: %.2f s, %.2f frames/s\n", SetupSeconds(), seconds, frameRate);
+    printf("Read: %.1f MB, written: %.1f MB\n", BytesRead() / 1e6, BytesWritten() / 1e6);
+    if (FramesPassedThrough() + PassthroughFallbacks() > 0)
+    {
+        printf("JPEG passthrough: %llu frames, %llu fell back to conversion\n",
+               static_cast<unsigned long long>(FramesPassedThrough()),
+               static_cast<unsigned long long>(PassthroughFallbacks()));
+    }
+    printf("-------------------------\n");
+}
+
+//=============================================================================
+// JSON Report
+//=============================================================================
+
+/**
+ * @brief Quote a string for JSON (paths contain backslashes on Windows)
+ */
+static std::string JsonString(const std::string& value)
+{
+    std::string quoted = "\"";
+    for (char c : value)
+    {
+        switch (c)
+        {
+        case '"':   quoted += "\\\""; break;
+        case '\\':  quoted += "\\\\"; break;
+        case '\n':  quoted += "\\n"; break;
+        case '\r':  quoted += "\\r"; break;
+        case '\t':  quoted += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+                quoted += escaped;
+            }
+            else
+            {
+                quoted += c;
+            }
+        }
+    }
+    return quoted + "\"";
+}
+
+bool WriteRunReport(const std::string& path, const RunReportInfo& info, const RunStats& stats)
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (fp == nullptr)
+    {
+        printf("Warning: Could not create report %s\n", path.c_str());
+        return false;
+    }
+
+    const double seconds = stats.ProcessingSeconds();
+    const double perSecond = seconds > 0.0 ? 1.0 / seconds : 0.0;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"input\": %s,\n", JsonString(info.input).c_str());
+    fprintf(fp, "  \"output\": %s,\n", JsonString(info.output).c_str());
+    fprintf(fp, "  \"backend\": %s,\n", JsonString(info.backend).c_str());
+    fprintf(fp, "  \"exportType\": %s,\n", JsonString(info.exportType).c_str());
+    fprintf(fp, "  \"format\": %s,\n", JsonString(info.format).c_str());
+    fprintf(fp, "  \"colorProcessing\": %s,\n", JsonString(info.colorProcessing).c_str());
+    fprintf(fp, "  \"pipelineDepth\": %u,\n", info.pipelineDepth);
+    fprintf(fp, "  \"sessions\": %u,\n", info.numSessions);
+    fprintf(fp, "  \"shards\": %u,\n", info.numShards);
+    fprintf(fp, "  \"exitCode\": %d,\n", info.exitCode);
+    fprintf(fp, "  \"setupSeconds\": %.6f,\n", stats.SetupSeconds());
+    fprintf(fp, "  \"processingSeconds\": %.6f,\n", seconds);
+    fprintf(fp, "  \"framesExported\": %llu,\n", static_cast<unsigned long long>(stats.FramesExported()));
+    fprintf(fp, "  \"framesFailed\": %llu,\n", static_cast<unsigned long long>(stats.FramesFailed()));
+    fprintf(fp, "  \"framesPerSecond\": %.3f,\n", stats.FramesExported() * perSecond);
+    fprintf(fp, "  \"bytesRead\": %llu,\n", static_cast<unsigned long long>(stats.BytesRead()));
+    fprintf(fp, "  \"bytesWritten\": %llu,\n", static_cast<unsigned long long>(stats.BytesWritten()));
+    fprintf(fp, "  \"framesPassedThrough\": %llu,\n", static_cast<unsigned long long>(stats.FramesPassedThrough()));
+    fprintf(fp, "  \"passthroughFallbacks\": %llu,\n", static_cast<unsigned long long>(stats.PassthroughFallbacks()));
+    fprintf(fp, "  \"readMBPerSecond\": %.3f,\n", stats.BytesRead() / 1e6 * perSecond);
+    fprintf(fp, "  \"writeMBPerSecond\": %.3f,\n", stats.BytesWritten() / 1e6 * perSecond);
+    fprintf(fp, "  \"stages\": {");
+
+    for (int i = 0; i < NUM_STAGES; i++)
+    {
+        const LatencyHistogram& histogram = stats.GetStage(static_cast<Stage>(i));
+        const uint64_t calls = histogram.Count();
+        fprintf(fp, "%s\n    %s: {\"count\": %llu, \"totalMs\": %.3f, \"meanMs\": %.3f, "
+                "\"p50Ms\": %.3f, \"p95Ms\": %.3f, \"p99Ms\": %.3f, \"maxMs\": %.3f}",
+                i > 0 ? "," : "", JsonString(GetStageName(static_cast<Stage>(i))).c_str(),
+                static_cast<unsigned long long>(calls), histogram.TotalNanoseconds() / 1e6,
+                calls > 0 ? histogram.TotalNanoseconds() / 1e6 / calls : 0.0,
+                histogram.Percentile(0.50) / 1e6, histogram.Percentile(0.95) / 1e6,
+                histogram.Percentile(0.99) / 1e6, histogram.MaxNanoseconds() / 1e6);
+    }
+    fprintf(fp, "\n  }\n}\n");
+
+    if (fclose(fp) != 0)
+    {
+        printf("Warning: Could not write report %s\n", path.c_str());
+        return false;
+    }
+    printf("Run report written to %s\n", path.c_str());
+    return true;
+}
@@ -0,0 +1,215 @@
+//=============================================================================
+// RunStats - Per-stage timing and the --report run summary
+//
+// Every pipeline stage (and a few sub-steps inside the backends) measures
+// each call with a StageTimer and adds it to a LatencyHistogram. The
+// histograms are lock-free and shared by all threads and sessions of the
+// process, so timing costs two clock reads and a few atomic adds per call.
+// Without --report or --trace no RunStats exists and StageTimer does nothing.
+//
+// At the end of the run WriteRunReport writes a JSON summary: throughput,
+// bytes read and written, --jpeg-passthrough frame counts, and
+// count/total/mean/p50/p95/p99/max per stage.
+// With --trace, StageTimer also hands each span to the run's TraceRecorder.
+//=============================================================================
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "TraceRecorder.h"
+
+/**
+ * @brief Timed steps of a frame
+ *
+ * Decode and Upload are measured inside Convert and Render respectively, so
+ * their time is also part of those stages. Decode and Encode are timed per
+ * camera image, the others per frame.
+ */
+enum class Stage
+{
+    Read,               // FrameStream::Read
+    Decode,             // Unpacking / JPEG decoding of the raw planes (cpu backend)
+    Convert,            // FrameConverter::Convert (decode + debayer)
+    PixelConvert,       // FrameConverter::ReduceTo8Bit (BGRU16 -> BGRU)
+    Upload,             // Texture upload to the GPU (sdk renderer)
+    Render,             // PanoramaRenderer::Render
+    Encode,             // ImageWriter::Save (encoding and writing the file)
+    Publish,            // Copying a frame into the --shm-ring
+    Count
+};
+
+constexpr int NUM_STAGES = static_cast<int>(Stage::Count);
+
+/**
+ * @brief Name of a stage in reports ("read", "pixel-convert", ...)
+ */
+const char* GetStageName(Stage stage);
+
+/**
+ * @brief Log-linear histogram of durations in nanoseconds
+ *
+ * 16 buckets per power of two, so percentiles are within about 3% of the
+ * true value. Record may be called from any number of threads.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void Record(uint64_t nanoseconds);
+
+    uint64_t Count() const { return count.load(std::memory_order_relaxed); }
+    uint64_t TotalNanoseconds() const { return total.load(std::memory_order_relaxed); }
+    uint64_t MaxNanoseconds() const { return maximum.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Approximate duration below which the given fraction of calls fall
+     */
+    uint64_t Percentile(double fraction) const;
+
+private:
+    static constexpr unsigned int SUB_BUCKET_BITS = 4;
+    static constexpr unsigned int SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    static constexpr unsigned int NUM_BUCKETS = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+    static unsigned int BucketIndex(uint64_t value);
+    static uint64_t BucketMidpoint(unsigned int index);
+
+    std::atomic<uint64_t> buckets[NUM_BUCKETS];
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> maximum{0};
+};
+
+/**
+ * @brief Stage histograms and I/O counters of one run
+ */
+class RunStats
+{
+public:
+    RunStats();
+
+    RunStats(const RunStats&) = delete;
+    RunStats& operator=(const RunStats&) = delete;
+
+    void Record(Stage stage, uint64_t nanoseconds) { stages[static_cast<int>(stage)].Record(nanoseconds); }
+    const LatencyHistogram& GetStage(Stage stage) const { return stages[static_cast<int>(stage)]; }
+
+    /**
+     * @brief Mark the first frame read (setup time ends here); later calls are ignored
+     */
+    void StartProcessing();
+
+    void AddFrames(unsigned int exported, unsigned int failed);
+    void AddBytesRead(uint64_t bytes) { bytesRead.fetch_add(bytes, std::memory_order_relaxed); }
+    void AddBytesWritten(uint64_t bytes) { bytesWritten.fetch_add(bytes, std::memory_order_relaxed); }
+
+    /**
+     * @brief Count --jpeg-passthrough frames: repacked, or converted because they could not be
+     */
+    void AddPassthroughFrames(unsigned int passedThrough, unsigned int fellBack);
+
+    uint64_t FramesExported() const { return framesExported.load(); }
+    uint64_t FramesFailed() const { return framesFailed.load(); }
+    uint64_t BytesRead() const { return bytesRead.load(); }
+    uint64_t BytesWritten() const { return bytesWritten.load(); }
+    uint64_t FramesPassedThrough() const { return framesPassedThrough.load(); }
+    uint64_t PassthroughFallbacks() const { return passthroughFallbacks.load(); }
+
+    /**
+     * @brief Seconds from construction to the first frame, and from there to now
+     */
+    double SetupSeconds() const;
+    double ProcessingSeconds() const;
+
+    /**
+     * @brief Print the stage table to the console
+     */
+    void PrintSummary() const;
+
+    /**
+     * @brief Timeline that also receives the stage spans (--trace), or null
+     */
+    void SetTrace(TraceRecorder* recorder) { trace = recorder; }
+    TraceRecorder* Trace() const { return trace; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    LatencyHistogram stages[NUM_STAGES];
+    Clock::time_point created;
+    std::atomic<int64_t> processingStart{0};    // Clock ticks since created, 0 = not started
+    std::atomic<uint64_t> framesExported{0};
+    std::atomic<uint64_t> framesFailed{0};
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> framesPassedThrough{0};
+    std::atomic<uint64_t> passthroughFallbacks{0};
+    TraceRecorder* trace = nullptr;
+};
+
+/**
+ * @brief Times a scope into a stage of stats (does nothing if stats is null)
+ */
+class StageTimer
+{
+public:
+    StageTimer(RunStats* stats, Stage stage, int64_t frame = TRACE_NO_FRAME)
+        : stats(stats), stage(stage), frame(frame)
+    {
+        if (stats != nullptr)
+        {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~StageTimer()
+    {
+        if (stats != nullptr)
+        {
+            const auto end = std::chrono::steady_clock::now();
+            stats->Record(stage, static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+            if (stats->Trace() != nullptr)
+            {
+                stats->Trace()->AddSpan(GetStageName(stage), "stage", start, end, frame);
+            }
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    RunStats* stats;
+    Stage stage;
+    int64_t frame;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * @brief Run description written at the top of the report
+ */
+struct RunReportInfo
+{
+    std::string input;
+    std::string output;
+    std::string backend;
+    std::string exportType;             // "panorama" or "6processed"
+    std::string format;
+    std::string colorProcessing;
+    unsigned int pipelineDepth = 0;
+    unsigned int numSessions = 1;
+    unsigned int numShards = 1;
+    int exitCode = 0;
+};
+
+/**
+ * @brief Write the JSON run report
+ * @return false (with a message) if the file cannot be written
+ */
+bool WriteRunReport(const std::string& path, const RunReportInfo& info, const RunStats& stats);
@@ -0,0 +1,1131 @@
+//=============================================================================
+// SdkBackend - ImagingBackend on top of the Teledyne FLIR Ladybug SDK
+//
+// Every SDK call of the exporter lives here. Contexts are never shared
+// between threads: the converter uses the context the alpha masks were
+// built on, the renderer creates its own on the render thread (OpenGL), and
+// every writer has its own for ladybugSaveImage.
+//=============================================================================
+
+#include "ImageFile.h"
+#include "ImagingBackend.h"
+#include "PanoramaLut.h"
+#include "PixelConvert.h"
+#include "RunStats.h"
+
+#include <windows.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+
+#include <ladybug.h>
+#include <ladybugrenderer.h>
+#include <ladybuggeom.h>
+#include <ladybugstream.h>
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+// Pi constant for angle conversions
+constexpr double PI = 3.14159265358979323846;
+
+// Radius (metres) of the sphere the CPU renderer projects onto, as the
+// SDK's default panorama sphere
+constexpr double PANORAMA_SPHERE_RADIUS = 20.0;
+
+#ifndef MAX_PATH
+#define MAX_PATH 260
+#endif
+
+//=============================================================================
+// Helper Macro for Error Checking
+//=============================================================================
+
+#define CHECK_SDK_ERROR(error, functionName) \
+    if (error != LADYBUG_OK) { \
+        printf("Error [%s]: %s\n", functionName, ladybugErrorToString(error)); \
+        return false; \
+    }
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+/**
+ * @brief Check if data format is high bit depth (12/16 bit)
+ */
+static bool IsHighBitDepthFormat(LadybugDataFormat format)
+{
+    return (
+        format == LADYBUG_DATAFORMAT_RAW12 ||
+        format == LADYBUG_DATAFORMAT_HALF_HEIGHT_RAW12 ||
+        format == LADYBUG_DATAFORMAT_COLOR_SEP_JPEG12 ||
+        format == LADYBUG_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG12 ||
+        format == LADYBUG_DATAFORMAT_COLOR_SEP_JPEG12_PROCESSED ||
+        format == LADYBUG_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG12_PROCESSED ||
+        format == LADYBUG_DATAFORMAT_RAW16 ||
+        format == LADYBUG_DATAFORMAT_HALF_HEIGHT_RAW16);
+}
+
+static LadybugColorProcessingMethod GetSdkColorMethod(ColorMethod method)
+{
+    switch (method)
+    {
+    case ColorMethod::HqLinear:        return LADYBUG_HQLINEAR;
+    case ColorMethod::EdgeSensing:     return LADYBUG_EDGE_SENSING;
+    case ColorMethod::NearestNeighbor: return LADYBUG_NEAREST_NEIGHBOR_FAST;
+    case ColorMethod::Downsample4:     return LADYBUG_DOWNSAMPLE4;
+    case ColorMethod::Downsample16:    return LADYBUG_DOWNSAMPLE16;
+    case ColorMethod::Mono:            return LADYBUG_MONO;
+    }
+    return LADYBUG_HQLINEAR;
+}
+
+static LadybugPixelFormat GetSdkPixelFormat(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::BGRU:   return LADYBUG_BGRU;
+    case PixelFormat::BGRU16: return LADYBUG_BGRU16;
+    case PixelFormat::BGR:    return LADYBUG_BGR;
+    }
+    return LADYBUG_BGRU;
+}
+
+static LadybugSaveFileFormat GetSdkFileFormat(ImageFileFormat format)
+{
+    switch (format)
+    {
+    case ImageFileFormat::BMP:  return LADYBUG_FILEFORMAT_BMP;
+    case ImageFileFormat::JPG:  return LADYBUG_FILEFORMAT_JPG;
+    case ImageFileFormat::TIFF: return LADYBUG_FILEFORMAT_TIFF;
+    case ImageFileFormat::PNG:  return LADYBUG_FILEFORMAT_PNG;
+    }
+    return LADYBUG_FILEFORMAT_JPG;
+}
+
+/**
+ * @brief Open a segment of the recording set for reading with the SDK
+ */
+static LadybugError OpenSdkSegment(const std::string& path, LadybugStreamContext& segmentContext)
+{
+    LadybugError error = ladybugCreateStreamContext(&segmentContext);
+    if (error != LADYBUG_OK)
+    {
+        segmentContext = nullptr;
+        return error;
+    }
+
+    error = ladybugInitializeStreamForReading(segmentContext, path.c_str(), true);
+    if (error != LADYBUG_OK)
+    {
+        ladybugDestroyStreamContext(&segmentContext);
+        segmentContext = nullptr;
+    }
+    return error;
+}
+
+/**
+ * @brief Hash the calibration file extracted from the stream (remap table cache key)
+ */
+static bool HashConfigFile(const char* path, uint64_t& hash)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> contents;
+    unsigned char buffer[4096];
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    {
+        contents.insert(contents.end(), buffer, buffer + bytesRead);
+    }
+    const bool ok = ferror(fp) == 0;
+    fclose(fp);
+
+    hash = HashCalibration(contents.data(), contents.size());
+    return ok;
+}
+
+/**
+ * @brief Raw frame plus the SDK image header ladybugConvertImage needs
+ */
+struct SdkRawFrame : public RawFrame
+{
+    LadybugImage image = {};
+};
+
+//=============================================================================
+// SdkFrameStream - ladybugReadImageFromStream across the recording set
+//=============================================================================
+
+class SdkFrameStream : public FrameStream
+{
+public:
+    SdkFrameStream(LadybugStreamContext streamContext, const std::vector<StreamSegment>& segments)
+        : streamContext(streamContext), segments(segments)
+    {
+    }
+
+    ~SdkFrameStream() override
+    {
+        if (prefetchedContext.valid())
+        {
+            LadybugStreamContext segmentContext = prefetchedContext.get();
+            if (segmentContext != nullptr)
+            {
+                ladybugDestroyStreamContext(&segmentContext);
+            }
+        }
+        if (streamContext != nullptr)
+        {
+            ladybugDestroyStreamContext(&streamContext);
+        }
+    }
+
+    std::unique_ptr<RawFrame> CreateFrame() const override
+    {
+        return std::unique_ptr<RawFrame>(new SdkRawFrame());
+    }
+
+    bool Seek(unsigned int frame) override
+    {
+        const size_t segment = FindSegmentForFrame(segments, frame);
+        if (segment == segments.size())
+        {
+            printf("Error: Frame %u is outside the recording set\n", frame);
+            return false;
+        }
+
+        LadybugError error = LADYBUG_OK;
+        if (segment != currentSegment)
+        {
+            error = SwitchSegment(segment);
+        }
+        if (error == LADYBUG_OK)
+        {
+            error = ladybugGoToImage(streamContext, frame - segments[segment].firstFrame);
+        }
+        if (error != LADYBUG_OK)
+        {
+            printf("Error: Could not seek to frame %u: %s\n", frame, ladybugErrorToString(error));
+            return false;
+        }
+        return true;
+    }
+
+    bool Read(unsigned int frame, RawFrame& raw) override
+    {
+        LadybugError error;
+
+        // Crossing into the next segment of the recording set
+        const size_t segment = FindSegmentForFrame(segments, frame);
+        if (segment != segments.size() && segment != currentSegment)
+        {
+            error = SwitchSegment(segment);
+            if (error != LADYBUG_OK)
+            {
+                printf("Warning: Could not open segment %s: %s\n",
+                       segments[segment].path.c_str(), ladybugErrorToString(error));
+                return false;
+            }
+        }
+
+        LadybugImage image;
+        error = ladybugReadImageFromStream(streamContext, &image);
+        if (error != LADYBUG_OK)
+        {
+            printf("Warning: Could not read frame %u: %s\n", frame, ladybugErrorToString(error));
+            return false;
+        }
+
+        // The SDK reuses its read buffer, so keep a private copy of the frame
+        SdkRawFrame& sdkFrame = static_cast<SdkRawFrame&>(raw);
+        sdkFrame.frameNum = frame;
+        sdkFrame.storage.assign(image.pData, image.pData + image.uiDataSizeBytes);
+        sdkFrame.data = sdkFrame.storage.data();
+        sdkFrame.size = sdkFrame.storage.size();
+        sdkFrame.image = image;
+        sdkFrame.image.pData = sdkFrame.storage.data();
+
+        if (segment != segments.size())
+        {
+            PrefetchNextSegment(segment, frame);
+        }
+        return true;
+    }
+
+private:
+    /**
+     * @brief Make a segment the one read by the stream context
+     *
+     * Uses the stream context opened ahead of time by PrefetchNextSegment
+     * when there is one, so crossing into the next file does not stall.
+     */
+    LadybugError SwitchSegment(size_t segment)
+    {
+        LadybugError error = LADYBUG_OK;
+        LadybugStreamContext segmentContext = nullptr;
+
+        if (prefetchedContext.valid())
+        {
+            segmentContext = prefetchedContext.get();
+            if (prefetchedSegment != segment && segmentContext != nullptr)
+            {
+                ladybugDestroyStreamContext(&segmentContext);
+                segmentContext = nullptr;
+            }
+            prefetchedSegment = 0;
+        }
+
+        if (segmentContext == nullptr)
+        {
+            error = OpenSdkSegment(segments[segment].path, segmentContext);
+            if (error != LADYBUG_OK)
+            {
+                return error;
+            }
+        }
+
+        ladybugDestroyStreamContext(&streamContext);
+        streamContext = segmentContext;
+        currentSegment = segment;
+        return LADYBUG_OK;
+    }
+
+    /**
+     * @brief Start opening the segment after this one when its end is near
+     */
+    void PrefetchNextSegment(size_t segment, unsigned int frame)
+    {
+        const size_t nextSegment = segment + 1;
+        if (nextSegment >= segments.size() || prefetchedSegment == nextSegment)
+        {
+            return;
+        }
+
+        const StreamSegment& current = segments[segment];
+        if (frame - current.firstFrame + SEGMENT_PREFETCH_FRAMES < current.frameCount)
+        {
+            return;
+        }
+
+        prefetchedSegment = nextSegment;
+        const std::string path = segments[nextSegment].path;
+        prefetchedContext = std::async(std::launch::async, [path]() {
+            LadybugStreamContext segmentContext = nullptr;
+            OpenSdkSegment(path, segmentContext);
+            return segmentContext;
+        });
+    }
+
+    LadybugStreamContext streamContext = nullptr;           // Reads the current segment
+    std::vector<StreamSegment> segments;
+    size_t currentSegment = 0;                              // Segment open in streamContext
+    size_t prefetchedSegment = 0;                           // Segment opened ahead of use (0 = none)
+    std::future<LadybugStreamContext> prefetchedContext;    // Stream context being opened for it
+};
+
+//=============================================================================
+// SdkNativeFrameStream - PgrStreamReader frames with an SDK image header
+//=============================================================================
+
+/**
+ * @brief Native reader frames for ladybugConvertImage
+ *
+ * Size and format come from the frame read during initialization (they are
+ * the same for the whole recording); timestamp, sequence id and image
+ * information are parsed from each frame's own image header.
+ */
+class SdkNativeFrameStream : public NativeFrameStream
+{
+public:
+    explicit SdkNativeFrameStream(const LadybugImage& imageTemplate)
+        : imageTemplate(imageTemplate)
+    {
+    }
+
+    std::unique_ptr<RawFrame> CreateFrame() const override
+    {
+        return std::unique_ptr<RawFrame>(new SdkRawFrame());
+    }
+
+    bool Read(unsigned int frame, RawFrame& raw) override
+    {
+        if (!NativeFrameStream::Read(frame, raw))
+        {
+            return false;
+        }
+
+        PgrImageInfo frameInfo;
+        if (!ParsePgrImageInfo(raw.data, raw.size, frameInfo))
+        {
+            printf("Warning: Could not read frame %u: Image header is truncated\n", frame);
+            return false;
+        }
+
+        SdkRawFrame& sdkFrame = static_cast<SdkRawFrame&>(raw);
+        sdkFrame.image = imageTemplate;
+        sdkFrame.image.pData = const_cast<unsigned char*>(raw.data);
+        sdkFrame.image.uiDataSizeBytes = static_cast<unsigned int>(raw.size);
+        sdkFrame.image.uiSeqId = frameInfo.sequenceId;
+        sdkFrame.image.timeStamp = LadybugTimestamp();
+        sdkFrame.image.timeStamp.ulSeconds = frameInfo.timeSeconds;
+        sdkFrame.image.timeStamp.ulMicroSeconds = frameInfo.timeMicroSeconds;
+
+        // Fields past the parsed ones (GPS) are not carried over from the
+        // template frame
+        LadybugImageInfo& imageInfo = sdkFrame.image.imageInfo;
+        imageInfo = LadybugImageInfo();
+        imageInfo.ulFingerprint = frameInfo.fingerprint;
+        imageInfo.ulVersion = frameInfo.version;
+        imageInfo.ulTimeSeconds = frameInfo.timeSeconds;
+        imageInfo.ulTimeMicroSeconds = frameInfo.timeMicroSeconds;
+        imageInfo.ulSequenceId = frameInfo.sequenceId;
+        imageInfo.ulHRate = frameInfo.refreshRate;
+        for (int cam = 0; cam < PGR_NUM_CAMERAS; cam++)
+        {
+            imageInfo.arulGainAdjust[cam] = frameInfo.gainAdjust[cam];
+            imageInfo.ulShutter[cam] = frameInfo.shutter[cam];
+        }
+        imageInfo.ulWhiteBalance = frameInfo.whiteBalance;
+        imageInfo.ulBayerGain = frameInfo.bayerGain;
+        imageInfo.ulBayerMap = frameInfo.bayerMap;
+        imageInfo.ulBrightness = frameInfo.brightness;
+        imageInfo.ulGamma = frameInfo.gamma;
+        imageInfo.ulSerialNum = frameInfo.serialNum;
+        return true;
+    }
+
+private:
+    LadybugImage imageTemplate;
+};
+
+//=============================================================================
+// SdkFrameConverter - ladybugConvertImage
+//=============================================================================
+
+class SdkFrameConverter : public FrameConverter
+{
+public:
+    SdkFrameConverter(LadybugContext context, const BackendOptions& options)
+        : context(context), pixelConverter(options.convertThreads, options.toneCurve)
+    {
+    }
+
+    bool Convert(const RawFrame& raw, unsigned char* const textures[NUM_CAMERAS], PixelFormat format) override
+    {
+        LadybugImage image = static_cast<const SdkRawFrame&>(raw).image;
+        LadybugError error = ladybugConvertImage(context, &image, const_cast<unsigned char**>(textures),
+                                                 GetSdkPixelFormat(format));
+        if (error != LADYBUG_OK)
+        {
+            printf("Warning: Could not convert frame %u: %s\n", raw.frameNum, ladybugErrorToString(error));
+            return false;
+        }
+        return true;
+    }
+
+    bool ReduceTo8Bit(unsigned char* const textures[NUM_CAMERAS], unsigned int cols, unsigned int rows) override
+    {
+        // Same high-byte result as ladybugConvertImageBuffersPixelFormat
+        // (BGRU16 to BGRU), but vectorized and one camera per thread
+        pixelConverter.ReduceTo8Bit(textures, cols, rows);
+        return true;
+    }
+
+private:
+    LadybugContext context;     // Owned by the backend
+    PixelConverter pixelConverter;
+};
+
+//=============================================================================
+// SdkPanoramaRenderer - ladybugRenderOffScreenImage
+//=============================================================================
+
+class SdkPanoramaRenderer : public PanoramaRenderer
+{
+public:
+    ~SdkPanoramaRenderer() override
+    {
+        if (renderContext != nullptr)
+        {
+            ladybugDestroyContext(&renderContext);
+        }
+    }
+
+    /**
+     * @brief Create and configure the panorama render context
+     *
+     * Called from the render stage thread so the off-screen OpenGL resources
+     * are created on the thread that uses them.
+     */
+    bool Initialize(const char* configPath, const BackendOptions& options, const StreamInfo& info)
+    {
+        LadybugError error;
+        stats = options.stats;
+
+        error = ladybugCreateContext(&renderContext);
+        CHECK_SDK_ERROR(error, "ladybugCreateContext (render)");
+
+        if (strlen(configPath) > 0)
+        {
+            error = ladybugLoadConfig(renderContext, configPath);
+            CHECK_SDK_ERROR(error, "ladybugLoadConfig (render)");
+        }
+
+        // Blending and alpha masks are per context; the converter's are not
+        // seen by this one
+        error = ladybugSetBlendingParams(renderContext, options.blendingWidth);
+        if (error != LADYBUG_OK)
+        {
+            printf("Warning: Could not set blending params: %s\n", ladybugErrorToString(error));
+        }
+
+        if (options.alphaMasks)
+        {
+            printf("Initializing alpha masks (this may take some time)...\n");
+            error = ladybugInitializeAlphaMasks(renderContext, info.textureWidth, info.textureHeight);
+            if (error != LADYBUG_OK)
+            {
+                printf("Warning: Could not initialize alpha masks: %s\n", ladybugErrorToString(error));
+            }
+            else
+            {
+                error = ladybugSetAlphaMasking(renderContext, true);
+                if (error != LADYBUG_OK)
+                {
+                    printf("Warning: Could not enable alpha masking: %s\n", ladybugErrorToString(error));
+                }
+            }
+        }
+
+        printf("Configure output images in Ladybug library...\n");
+        error = ladybugConfigureOutputImages(renderContext, LADYBUG_PANORAMIC);
+        CHECK_SDK_ERROR(error, "ladybugConfigureOutputImages");
+
+        printf("Set off-screen panoramic image size:%dx%d image.\n", options.panoWidth, options.panoHeight);
+        error = ladybugSetOffScreenImageSize(renderContext, LADYBUG_PANORAMIC, options.panoWidth, options.panoHeight);
+        CHECK_SDK_ERROR(error, "ladybugSetOffScreenImageSize");
+
+        // Apply rotation for panoramic images using ladybugSet3dMapRotation
+        // This rotates the 3D mesh used for panorama stitching
+        // Front = pitch (rotation around X axis)
+        // Down = yaw (rotation around Y axis)
+        if (options.rotFront != 0.0 || options.rotDown != 0.0)
+        {
+            double rotX = options.rotFront * PI / 180.0;  // Pitch (Front) in radians
+            double rotY = options.rotDown * PI / 180.0;   // Yaw (Down) in radians
+            double rotZ = 0.0;  // Roll
+
+            error = ladybugSet3dMapRotation(renderContext, rotX, rotY, rotZ);
+            if (error != LADYBUG_OK)
+            {
+                printf("Warning: Could not set 3D map rotation: %s\n", ladybugErrorToString(error));
+            }
+            else
+            {
+                printf("Applied rotation: Front=%.1f, Down=%.1f degrees\n", options.rotFront, options.rotDown);
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * The rendered image points into SDK-owned memory that is overwritten by
+     * the next render, so it is copied into the caller's buffer.
+     */
+    bool Render(const unsigned char* const textures[NUM_CAMERAS], PixelFormat format,
+                std::vector<unsigned char>& panoBuffer, ImageView& panoImage) override
+    {
+        LadybugError error;
+
+        {
+            StageTimer uploadTimer(stats, Stage::Upload);
+            error = ladybugUpdateTextures(renderContext, NUM_CAMERAS, const_cast<const unsigned char**>(textures),
+                                          GetSdkPixelFormat(format));
+        }
+        if (error != LADYBUG_OK)
+        {
+            printf("Warning: Could not update textures: %s\n", ladybugErrorToString(error));
+            return false;
+        }
+
+        LadybugProcessedImage processedImage;
+        error = ladybugRenderOffScreenImage(renderContext, LADYBUG_PANORAMIC, LADYBUG_BGR, &processedImage);
+        if (error != LADYBUG_OK)
+        {
+            printf("Error: Could not render panorama: %s\n", ladybugErrorToString(error));
+            return false;
+        }
+
+        const size_t panoBytes = static_cast<size_t>(processedImage.uiCols) * processedImage.uiRows * 3;  // BGR
+        panoBuffer.assign(processedImage.pData, processedImage.pData + panoBytes);
+
+        panoImage.data = panoBuffer.data();
+        panoImage.cols = processedImage.uiCols;
+        panoImage.rows = processedImage.uiRows;
+        panoImage.format = PixelFormat::BGR;
+        return true;
+    }
+
+private:
+    LadybugContext renderContext = nullptr;
+    RunStats* stats = nullptr;                      // Upload timer (--report)
+};
+
+//=============================================================================
+// SdkCameraModel - Calibrated projection for the CPU panorama renderer
+//=============================================================================
+
+/**
+ * @brief CameraModel from the stream's calibration
+ *
+ * A direction is placed on the panorama sphere, projected with
+ * ladybugXYZtoRC into the camera's rectified image and mapped back into the
+ * raw (distorted) image with ladybugUnrectifyPixel, then scaled to the
+ * texture size. The SDK does not document these calls as thread-safe, so
+ * tables are built on one thread.
+ */
+class SdkCameraModel : public CameraModel
+{
+public:
+    SdkCameraModel(LadybugContext context, double textureScaleX, double textureScaleY)
+        : context(context), textureScaleX(textureScaleX), textureScaleY(textureScaleY)
+    {
+    }
+
+    /**
+     * @brief Read each camera's optical axis from its extrinsics
+     */
+    bool Initialize()
+    {
+        for (int cam = 0; cam < NUM_CAMERAS; cam++)
+        {
+            // Euler angles (Rx, Ry, Rz) and translation; the optical axis is
+            // the camera's Z axis rotated by Rz * Ry * Rx
+            double extrinsics[6];
+            LadybugError error = ladybugGetCameraUnitExtrinsics(context, cam, extrinsics);
+            CHECK_SDK_ERROR(error, "ladybugGetCameraUnitExtrinsics");
+
+            const double rx = extrinsics[0];
+            const double ry = extrinsics[1];
+            const double rz = extrinsics[2];
+            opticalAxis[cam][0] = cos(rz) * sin(ry) * cos(rx) + sin(rz) * sin(rx);
+            opticalAxis[cam][1] = sin(rz) * sin(ry) * cos(rx) - cos(rz) * sin(rx);
+            opticalAxis[cam][2] = cos(ry) * cos(rx);
+        }
+        return true;
+    }
+
+    bool Project(int camera, const double direction[3], double& col, double& row) const override
+    {
+        const double* axis = opticalAxis[camera];
+        if (direction[0] * axis[0] + direction[1] * axis[1] + direction[2] * axis[2] <= 0.0)
+        {
+            return false;
+        }
+
+        double rectifiedRow = 0.0;
+        double rectifiedCol = 0.0;
+        if (ladybugXYZtoRC(context, direction[0] * PANORAMA_SPHERE_RADIUS, direction[1] * PANORAMA_SPHERE_RADIUS,
+                           direction[2] * PANORAMA_SPHERE_RADIUS, camera, &rectifiedRow, &rectifiedCol,
+                           nullptr) != LADYBUG_OK)
+        {
+            return false;
+        }
+
+        double rawRow = 0.0;
+        double rawCol = 0.0;
+        if (ladybugUnrectifyPixel(context, camera, rectifiedRow, rectifiedCol, &rawRow, &rawCol) != LADYBUG_OK)
+        {
+            return false;
+        }
+
+        col = rawCol * textureScaleX;
+        row = rawRow * textureScaleY;
+        return true;
+    }
+
+    bool IsThreadSafe() const override { return false; }
+
+private:
+    LadybugContext context;
+    double textureScaleX;
+    double textureScaleY;
+    double opticalAxis[NUM_CAMERAS][3] = {};
+};
+
+//=============================================================================
+// SdkImageWriter - ladybugSaveImage
+//=============================================================================
+
+class SdkImageWriter : public ImageWriter
+{
+public:
+    /**
+     * @brief Uses the in-tree encoders instead of ladybugSaveImage for the
+     *        formats whose options were given (JPEG needs libjpeg, PNG zlib)
+     */
+    explicit SdkImageWriter(const BackendOptions& options)
+        : jpegEncoder(options.jpeg), losslessEncoder(options.lossless),
+          nativeJpeg(options.nativeJpeg), nativeLossless(options.nativeLossless)
+    {
+    }
+
+    ~SdkImageWriter() override
+    {
+        if (saveContext != nullptr)
+        {
+            ladybugDestroyContext(&saveContext);
+        }
+    }
+
+    bool Initialize()
+    {
+        LadybugError error = ladybugCreateContext(&saveContext);
+        if (error != LADYBUG_OK)
+        {
+            printf("Error [ladybugCreateContext (encoder)]: %s\n", ladybugErrorToString(error));
+            saveContext = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    bool Save(const ImageView& image, const std::string& path, ImageFileFormat format) override
+    {
+#ifdef USE_LIBJPEG
+        if (nativeJpeg && format == ImageFileFormat::JPG)
+        {
+            return jpegEncoder.Write(image, path);
+        }
+#endif
+#ifdef USE_ZLIB
+        if (nativeLossless && format == ImageFileFormat::PNG)
+        {
+            return losslessEncoder.WritePng(image, path);
+        }
+#endif
+        if (nativeLossless && format == ImageFileFormat::TIFF)
+        {
+            return losslessEncoder.WriteTiff(image, path);
+        }
+        LadybugProcessedImage processedImage;
+        memset(&processedImage, 0, sizeof(processedImage));
+        processedImage.pData = const_cast<unsigned char*>(image.data);
+        processedImage.uiCols = image.cols;
+        processedImage.uiRows = image.rows;
+        processedImage.pixelFormat = GetSdkPixelFormat(image.format);
+
+        LadybugError error = ladybugSaveImage(saveContext, &processedImage, path.c_str(),
+                                              GetSdkFileFormat(format), false);
+        if (error != LADYBUG_OK)
+        {
+            printf("Warning: Could not save %s: %s\n", path.c_str(), ladybugErrorToString(error));
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Encodes with the in-tree encoders where they are built in;
+     *        otherwise ladybugSaveImage writes a temporary file that is read
+     *        back
+     */
+    bool Encode(const ImageView& image, const std::string& name, ImageFileFormat format,
+                std::vector<unsigned char>& data) override
+    {
+        switch (format)
+        {
+        case ImageFileFormat::BMP:
+            return EncodeBmp(image, name, data);
+#ifdef USE_LIBJPEG
+        case ImageFileFormat::JPG:
+            return jpegEncoder.Encode(image, name, data);
+#endif
+#ifdef USE_ZLIB
+        case ImageFileFormat::PNG:
+            return losslessEncoder.EncodePng(image, name, data);
+#endif
+        case ImageFileFormat::TIFF:
+            return losslessEncoder.EncodeTiff(image, name, data);
+        default:
+            break;
+        }
+
+        char tempDir[MAX_PATH];
+        char tempPath[MAX_PATH];
+        if (GetTempPathA(MAX_PATH, tempDir) == 0 || GetTempFileNameA(tempDir, "lbx", 0, tempPath) == 0)
+        {
+            printf("Warning: Could not encode %s: no temporary file\n", name.c_str());
+            return false;
+        }
+        bool encoded = Save(image, tempPath, format);
+        if (encoded)
+        {
+            FILE* file = fopen(tempPath, "rb");
+            encoded = file != nullptr && fseek(file, 0, SEEK_END) == 0;
+            const long size = encoded ? ftell(file) : -1;
+            encoded = encoded && size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+            if (encoded)
+            {
+                data.resize(static_cast<size_t>(size));
+                encoded = fread(data.data(), 1, data.size(), file) == data.size();
+            }
+            if (file != nullptr)
+            {
+                fclose(file);
+            }
+            if (!encoded)
+            {
+                printf("Warning: Could not read back %s\n", name.c_str());
+            }
+        }
+        DeleteFileA(tempPath);
+        return encoded;
+    }
+
+private:
+    LadybugContext saveContext = nullptr;
+    JpegEncoder jpegEncoder;
+    LosslessEncoder losslessEncoder;
+    bool nativeJpeg;
+    bool nativeLossless;
+};
+
+//=============================================================================
+// SdkBackend
+//=============================================================================
+
+class SdkBackend : public ImagingBackend
+{
+public:
+    ~SdkBackend() override
+    {
+        if (streamContext != nullptr)
+        {
+            ladybugDestroyStreamContext(&streamContext);
+        }
+        if (context != nullptr)
+        {
+            ladybugDestroyContext(&context);
+        }
+        if (strlen(tempConfigPath) > 0)
+        {
+            remove(tempConfigPath);
+        }
+    }
+
+    const char* Name() const override { return "sdk"; }
+
+    bool Initialize(std::vector<StreamSegment>& streamSegments, const BackendOptions& backendOptions,
+                    StreamInfo& info) override
+    {
+        LadybugError error;
+        options = backendOptions;
+
+        printf("Initializing Ladybug SDK...\n");
+#ifndef USE_LIBJPEG
+        if (options.nativeJpeg)
+        {
+            printf("Warning: --jpeg-* options need a build with libjpeg; ladybugSaveImage encodes JPEG\n");
+        }
+#endif
+#ifndef USE_ZLIB
+        if (options.nativeLossless)
+        {
+            printf("Warning: PNG encoder options need a build with zlib; ladybugSaveImage encodes PNG\n");
+        }
+#endif
+
+        // Create contexts
+        error = ladybugCreateContext(&context);
+        CHECK_SDK_ERROR(error, "ladybugCreateContext");
+
+        error = ladybugCreateStreamContext(&streamContext);
+        CHECK_SDK_ERROR(error, "ladybugCreateStreamContext");
+
+        // Open stream file (the first segment of the recording set)
+        const std::string& streamFile = streamSegments.front().path;
+        printf("Opening stream file: %s\n", streamFile.c_str());
+        error = ladybugInitializeStreamForReading(streamContext, streamFile.c_str(), true);
+        CHECK_SDK_ERROR(error, "ladybugInitializeStreamForReading");
+
+        // Extract config file
+        char* tempFile = _tempnam(NULL, "lb_cfg_");
+        if (tempFile != NULL)
+        {
+            strncpy_s(tempConfigPath, tempFile, MAX_PATH);
+            free(tempFile);
+
+            error = ladybugGetStreamConfigFile(streamContext, tempConfigPath);
+            if (error != LADYBUG_OK)
+            {
+                printf("Warning: Could not extract config file: %s\n", ladybugErrorToString(error));
+                tempConfigPath[0] = '\0';
+            }
+        }
+
+        // Load configuration (the file is kept until cleanup so the render
+        // stage can load it into its own context)
+        if (strlen(tempConfigPath) > 0)
+        {
+            error = ladybugLoadConfig(context, tempConfigPath);
+            CHECK_SDK_ERROR(error, "ladybugLoadConfig");
+        }
+
+        // Get stream header
+        LadybugStreamHeadInfo streamHeaderInfo;
+        error = ladybugGetStreamHeader(streamContext, &streamHeaderInfo);
+        CHECK_SDK_ERROR(error, "ladybugGetStreamHeader");
+
+        info.serialBase = streamHeaderInfo.serialBase;
+        info.serialHead = streamHeaderInfo.serialHead;
+        info.frameRate = (streamHeaderInfo.ulLadybugStreamVersion < 7)
+            ? (float)streamHeaderInfo.ulFrameRate
+            : streamHeaderInfo.frameRate;
+        info.dataFormat = streamHeaderInfo.dataFormat;
+        info.resolution = streamHeaderInfo.resolution;
+        info.streamVersion = static_cast<unsigned int>(streamHeaderInfo.ulLadybugStreamVersion);
+        info.highBitDepth = IsHighBitDepthFormat(streamHeaderInfo.dataFormat);
+
+        // Set color processing method
+        printf("Setting debayering method...\n");
+        error = ladybugSetColorProcessingMethod(context, GetSdkColorMethod(options.colorMethod));
+        CHECK_SDK_ERROR(error, "ladybugSetColorProcessingMethod");
+
+        // Read one image to get dimensions
+        error = ladybugReadImageFromStream(streamContext, &imageTemplate);
+        CHECK_SDK_ERROR(error, "ladybugReadImageFromStream (initial)");
+
+        info.imageCols = imageTemplate.uiCols;
+        info.imageRows = imageTemplate.uiRows;
+        GetTextureSize(options.colorMethod, info.imageCols, info.imageRows, info.textureWidth, info.textureHeight);
+
+        // Alpha masks of the exported camera images; panoramas get theirs
+        // in the render context (the CPU renderer blends with the weights
+        // of its remap table instead)
+        if (options.cameraAlphaMasks)
+        {
+            error = ladybugSetBlendingParams(context, options.blendingWidth);
+            if (error != LADYBUG_OK)
+            {
+                printf("Warning: Could not set blending params: %s\n", ladybugErrorToString(error));
+            }
+
+            printf("Initializing alpha masks (this may take some time)...\n");
+            error = ladybugInitializeAlphaMasks(context, info.textureWidth, info.textureHeight);
+            if (error != LADYBUG_OK)
+            {
+                printf("Warning: Could not initialize alpha masks: %s\n", ladybugErrorToString(error));
+            }
+
+            error = ladybugSetAlphaMasking(context, true);
+            if (error != LADYBUG_OK)
+            {
+                printf("Warning: Could not enable alpha masking: %s\n", ladybugErrorToString(error));
+            }
+        }
+        else if (!options.alphaMasks)
+        {
+            printf("Skipping alpha masks (not used by the CPU renderer)\n");
+        }
+
+        // Rewind stream
+        error = ladybugGoToImage(streamContext, 0);
+        CHECK_SDK_ERROR(error, "ladybugGoToImage (rewind)");
+
+        // Count the frames of every segment
+        if (!InitializeSegments(streamSegments))
+        {
+            return false;
+        }
+        segments = streamSegments;
+        streamInfo = info;
+        return true;
+    }
+
+    std::unique_ptr<FrameStream> CreateStream() override
+    {
+        if (options.nativeReader)
+        {
+            return std::move(nativeStream);
+        }
+
+        // The stream context opened by Initialize moves to the stream
+        std::unique_ptr<FrameStream> stream(new SdkFrameStream(streamContext, segments));
+        streamContext = nullptr;
+        return stream;
+    }
+
+    std::unique_ptr<FrameConverter> CreateConverter() override
+    {
+        return std::unique_ptr<FrameConverter>(new SdkFrameConverter(context, options));
+    }
+
+    std::unique_ptr<PanoramaRenderer> CreateRenderer() override
+    {
+        if (options.cpuRenderer)
+        {
+            if (panoramaLut == nullptr && !BuildCpuPanoramaLut())
+            {
+                return nullptr;
+            }
+            return std::unique_ptr<PanoramaRenderer>(new LutPanoramaRenderer(panoramaLut, options.renderThreads));
+        }
+
+        std::unique_ptr<SdkPanoramaRenderer> renderer(new SdkPanoramaRenderer());
+        if (!renderer->Initialize(tempConfigPath, options, streamInfo))
+        {
+            return nullptr;
+        }
+        return renderer;
+    }
+
+    std::unique_ptr<ImageWriter> CreateWriter() override
+    {
+        std::unique_ptr<SdkImageWriter> writer(new SdkImageWriter(options));
+        if (!writer->Initialize())
+        {
+            return nullptr;
+        }
+        return writer;
+    }
+
+private:
+    /**
+     * @brief Build the CPU renderer's remap table from the stream's calibration
+     *
+     * Uses a context of its own: the converter's context is in use on the
+     * convert thread.
+     */
+    bool BuildCpuPanoramaLut()
+    {
+        if (strlen(tempConfigPath) == 0)
+        {
+            printf("Error: The CPU renderer needs the stream's calibration file\n");
+            return false;
+        }
+
+        PanoramaLutParams params;
+        params.panoWidth = static_cast<unsigned int>(options.panoWidth);
+        params.panoHeight = static_cast<unsigned int>(options.panoHeight);
+        params.textureWidth = streamInfo.textureWidth;
+        params.textureHeight = streamInfo.textureHeight;
+        params.rotFront = options.rotFront;
+        params.rotDown = options.rotDown;
+        params.blendingWidth = static_cast<double>(options.blendingWidth) * streamInfo.textureWidth /
+                               streamInfo.imageCols;
+
+        PanoramaLutKey key;
+        key.serialHead = streamInfo.serialHead;
+        if (!HashConfigFile(tempConfigPath, key.calibrationHash))
+        {
+            printf("Error: Could not read calibration file %s\n", tempConfigPath);
+            return false;
+        }
+
+        printf("Rendering panoramas on the CPU (stream calibration)\n");
+        panoramaLut = LoadCachedPanoramaLut(options.cacheDir, key, params);
+        if (panoramaLut != nullptr)
+        {
+            return true;
+        }
+
+        LadybugContext geometryContext = nullptr;
+        LadybugError error = ladybugCreateContext(&geometryContext);
+        CHECK_SDK_ERROR(error, "ladybugCreateContext (geometry)");
+
+        error = ladybugLoadConfig(geometryContext, tempConfigPath);
+        if (error != LADYBUG_OK)
+        {
+            printf("Error [ladybugLoadConfig (geometry)]: %s\n", ladybugErrorToString(error));
+        }
+        else
+        {
+            SdkCameraModel model(geometryContext,
+                                 static_cast<double>(streamInfo.textureWidth) / streamInfo.imageCols,
+                                 static_cast<double>(streamInfo.textureHeight) / streamInfo.imageRows);
+            if (model.Initialize())
+            {
+                panoramaLut = BuildPanoramaLut(model, params, 1);
+                SaveCachedPanoramaLut(options.cacheDir, key, *panoramaLut);
+            }
+        }
+
+        ladybugDestroyContext(&geometryContext);
+        return panoramaLut != nullptr;
+    }
+
+    /**
+     * @brief Count the frames of each segment and number them globally
+     *
+     * The SDK and alpha masks are only initialized once, from the first
+     * segment; the other segments are only opened to count their frames (SDK
+     * reader) or mapped and indexed (native reader).
+     */
+    bool InitializeSegments(std::vector<StreamSegment>& streamSegments)
+    {
+        LadybugError error;
+
+        if (options.nativeReader)
+        {
+            // The SDK stream context is still used for the configuration and
+            // the initial image header
+            nativeStream.reset(new SdkNativeFrameStream(imageTemplate));
+            return nativeStream->Open(streamSegments);
+        }
+
+        for (size_t i = 0; i < streamSegments.size(); i++)
+        {
+            StreamSegment& segment = streamSegments[i];
+
+            if (i == 0)
+            {
+                error = ladybugGetStreamNumOfImages(streamContext, &segment.frameCount);
+                CHECK_SDK_ERROR(error, "ladybugGetStreamNumOfImages");
+                continue;
+            }
+
+            LadybugStreamContext segmentContext = nullptr;
+            error = OpenSdkSegment(segment.path, segmentContext);
+            if (error == LADYBUG_OK)
+            {
+                error = ladybugGetStreamNumOfImages(segmentContext, &segment.frameCount);
+                ladybugDestroyStreamContext(&segmentContext);
+            }
+            if (error != LADYBUG_OK)
+            {
+                printf("Error [ladybugInitializeStreamForReading (segment)]: %s: %s\n",
+                       segment.path.c_str(), ladybugErrorToString(error));
+                return false;
+            }
+        }
+
+        NumberStreamSegments(streamSegments);
+        return true;
+    }
+
+    BackendOptions options;
+    LadybugContext context = nullptr;               // Convert stage (debayer, alpha masks)
+    LadybugStreamContext streamContext = nullptr;   // Until CreateStream takes it
+    LadybugImage imageTemplate = {};                // First frame (header fields for the native reader)
+    std::vector<StreamSegment> segments;
+    std::unique_ptr<SdkNativeFrameStream> nativeStream;
+    StreamInfo streamInfo;
+    std::shared_ptr<const PanoramaLut> panoramaLut;         // CPU renderer (--renderer cpu)
+    char tempConfigPath[MAX_PATH] = {0};
+};
+
+std::unique_ptr<ImagingBackend> CreateSdkBackend()
+{
+    return std::unique_ptr<ImagingBackend>(new SdkBackend());
+}
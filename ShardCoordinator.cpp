@@ -0,0 +1,710 @@
+//=============================================================================
+// ShardCoordinator - Split a frame range across worker processes
+//=============================================================================
+
+#include "ShardCoordinator.h"
+#include "BoundedQueue.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+// A chunk is given to at most this many workers before its frames count as failed
+constexpr unsigned int MAX_CHUNK_ATTEMPTS = 2;
+
+// Coordinator event queue size (worker output is read in the background)
+constexpr size_t SHARD_EVENT_QUEUE_SIZE = 1024;
+
+//=============================================================================
+// Worker Process
+//=============================================================================
+
+/**
+ * @brief Child process with its stdin and stdout connected to pipes
+ */
+class WorkerProcess
+{
+public:
+    WorkerProcess() = default;
+    ~WorkerProcess();
+
+    WorkerProcess(const WorkerProcess&) = delete;
+    WorkerProcess& operator=(const WorkerProcess&) = delete;
+
+    bool Start(const std::vector<std::string>& command);
+    bool WriteLine(const std::string& line);
+    bool ReadLine(std::string& line);
+    void CloseInput();
+    int Wait();
+
+private:
+    bool ReadMore();
+
+    std::string readBuffer;
+    bool endOfOutput = false;
+#ifdef _WIN32
+    HANDLE process = NULL;
+    HANDLE inputWrite = NULL;
+    HANDLE outputRead = NULL;
+#else
+    pid_t pid = -1;
+    int inputFd = -1;
+    int outputFd = -1;
+#endif
+};
+
+bool WorkerProcess::ReadLine(std::string& line)
+{
+    for (;;)
+    {
+        size_t newline = readBuffer.find('\n');
+        if (newline != std::string::npos)
+        {
+            line = readBuffer.substr(0, newline);
+            readBuffer.erase(0, newline + 1);
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            return true;
+        }
+
+        if (endOfOutput || !ReadMore())
+        {
+            endOfOutput = true;
+            if (readBuffer.empty())
+            {
+                return false;
+            }
+            line.swap(readBuffer);
+            readBuffer.clear();
+            return true;
+        }
+    }
+}
+
+#ifdef _WIN32
+
+/**
+ * @brief Quote one argument for CreateProcess (MSVC runtime rules)
+ */
+static std::string QuoteArgument(const std::string& arg)
+{
+    if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos)
+    {
+        return arg;
+    }
+
+    std::string quoted = "\"";
+    size_t backslashes = 0;
+    for (char c : arg)
+    {
+        if (c == '\\')
+        {
+            backslashes++;
+            continue;
+        }
+        if (c == '"')
+        {
+            quoted.append(backslashes * 2 + 1, '\\');
+        }
+        else
+        {
+            quoted.append(backslashes, '\\');
+        }
+        backslashes = 0;
+        quoted += c;
+    }
+    quoted.append(backslashes * 2, '\\');
+    quoted += '"';
+    return quoted;
+}
+
+WorkerProcess::~WorkerProcess()
+{
+    CloseInput();
+    if (outputRead != NULL)
+    {
+        CloseHandle(outputRead);
+    }
+    if (process != NULL)
+    {
+        CloseHandle(process);
+    }
+}
+
+bool WorkerProcess::Start(const std::vector<std::string>& command)
+{
+    SECURITY_ATTRIBUTES security = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+    HANDLE inputRead = NULL;
+    HANDLE outputWrite = NULL;
+
+    if (!CreatePipe(&inputRead, &inputWrite, &security, 0))
+    {
+        return false;
+    }
+    if (!CreatePipe(&outputRead, &outputWrite, &security, 0))
+    {
+        CloseHandle(inputRead);
+        CloseHandle(inputWrite);
+        inputWrite = NULL;
+        return false;
+    }
+
+    // Only the child's ends of the pipes are inherited
+    SetHandleInformation(inputWrite, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(outputRead, HANDLE_FLAG_INHERIT, 0);
+
+    std::string commandLine;
+    for (const std::string& arg : command)
+    {
+        if (!commandLine.empty())
+        {
+            commandLine += ' ';
+        }
+        commandLine += QuoteArgument(arg);
+    }
+
+    STARTUPINFOA startup;
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = inputRead;
+    startup.hStdOutput = outputWrite;
+    startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+    PROCESS_INFORMATION info;
+    BOOL created = CreateProcessA(NULL, &commandLine[0], NULL, NULL, TRUE, 0, NULL, NULL, &startup, &info);
+
+    CloseHandle(inputRead);
+    CloseHandle(outputWrite);
+    if (!created)
+    {
+        return false;
+    }
+
+    CloseHandle(info.hThread);
+    process = info.hProcess;
+    return true;
+}
+
+bool WorkerProcess::WriteLine(const std::string& line)
+{
+    if (inputWrite == NULL)
+    {
+        return false;
+    }
+
+    const std::string data = line + "\n";
+    DWORD written = 0;
+    return WriteFile(inputWrite, data.data(), (DWORD)data.size(), &written, NULL) && written == data.size();
+}
+
+bool WorkerProcess::ReadMore()
+{
+    char buffer[4096];
+    DWORD bytesRead = 0;
+    if (!ReadFile(outputRead, buffer, sizeof(buffer), &bytesRead, NULL) || bytesRead == 0)
+    {
+        return false;
+    }
+    readBuffer.append(buffer, bytesRead);
+    return true;
+}
+
+void WorkerProcess::CloseInput()
+{
+    if (inputWrite != NULL)
+    {
+        CloseHandle(inputWrite);
+        inputWrite = NULL;
+    }
+}
+
+int WorkerProcess::Wait()
+{
+    if (process == NULL)
+    {
+        return -1;
+    }
+
+    DWORD exitCode = 0;
+    WaitForSingleObject(process, INFINITE);
+    GetExitCodeProcess(process, &exitCode);
+    return (int)exitCode;
+}
+
+#else
+
+WorkerProcess::~WorkerProcess()
+{
+    CloseInput();
+    if (outputFd >= 0)
+    {
+        close(outputFd);
+    }
+}
+
+bool WorkerProcess::Start(const std::vector<std::string>& command)
+{
+    if (command.empty())
+    {
+        return false;
+    }
+
+    int inputPipe[2];
+    int outputPipe[2];
+    if (pipe(inputPipe) != 0)
+    {
+        return false;
+    }
+    if (pipe(outputPipe) != 0)
+    {
+        close(inputPipe[0]);
+        close(inputPipe[1]);
+        return false;
+    }
+
+    // Keep the coordinator's ends out of other workers
+    fcntl(inputPipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(outputPipe[0], F_SETFD, FD_CLOEXEC);
+
+    std::vector<char*> argv;
+    for (const std::string& arg : command)
+    {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid = fork();
+    if (pid == 0)
+    {
+        dup2(inputPipe[0], STDIN_FILENO);
+        dup2(outputPipe[1], STDOUT_FILENO);
+        close(inputPipe[0]);
+        close(outputPipe[1]);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    close(inputPipe[0]);
+    close(outputPipe[1]);
+    if (pid < 0)
+    {
+        close(inputPipe[1]);
+        close(outputPipe[0]);
+        return false;
+    }
+
+    inputFd = inputPipe[1];
+    outputFd = outputPipe[0];
+    return true;
+}
+
+bool WorkerProcess::WriteLine(const std::string& line)
+{
+    if (inputFd < 0)
+    {
+        return false;
+    }
+
+    const std::string data = line + "\n";
+    size_t offset = 0;
+    while (offset < data.size())
+    {
+        ssize_t written = write(inputFd, data.data() + offset, data.size() - offset);
+        if (written <= 0)
+        {
+            return false;
+        }
+        offset += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool WorkerProcess::ReadMore()
+{
+    char buffer[4096];
+    ssize_t bytesRead = read(outputFd, buffer, sizeof(buffer));
+    if (bytesRead <= 0)
+    {
+        return false;
+    }
+    readBuffer.append(buffer, static_cast<size_t>(bytesRead));
+    return true;
+}
+
+void WorkerProcess::CloseInput()
+{
+    if (inputFd >= 0)
+    {
+        close(inputFd);
+        inputFd = -1;
+    }
+}
+
+int WorkerProcess::Wait()
+{
+    if (pid <= 0)
+    {
+        return -1;
+    }
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid)
+    {
+        return -1;
+    }
+    pid = -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+#endif
+
+//=============================================================================
+// Coordinator
+//=============================================================================
+
+enum class ShardEventType
+{
+    Ready,      // Worker initialized (value1 = total frames)
+    Done,       // Chunk finished (value1..value2 = frames, value3 = failed)
+    Log,        // Any other output line
+    Exited      // Worker process ended (exitCode)
+};
+
+struct ShardEvent
+{
+    ShardEventType type = ShardEventType::Log;
+    unsigned int shard = 0;
+    unsigned int value1 = 0;
+    unsigned int value2 = 0;
+    unsigned int value3 = 0;
+    int exitCode = 0;
+    std::string text;
+};
+
+struct ShardChunk
+{
+    unsigned int firstFrame = 0;
+    unsigned int lastFrame = 0;
+    unsigned int attempts = 0;
+};
+
+struct ShardWorker
+{
+    WorkerProcess process;
+    std::thread outputThread;
+    bool alive = false;
+    bool idle = false;          // Waiting for a chunk
+    bool busy = false;          // Working on 'chunk'
+    ShardChunk chunk;
+};
+
+/**
+ * @brief Forward a worker's output to the coordinator as events
+ */
+static void ReadWorkerOutput(ShardWorker& worker, unsigned int shard, BoundedQueue<ShardEvent>& events)
+{
+    const size_t prefixLength = strlen(SHARD_MESSAGE_PREFIX);
+    std::string line;
+
+    while (worker.process.ReadLine(line))
+    {
+        ShardEvent event;
+        event.shard = shard;
+
+        if (line.compare(0, prefixLength, SHARD_MESSAGE_PREFIX) == 0)
+        {
+            const char* message = line.c_str() + prefixLength;
+            if (sscanf(message, "READY %u", &event.value1) == 1)
+            {
+                event.type = ShardEventType::Ready;
+            }
+            else if (sscanf(message, "DONE %u %u %u", &event.value1, &event.value2, &event.value3) == 3)
+            {
+                event.type = ShardEventType::Done;
+            }
+            else
+            {
+                event.text = line;
+            }
+        }
+        else
+        {
+            event.text = line;
+        }
+
+        events.Push(event);
+    }
+
+    ShardEvent exited;
+    exited.type = ShardEventType::Exited;
+    exited.shard = shard;
+    exited.exitCode = worker.process.Wait();
+    events.Push(exited);
+}
+
+static bool SendChunk(ShardWorker& worker, const ShardChunk& chunk)
+{
+    char message[64];
+    snprintf(message, sizeof(message), "%sCHUNK %u %u", SHARD_MESSAGE_PREFIX, chunk.firstFrame, chunk.lastFrame);
+
+    worker.chunk = chunk;
+    worker.chunk.attempts++;
+    worker.busy = true;
+    worker.idle = false;
+
+    // On failure the worker's exit event puts the chunk back in the queue
+    return worker.process.WriteLine(message);
+}
+
+static void SendQuit(ShardWorker& worker)
+{
+    worker.process.WriteLine(std::string(SHARD_MESSAGE_PREFIX) + "QUIT");
+    worker.process.CloseInput();
+    worker.idle = false;
+}
+
+bool RunShardCoordinator(const ShardOptions& options, ShardResult& result)
+{
+    result = ShardResult();
+
+#ifndef _WIN32
+    // A worker that dies must not take the coordinator down with SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    const unsigned int numShards = options.numShards > 0 ? options.numShards : 1;
+    const unsigned int chunkFrames = options.chunkFrames > 0 ? options.chunkFrames : DEFAULT_SHARD_CHUNK;
+
+    BoundedQueue<ShardEvent> events(SHARD_EVENT_QUEUE_SIZE);
+    std::vector<std::unique_ptr<ShardWorker>> workers;
+    unsigned int liveWorkers = 0;
+
+    printf("Starting %u shard workers...\n", numShards);
+    for (unsigned int shard = 0; shard < numShards; shard++)
+    {
+        std::unique_ptr<ShardWorker> worker(new ShardWorker());
+        if (worker->process.Start(options.workerCommand))
+        {
+            worker->alive = true;
+            worker->outputThread = std::thread(ReadWorkerOutput, std::ref(*worker), shard, std::ref(events));
+            liveWorkers++;
+        }
+        else
+        {
+            printf("Error: Could not start shard worker %u\n", shard);
+            result.workersFailed++;
+        }
+        workers.push_back(std::move(worker));
+    }
+
+    std::deque<ShardChunk> pending;
+    bool rangeKnown = false;
+    unsigned int chunksOutstanding = 0;
+
+    ShardEvent event;
+    while (liveWorkers > 0 && events.Pop(event))
+    {
+        ShardWorker& worker = *workers[event.shard];
+
+        switch (event.type)
+        {
+        case ShardEventType::Log:
+            printf("[shard %u] %s\n", event.shard, event.text.c_str());
+            break;
+
+        case ShardEventType::Ready:
+            if (!rangeKnown)
+            {
+                // The first worker to open the stream defines the frame range
+                const unsigned int totalFrames = event.value1;
+                unsigned int startFrame = options.processAllFrames ? 0 : options.startFrame;
+                unsigned int endFrame = options.processAllFrames ? totalFrames - 1 : options.endFrame;
+                if (totalFrames > 0 && endFrame >= totalFrames)
+                {
+                    endFrame = totalFrames - 1;
+                }
+
+                if (totalFrames > 0 && startFrame <= endFrame)
+                {
+                    for (unsigned int first = startFrame; first <= endFrame; first += chunkFrames)
+                    {
+                        ShardChunk chunk;
+                        chunk.firstFrame = first;
+                        chunk.lastFrame = std::min(endFrame, first + chunkFrames - 1);
+                        pending.push_back(chunk);
+                        if (chunk.lastFrame == endFrame)
+                        {
+                            break;
+                        }
+                    }
+                    result.totalFrames = endFrame - startFrame + 1;
+                }
+
+                printf("Sharding %u frames in %zu chunks of up to %u frames\n",
+                       result.totalFrames, pending.size(), chunkFrames);
+                rangeKnown = true;
+            }
+            worker.idle = true;
+            break;
+
+        case ShardEventType::Done:
+        {
+            const unsigned int frames = event.value2 - event.value1 + 1;
+            const unsigned int failed = std::min(event.value3, frames);
+            result.framesDone += frames - failed;
+            result.framesFailed += failed;
+            worker.busy = false;
+            worker.idle = true;
+            chunksOutstanding--;
+
+            const unsigned int finished = result.framesDone + result.framesFailed;
+            printf("Progress: %u/%u frames (%.1f%%), %u failed\n", finished, result.totalFrames,
+                   result.totalFrames > 0 ? 100.0 * finished / result.totalFrames : 100.0,
+                   result.framesFailed);
+            break;
+        }
+
+        case ShardEventType::Exited:
+            worker.alive = false;
+            worker.idle = false;
+            liveWorkers--;
+            worker.outputThread.join();
+
+            if (event.exitCode != 0 || worker.busy)
+            {
+                printf("Warning: Shard worker %u exited with code %d\n", event.shard, event.exitCode);
+                result.workersFailed++;
+            }
+
+            if (worker.busy)
+            {
+                worker.busy = false;
+                chunksOutstanding--;
+
+                const unsigned int frames = worker.chunk.lastFrame - worker.chunk.firstFrame + 1;
+                if (worker.chunk.attempts < MAX_CHUNK_ATTEMPTS)
+                {
+                    printf("Warning: Reassigning frames %u-%u\n", worker.chunk.firstFrame, worker.chunk.lastFrame);
+                    pending.push_front(worker.chunk);
+                    result.chunksRetried++;
+                }
+                else
+                {
+                    printf("Error: Frames %u-%u failed on %u workers\n",
+                           worker.chunk.firstFrame, worker.chunk.lastFrame, worker.chunk.attempts);
+                    result.framesFailed += frames;
+                }
+            }
+            break;
+        }
+
+        if (!rangeKnown)
+        {
+            continue;
+        }
+
+        // Hand out work to idle workers; once nothing is left or in flight, let them go
+        for (std::unique_ptr<ShardWorker>& candidate : workers)
+        {
+            if (!candidate->alive || !candidate->idle)
+            {
+                continue;
+            }
+
+            if (!pending.empty())
+            {
+                ShardChunk chunk = pending.front();
+                pending.pop_front();
+                chunksOutstanding++;
+                SendChunk(*candidate, chunk);
+            }
+            else if (chunksOutstanding == 0)
+            {
+                SendQuit(*candidate);
+            }
+        }
+    }
+
+    // Every worker is gone; whatever was never assigned is lost
+    for (const ShardChunk& chunk : pending)
+    {
+        result.framesFailed += chunk.lastFrame - chunk.firstFrame + 1;
+    }
+    if (!rangeKnown && result.workersFailed > 0)
+    {
+        printf("Error: No shard worker could open the stream\n");
+    }
+
+    for (std::unique_ptr<ShardWorker>& worker : workers)
+    {
+        if (worker->outputThread.joinable())
+        {
+            worker->outputThread.join();
+        }
+    }
+
+    return rangeKnown && result.framesFailed == 0 && result.framesDone == result.totalFrames;
+}
+
+//=============================================================================
+// Worker side of the protocol
+//=============================================================================
+
+void SendShardReady(unsigned int totalFrames)
+{
+    printf("%sREADY %u\n", SHARD_MESSAGE_PREFIX, totalFrames);
+    fflush(stdout);
+}
+
+bool ReceiveShardChunk(unsigned int& firstFrame, unsigned int& lastFrame)
+{
+    const size_t prefixLength = strlen(SHARD_MESSAGE_PREFIX);
+    char line[256];
+
+    while (fgets(line, sizeof(line), stdin) != nullptr)
+    {
+        if (strncmp(line, SHARD_MESSAGE_PREFIX, prefixLength) != 0)
+        {
+            continue;
+        }
+
+        const char* message = line + prefixLength;
+        if (sscanf(message, "CHUNK %u %u", &firstFrame, &lastFrame) == 2 && firstFrame <= lastFrame)
+        {
+            return true;
+        }
+        if (strncmp(message, "QUIT", 4) == 0)
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+void SendShardDone(unsigned int firstFrame, unsigned int lastFrame, unsigned int failedFrames)
+{
+    fflush(stdout);
+    printf("%sDONE %u %u %u\n", SHARD_MESSAGE_PREFIX, firstFrame, lastFrame, failedFrames);
+    fflush(stdout);
+}
@@ -0,0 +1,75 @@
+//=============================================================================
+// ShardCoordinator - Split a frame range across worker processes
+//
+// With --shards N the exporter becomes a coordinator: it launches N copies of
+// itself as workers (each with its own SDK context), hands out chunks of
+// frames to whichever worker is idle, and aggregates their progress and
+// failures. Workers talk to the coordinator over stdin/stdout with one-line
+// messages prefixed by SHARD_MESSAGE_PREFIX; any other output of a worker is
+// forwarded to the coordinator's console, tagged with the shard number.
+//
+//   worker      -> coordinator   @@LBX READY <totalFrames>
+//   coordinator -> worker        @@LBX CHUNK <firstFrame> <lastFrame>
+//   worker      -> coordinator   @@LBX DONE <firstFrame> <lastFrame> <failedFrames>
+//   coordinator -> worker        @@LBX QUIT
+//
+// The coordinator has no SDK dependency, so it can be exercised on Linux
+// with a stub worker that speaks the same protocol.
+//=============================================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Default number of frames handed to a worker at a time
+constexpr unsigned int DEFAULT_SHARD_CHUNK = 32;
+
+// Prefix of protocol lines on the workers' stdin/stdout
+constexpr const char* SHARD_MESSAGE_PREFIX = "@@LBX ";
+
+struct ShardOptions
+{
+    std::vector<std::string> workerCommand;     // Program and arguments of a worker
+    unsigned int numShards = 1;
+    unsigned int chunkFrames = DEFAULT_SHARD_CHUNK;
+
+    bool processAllFrames = true;               // Otherwise startFrame..endFrame
+    unsigned int startFrame = 0;
+    unsigned int endFrame = 0;                  // Inclusive
+};
+
+struct ShardResult
+{
+    unsigned int totalFrames = 0;               // Frames in the requested range
+    unsigned int framesDone = 0;                // Frames exported successfully
+    unsigned int framesFailed = 0;              // Frames reported failed or lost
+    unsigned int chunksRetried = 0;             // Chunks reassigned after a worker died
+    unsigned int workersFailed = 0;             // Workers that exited abnormally
+};
+
+/**
+ * @brief Run the coordinator until every chunk is done or all workers exit
+ * @return true if every frame in the range was exported
+ */
+bool RunShardCoordinator(const ShardOptions& options, ShardResult& result);
+
+//=============================================================================
+// Worker side of the protocol
+//=============================================================================
+
+/**
+ * @brief Tell the coordinator the worker is initialized
+ */
+void SendShardReady(unsigned int totalFrames);
+
+/**
+ * @brief Wait for the next chunk of frames
+ * @return false when the coordinator says QUIT or closes the pipe
+ */
+bool ReceiveShardChunk(unsigned int& firstFrame, unsigned int& lastFrame);
+
+/**
+ * @brief Report a finished chunk
+ */
+void SendShardDone(unsigned int firstFrame, unsigned int lastFrame, unsigned int failedFrames);
@@ -0,0 +1,444 @@
+//=============================================================================
+// SharedRing - Raw frames in a shared-memory ring buffer (--shm-ring)
+//=============================================================================
+
+#include "SharedRing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+// Polls of a counter before a waiting side starts to sleep between them
+constexpr unsigned int SPIN_POLLS = 64;
+constexpr std::chrono::microseconds POLL_SLEEP(100);
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+static size_t AlignUp(size_t value)
+{
+    return (value + SHARED_RING_ALIGNMENT - 1) / SHARED_RING_ALIGNMENT * SHARED_RING_ALIGNMENT;
+}
+
+/**
+ * @brief Wait before polling a counter again: spin first, then sleep
+ */
+static void WaitToPoll(unsigned int& polls)
+{
+    if (++polls < SPIN_POLLS)
+    {
+        std::this_thread::yield();
+    }
+    else
+    {
+        std::this_thread::sleep_for(POLL_SLEEP);
+    }
+}
+
+static SharedRingSlot* GetSlot(const SharedRingHeader* header, uint64_t frame)
+{
+    unsigned char* base = const_cast<unsigned char*>(reinterpret_cast<const unsigned char*>(header));
+    const size_t offset = AlignUp(sizeof(SharedRingHeader)) + (frame % header->slotCount) * header->slotBytes;
+    return reinterpret_cast<SharedRingSlot*>(base + offset);
+}
+
+static size_t GetImageOffset(const SharedRingHeader* header, unsigned int image)
+{
+    return AlignUp(sizeof(SharedRingSlot)) + image * AlignUp(header->imageBytes);
+}
+
+//=============================================================================
+// SharedMemory
+//=============================================================================
+
+SharedMemory::~SharedMemory()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool SharedMemory::Create(const std::string& memoryName, size_t memorySize)
+{
+    Close();
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                        static_cast<DWORD>(static_cast<uint64_t>(memorySize) >> 32),
+                                        static_cast<DWORD>(memorySize), memoryName.c_str());
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, memorySize);
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    name = memoryName;
+    mappingHandle = mapping;
+    data = static_cast<unsigned char*>(view);
+    size = memorySize;
+    created = true;
+    return true;
+}
+
+bool SharedMemory::Open(const std::string& memoryName)
+{
+    Close();
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, memoryName.c_str());
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (view == nullptr || VirtualQuery(view, &info, sizeof(info)) == 0)
+    {
+        if (view != nullptr)
+        {
+            UnmapViewOfFile(view);
+        }
+        CloseHandle(mapping);
+        return false;
+    }
+    name = memoryName;
+    mappingHandle = mapping;
+    data = static_cast<unsigned char*>(view);
+    size = info.RegionSize;
+    created = false;
+    return true;
+}
+
+void SharedMemory::Close()
+{
+    // The mapping disappears with its last handle
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle != nullptr)
+    {
+        CloseHandle(mappingHandle);
+    }
+    data = nullptr;
+    size = 0;
+    mappingHandle = nullptr;
+    created = false;
+}
+
+#else
+
+bool SharedMemory::Create(const std::string& memoryName, size_t memorySize)
+{
+    Close();
+    shm_unlink(memoryName.c_str());
+    const int fd = shm_open(memoryName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        return false;
+    }
+    void* view = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(memorySize)) == 0)
+    {
+        view = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        shm_unlink(memoryName.c_str());
+        return false;
+    }
+    name = memoryName;
+    data = static_cast<unsigned char*>(view);
+    size = memorySize;
+    created = true;
+    return true;
+}
+
+bool SharedMemory::Open(const std::string& memoryName)
+{
+    Close();
+    const int fd = shm_open(memoryName.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && status.st_size > 0)
+    {
+        view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+    name = memoryName;
+    data = static_cast<unsigned char*>(view);
+    size = static_cast<size_t>(status.st_size);
+    created = false;
+    return true;
+}
+
+void SharedMemory::Close()
+{
+    if (data != nullptr)
+    {
+        munmap(data, size);
+    }
+    if (created)
+    {
+        shm_unlink(name.c_str());
+    }
+    data = nullptr;
+    size = 0;
+    created = false;
+}
+
+#endif
+
+//=============================================================================
+// SharedRingWriter
+//=============================================================================
+
+SharedRingWriter::~SharedRingWriter()
+{
+    Close();
+}
+
+bool SharedRingWriter::Create(const std::string& name, unsigned int slotCount, unsigned int imageCount,
+                              unsigned int cols, unsigned int rows, SharedRingPixelFormat pixelFormat,
+                              unsigned int timeoutMs)
+{
+    const size_t pixelBytes = (pixelFormat == SHARED_RING_BGRU16) ? 8 : (pixelFormat == SHARED_RING_BGR) ? 3 : 4;
+    const size_t imageBytes = static_cast<size_t>(cols) * rows * pixelBytes;
+    const size_t slotBytes = AlignUp(sizeof(SharedRingSlot)) + imageCount * AlignUp(imageBytes);
+    const size_t totalBytes = AlignUp(sizeof(SharedRingHeader)) + slotCount * slotBytes;
+
+    if (!memory.Create(name, totalBytes))
+    {
+        printf("Error: Could not create shared memory %s (%zu MB)\n", name.c_str(), totalBytes >> 20);
+        return false;
+    }
+
+    header = new (memory.Data()) SharedRingHeader();
+    header->slotCount = slotCount;
+    header->imageCount = imageCount;
+    header->cols = cols;
+    header->rows = rows;
+    header->pixelFormat = pixelFormat;
+    header->reserved = 0;
+    header->imageBytes = imageBytes;
+    header->slotBytes = slotBytes;
+    header->written.store(0);
+    header->released.store(0);
+    header->finished.store(0);
+    header->attached.store(0);
+    header->heartbeat.store(0);
+    this->name = name;
+    this->timeoutMs = timeoutMs;
+    readerLost = false;
+
+    // The magic goes last: a reader that sees it sees a complete header
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, SHARED_RING_MAGIC, sizeof(SHARED_RING_MAGIC));
+
+    printf("Shared memory ring %s: %u slot(s) of %zu MB\n", name.c_str(), slotCount, slotBytes >> 20);
+    return true;
+}
+
+SharedRingSlot* SharedRingWriter::BeginFrame(unsigned int frameNum)
+{
+    const uint64_t frame = header->written.load(std::memory_order_relaxed);
+    if (frame >= header->slotCount && !WaitForRelease(frame - header->slotCount + 1))
+    {
+        return nullptr;
+    }
+
+    SharedRingSlot* slot = GetSlot(header, frame);
+    slot->sequence = frame;
+    slot->frameNum = frameNum;
+    slot->imageCount = header->imageCount;
+    return slot;
+}
+
+unsigned char* SharedRingWriter::Image(SharedRingSlot* slot, unsigned int image) const
+{
+    return reinterpret_cast<unsigned char*>(slot) + GetImageOffset(header, image);
+}
+
+void SharedRingWriter::EndFrame()
+{
+    header->written.fetch_add(1, std::memory_order_release);
+}
+
+void SharedRingWriter::Close()
+{
+    if (header != nullptr)
+    {
+        // Frames still in the ring are lost once the name is gone, so they
+        // are waited for as any other full slot would be
+        header->finished.store(1, std::memory_order_release);
+        const uint64_t frames = header->written.load(std::memory_order_relaxed);
+        if (!WaitForRelease(frames))
+        {
+            const uint64_t released = header->released.load(std::memory_order_acquire);
+            printf("Warning: %llu frame(s) in shared memory ring %s were not read\n",
+                   static_cast<unsigned long long>(frames - std::min(released, frames)), name.c_str());
+        }
+        header = nullptr;
+    }
+    memory.Close();
+}
+
+bool SharedRingWriter::WaitForRelease(uint64_t frames)
+{
+    if (readerLost)
+    {
+        return header->released.load(std::memory_order_acquire) >= frames;
+    }
+
+    // The timeout runs from the reader's last sign of life
+    uint64_t released = header->released.load(std::memory_order_acquire);
+    uint64_t heartbeat = header->heartbeat.load(std::memory_order_relaxed);
+    auto lastProgress = std::chrono::steady_clock::now();
+    unsigned int polls = 0;
+    while (released < frames)
+    {
+        WaitToPoll(polls);
+        const uint64_t nowReleased = header->released.load(std::memory_order_acquire);
+        const uint64_t nowHeartbeat = header->heartbeat.load(std::memory_order_relaxed);
+        const auto now = std::chrono::steady_clock::now();
+        if (nowReleased != released || nowHeartbeat != heartbeat)
+        {
+            released = nowReleased;
+            heartbeat = nowHeartbeat;
+            lastProgress = now;
+        }
+        else if (now - lastProgress >= std::chrono::milliseconds(timeoutMs))
+        {
+            if (header->attached.load(std::memory_order_acquire) == 0)
+            {
+                printf("Error: No reader attached to shared memory ring %s for %.1f s\n", name.c_str(),
+                       timeoutMs / 1000.0);
+            }
+            else
+            {
+                printf("Error: The reader of shared memory ring %s stopped responding (no progress for %.1f s)\n",
+                       name.c_str(), timeoutMs / 1000.0);
+            }
+            readerLost = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+//=============================================================================
+// SharedRingReader
+//=============================================================================
+
+bool SharedRingReader::Open(const std::string& name)
+{
+    Close();
+    if (!memory.Open(name))
+    {
+        printf("Error: No shared memory ring %s\n", name.c_str());
+        return false;
+    }
+
+    header = reinterpret_cast<SharedRingHeader*>(memory.Data());
+    const bool valid = memory.Size() >= sizeof(SharedRingHeader) &&
+                       memcmp(header->magic, SHARED_RING_MAGIC, sizeof(SHARED_RING_MAGIC)) == 0 &&
+                       header->slotCount > 0 &&
+                       AlignUp(sizeof(SharedRingHeader)) + header->slotCount * header->slotBytes <= memory.Size();
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!valid)
+    {
+        printf("Error: %s is not a shared memory ring of this version\n", name.c_str());
+        header = nullptr;
+        memory.Close();
+        return false;
+    }
+
+    header->attached.store(1, std::memory_order_release);
+    Heartbeat();
+    return true;
+}
+
+SharedRingReader::~SharedRingReader()
+{
+    Close();
+}
+
+void SharedRingReader::Close()
+{
+    if (header != nullptr)
+    {
+        header->attached.store(0, std::memory_order_release);
+        header = nullptr;
+    }
+    memory.Close();
+}
+
+const SharedRingSlot* SharedRingReader::Acquire(unsigned int timeoutMs)
+{
+    const uint64_t frame = header->released.load(std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    unsigned int polls = 0;
+    while (header->written.load(std::memory_order_acquire) <= frame)
+    {
+        // finished is set after the last frame was published
+        if (header->finished.load(std::memory_order_acquire) != 0 &&
+            header->written.load(std::memory_order_acquire) <= frame)
+        {
+            return nullptr;
+        }
+        if (timeoutMs > 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeoutMs))
+        {
+            return nullptr;
+        }
+        Heartbeat();
+        WaitToPoll(polls);
+    }
+    return GetSlot(header, frame);
+}
+
+const unsigned char* SharedRingReader::Image(const SharedRingSlot* slot, unsigned int image) const
+{
+    return reinterpret_cast<const unsigned char*>(slot) + GetImageOffset(header, image);
+}
+
+void SharedRingReader::Release()
+{
+    header->released.fetch_add(1, std::memory_order_release);
+}
+
+void SharedRingReader::Heartbeat()
+{
+    header->heartbeat.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SharedRingReader::Finished() const
+{
+    return header->finished.load(std::memory_order_acquire) != 0 &&
+           header->released.load(std::memory_order_acquire) >= header->written.load(std::memory_order_acquire);
+}
@@ -0,0 +1,243 @@
+//=============================================================================
+// SharedRing - Raw frames in a shared-memory ring buffer (--shm-ring)
+//
+// For consumers on the same machine, encoding is wasted work: with
+// --shm-ring the exporter copies the processed images of each frame (the six
+// camera textures, or the panorama) into a ring of slots in named shared
+// memory (POSIX shm_open, a named file mapping on Windows), and a reader
+// process works on them in place.
+//
+// Layout, all fields in the machine's byte order:
+//
+//   SharedRingHeader   geometry of the ring and its two counters
+//   slot[slotCount]    SharedRingSlot, then imageCount images of imageBytes,
+//                      each starting on a 64-byte boundary
+//
+// The protocol is single producer, single consumer and lock-free. The
+// exporter fills slot (written % slotCount) and then advances written; the
+// reader works on slot (released % slotCount) once written is past it and
+// then advances released. The exporter waits while all slots are full, so
+// no frame is lost and a slow reader slows the export down. The counters
+// are atomics that both processes update without locks; acquire/release
+// ordering makes a slot's contents visible before its counter.
+//
+// The reader also sets attached while it has the ring open and advances
+// heartbeat while it waits for frames. The exporter only waits for a reader
+// that shows signs of life: when neither released nor heartbeat moves for
+// the writer's timeout (no reader started, or it died), it gives up with a
+// message instead of hanging.
+//
+// SharedRingReader is the reader side, for the consumer's process; it only
+// needs this header and SharedRing.cpp.
+//=============================================================================
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Identifies the layout; changes with it
+constexpr char SHARED_RING_MAGIC[8] = { 'L', 'B', 'X', 'R', 'I', 'N', 'G', '2' };
+
+// Offsets of slots and images
+constexpr size_t SHARED_RING_ALIGNMENT = 64;
+
+// The counters must work between processes
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared ring needs lock-free 64-bit atomics");
+
+/**
+ * @brief Pixel format of the images (values of PixelFormat)
+ */
+enum SharedRingPixelFormat : uint32_t
+{
+    SHARED_RING_BGRU = 0,           // 8-bit blue, green, red, unused
+    SHARED_RING_BGRU16 = 1,         // 16-bit samples
+    SHARED_RING_BGR = 2             // 8-bit, no padding (panoramas)
+};
+
+/**
+ * @brief Start of the shared memory
+ */
+struct SharedRingHeader
+{
+    char magic[8];
+    uint32_t slotCount;
+    uint32_t imageCount;            // 6 cameras, or 1 panorama
+    uint32_t cols;                  // Size of every image
+    uint32_t rows;
+    uint32_t pixelFormat;           // SharedRingPixelFormat
+    uint32_t reserved;
+    uint64_t imageBytes;
+    uint64_t slotBytes;             // Distance between slots
+
+    alignas(SHARED_RING_ALIGNMENT) std::atomic<uint64_t> written;   // Frames the exporter has published
+    alignas(SHARED_RING_ALIGNMENT) std::atomic<uint64_t> released;  // Frames the reader is done with
+    alignas(SHARED_RING_ALIGNMENT) std::atomic<uint32_t> finished;  // The exporter published its last frame
+    alignas(SHARED_RING_ALIGNMENT) std::atomic<uint32_t> attached;  // A reader has the ring open
+    std::atomic<uint64_t> heartbeat;                                // Advanced by the reader while it waits
+};
+
+/**
+ * @brief Start of every slot, followed by its images
+ */
+struct alignas(SHARED_RING_ALIGNMENT) SharedRingSlot
+{
+    uint64_t sequence;              // Position of the frame in the ring's output, from 0
+    uint32_t frameNum;
+    uint32_t imageCount;
+};
+
+/**
+ * @brief Named shared memory, created or opened
+ */
+class SharedMemory
+{
+public:
+    SharedMemory() = default;
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    /**
+     * @brief Create the memory, replacing any left over under the name
+     */
+    bool Create(const std::string& name, size_t size);
+    bool Open(const std::string& name);
+
+    /**
+     * @brief Unmap; the creator also removes the name, so readers that are
+     *        attached keep their mapping but no new one can open it
+     */
+    void Close();
+
+    unsigned char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    std::string name;
+    unsigned char* data = nullptr;
+    size_t size = 0;
+    bool created = false;
+#ifdef _WIN32
+    void* mappingHandle = nullptr;
+#endif
+};
+
+/**
+ * @brief Producer side, used by the exporter's publish stage
+ */
+class SharedRingWriter
+{
+public:
+    ~SharedRingWriter();
+
+    /**
+     * @param name Shared memory name ("/name" on POSIX)
+     * @param timeoutMs How long to wait for a reader that shows no sign of
+     *        life (not attached yet, or neither releasing nor polling)
+     * @return false (with a message) if the memory cannot be created
+     */
+    bool Create(const std::string& name, unsigned int slotCount, unsigned int imageCount, unsigned int cols,
+                unsigned int rows, SharedRingPixelFormat pixelFormat, unsigned int timeoutMs);
+
+    /**
+     * @brief Wait for a free slot
+     * @return Image i of the slot is at Image(slot, i); null (with a
+     *         message) if the reader timed out, and from then on
+     */
+    SharedRingSlot* BeginFrame(unsigned int frameNum);
+    unsigned char* Image(SharedRingSlot* slot, unsigned int image) const;
+
+    /**
+     * @brief Hand the slot to the reader
+     */
+    void EndFrame();
+
+    /**
+     * @brief Tell the reader no more frames come, wait until it released
+     *        the ones in the ring (unless it timed out) and remove the name
+     */
+    void Close();
+
+    const SharedRingHeader* Header() const { return header; }
+
+private:
+    /**
+     * @brief Wait until the reader released frame @p frames - 1
+     * @return false (with a message) if it timed out
+     */
+    bool WaitForRelease(uint64_t frames);
+
+    SharedMemory memory;
+    std::string name;
+    SharedRingHeader* header = nullptr;
+    unsigned int timeoutMs = 0;
+    bool readerLost = false;        // A wait timed out; no more waiting
+};
+
+/**
+ * @brief Consumer side
+ *
+ *     SharedRingReader ring;
+ *     ring.Open("/ladybug");
+ *     while (const SharedRingSlot* slot = ring.Acquire())
+ *     {
+ *         for (unsigned int i = 0; i < slot->imageCount; i++)
+ *             Use(ring.Image(slot, i), ring.Header()->cols, ring.Header()->rows);
+ *         ring.Release();
+ *     }
+ */
+class SharedRingReader
+{
+public:
+    SharedRingReader() = default;
+    ~SharedRingReader();
+
+    SharedRingReader(const SharedRingReader&) = delete;
+    SharedRingReader& operator=(const SharedRingReader&) = delete;
+
+    /**
+     * @brief Open the ring and mark it attached
+     * @return false (with a message) if there is no ring under the name
+     */
+    bool Open(const std::string& name);
+
+    /**
+     * @brief Detach from the ring
+     */
+    void Close();
+
+    /**
+     * @brief Wait for the next frame; it stays valid until Release
+     * @param timeoutMs Give up after this long (0 = wait for ever)
+     * @return null once the exporter finished and every frame was released
+     *         (Finished() is then true), or on timeout
+     */
+    const SharedRingSlot* Acquire(unsigned int timeoutMs = 0);
+    const unsigned char* Image(const SharedRingSlot* slot, unsigned int image) const;
+
+    /**
+     * @brief Hand the frame from Acquire back to the exporter
+     */
+    void Release();
+
+    /**
+     * @brief Show the exporter the reader is alive; call it during work on
+     *        a frame that can take longer than the exporter's timeout
+     */
+    void Heartbeat();
+
+    /**
+     * @brief The exporter finished and every frame was released
+     */
+    bool Finished() const;
+
+    const SharedRingHeader* Header() const { return header; }
+
+private:
+    SharedMemory memory;
+    SharedRingHeader* header = nullptr;
+};
@@ -0,0 +1,96 @@
+//=============================================================================
+// StreamSegments - Multi-file PGR recording sets
+//=============================================================================
+
+#include "StreamSegments.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <regex>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+// <BaseName>-NNNNNN.pgr
+static const std::regex SEGMENT_PATTERN(R"(^(.*)-(\d{6})\.pgr$)", std::regex::icase);
+
+std::vector<std::string> FindStreamSegments(const std::string& pgrPath)
+{
+    const fs::path inputPath(pgrPath);
+    const std::string inputName = inputPath.filename().string();
+
+    std::smatch inputMatch;
+    if (!std::regex_match(inputName, inputMatch, SEGMENT_PATTERN))
+    {
+        return { pgrPath };
+    }
+
+    const std::string baseName = inputMatch[1].str();
+    const unsigned long inputNumber = std::stoul(inputMatch[2].str());
+
+    // Collect sibling segments of the same recording by number
+    std::map<unsigned long, std::string> siblings;
+    siblings[inputNumber] = pgrPath;
+
+    fs::path directory = inputPath.parent_path();
+    std::error_code ec;
+    for (fs::directory_iterator it(directory.empty() ? fs::path(".") : directory, ec), end;
+         !ec && it != end; it.increment(ec))
+    {
+        const std::string name = it->path().filename().string();
+        std::smatch match;
+        if (std::regex_match(name, match, SEGMENT_PATTERN) && match[1].str() == baseName)
+        {
+            const unsigned long number = std::stoul(match[2].str());
+            if (number != inputNumber)
+            {
+                siblings[number] = (directory / name).string();
+            }
+        }
+    }
+
+    // Keep the unbroken run of numbers around the input file
+    unsigned long first = inputNumber;
+    while (first > 0 && siblings.count(first - 1) != 0)
+    {
+        first--;
+    }
+
+    std::vector<std::string> segments;
+    for (unsigned long number = first; siblings.count(number) != 0; number++)
+    {
+        segments.push_back(siblings[number]);
+    }
+
+    return segments;
+}
+
+unsigned int NumberStreamSegments(std::vector<StreamSegment>& segments)
+{
+    unsigned int totalFrames = 0;
+    for (StreamSegment& segment : segments)
+    {
+        segment.firstFrame = totalFrames;
+        totalFrames += segment.frameCount;
+    }
+    return totalFrames;
+}
+
+size_t FindSegmentForFrame(const std::vector<StreamSegment>& segments, unsigned int frame)
+{
+    // First segment that starts after the frame; the one before it holds the frame
+    auto it = std::upper_bound(segments.begin(), segments.end(), frame,
+        [](unsigned int value, const StreamSegment& segment) { return value < segment.firstFrame; });
+    if (it == segments.begin())
+    {
+        return segments.size();
+    }
+
+    const size_t index = static_cast<size_t>(it - segments.begin()) - 1;
+    if (frame - segments[index].firstFrame >= segments[index].frameCount)
+    {
+        return segments.size();
+    }
+    return index;
+}
@@ -0,0 +1,44 @@
+//=============================================================================
+// StreamSegments - Multi-file PGR recording sets
+//
+// LadybugCapPro splits long recordings into segments named
+// <BaseName>-000000.pgr, <BaseName>-000001.pgr, ... This module finds the
+// segments that belong to one recording and maps global frame numbers
+// (contiguous across the whole set) to a segment and a frame within it.
+//=============================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct StreamSegment
+{
+    std::string path;
+    unsigned int firstFrame = 0;    // Global number of the segment's first frame
+    unsigned int frameCount = 0;
+};
+
+/**
+ * @brief Find all segments of the recording set a stream file belongs to
+ *
+ * Input: "C:\path\Record_20250702_082939-000001.pgr"
+ * Output: "...-000000.pgr", "...-000001.pgr", "...-000002.pgr", ...
+ *
+ * Returns the unbroken run of segment numbers that contains the input file.
+ * A file without a segment suffix is returned on its own.
+ */
+std::vector<std::string> FindStreamSegments(const std::string& pgrPath);
+
+/**
+ * @brief Assign global frame numbers from each segment's frame count
+ * @return Total number of frames in the set
+ */
+unsigned int NumberStreamSegments(std::vector<StreamSegment>& segments);
+
+/**
+ * @brief Find the segment holding a global frame number
+ * @return Segment index, or segments.size() if the frame is out of range
+ */
+size_t FindSegmentForFrame(const std::vector<StreamSegment>& segments, unsigned int frame);
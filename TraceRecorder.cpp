@@ -0,0 +1,124 @@
+//=============================================================================
+// TraceRecorder - Chrome trace-event timeline of the frame pipeline (--trace)
+//=============================================================================
+
+#include "TraceRecorder.h"
+
+#include <atomic>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+//=============================================================================
+// Recording
+//=============================================================================
+
+// Recorder ids start at 1 so a thread's empty cache never matches
+static std::atomic<unsigned int> nextRecorderId{1};
+
+TraceRecorder::TraceRecorder()
+    : origin(Clock::now()), recorderId(nextRecorderId++)
+{
+}
+
+TraceRecorder::~TraceRecorder() = default;
+
+TraceRecorder::ThreadBuffer& TraceRecorder::CurrentThreadBuffer()
+{
+    // A thread looks its buffer up once per recorder
+    thread_local unsigned int cachedRecorder = 0;
+    thread_local ThreadBuffer* cachedBuffer = nullptr;
+    if (cachedRecorder == recorderId)
+    {
+        return *cachedBuffer;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers.emplace_back(new ThreadBuffer());
+    buffers.back()->threadId = static_cast<unsigned int>(buffers.size());
+    cachedRecorder = recorderId;
+    cachedBuffer = buffers.back().get();
+    return *cachedBuffer;
+}
+
+void TraceRecorder::NameThread(const std::string& name)
+{
+    CurrentThreadBuffer().name = name;
+}
+
+void TraceRecorder::AddSpan(const char* name, const char* category, Clock::time_point start, Clock::time_point end,
+                            int64_t frame)
+{
+    Event event;
+    event.name = name;
+    event.category = category;
+    event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin).count();
+    event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    event.frame = frame;
+    CurrentThreadBuffer().events.push_back(event);
+}
+
+//=============================================================================
+// Output
+//=============================================================================
+
+bool TraceRecorder::Write(const std::string& path) const
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (fp == nullptr)
+    {
+        printf("Warning: Could not create trace %s\n", path.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    const int processId = _getpid();
+#else
+    const int processId = static_cast<int>(getpid());
+#endif
+
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t numEvents = 0;
+    bool first = true;
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers)
+    {
+        // Thread names are used as given; they are plain identifiers
+        if (!buffer->name.empty())
+        {
+            fprintf(fp, "%s{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": %d, \"tid\": %u, "
+                    "\"args\": {\"name\": \"%s\"}}",
+                    first ? "" : ",\n", processId, buffer->threadId, buffer->name.c_str());
+            first = false;
+        }
+
+        for (const Event& event : buffer->events)
+        {
+            fprintf(fp, "%s{\"ph\": \"X\", \"name\": \"%s\", \"cat\": \"%s\", \"pid\": %d, \"tid\": %u, "
+                    "\"ts\": %.3f, \"dur\": %.3f",
+                    first ? "" : ",\n", event.name, event.category, processId, buffer->threadId,
+                    event.start / 1000.0, event.duration / 1000.0);
+            if (event.frame != TRACE_NO_FRAME)
+            {
+                fprintf(fp, ", \"args\": {\"frame\": %lld}", static_cast<long long>(event.frame));
+            }
+            fprintf(fp, "}");
+            first = false;
+        }
+        numEvents += buffer->events.size();
+    }
+    fprintf(fp, "\n]}\n");
+
+    if (fclose(fp) != 0)
+    {
+        printf("Warning: Could not write trace %s\n", path.c_str());
+        return false;
+    }
+    printf("Trace with %zu events written to %s\n", numEvents, path.c_str());
+    return true;
+}
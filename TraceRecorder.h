@@ -0,0 +1,122 @@
+//=============================================================================
+// TraceRecorder - Chrome trace-event timeline of the frame pipeline (--trace)
+//
+// Every StageTimer span and every wait on a pipeline queue becomes a
+// complete ("X") event on the thread that ran it, tagged with the frame
+// number where known. The file loads in chrome://tracing and
+// ui.perfetto.dev, where stalls show up as long wait spans on one thread
+// while another is busy.
+//
+// Each thread appends to a buffer of its own, so recording takes no lock;
+// a lock is only taken the first time a thread records. Events are kept in
+// memory (about 40 bytes each, 20-40 per frame) and written by Write once
+// the pipeline threads have finished. Without --trace no recorder exists
+// and the spans cost a null check.
+//=============================================================================
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Frame number of spans that do not belong to one frame
+constexpr int64_t TRACE_NO_FRAME = -1;
+
+class TraceRecorder
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TraceRecorder();
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    /**
+     * @brief Name the calling thread in the timeline ("read", "encode", ...)
+     */
+    void NameThread(const std::string& name);
+
+    /**
+     * @brief Record a span of the calling thread
+     * @param name, category Must outlive the recorder (string literals)
+     */
+    void AddSpan(const char* name, const char* category, Clock::time_point start, Clock::time_point end,
+                 int64_t frame);
+
+    /**
+     * @brief Write all events as Chrome trace JSON; call after the recording threads finished
+     * @return false (with a message) if the file cannot be written
+     */
+    bool Write(const std::string& path) const;
+
+private:
+    struct Event
+    {
+        const char* name;
+        const char* category;
+        int64_t start;              // Nanoseconds since the recorder was created
+        int64_t duration;
+        int64_t frame;
+    };
+
+    struct ThreadBuffer
+    {
+        unsigned int threadId = 0;
+        std::string name;
+        std::deque<Event> events;
+    };
+
+    ThreadBuffer& CurrentThreadBuffer();
+
+    Clock::time_point origin;
+    unsigned int recorderId;        // Tells thread-local buffer caches of different recorders apart
+
+    mutable std::mutex mutex;       // Guards buffers (not their contents)
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+/**
+ * @brief Records its scope as a span (does nothing if trace is null)
+ */
+class TraceSpan
+{
+public:
+    TraceSpan(TraceRecorder* trace, const char* name, const char* category, int64_t frame = TRACE_NO_FRAME)
+        : trace(trace), name(name), category(category), frame(frame)
+    {
+        if (trace != nullptr)
+        {
+            start = TraceRecorder::Clock::now();
+        }
+    }
+
+    ~TraceSpan()
+    {
+        if (trace != nullptr)
+        {
+            trace->AddSpan(name, category, start, TraceRecorder::Clock::now(), frame);
+        }
+    }
+
+    /**
+     * @brief Tag the span with a frame learned inside it (e.g. after a queue pop)
+     */
+    void SetFrame(int64_t frameNum) { frame = frameNum; }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    TraceRecorder* trace;
+    const char* name;
+    const char* category;
+    int64_t frame;
+    TraceRecorder::Clock::time_point start;
+};
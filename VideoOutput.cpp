@@ -0,0 +1,517 @@
+//=============================================================================
+// VideoOutput - Motion JPEG AVI output of the exported images (--video)
+//=============================================================================
+
+#include "VideoOutput.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "PgrStreamReader.h"
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+// Frame rate when the stream header has none
+constexpr float DEFAULT_VIDEO_FRAME_RATE = 15.0f;
+
+// Frame rate denominator (rate / scale frames per second)
+constexpr uint32_t VIDEO_RATE_SCALE = 1000;
+
+constexpr uint32_t AVIF_HASINDEX = 0x10;
+constexpr uint32_t AVIIF_KEYFRAME = 0x10;
+constexpr unsigned char AVI_INDEX_OF_INDEXES = 0x00;
+constexpr unsigned char AVI_INDEX_OF_CHUNKS = 0x01;
+
+// Sizes of header structures and index entries
+constexpr uint32_t BITMAP_INFO_HEADER_SIZE = 40;
+constexpr uint32_t ODML_HEADER_SIZE = 248;
+constexpr uint32_t SUPER_INDEX_ENTRY_SIZE = 16;
+constexpr uint32_t STANDARD_INDEX_ENTRY_SIZE = 8;
+constexpr uint32_t LEGACY_INDEX_ENTRY_SIZE = 16;
+
+// Room in a segment for its indexes besides the entries
+constexpr uint64_t SEGMENT_INDEX_RESERVE = 64;
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+static void PutLE(std::vector<unsigned char>& out, uint64_t value, unsigned int bytes)
+{
+    for (unsigned int i = 0; i < bytes; i++)
+    {
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+static void PutFourCC(std::vector<unsigned char>& out, const char* fourcc)
+{
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        out.push_back(static_cast<unsigned char>(fourcc[i]));
+    }
+}
+
+/**
+ * @brief Start a chunk (or list): fourcc and a size filled in by EndChunk
+ * @return Position of the size
+ */
+static size_t BeginChunk(std::vector<unsigned char>& out, const char* fourcc)
+{
+    PutFourCC(out, fourcc);
+    const size_t sizePosition = out.size();
+    PutLE(out, 0, 4);
+    return sizePosition;
+}
+
+static void EndChunk(std::vector<unsigned char>& out, size_t sizePosition)
+{
+    const uint64_t size = out.size() - sizePosition - 4;
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        out[sizePosition + i] = static_cast<unsigned char>(size >> (8 * i));
+    }
+}
+
+static bool SeekTo(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+/**
+ * @brief File of one camera: "run.avi" -> "run_Cam0.avi"
+ */
+static std::string GetCameraVideoPath(const std::string& path, int camera)
+{
+    const size_t dot = path.find_last_of('.');
+    const size_t slash = path.find_last_of("\\/");
+    const bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    const std::string stem = hasExtension ? path.substr(0, dot) : path;
+    const std::string extension = hasExtension ? path.substr(dot) : ".avi";
+    return stem + "_Cam" + std::to_string(camera) + extension;
+}
+
+//=============================================================================
+// AviWriter
+//=============================================================================
+
+AviWriter::~AviWriter()
+{
+    if (file != nullptr)
+    {
+        Close();
+    }
+}
+
+bool AviWriter::Open(const std::string& videoPath, unsigned int frameCols, unsigned int frameRows, float frameRate)
+{
+    file = fopen(videoPath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        printf("Error: Could not create video %s\n", videoPath.c_str());
+        return false;
+    }
+    path = videoPath;
+    offset = 0;
+    failed = false;
+    full = false;
+    cols = frameCols;
+    rows = frameRows;
+    if (frameRate <= 0.0f)
+    {
+        frameRate = DEFAULT_VIDEO_FRAME_RATE;
+    }
+    rate = static_cast<uint32_t>(std::lround(frameRate * VIDEO_RATE_SCALE));
+    scale = VIDEO_RATE_SCALE;
+    segmentFrames.clear();
+    firstSegmentFrames.clear();
+    firstRiffSize = 0;
+    firstMoviSize = 0;
+    segments.clear();
+    totalFrames = 0;
+    maxFrameSize = 0;
+
+    // Written again with the final values by Close
+    const std::vector<unsigned char> header = BuildHeader();
+    segmentStart = 0;
+    moviStart = header.size() - 12;
+    return Put(header.data(), header.size());
+}
+
+std::vector<unsigned char> AviWriter::BuildHeader() const
+{
+    std::vector<unsigned char> out;
+    const uint32_t microSecondsPerFrame = static_cast<uint32_t>(std::lround(1000000.0 * scale / rate));
+    const uint32_t firstFrames = static_cast<uint32_t>(firstSegmentFrames.size());
+    const uint32_t bufferSize = maxFrameSize + 8;
+
+    PutFourCC(out, "RIFF");
+    PutLE(out, firstRiffSize, 4);
+    PutFourCC(out, "AVI ");
+
+    const size_t hdrl = BeginChunk(out, "LIST");
+    PutFourCC(out, "hdrl");
+
+    const size_t avih = BeginChunk(out, "avih");
+    PutLE(out, microSecondsPerFrame, 4);
+    PutLE(out, static_cast<uint64_t>(bufferSize) * rate / scale, 4);   // dwMaxBytesPerSec
+    PutLE(out, 0, 4);                                                   // dwPaddingGranularity
+    PutLE(out, AVIF_HASINDEX, 4);
+    PutLE(out, firstFrames, 4);                                         // dwTotalFrames (first segment)
+    PutLE(out, 0, 4);                                                   // dwInitialFrames
+    PutLE(out, 1, 4);                                                   // dwStreams
+    PutLE(out, bufferSize, 4);
+    PutLE(out, cols, 4);
+    PutLE(out, rows, 4);
+    PutLE(out, 0, 16);                                                  // dwReserved
+    EndChunk(out, avih);
+
+    const size_t strl = BeginChunk(out, "LIST");
+    PutFourCC(out, "strl");
+
+    const size_t strh = BeginChunk(out, "strh");
+    PutFourCC(out, "vids");
+    PutFourCC(out, "MJPG");
+    PutLE(out, 0, 4);                                                   // dwFlags
+    PutLE(out, 0, 2);                                                   // wPriority
+    PutLE(out, 0, 2);                                                   // wLanguage
+    PutLE(out, 0, 4);                                                   // dwInitialFrames
+    PutLE(out, scale, 4);
+    PutLE(out, rate, 4);
+    PutLE(out, 0, 4);                                                   // dwStart
+    PutLE(out, totalFrames, 4);                                         // dwLength
+    PutLE(out, bufferSize, 4);
+    PutLE(out, 0xFFFFFFFF, 4);                                          // dwQuality (default)
+    PutLE(out, 0, 4);                                                   // dwSampleSize (varies)
+    PutLE(out, 0, 2);                                                   // rcFrame
+    PutLE(out, 0, 2);
+    PutLE(out, cols, 2);
+    PutLE(out, rows, 2);
+    EndChunk(out, strh);
+
+    const size_t strf = BeginChunk(out, "strf");
+    PutLE(out, BITMAP_INFO_HEADER_SIZE, 4);
+    PutLE(out, cols, 4);
+    PutLE(out, rows, 4);
+    PutLE(out, 1, 2);                                                   // biPlanes
+    PutLE(out, 24, 2);                                                  // biBitCount
+    PutFourCC(out, "MJPG");
+    PutLE(out, static_cast<uint64_t>(cols) * rows * 3, 4);              // biSizeImage
+    PutLE(out, 0, 16);                                                  // Resolution, palette
+    EndChunk(out, strf);
+
+    // Super index; its space is reserved for AVI_MAX_SEGMENTS entries
+    const size_t indx = BeginChunk(out, "indx");
+    PutLE(out, SUPER_INDEX_ENTRY_SIZE / 4, 2);                          // wLongsPerEntry
+    out.push_back(0);                                                   // bIndexSubType
+    out.push_back(AVI_INDEX_OF_INDEXES);
+    PutLE(out, segments.size(), 4);                                     // nEntriesInUse
+    PutFourCC(out, "00dc");
+    PutLE(out, 0, 12);                                                  // dwReserved
+    for (unsigned int i = 0; i < AVI_MAX_SEGMENTS; i++)
+    {
+        const SegmentIndex segment = (i < segments.size()) ? segments[i] : SegmentIndex();
+        PutLE(out, segment.offset, 8);
+        PutLE(out, segment.size, 4);
+        PutLE(out, segment.frames, 4);
+    }
+    EndChunk(out, indx);
+    EndChunk(out, strl);
+
+    const size_t odml = BeginChunk(out, "LIST");
+    PutFourCC(out, "odml");
+    const size_t dmlh = BeginChunk(out, "dmlh");
+    PutLE(out, totalFrames, 4);
+    PutLE(out, 0, ODML_HEADER_SIZE - 4);
+    EndChunk(out, dmlh);
+    EndChunk(out, odml);
+    EndChunk(out, hdrl);
+
+    PutFourCC(out, "LIST");
+    PutLE(out, firstMoviSize, 4);
+    PutFourCC(out, "movi");
+    return out;
+}
+
+bool AviWriter::Put(const void* data, size_t size)
+{
+    if (!failed && size > 0 && fwrite(data, 1, size, file) != size)
+    {
+        printf("Error: Could not write video %s\n", path.c_str());
+        failed = true;
+    }
+    offset += size;
+    return !failed;
+}
+
+bool AviWriter::PutAt(uint64_t at, const std::vector<unsigned char>& data)
+{
+    if (!failed && (!SeekTo(file, at) || fwrite(data.data(), 1, data.size(), file) != data.size() ||
+                    !SeekTo(file, offset)))
+    {
+        printf("Error: Could not write video %s\n", path.c_str());
+        failed = true;
+    }
+    return !failed;
+}
+
+void AviWriter::StartSegment()
+{
+    segmentStart = offset;
+    moviStart = offset + 12;
+    std::vector<unsigned char> header;
+    PutFourCC(header, "RIFF");
+    PutLE(header, 0, 4);
+    PutFourCC(header, "AVIX");
+    PutFourCC(header, "LIST");
+    PutLE(header, 0, 4);
+    PutFourCC(header, "movi");
+    Put(header.data(), header.size());
+}
+
+void AviWriter::EndSegment()
+{
+    std::vector<unsigned char> out;
+
+    // Standard index of the segment, at the end of its movi list
+    if (!segmentFrames.empty())
+    {
+        SegmentIndex segment;
+        segment.offset = offset;
+        segment.frames = static_cast<uint32_t>(segmentFrames.size());
+        const size_t ix00 = BeginChunk(out, "ix00");
+        PutLE(out, STANDARD_INDEX_ENTRY_SIZE / 4, 2);                   // wLongsPerEntry
+        out.push_back(0);                                               // bIndexSubType
+        out.push_back(AVI_INDEX_OF_CHUNKS);
+        PutLE(out, segmentFrames.size(), 4);                            // nEntriesInUse
+        PutFourCC(out, "00dc");
+        PutLE(out, segmentStart, 8);                                    // qwBaseOffset
+        PutLE(out, 0, 4);                                               // dwReserved
+        for (const FrameEntry& frame : segmentFrames)
+        {
+            PutLE(out, frame.offset + 8 - segmentStart, 4);             // Offset of the data
+            PutLE(out, frame.size, 4);                                  // Key frame (bit 31 clear)
+        }
+        EndChunk(out, ix00);
+        segment.size = static_cast<uint32_t>(out.size());
+        segments.push_back(segment);
+    }
+    const uint32_t moviSize = static_cast<uint32_t>(offset + out.size() - moviStart - 8);
+
+    // The first segment also has the index of AVI 1.0, after its movi list
+    if (segmentStart == 0)
+    {
+        const size_t idx1 = BeginChunk(out, "idx1");
+        for (const FrameEntry& frame : segmentFrames)
+        {
+            PutFourCC(out, "00dc");
+            PutLE(out, AVIIF_KEYFRAME, 4);
+            PutLE(out, frame.offset - moviStart - 8, 4);                // From the movi fourcc
+            PutLE(out, frame.size, 4);
+        }
+        EndChunk(out, idx1);
+        firstSegmentFrames = segmentFrames;
+    }
+    Put(out.data(), out.size());
+    const uint32_t riffSize = static_cast<uint32_t>(offset - segmentStart - 8);
+
+    if (segmentStart == 0)
+    {
+        // Written with the header by Close
+        firstRiffSize = riffSize;
+        firstMoviSize = moviSize;
+    }
+    else
+    {
+        std::vector<unsigned char> size;
+        PutLE(size, riffSize, 4);
+        PutAt(segmentStart + 4, size);
+        size.clear();
+        PutLE(size, moviSize, 4);
+        PutAt(moviStart + 4, size);
+    }
+    segmentFrames.clear();
+}
+
+bool AviWriter::AddFrame(const std::vector<unsigned char>& jpeg)
+{
+    if (file == nullptr || failed || full)
+    {
+        return false;
+    }
+
+    // A frame that would take the segment (with its indexes) past the limit
+    // starts the next one
+    const uint64_t chunkSize = 8 + jpeg.size() + (jpeg.size() & 1);
+    const uint64_t indexSize = (segmentFrames.size() + 1) * (STANDARD_INDEX_ENTRY_SIZE + LEGACY_INDEX_ENTRY_SIZE);
+    if (!segmentFrames.empty() &&
+        offset + chunkSize + indexSize + SEGMENT_INDEX_RESERVE - segmentStart > AVI_SEGMENT_BYTES)
+    {
+        // A full file still gets its indexes from Close
+        if (segments.size() + 1 >= AVI_MAX_SEGMENTS)
+        {
+            printf("Error: Video %s is full (%u segments of %llu MB)\n", path.c_str(), AVI_MAX_SEGMENTS,
+                   static_cast<unsigned long long>(AVI_SEGMENT_BYTES >> 20));
+            full = true;
+            return false;
+        }
+        EndSegment();
+        StartSegment();
+    }
+
+    FrameEntry frame;
+    frame.offset = offset;
+    frame.size = static_cast<uint32_t>(jpeg.size());
+    std::vector<unsigned char> header;
+    PutFourCC(header, "00dc");
+    PutLE(header, jpeg.size(), 4);
+    static const unsigned char padding = 0;
+    if (!Put(header.data(), header.size()) || !Put(jpeg.data(), jpeg.size()) ||
+        ((jpeg.size() & 1) != 0 && !Put(&padding, 1)))
+    {
+        return false;
+    }
+    segmentFrames.push_back(frame);
+    totalFrames++;
+    if (frame.size > maxFrameSize)
+    {
+        maxFrameSize = frame.size;
+    }
+    return true;
+}
+
+bool AviWriter::Close()
+{
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    EndSegment();
+    PutAt(0, BuildHeader());
+    if (fclose(file) != 0 && !failed)
+    {
+        printf("Error: Could not write video %s\n", path.c_str());
+        failed = true;
+    }
+    file = nullptr;
+    return !failed;
+}
+
+//=============================================================================
+// VideoWriter
+//=============================================================================
+
+VideoWriter::~VideoWriter()
+{
+    if (!files.empty())
+    {
+        Close();
+    }
+}
+
+bool VideoWriter::Open(const std::string& path, bool cameraFiles, unsigned int cols, unsigned int rows,
+                       float frameRate)
+{
+    files.clear();
+    const int fileCount = cameraFiles ? PGR_NUM_CAMERAS : 1;
+    files.resize(fileCount);
+    for (int i = 0; i < fileCount; i++)
+    {
+        files[i].file.reset(new AviWriter());
+        if (!files[i].file->Open(cameraFiles ? GetCameraVideoPath(path, i) : path, cols, rows, frameRate))
+        {
+            files.clear();
+            return false;
+        }
+    }
+    ResetOrder();
+    return true;
+}
+
+VideoWriter::CameraVideo* VideoWriter::GetVideo(int camera)
+{
+    const size_t index = (camera < 0) ? 0 : static_cast<size_t>(camera);
+    return (index < files.size()) ? &files[index] : nullptr;
+}
+
+void VideoWriter::AddFrame(CameraVideo& video, const std::vector<unsigned char>& data)
+{
+    if (!video.file->AddFrame(data))
+    {
+        failed = true;
+    }
+}
+
+void VideoWriter::WriteImage(const std::string&, unsigned int, int camera, const std::vector<unsigned char>& data)
+{
+    CameraVideo* video = GetVideo(camera);
+    if (video == nullptr)
+    {
+        return;
+    }
+
+    // Images skipped before the first one are filled in with it
+    for (; video->missingFrames > 0 && !failed; video->missingFrames--)
+    {
+        AddFrame(*video, data);
+        video->repeatedFrames++;
+    }
+    AddFrame(*video, data);
+    video->lastFrame = data;
+}
+
+void VideoWriter::SkipImage(int camera)
+{
+    CameraVideo* video = GetVideo(camera);
+    if (video == nullptr)
+    {
+        return;
+    }
+
+    if (video->lastFrame.empty())
+    {
+        video->missingFrames++;
+        return;
+    }
+    AddFrame(*video, video->lastFrame);
+    video->repeatedFrames++;
+}
+
+bool VideoWriter::Close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (files.empty())
+    {
+        return false;
+    }
+
+    // Frames still held wait for one that never came (the export stopped
+    // early); they go in, in order, all the same
+    WriteHeldImages();
+
+    for (CameraVideo& video : files)
+    {
+        const bool written = video.file->Close();
+        failed = failed || !written;
+        if (written && video.repeatedFrames > 0)
+        {
+            printf("Video: %llu frame(s) written to %s, %llu of them repeated for images that could not be "
+                   "encoded\n", static_cast<unsigned long long>(video.file->Frames()), video.file->Path().c_str(),
+                   static_cast<unsigned long long>(video.repeatedFrames));
+        }
+        else if (written)
+        {
+            printf("Video: %llu frame(s) written to %s\n", static_cast<unsigned long long>(video.file->Frames()),
+                   video.file->Path().c_str());
+        }
+    }
+    files.clear();
+    return !failed;
+}
@@ -0,0 +1,184 @@
+//=============================================================================
+// VideoOutput - Motion JPEG AVI output of the exported images (--video)
+//
+// Turning an exported image sequence into a video means reading and
+// decoding every file again. With --video the encoder threads' JPEGs go
+// straight into an AVI file as the frames of a Motion JPEG stream, at the
+// recording's frame rate: the panoramas into FILE, or with -x 6processed
+// each camera into its own file (FILE_Cam0.avi ... FILE_Cam5.avi). No
+// codec library beyond the JPEG encoder is needed.
+//
+// Files are OpenDML (AVI 2.0) so they can grow past the 1 GB of a plain AVI:
+// the frames are split into RIFF segments of at most AVI_SEGMENT_BYTES, each
+// with a standard index (ix00) that a super index (indx) in the header
+// points to. The first segment also carries the legacy idx1 index, so
+// players without OpenDML support still play its frames.
+//=============================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ImageSink.h"
+
+// Size limit of a RIFF segment (the first one is all a plain AVI reader sees)
+constexpr uint64_t AVI_SEGMENT_BYTES = 1ull << 30;
+
+// Entries of the super index: segments (and so about GB) per file
+constexpr unsigned int AVI_MAX_SEGMENTS = 256;
+
+/**
+ * @brief One Motion JPEG AVI file; not thread safe
+ */
+class AviWriter
+{
+public:
+    AviWriter() = default;
+    ~AviWriter();
+
+    AviWriter(const AviWriter&) = delete;
+    AviWriter& operator=(const AviWriter&) = delete;
+
+    /**
+     * @param frameRate Frames per second (of the recording)
+     * @return false (with a message) if the file cannot be created
+     */
+    bool Open(const std::string& path, unsigned int cols, unsigned int rows, float frameRate);
+
+    /**
+     * @brief Append a JPEG as the next frame
+     * @return false (with a message) if it could not be written
+     */
+    bool AddFrame(const std::vector<unsigned char>& jpeg);
+
+    /**
+     * @brief Write the indexes and the final header
+     * @return false (with a message) if the file could not be written; a
+     *         file that filled up is complete with the frames it took
+     */
+    bool Close();
+
+    bool Failed() const { return failed || full; }
+    uint64_t Frames() const { return totalFrames; }
+    const std::string& Path() const { return path; }
+
+private:
+    /**
+     * @brief A frame chunk: offset of its header in the file, data size
+     */
+    struct FrameEntry
+    {
+        uint64_t offset = 0;
+        uint32_t size = 0;
+    };
+
+    /**
+     * @brief A finished segment's standard index, for the super index
+     */
+    struct SegmentIndex
+    {
+        uint64_t offset = 0;
+        uint32_t size = 0;
+        uint32_t frames = 0;
+    };
+
+    /**
+     * @brief Everything in front of the first frame (RIFF, hdrl and the
+     *        movi list header), with the values known so far
+     */
+    std::vector<unsigned char> BuildHeader() const;
+
+    void StartSegment();
+    void EndSegment();
+    bool Put(const void* data, size_t size);
+    bool PutAt(uint64_t at, const std::vector<unsigned char>& data);
+
+    FILE* file = nullptr;
+    std::string path;
+    uint64_t offset = 0;                // End of the file
+    bool failed = false;                // A write failed
+    bool full = false;                  // AVI_MAX_SEGMENTS reached
+
+    unsigned int cols = 0;
+    unsigned int rows = 0;
+    uint32_t rate = 0;                  // Frame rate as rate / scale
+    uint32_t scale = 0;
+
+    uint64_t segmentStart = 0;          // RIFF chunk of the current segment
+    uint64_t moviStart = 0;             // Its movi list
+    std::vector<FrameEntry> segmentFrames;
+    std::vector<FrameEntry> firstSegmentFrames;     // For idx1
+    uint32_t firstRiffSize = 0;
+    uint32_t firstMoviSize = 0;
+    std::vector<SegmentIndex> segments;
+
+    uint64_t totalFrames = 0;
+    uint32_t maxFrameSize = 0;
+};
+
+/**
+ * @brief Puts the images of an export into AVI files in frame order;
+ *        thread safe
+ *
+ * A camera image that could not be encoded is replaced by that camera's
+ * previous frame (or, at the start, by its next one), so every file keeps
+ * one frame per exported frame and the timelines stay aligned.
+ */
+class VideoWriter : public OrderedImageSink
+{
+public:
+    VideoWriter() = default;
+    ~VideoWriter() override;
+
+    VideoWriter(const VideoWriter&) = delete;
+    VideoWriter& operator=(const VideoWriter&) = delete;
+
+    /**
+     * @param cameraFiles One file per camera (-x 6processed) instead of one
+     *        for the panoramas
+     * @param cols Size of every frame
+     * @return false (with a message) if a file cannot be created
+     */
+    bool Open(const std::string& path, bool cameraFiles, unsigned int cols, unsigned int rows, float frameRate);
+
+    bool Close() override;
+
+protected:
+    bool IsOpen() const override { return !files.empty(); }
+
+    /**
+     * @brief Append a frame to the file of its camera
+     */
+    void WriteImage(const std::string& name, unsigned int frameNum, int camera,
+                    const std::vector<unsigned char>& data) override;
+
+    /**
+     * @brief Repeat the camera's previous frame in place of the skipped one
+     */
+    void SkipImage(int camera) override;
+
+private:
+    /**
+     * @brief An output file and what it needs to fill in skipped frames
+     */
+    struct CameraVideo
+    {
+        std::unique_ptr<AviWriter> file;
+        std::vector<unsigned char> lastFrame;       // Repeated for a skipped image
+        unsigned int missingFrames = 0;             // Skipped before the first frame
+        uint64_t repeatedFrames = 0;
+    };
+
+    /**
+     * @brief Append a frame to a file, repeats included
+     */
+    void AddFrame(CameraVideo& video, const std::vector<unsigned char>& data);
+
+    CameraVideo* GetVideo(int camera);
+
+    std::vector<CameraVideo> files;                 // Per camera, or the panorama file
+};
@@ -0,0 +1,101 @@
+//=============================================================================
+// WorkerPool - Fixed set of threads for data-parallel loops over one frame
+//=============================================================================
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned int numThreads)
+{
+    if (numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned int i = 1; i < numThreads; i++)
+    {
+        threads.emplace_back(&WorkerPool::WorkerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void WorkerPool::Run(unsigned int numTasks, const std::function<void(unsigned int)>& task)
+{
+    RunIndexed(numTasks, [&task](unsigned int taskIndex, unsigned int) { task(taskIndex); });
+}
+
+void WorkerPool::RunIndexed(unsigned int numTasks, const std::function<void(unsigned int, unsigned int)>& task)
+{
+    if (threads.empty() || numTasks <= 1)
+    {
+        for (unsigned int i = 0; i < numTasks; i++)
+        {
+            task(i, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &task;
+        jobTasks = numTasks;
+        nextTask = 0;
+        busyWorkers = static_cast<unsigned int>(threads.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    RunTasks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]() { return busyWorkers == 0; });
+    job = nullptr;
+}
+
+void WorkerPool::WorkerLoop(unsigned int threadIndex)
+{
+    unsigned int seenGeneration = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seenGeneration]() { return stopping || generation != seenGeneration; });
+            if (stopping)
+            {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        RunTasks(threadIndex);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busyWorkers == 0)
+        {
+            finished.notify_one();
+        }
+    }
+}
+
+void WorkerPool::RunTasks(unsigned int threadIndex)
+{
+    unsigned int task;
+    while ((task = nextTask++) < jobTasks)
+    {
+        (*job)(task, threadIndex);
+    }
+}
@@ -0,0 +1,62 @@
+//=============================================================================
+// WorkerPool - Fixed set of threads for data-parallel loops over one frame
+//
+// Run(numTasks, task) calls task(0) .. task(numTasks - 1) on the pool's
+// threads and the calling thread and returns once all of them finished.
+// RunIndexed also passes the index of the thread running the task (0 is the
+// caller), so tasks can use per-thread state such as a decoder.
+// Stage objects own a pool so its threads stay alive from frame to frame
+// instead of being created per image.
+//=============================================================================
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+    /**
+     * @param numThreads Threads working on a Run, the caller included
+     *                   (0 = one per logical processor)
+     */
+    explicit WorkerPool(unsigned int numThreads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    unsigned int NumThreads() const { return static_cast<unsigned int>(threads.size()) + 1; }
+
+    /**
+     * @brief Run numTasks tasks and wait for them (one Run at a time)
+     */
+    void Run(unsigned int numTasks, const std::function<void(unsigned int)>& task);
+
+    /**
+     * @brief Run numTasks tasks as task(taskIndex, threadIndex), with
+     *        threadIndex below NumThreads(), and wait for them
+     */
+    void RunIndexed(unsigned int numTasks, const std::function<void(unsigned int, unsigned int)>& task);
+
+private:
+    void WorkerLoop(unsigned int threadIndex);
+    void RunTasks(unsigned int threadIndex);
+
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake;           // A new Run started, or shutdown
+    std::condition_variable finished;       // The last worker left the current Run
+    const std::function<void(unsigned int, unsigned int)>* job = nullptr;
+    unsigned int jobTasks = 0;
+    std::atomic<unsigned int> nextTask{0};
+    unsigned int generation = 0;            // Incremented by every Run
+    unsigned int busyWorkers = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,579 @@
+//=============================================================================
+// KernelBenchmarks - Microbenchmarks of the CPU pixel kernels
+//
+// Times the per-image kernels of the cpu backend on fixed-size synthetic
+// inputs, so a kernel change can be measured without a camera, a stream or
+// the rest of the pipeline:
+//
+//   demosaic/<method>/<8|16>bit    Demosaic of one 2448x2048 camera image
+//   demosaic/hq/6cam/t<N>          DemosaicEngine on six 16-bit images, N threads
+//   demosaic/planes/6cam/t<N>      DemosaicEngine building six 16-bit down4 textures
+//                                  from Bayer planes (JPEG streams), N threads
+//   bgru16-to-bgru[/gamma]         ConvertBgru16ToBgru of one camera texture, high
+//                                  byte or through a gamma 2.2 ToneCurve
+//   bgru16-to-bgru/6cam/t<N>       PixelConverter on the six textures, N threads
+//   remap/<bgru|bgru16>/t<N>       LutPanoramaRenderer, 2048x1024 panorama, N threads
+//   encode/<jpg|png>               JpegEncoder/LosslessEncoder of that panorama
+//   encode/jpg/<444|fast-dct|optimize>  JpegEncoder with that --jpeg-* setting
+//   encode/png/level1-rle/t<N>     PNG at zlib level 1 with Z_RLE, N strip threads
+//   encode/tiff/<lzw|deflate>      Compressed TIFF
+//
+// Each kernel runs once per instruction set level it has a code path for
+// (see the *_LEVELS tables) and the processor supports, with SetIsaLimit
+// selecting the path; the level is the last part of the benchmark name.
+// Besides time, every benchmark reports MPix/s (input pixels) and
+// bytes/cycle (input plus output bytes per cycle of the nominal clock that
+// Google Benchmark reports, so turbo clocks inflate it somewhat).
+//
+// Built with Google Benchmark, so the usual options apply, e.g.
+//   LadybugMicrobench --benchmark_filter=demosaic/hq --benchmark_format=json
+//=============================================================================
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "Demosaic.h"
+#include "ImageFile.h"
+#include "PanoramaLut.h"
+#include "PixelConvert.h"
+#include "SyntheticStream.h"
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+// Ladybug5 camera image and the default panorama size
+constexpr unsigned int IMAGE_COLS = 2448;
+constexpr unsigned int IMAGE_ROWS = 2048;
+constexpr unsigned int PANO_WIDTH = 2048;
+constexpr unsigned int PANO_HEIGHT = 1024;
+
+// Instruction set levels each kernel has a code path of its own for
+static const IsaLevel DEMOSAIC_LEVELS[] = { IsaLevel::Scalar, IsaLevel::AVX2 };
+static const IsaLevel PIXEL_CONVERT_LEVELS[] = { IsaLevel::Scalar, IsaLevel::SSE4, IsaLevel::AVX2, IsaLevel::AVX512 };
+static const IsaLevel TONE_CURVE_LEVELS[] = { IsaLevel::Scalar };
+static const IsaLevel REMAP_LEVELS[] = { IsaLevel::Scalar };
+static const IsaLevel ENCODE_LEVELS[] = { IsaLevel::Scalar };
+
+struct MethodName
+{
+    ColorMethod method;
+    const char* name;
+};
+
+// -c names of the debayering methods
+static const MethodName DEMOSAIC_METHODS[] =
+{
+    { ColorMethod::HqLinear, "hq" },
+    { ColorMethod::EdgeSensing, "edge" },
+    { ColorMethod::NearestNeighbor, "near" },
+    { ColorMethod::Downsample4, "down4" },
+    { ColorMethod::Downsample16, "down16" },
+    { ColorMethod::Mono, "mono" },
+};
+
+//=============================================================================
+// Synthetic Inputs
+//=============================================================================
+
+/**
+ * @brief Inputs shared by all benchmarks, built on first use
+ */
+struct KernelInputs
+{
+    BayerImage mosaic8[NUM_CAMERAS];
+    BayerImage mosaic16[NUM_CAMERAS];
+    std::vector<uint16_t> planes[NUM_CAMERAS][4];           // mosaic16 split by Bayer position
+    std::vector<unsigned char> textures8[NUM_CAMERAS];      // HqLinear BGRU
+    std::vector<unsigned char> textures16[NUM_CAMERAS];     // HqLinear BGRU16
+    std::shared_ptr<const PanoramaLut> lut;
+    std::vector<unsigned char> panoBuffer;                  // Rendered from textures8
+    ImageView panorama;
+};
+
+static const KernelInputs& GetInputs()
+{
+    static std::unique_ptr<KernelInputs> inputs;
+    if (inputs != nullptr)
+    {
+        return *inputs;
+    }
+
+    inputs.reset(new KernelInputs());
+    std::vector<uint16_t> samples(static_cast<size_t>(IMAGE_COLS) * IMAGE_ROWS);
+    const size_t texturePixels = static_cast<size_t>(IMAGE_COLS) * IMAGE_ROWS;
+
+    for (int cam = 0; cam < NUM_CAMERAS; cam++)
+    {
+        FillSyntheticMosaic(IMAGE_COLS, IMAGE_ROWS, cam, 0, PGR_STIPPLED_RGGB, samples.data());
+
+        BayerImage& mosaic8 = inputs->mosaic8[cam];
+        BayerImage& mosaic16 = inputs->mosaic16[cam];
+        mosaic8.Resize(IMAGE_COLS, IMAGE_ROWS, false, BayerPattern::RGGB);
+        mosaic16.Resize(IMAGE_COLS, IMAGE_ROWS, true, BayerPattern::RGGB);
+        for (unsigned int y = 0; y < IMAGE_ROWS; y++)
+        {
+            const uint16_t* in = samples.data() + static_cast<size_t>(y) * IMAGE_COLS;
+            uint8_t* row8 = mosaic8.Row8(y);
+            uint16_t* row16 = mosaic16.Row16(y);
+            for (unsigned int x = 0; x < IMAGE_COLS; x++)
+            {
+                row8[x] = static_cast<uint8_t>(in[x] >> 8);
+                row16[x] = in[x];
+            }
+        }
+        mosaic8.FillBorder();
+        mosaic16.FillBorder();
+
+        for (unsigned int k = 0; k < 4; k++)
+        {
+            std::vector<uint16_t>& plane = inputs->planes[cam][k];
+            plane.resize(static_cast<size_t>(IMAGE_COLS / 2) * (IMAGE_ROWS / 2));
+            for (unsigned int y = 0; y < IMAGE_ROWS / 2; y++)
+            {
+                const uint16_t* in = mosaic16.Row16(2 * y + (k >> 1)) + (k & 1);
+                for (unsigned int x = 0; x < IMAGE_COLS / 2; x++)
+                {
+                    plane[static_cast<size_t>(y) * (IMAGE_COLS / 2) + x] = in[2 * x];
+                }
+            }
+        }
+
+        inputs->textures8[cam].resize(texturePixels * GetBytesPerPixel(PixelFormat::BGRU));
+        inputs->textures16[cam].resize(texturePixels * GetBytesPerPixel(PixelFormat::BGRU16));
+        Demosaic(mosaic8, ColorMethod::HqLinear, inputs->textures8[cam].data(), PixelFormat::BGRU);
+        Demosaic(mosaic16, ColorMethod::HqLinear, inputs->textures16[cam].data(), PixelFormat::BGRU16);
+    }
+
+    PanoramaLutParams params;
+    params.panoWidth = PANO_WIDTH;
+    params.panoHeight = PANO_HEIGHT;
+    params.textureWidth = IMAGE_COLS;
+    params.textureHeight = IMAGE_ROWS;
+    params.blendingWidth = 100.0;
+    inputs->lut = BuildPanoramaLut(NominalCameraModel(IMAGE_COLS, IMAGE_ROWS), params, 0);
+
+    const unsigned char* textures[NUM_CAMERAS];
+    for (int cam = 0; cam < NUM_CAMERAS; cam++)
+    {
+        textures[cam] = inputs->textures8[cam].data();
+    }
+    LutPanoramaRenderer renderer(inputs->lut, 0);
+    renderer.Render(textures, PixelFormat::BGRU, inputs->panoBuffer, inputs->panorama);
+    return *inputs;
+}
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+/**
+ * @brief Times one iteration and hands the time to the framework (manual timing)
+ */
+class IterationTimer
+{
+public:
+    IterationTimer(benchmark::State& state, double& totalSeconds)
+        : state(state), totalSeconds(totalSeconds), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~IterationTimer()
+    {
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        state.SetIterationTime(seconds);
+        totalSeconds += seconds;
+    }
+
+    IterationTimer(const IterationTimer&) = delete;
+    IterationTimer& operator=(const IterationTimer&) = delete;
+
+private:
+    benchmark::State& state;
+    double& totalSeconds;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * @brief Add the MPix/s and bytes/cycle counters for the work of one iteration
+ */
+static void SetThroughput(benchmark::State& state, double totalSeconds, double pixels, double bytes)
+{
+    if (totalSeconds <= 0.0)
+    {
+        return;
+    }
+    const double iterationsPerSecond = state.iterations() / totalSeconds;
+    const double cyclesPerSecond = benchmark::CPUInfo::Get().cycles_per_second;
+    state.counters["MPix/s"] = pixels * iterationsPerSecond / 1e6;
+    state.counters["bytes/cycle"] = cyclesPerSecond > 0.0 ? bytes * iterationsPerSecond / cyclesPerSecond : 0.0;
+    state.SetBytesProcessed(static_cast<int64_t>(bytes * state.iterations()));
+}
+
+/**
+ * @brief Register a benchmark once per level in levels that the processor supports
+ */
+template <size_t N, typename Function>
+static void RegisterPerLevel(const std::string& name, const IsaLevel (&levels)[N], Function function)
+{
+    for (IsaLevel level : levels)
+    {
+        if (level > GetSupportedIsaLevel())
+        {
+            continue;
+        }
+        benchmark::RegisterBenchmark((name + "/" + GetIsaName(level)).c_str(),
+                                     [level, function](benchmark::State& state)
+                                     {
+                                         SetIsaLimit(level);
+                                         function(state);
+                                         SetIsaLimit(static_cast<IsaLevel>(NUM_ISA_LEVELS - 1));
+                                     })
+            ->Unit(benchmark::kMillisecond)
+            ->UseManualTime();
+    }
+}
+
+//=============================================================================
+// Benchmarks
+//=============================================================================
+
+static void BenchmarkDemosaic(benchmark::State& state, ColorMethod method, bool is16Bit)
+{
+    const KernelInputs& inputs = GetInputs();
+    const BayerImage& mosaic = is16Bit ? inputs.mosaic16[0] : inputs.mosaic8[0];
+    const PixelFormat format = is16Bit ? PixelFormat::BGRU16 : PixelFormat::BGRU;
+
+    unsigned int textureWidth;
+    unsigned int textureHeight;
+    GetTextureSize(method, IMAGE_COLS, IMAGE_ROWS, textureWidth, textureHeight);
+    const size_t textureBytes = static_cast<size_t>(textureWidth) * textureHeight * GetBytesPerPixel(format);
+    std::vector<unsigned char> texture(textureBytes);
+
+    double seconds = 0.0;
+    for (auto _ : state)
+    {
+        IterationTimer timer(state, seconds);
+        Demosaic(mosaic, method, texture.data(), format);
+        benchmark::DoNotOptimize(texture.data());
+        benchmark::ClobberMemory();
+    }
+
+    const double pixels = static_cast<double>(IMAGE_COLS) * IMAGE_ROWS;
+    SetThroughput(state, seconds, pixels, pixels * (is16Bit ? 2 : 1) + textureBytes);
+}
+
+static void BenchmarkDemosaicFrame(benchmark::State& state, unsigned int numThreads)
+{
+    const KernelInputs& inputs = GetInputs();
+    DemosaicEngine engine(numThreads);
+    const size_t textureBytes = static_cast<size_t>(IMAGE_COLS) * IMAGE_ROWS * GetBytesPerPixel(PixelFormat::BGRU16);
+
+    std::vector<unsigned char> buffers[NUM_CAMERAS];
+    const BayerImage* mosaics[NUM_CAMERAS];
+    unsigned char* textures[NUM_CAMERAS];
+    for (int cam = 0; cam < NUM_CAMERAS; cam++)
+    {
+        buffers[cam].resize(textureBytes);
+        mosaics[cam] = &inputs.mosaic16[cam];
+        textures[cam] = buffers[cam].data();
+    }
+
+    double seconds = 0.0;
+    for (auto _ : state)
+    {
+        IterationTimer timer(state, seconds);
+        engine.Run(mosaics, textures, NUM_CAMERAS, ColorMethod::HqLinear, PixelFormat::BGRU16);
+        benchmark::ClobberMemory();
+    }
+
+    const double pixels = static_cast<double>(IMAGE_COLS) * IMAGE_ROWS * NUM_CAMERAS;
+    SetThroughput(state, seconds, pixels, pixels * 2 + static_cast<double>(textureBytes) * NUM_CAMERAS);
+}
+
+static void BenchmarkPlanesFrame(benchmark::State& state, unsigned int numThreads)
+{
+    const KernelInputs& inputs = GetInputs();
+    DemosaicEngine engine(numThreads);
+    const unsigned int cols = IMAGE_COLS / 2;
+    const unsigned int rows = IMAGE_ROWS / 2;
+    const size_t textureBytes = static_cast<size_t>(cols) * rows * GetBytesPerPixel(PixelFormat::BGRU16);
+
+    std::vector<unsigned char> buffers[NUM_CAMERAS];
+    BayerPlanes planes[NUM_CAMERAS];
+    unsigned char* textures[NUM_CAMERAS];
+    for (int cam = 0; cam < NUM_CAMERAS; cam++)
+    {
+        buffers[cam].resize(textureBytes);
+        textures[cam] = buffers[cam].data();
+        for (unsigned int k = 0; k < 4; k++)
+        {
+            planes[cam].planes[k] = inputs.planes[cam][k].data();
+        }
+        planes[cam].stride = cols;
+        planes[cam].cols = cols;
+        planes[cam].rows = rows;
+        planes[cam].is16Bit = true;
+        planes[cam].pattern = BayerPattern::RGGB;
+    }
+
+    double seconds = 0.0;
+    for (auto _ : state)
+    {
+        IterationTimer timer(state, seconds);
+        engine.Run(planes, textures, NUM_CAMERAS, PixelFormat::BGRU16);
+        benchmark::ClobberMemory();
+    }
+
+    const double pixels = static_cast<double>(IMAGE_COLS) * IMAGE_ROWS * NUM_CAMERAS;
+    SetThroughput(state, seconds, pixels, pixels * 2 + static_cast<double>(textureBytes) * NUM_CAMERAS);
+}
+
+static void BenchmarkPixelConvert(benchmark::State& state, const ToneCurve* curve)
+{
+    const KernelInputs& inputs = GetInputs();
+    const size_t numPixels = static_cast<size_t>(IMAGE_COLS) * IMAGE_ROWS;
+    std::vector<unsigned char> out(numPixels * GetBytesPerPixel(PixelFormat::BGRU));
+
+    double seconds = 0.0;
+    for (auto _ : state)
+    {
+        IterationTimer timer(state, seconds);
+        ConvertBgru16ToBgru(reinterpret_cast<const uint16_t*>(inputs.textures16[0].data()), out.data(), numPixels,
+                            curve);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+
+    SetThroughput(state, seconds, static_cast<double>(numPixels),
+                  static_cast<double>(numPixels) * (GetBytesPerPixel(PixelFormat::BGRU16) +
+                                                    GetBytesPerPixel(PixelFormat::BGRU)));
+}
+
+static void BenchmarkFrameConvert(benchmark::State& state, unsigned int numThreads)
+{
+    const KernelInputs& inputs = GetInputs();
+    const size_t numPixels = static_cast<size_t>(IMAGE_COLS) * IMAGE_ROWS;
+    PixelConverter converter(numThreads, nullptr);
+
+    // The conversion is in place, so each iteration starts from a fresh copy
+    std::vector<unsigned char> buffers[NUM_CAMERAS];
+    unsigned char* textures[NUM_CAMERAS];
+    double seconds = 0.0;
+    for (auto _ : state)
+    {
+        for (int cam = 0; cam < NUM_CAMERAS; cam++)
+        {
+            buffers[cam] = inputs.textures16[cam];
+            textures[cam] = buffers[cam].data();
+        }
+
+        IterationTimer timer(state, seconds);
+        converter.ReduceTo8Bit(textures, IMAGE_COLS, IMAGE_ROWS);
+        benchmark::ClobberMemory();
+    }
+
+    const double pixels = static_cast<double>(numPixels) * NUM_CAMERAS;
+    SetThroughput(state, seconds, pixels,
+                  pixels * (GetBytesPerPixel(PixelFormat::BGRU16) + GetBytesPerPixel(PixelFormat::BGRU)));
+}
+
+static void BenchmarkRemap(benchmark::State& state, bool is16Bit, unsigned int numThreads)
+{
+    const KernelInputs& inputs = GetInputs();
+    const PixelFormat format = is16Bit ? PixelFormat::BGRU16 : PixelFormat::BGRU;
+    const unsigned char* textures[NUM_CAMERAS];
+    for (int cam = 0; cam < NUM_CAMERAS; cam++)
+    {
+        textures[cam] = is16Bit ? inputs.textures16[cam].data() : inputs.textures8[cam].data();
+    }
+
+    LutPanoramaRenderer renderer(inputs.lut, numThreads);
+    std::vector<unsigned char> panoBuffer;
+    ImageView panorama;
+    double seconds = 0.0;
+    for (auto _ : state)
+    {
+        IterationTimer timer(state, seconds);
+        renderer.Render(textures, format, panoBuffer, panorama);
+        benchmark::DoNotOptimize(panoBuffer.data());
+        benchmark::ClobberMemory();
+    }
+
+    // Per output pixel: the table entries, four texels per sample and the BGR result
+    const double pixels = static_cast<double>(PANO_WIDTH) * PANO_HEIGHT;
+    const double bytesPerPixel = PANORAMA_SAMPLES_PER_PIXEL * (sizeof(PanoramaSample) + 4.0 * GetBytesPerPixel(format)) +
+                                 GetBytesPerPixel(PixelFormat::BGR);
+    SetThroughput(state, seconds, pixels, pixels * bytesPerPixel);
+}
+
+static void BenchmarkEncode(benchmark::State& state, ImageFileFormat format, const JpegOptions& jpegOptions,
+                            const LosslessOptions& losslessOptions)
+{
+    const KernelInputs& inputs = GetInputs();
+    const char* extension = (format == ImageFileFormat::JPG) ? ".jpg" : (format == ImageFileFormat::PNG) ? ".png" : ".tif";
+    const std::string path = (std::filesystem::temp_directory_path() / (std::string("LadybugMicrobench") + extension)).string();
+
+    // One encoder for all iterations, as an encoder thread keeps it
+    JpegEncoder jpegEncoder(jpegOptions);
+    LosslessEncoder losslessEncoder(losslessOptions);
+    double seconds = 0.0;
+    for (auto _ : state)
+    {
+        IterationTimer timer(state, seconds);
+        bool written = false;
+        switch (format)
+        {
+        case ImageFileFormat::JPG:  written = jpegEncoder.Write(inputs.panorama, path); break;
+        case ImageFileFormat::PNG:  written = losslessEncoder.WritePng(inputs.panorama, path); break;
+        case ImageFileFormat::TIFF: written = losslessEncoder.WriteTiff(inputs.panorama, path); break;
+        default:                    written = WriteImageFile(inputs.panorama, path, format); break;
+        }
+        if (!written)
+        {
+            state.SkipWithError("Encoder not available in this build");
+            break;
+        }
+    }
+
+    std::error_code error;
+    const size_t fileBytes = static_cast<size_t>(std::filesystem::file_size(path, error));
+    std::filesystem::remove(path, error);
+
+    const double pixels = static_cast<double>(inputs.panorama.cols) * inputs.panorama.rows;
+    SetThroughput(state, seconds, pixels, pixels * GetBytesPerPixel(PixelFormat::BGR) + fileBytes);
+    state.counters["KiB"] = static_cast<double>(fileBytes) / 1024.0;
+}
+
+//=============================================================================
+// Main Entry Point
+//=============================================================================
+
+int main(int argc, char* argv[])
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::AddCustomContext("isa", GetIsaName(GetSupportedIsaLevel()));
+    benchmark::AddCustomContext("image", std::to_string(IMAGE_COLS) + "x" + std::to_string(IMAGE_ROWS));
+    benchmark::AddCustomContext("panorama", std::to_string(PANO_WIDTH) + "x" + std::to_string(PANO_HEIGHT));
+
+    for (const MethodName& method : DEMOSAIC_METHODS)
+    {
+        for (bool is16Bit : { false, true })
+        {
+            const ColorMethod colorMethod = method.method;
+            RegisterPerLevel(std::string("demosaic/") + method.name + (is16Bit ? "/16bit" : "/8bit"),
+                             DEMOSAIC_LEVELS,
+                             [colorMethod, is16Bit](benchmark::State& state)
+                             {
+                                 BenchmarkDemosaic(state, colorMethod, is16Bit);
+                             });
+        }
+    }
+
+    // Single-threaded (kernel cost) and with every logical processor
+    std::vector<unsigned int> threadCounts = { 1 };
+    if (std::thread::hardware_concurrency() > 1)
+    {
+        threadCounts.push_back(std::thread::hardware_concurrency());
+    }
+    for (unsigned int numThreads : threadCounts)
+    {
+        RegisterPerLevel("demosaic/hq/6cam/t" + std::to_string(numThreads), DEMOSAIC_LEVELS,
+                         [numThreads](benchmark::State& state) { BenchmarkDemosaicFrame(state, numThreads); });
+        RegisterPerLevel("demosaic/planes/6cam/t" + std::to_string(numThreads), DEMOSAIC_LEVELS,
+                         [numThreads](benchmark::State& state) { BenchmarkPlanesFrame(state, numThreads); });
+    }
+
+    std::shared_ptr<const ToneCurve> gamma;
+    ToneCurve::Create("gamma:2.2", gamma);
+    RegisterPerLevel("bgru16-to-bgru", PIXEL_CONVERT_LEVELS,
+                     [](benchmark::State& state) { BenchmarkPixelConvert(state, nullptr); });
+    RegisterPerLevel("bgru16-to-bgru/gamma", TONE_CURVE_LEVELS,
+                     [gamma](benchmark::State& state) { BenchmarkPixelConvert(state, gamma.get()); });
+
+    for (unsigned int numThreads : threadCounts)
+    {
+        RegisterPerLevel("bgru16-to-bgru/6cam/t" + std::to_string(numThreads), PIXEL_CONVERT_LEVELS,
+                         [numThreads](benchmark::State& state) { BenchmarkFrameConvert(state, numThreads); });
+    }
+    for (bool is16Bit : { false, true })
+    {
+        for (unsigned int numThreads : threadCounts)
+        {
+            RegisterPerLevel(std::string("remap/") + (is16Bit ? "bgru16" : "bgru") + "/t" + std::to_string(numThreads),
+                             REMAP_LEVELS,
+                             [is16Bit, numThreads](benchmark::State& state)
+                             {
+                                 BenchmarkRemap(state, is16Bit, numThreads);
+                             });
+        }
+    }
+
+    JpegOptions jpeg444;
+    jpeg444.subsampling = JpegSubsampling::S444;
+    JpegOptions jpegFastDct;
+    jpegFastDct.fastDct = true;
+    JpegOptions jpegOptimize;
+    jpegOptimize.optimizeCoding = true;
+    const std::pair<const char*, JpegOptions> jpegVariants[] = {
+        { "encode/jpg", JpegOptions() },
+        { "encode/jpg/444", jpeg444 },
+        { "encode/jpg/fast-dct", jpegFastDct },
+        { "encode/jpg/optimize", jpegOptimize },
+    };
+    for (const auto& variant : jpegVariants)
+    {
+        const JpegOptions jpegOptions = variant.second;
+        RegisterPerLevel(variant.first, ENCODE_LEVELS,
+                         [jpegOptions](benchmark::State& state)
+                         {
+                             BenchmarkEncode(state, ImageFileFormat::JPG, jpegOptions, LosslessOptions());
+                         });
+    }
+
+    RegisterPerLevel("encode/png", ENCODE_LEVELS,
+                     [](benchmark::State& state)
+                     {
+                         BenchmarkEncode(state, ImageFileFormat::PNG, JpegOptions(), LosslessOptions());
+                     });
+    for (unsigned int numThreads : threadCounts)
+    {
+        LosslessOptions fastPng;
+        fastPng.zlibLevel = 1;
+        fastPng.zlibStrategy = ZlibStrategy::Rle;
+        fastPng.stripThreads = numThreads;
+        RegisterPerLevel("encode/png/level1-rle/t" + std::to_string(numThreads), ENCODE_LEVELS,
+                         [fastPng](benchmark::State& state)
+                         {
+                             BenchmarkEncode(state, ImageFileFormat::PNG, JpegOptions(), fastPng);
+                         });
+    }
+    for (TiffCompression compression : { TiffCompression::Lzw, TiffCompression::Deflate })
+    {
+        LosslessOptions tiff;
+        tiff.tiffCompression = compression;
+        RegisterPerLevel(std::string("encode/tiff/") + (compression == TiffCompression::Lzw ? "lzw" : "deflate"),
+                         ENCODE_LEVELS,
+                         [tiff](benchmark::State& state)
+                         {
+                             BenchmarkEncode(state, ImageFileFormat::TIFF, JpegOptions(), tiff);
+                         });
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
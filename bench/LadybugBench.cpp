@@ -0,0 +1,662 @@
+//=============================================================================
+// LadybugBench - End-to-end benchmark of LadybugExport on synthetic streams
+//
+// For every data format asked for, writes a synthetic stream (see
+// SyntheticStream.h), runs the exporter on it once per export type (6 camera
+// images and panorama) with --report, and collects the run reports into one
+// JSON results file. Needs neither a camera nor the SDK: the exporter is run
+// with the cpu backend unless told otherwise.
+//
+// The results file lists the settings of the benchmark followed by one entry
+// per format and export type, holding the exporter's run report (stage
+// timings, frames per second, bytes read and written). Keys and order are
+// fixed, so results of two releases can be compared with diff or a script.
+//
+// Usage:
+//   LadybugBench [--formats LIST] [--resolution N] [--frames N] [OPTIONS]
+//=============================================================================
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SyntheticStream.h"
+
+namespace fs = std::filesystem;
+
+#ifndef LADYBUG_EXPORT_VERSION
+#define LADYBUG_EXPORT_VERSION "unknown"
+#endif
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+struct BenchFormat
+{
+    const char* name;
+    uint32_t dataFormat;
+};
+
+// Formats in the order they are run and reported
+static const BenchFormat BENCH_FORMATS[] =
+{
+    { "raw8", PGR_DATAFORMAT_RAW8 },
+    { "raw8-half", PGR_DATAFORMAT_HALF_HEIGHT_RAW8 },
+    { "raw12", PGR_DATAFORMAT_RAW12 },
+    { "raw12-half", PGR_DATAFORMAT_HALF_HEIGHT_RAW12 },
+    { "raw16", PGR_DATAFORMAT_RAW16 },
+    { "raw16-half", PGR_DATAFORMAT_HALF_HEIGHT_RAW16 },
+    { "jpeg8", PGR_DATAFORMAT_COLOR_SEP_JPEG8 },
+    { "jpeg8-half", PGR_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG8 },
+    { "jpeg12", PGR_DATAFORMAT_COLOR_SEP_JPEG12 },
+    { "jpeg12-half", PGR_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG12 },
+};
+
+static const char* const EXPORT_TYPES[] = { "6processed", "panorama" };
+
+#ifdef _WIN32
+static const char EXPORTER_NAME[] = "LadybugExport.exe";
+#else
+static const char EXPORTER_NAME[] = "LadybugExport";
+#endif
+
+//=============================================================================
+// Command Line
+//=============================================================================
+
+struct BenchArgs
+{
+    std::vector<const BenchFormat*> formats;
+    std::vector<std::string> exportTypes;
+    uint32_t resolution = 4;                // 1024x768
+    unsigned int numFrames = 10;
+    std::string exporter;                   // Default: next to this program
+    std::string backend = "cpu";
+    std::string imageFormat = "jpg";        // -f
+    std::string colorProcessing;            // -c, exporter default if empty
+    std::string panoSize = "2048x1024";     // -w
+    std::string cacheDir = "none";          // --cache-dir of the exporter
+    std::vector<std::string> extraArgs;     // Appended to every exporter run
+    std::string workDir = "bench_work";
+    std::string outputPath = "bench_results.json";
+    bool generateOnly = false;
+    bool keepFiles = false;
+};
+
+static void PrintUsage(const char* programName)
+{
+    printf("\nUsage:\n\n");
+    printf("%s [OPTIONS]\n\n", programName);
+    printf("Generates synthetic streams and times LadybugExport on them.\n\n");
+    printf("OPTIONS\n\n");
+    printf("  --formats LIST     Comma-separated data formats, or 'all' (default):\n");
+    printf("                     ");
+    for (const BenchFormat& format : BENCH_FORMATS)
+    {
+        printf("%s ", format.name);
+    }
+    printf("\n");
+    printf("  --exports LIST     Comma-separated export types: 6processed, panorama.\n");
+    printf("                     Default is both.\n");
+    printf("  --resolution N     Camera image size as a LadybugResolution value\n");
+    printf("                     (0 = 128x96 ... 4 = 1024x768 ... 8 = 2448x2048).\n");
+    printf("                     Default is 4.\n");
+    printf("  --frames N         Frames per stream. Default is 10.\n");
+    printf("  --exporter PATH    LadybugExport executable. Default is the one next to\n");
+    printf("                     this program.\n");
+    printf("  --backend NAME     Exporter --backend. Default is cpu.\n");
+    printf("  -f FORMAT          Exporter output image format. Default is jpg.\n");
+    printf("  -c COLOR_PROCESS   Exporter debayering method. Default is the exporter's.\n");
+    printf("  -w NNNNxNNNN       Panorama size. Default is 2048x1024.\n");
+    printf("  --cache-dir DIR    Exporter remap table cache. Default is none, so every\n");
+    printf("                     panorama run builds its table (counted as setup).\n");
+    printf("  --extra \"ARGS\"     Extra exporter arguments, e.g. \"--pipeline-depth 8\".\n");
+    printf("  --work-dir DIR     Where streams and outputs are written.\n");
+    printf("                     Default is bench_work.\n");
+    printf("  --output FILE      Results file (JSON). Default is bench_results.json.\n");
+    printf("  --generate-only    Only write the streams (kept in the work directory).\n");
+    printf("  --keep-files       Keep the streams and exported images.\n");
+    printf("\n");
+}
+
+/**
+ * @brief Split a comma-separated list
+ */
+static std::vector<std::string> SplitList(const std::string& list, char separator)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, separator))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static bool ParseBenchArgs(int argc, char* argv[], BenchArgs& args)
+{
+    std::string formatList = "all";
+    std::string exportList = "6processed,panorama";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "-?" || arg == "-h" || arg == "--help")
+        {
+            PrintUsage(argv[0]);
+            return false;
+        }
+        else if (arg == "--generate-only")
+        {
+            args.generateOnly = true;
+            continue;
+        }
+        else if (arg == "--keep-files")
+        {
+            args.keepFiles = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            printf("Error: Unknown option or missing value: %s\n", arg.c_str());
+            return false;
+        }
+
+        const char* param = argv[++i];
+        if (arg == "--formats")
+        {
+            formatList = param;
+        }
+        else if (arg == "--exports")
+        {
+            exportList = param;
+        }
+        else if (arg == "--resolution")
+        {
+            args.resolution = static_cast<uint32_t>(atoi(param));
+        }
+        else if (arg == "--frames")
+        {
+            const int frames = atoi(param);
+            if (frames < 1)
+            {
+                printf("Error: --frames must be at least 1\n");
+                return false;
+            }
+            args.numFrames = static_cast<unsigned int>(frames);
+        }
+        else if (arg == "--exporter")
+        {
+            args.exporter = param;
+        }
+        else if (arg == "--backend")
+        {
+            args.backend = param;
+        }
+        else if (arg == "-f")
+        {
+            args.imageFormat = param;
+        }
+        else if (arg == "-c")
+        {
+            args.colorProcessing = param;
+        }
+        else if (arg == "-w")
+        {
+            args.panoSize = param;
+        }
+        else if (arg == "--cache-dir")
+        {
+            args.cacheDir = param;
+        }
+        else if (arg == "--extra")
+        {
+            args.extraArgs = SplitList(param, ' ');
+        }
+        else if (arg == "--work-dir")
+        {
+            args.workDir = param;
+        }
+        else if (arg == "--output")
+        {
+            args.outputPath = param;
+        }
+        else
+        {
+            printf("Error: Unknown option: %s\n", arg.c_str());
+            return false;
+        }
+    }
+
+    unsigned int cols;
+    unsigned int rows;
+    if (!GetPgrResolutionSize(args.resolution, cols, rows))
+    {
+        printf("Error: Unknown resolution %u\n", args.resolution);
+        return false;
+    }
+
+    for (const std::string& name : SplitList(formatList, ','))
+    {
+        bool found = false;
+        for (const BenchFormat& format : BENCH_FORMATS)
+        {
+            if (name == "all" || name == format.name)
+            {
+                args.formats.push_back(&format);
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            printf("Error: Unknown format: %s\n", name.c_str());
+            return false;
+        }
+    }
+
+    for (const std::string& name : SplitList(exportList, ','))
+    {
+        if (name != EXPORT_TYPES[0] && name != EXPORT_TYPES[1])
+        {
+            printf("Error: Unknown export type: %s\n", name.c_str());
+            return false;
+        }
+        args.exportTypes.push_back(name);
+    }
+
+    if (args.formats.empty() || (args.exportTypes.empty() && !args.generateOnly))
+    {
+        printf("Error: Nothing to run\n");
+        return false;
+    }
+
+    if (args.exporter.empty())
+    {
+        args.exporter = (fs::path(argv[0]).parent_path() / EXPORTER_NAME).string();
+    }
+    return true;
+}
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+/**
+ * @brief Quote a string for JSON
+ */
+static std::string JsonString(const std::string& value)
+{
+    std::string quoted = "\"";
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+/**
+ * @brief Quote one argument for the shell std::system runs
+ */
+static std::string QuoteShellArgument(const std::string& arg)
+{
+#ifdef _WIN32
+    return "\"" + arg + "\"";
+#else
+    std::string quoted = "'";
+    for (char c : arg)
+    {
+        if (c == '\'')
+        {
+            quoted += "'\\''";
+        }
+        else
+        {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+#endif
+}
+
+/**
+ * @brief Run a program with its output sent to a log file
+ * @return Its exit code, or -1 if it could not be run or crashed
+ */
+static int RunCommand(const std::vector<std::string>& command, const std::string& logPath)
+{
+    std::string line;
+    for (const std::string& arg : command)
+    {
+        line += QuoteShellArgument(arg) + " ";
+    }
+    line += "> " + QuoteShellArgument(logPath) + " 2>&1";
+
+#ifdef _WIN32
+    // cmd.exe strips the outer quotes of a line that starts with one
+    return std::system(("\"" + line + "\"").c_str());
+#else
+    const int status = std::system(line.c_str());
+    if (status == -1 || !WIFEXITED(status))
+    {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+#endif
+}
+
+static bool ReadTextFile(const std::string& path, std::string& text)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+
+    text.clear();
+    char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    {
+        text.append(buffer, count);
+    }
+    fclose(fp);
+    return true;
+}
+
+/**
+ * @brief Value of a top-level number in a run report, 0 if missing
+ */
+static double FindReportNumber(const std::string& report, const char* key)
+{
+    const std::string quotedKey = std::string("\"") + key + "\":";
+    const size_t pos = report.find(quotedKey);
+    if (pos == std::string::npos)
+    {
+        return 0.0;
+    }
+    return strtod(report.c_str() + pos + quotedKey.size(), nullptr);
+}
+
+//=============================================================================
+// Benchmark
+//=============================================================================
+
+struct BenchRun
+{
+    const BenchFormat* format = nullptr;
+    std::string exportType;
+    std::string status;                 // "ok", "failed" or "skipped"
+    std::string reason;                 // Why a run was skipped or failed
+    uint64_t streamBytes = 0;
+    int exitCode = 0;
+    double wallSeconds = 0.0;
+    std::string report;                 // The exporter's JSON run report
+};
+
+/**
+ * @brief Export one stream with --report and time it
+ */
+static void RunExport(const BenchArgs& args, const std::string& streamPath, const std::string& runName,
+                      BenchRun& run)
+{
+    const fs::path workDir(args.workDir);
+    const std::string outputDir = (workDir / runName).string();
+    const std::string reportPath = (workDir / (runName + ".report.json")).string();
+    const std::string logPath = (workDir / (runName + ".log")).string();
+    fs::remove(reportPath);
+
+    std::vector<std::string> command =
+    {
+        args.exporter, "-i", streamPath, "-o", outputDir, "-f", args.imageFormat,
+        "--backend", args.backend, "--cache-dir", args.cacheDir, "--report", reportPath
+    };
+    if (run.exportType == "6processed")
+    {
+        command.insert(command.end(), { "-x", "6processed" });
+    }
+    else
+    {
+        command.insert(command.end(), { "-w", args.panoSize });
+    }
+    if (!args.colorProcessing.empty())
+    {
+        command.insert(command.end(), { "-c", args.colorProcessing });
+    }
+    command.insert(command.end(), args.extraArgs.begin(), args.extraArgs.end());
+
+    const auto start = std::chrono::steady_clock::now();
+    run.exitCode = RunCommand(command, logPath);
+    run.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!ReadTextFile(reportPath, run.report))
+    {
+        run.report.clear();
+    }
+    while (!run.report.empty() && (run.report.back() == '\n' || run.report.back() == '\r'))
+    {
+        run.report.pop_back();
+    }
+
+    if (run.exitCode != 0 || run.report.empty())
+    {
+        run.status = "failed";
+        run.reason = "exporter exited with code " + std::to_string(run.exitCode) + ", see " + logPath;
+    }
+    else
+    {
+        run.status = "ok";
+    }
+
+    if (!args.keepFiles)
+    {
+        std::error_code error;
+        fs::remove_all(outputDir, error);
+    }
+}
+
+static void PrintRun(const BenchRun& run)
+{
+    if (run.status != "ok")
+    {
+        printf("%-12s %-11s %s (%s)\n", run.format->name, run.exportType.c_str(), run.status.c_str(),
+               run.reason.c_str());
+        return;
+    }
+    printf("%-12s %-11s %7.0f %9.2f %10.1f %10.1f %8.2f %8.2f\n", run.format->name, run.exportType.c_str(),
+           FindReportNumber(run.report, "framesExported"), FindReportNumber(run.report, "framesPerSecond"),
+           FindReportNumber(run.report, "readMBPerSecond"), FindReportNumber(run.report, "writeMBPerSecond"),
+           FindReportNumber(run.report, "setupSeconds"), run.wallSeconds);
+}
+
+static bool WriteResults(const BenchArgs& args, const std::vector<BenchRun>& runs)
+{
+    FILE* fp = fopen(args.outputPath.c_str(), "w");
+    if (fp == nullptr)
+    {
+        printf("Error: Could not create %s\n", args.outputPath.c_str());
+        return false;
+    }
+
+    unsigned int cols = 0;
+    unsigned int rows = 0;
+    GetPgrResolutionSize(args.resolution, cols, rows);
+
+    std::string extraArgs;
+    for (const std::string& arg : args.extraArgs)
+    {
+        extraArgs += (extraArgs.empty() ? "" : " ") + arg;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"benchmark\": \"LadybugBench\",\n");
+    fprintf(fp, "  \"version\": %s,\n", JsonString(LADYBUG_EXPORT_VERSION).c_str());
+    fprintf(fp, "  \"resolution\": %u,\n", args.resolution);
+    fprintf(fp, "  \"imageCols\": %u,\n", cols);
+    fprintf(fp, "  \"imageRows\": %u,\n", rows);
+    fprintf(fp, "  \"frames\": %u,\n", args.numFrames);
+    fprintf(fp, "  \"backend\": %s,\n", JsonString(args.backend).c_str());
+    fprintf(fp, "  \"imageFormat\": %s,\n", JsonString(args.imageFormat).c_str());
+    fprintf(fp, "  \"colorProcessing\": %s,\n", JsonString(args.colorProcessing).c_str());
+    fprintf(fp, "  \"panoSize\": %s,\n", JsonString(args.panoSize).c_str());
+    fprintf(fp, "  \"extraArgs\": %s,\n", JsonString(extraArgs).c_str());
+    fprintf(fp, "  \"hardwareThreads\": %u,\n", std::thread::hardware_concurrency());
+    fprintf(fp, "  \"runs\": [");
+
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        const BenchRun& run = runs[i];
+        fprintf(fp, "%s\n    {\"format\": %s, \"dataFormat\": %u, \"exportType\": %s, \"status\": %s",
+                i > 0 ? "," : "", JsonString(run.format->name).c_str(), run.format->dataFormat,
+                JsonString(run.exportType).c_str(), JsonString(run.status).c_str());
+        if (!run.reason.empty())
+        {
+            fprintf(fp, ", \"reason\": %s", JsonString(run.reason).c_str());
+        }
+        if (run.status != "skipped")
+        {
+            fprintf(fp, ", \"streamBytes\": %llu, \"exitCode\": %d, \"wallSeconds\": %.3f",
+                    static_cast<unsigned long long>(run.streamBytes), run.exitCode, run.wallSeconds);
+        }
+        if (!run.report.empty())
+        {
+            fprintf(fp, ",\n     \"report\": %s", run.report.c_str());
+        }
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+
+    if (fclose(fp) != 0)
+    {
+        printf("Error: Could not write %s\n", args.outputPath.c_str());
+        return false;
+    }
+    printf("Results written to %s\n", args.outputPath.c_str());
+    return true;
+}
+
+//=============================================================================
+// Main Entry Point
+//=============================================================================
+
+int main(int argc, char* argv[])
+{
+    BenchArgs args;
+    if (!ParseBenchArgs(argc, argv, args))
+    {
+        return 1;
+    }
+
+    std::error_code error;
+    fs::create_directories(args.workDir, error);
+    if (error)
+    {
+        printf("Error: Could not create %s\n", args.workDir.c_str());
+        return 1;
+    }
+
+    if (!args.generateOnly && !fs::exists(args.exporter))
+    {
+        printf("Error: Exporter not found: %s (use --exporter)\n", args.exporter.c_str());
+        return 1;
+    }
+
+    unsigned int cols = 0;
+    unsigned int rows = 0;
+    GetPgrResolutionSize(args.resolution, cols, rows);
+    printf("Synthetic streams: %ux%u, %u frames\n", cols, rows, args.numFrames);
+    if (!args.generateOnly)
+    {
+        printf("\n%-12s %-11s %7s %9s %10s %10s %8s %8s\n", "format", "export", "frames", "frames/s",
+               "read MB/s", "write MB/s", "setup s", "wall s");
+    }
+
+    std::vector<BenchRun> runs;
+    bool allOk = true;
+
+    for (const BenchFormat* format : args.formats)
+    {
+        const std::string streamPath = (fs::path(args.workDir) / (std::string(format->name) + "-000000.pgr")).string();
+
+        SyntheticStreamOptions streamOptions;
+        streamOptions.dataFormat = format->dataFormat;
+        streamOptions.resolution = args.resolution;
+        streamOptions.numFrames = args.numFrames;
+
+        std::string skipReason;
+        if (!IsSyntheticFormatSupported(format->dataFormat))
+        {
+            skipReason = "not supported by this build";
+        }
+        else if (!WriteSyntheticStream(streamPath, streamOptions))
+        {
+            skipReason = "stream could not be written";
+            allOk = false;
+        }
+
+        if (args.generateOnly)
+        {
+            printf("%-12s %s\n", format->name, skipReason.empty() ? streamPath.c_str() : skipReason.c_str());
+            continue;
+        }
+
+        for (const std::string& exportType : args.exportTypes)
+        {
+            BenchRun run;
+            run.format = format;
+            run.exportType = exportType;
+
+            if (!skipReason.empty())
+            {
+                run.status = "skipped";
+                run.reason = skipReason;
+            }
+            else
+            {
+                run.streamBytes = static_cast<uint64_t>(fs::file_size(streamPath, error));
+                RunExport(args, streamPath, std::string(format->name) + "-" + exportType, run);
+                allOk = allOk && run.status == "ok";
+            }
+
+            PrintRun(run);
+            runs.push_back(run);
+        }
+
+        if (!args.keepFiles)
+        {
+            // The exporter leaves a frame index next to the stream
+            fs::remove(streamPath, error);
+            fs::remove(streamPath + ".idx", error);
+        }
+    }
+
+    if (!args.generateOnly)
+    {
+        printf("\n");
+        if (!WriteResults(args, runs))
+        {
+            return 1;
+        }
+    }
+
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,443 @@
+//=============================================================================
+// SyntheticStream - Writes artificial Ladybug .pgr streams for benchmarking
+//=============================================================================
+
+#include "SyntheticStream.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csetjmp>
+#include <vector>
+
+#ifdef USE_LIBJPEG
+#include <jpeglib.h>
+#include "JpegSupport.h"
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER) && LIBJPEG_TURBO_VERSION_NUMBER >= 3000000
+#define SYNTH_JPEG12_SUPPORTED
+#endif
+#endif
+
+//=============================================================================
+// Constants
+//=============================================================================
+
+static const char PGR_SIGNATURE[] = "PGRLADYBUGSTREAM";
+constexpr size_t PGR_SIGNATURE_SIZE = 16;
+
+// Header field offsets (see PgrStreamReader.h)
+constexpr size_t PGR_OFFSET_VERSION = 0x0010;
+constexpr size_t PGR_OFFSET_SERIAL_BASE = 0x0018;
+constexpr size_t PGR_OFFSET_SERIAL_HEAD = 0x001C;
+constexpr size_t PGR_OFFSET_PADDING_BLOCK = 0x0084;
+constexpr size_t PGR_OFFSET_DATA_FORMAT = 0x0088;
+constexpr size_t PGR_OFFSET_RESOLUTION = 0x008C;
+constexpr size_t PGR_OFFSET_STIPPLED_FORMAT = 0x0090;
+constexpr size_t PGR_OFFSET_NUM_IMAGES = 0x0098;
+constexpr size_t PGR_OFFSET_STREAM_DATA = 0x00A4;
+constexpr size_t PGR_OFFSET_FRAME_RATE = 0x00C0;
+
+// Written streams: version 7 (float frame rate), frames on 512-byte blocks
+constexpr uint32_t SYNTH_STREAM_VERSION = 7;
+constexpr uint32_t SYNTH_PADDING_BLOCK = 512;
+constexpr uint32_t SYNTH_STREAM_DATA_OFFSET = 512;
+
+// Scene: blocks of BLOCK_SIZE pixels, panning PAN_PER_FRAME pixels a frame
+constexpr unsigned int BLOCK_SIZE = 48;
+constexpr unsigned int PAN_PER_FRAME = 6;
+
+// Colour (0 = R, 1 = G, 2 = B) of each position of the 2x2 Bayer tile,
+// indexed by PgrStippledFormat
+static const int TILE_COLORS[4][4] =
+{
+    { 2, 1, 1, 0 },     // BGGR
+    { 1, 2, 0, 1 },     // GBRG
+    { 1, 0, 2, 1 },     // GRBG
+    { 0, 1, 1, 2 },     // RGGB
+};
+
+// R, G, B gains (1/256) of the three block colours
+static const unsigned int BLOCK_GAINS[3][3] =
+{
+    { 256, 200, 120 },
+    { 140, 220, 256 },
+    { 230, 256, 180 },
+};
+
+//=============================================================================
+// Helper Functions
+//=============================================================================
+
+static void WriteLE32(unsigned char* p, uint32_t value)
+{
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+static void WriteBE32(unsigned char* p, uint32_t value)
+{
+    p[0] = (unsigned char)(value >> 24);
+    p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8);
+    p[3] = (unsigned char)value;
+}
+
+/**
+ * @brief Storage of a data format: sample bits, colour separation, half height
+ */
+static bool DescribeSyntheticFormat(uint32_t dataFormat, unsigned int& bits, bool& colorSeparated,
+                                    bool& halfHeight)
+{
+    bits = 8;
+    colorSeparated = false;
+    halfHeight = false;
+
+    switch (dataFormat)
+    {
+    case PGR_DATAFORMAT_RAW8:
+        break;
+    case PGR_DATAFORMAT_HALF_HEIGHT_RAW8:
+        halfHeight = true;
+        break;
+    case PGR_DATAFORMAT_RAW12:
+        bits = 12;
+        break;
+    case PGR_DATAFORMAT_HALF_HEIGHT_RAW12:
+        bits = 12;
+        halfHeight = true;
+        break;
+    case PGR_DATAFORMAT_RAW16:
+        bits = 16;
+        break;
+    case PGR_DATAFORMAT_HALF_HEIGHT_RAW16:
+        bits = 16;
+        halfHeight = true;
+        break;
+#ifdef USE_LIBJPEG
+    case PGR_DATAFORMAT_COLOR_SEP_JPEG8:
+        colorSeparated = true;
+        break;
+    case PGR_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG8:
+        colorSeparated = true;
+        halfHeight = true;
+        break;
+#endif
+#ifdef SYNTH_JPEG12_SUPPORTED
+    case PGR_DATAFORMAT_COLOR_SEP_JPEG12:
+        bits = 12;
+        colorSeparated = true;
+        break;
+    case PGR_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG12:
+        bits = 12;
+        colorSeparated = true;
+        halfHeight = true;
+        break;
+#endif
+    default:
+        return false;
+    }
+    return true;
+}
+
+bool IsSyntheticFormatSupported(uint32_t dataFormat)
+{
+    unsigned int bits;
+    bool colorSeparated;
+    bool halfHeight;
+    return DescribeSyntheticFormat(dataFormat, bits, colorSeparated, halfHeight);
+}
+
+//=============================================================================
+// Scene
+//=============================================================================
+
+void FillSyntheticMosaic(unsigned int cols, unsigned int rows, unsigned int camera, unsigned int frame,
+                         uint32_t stippledFormat, uint16_t* out)
+{
+    const int* tileColors = TILE_COLORS[stippledFormat & 3];
+
+    for (unsigned int y = 0; y < rows; y++)
+    {
+        // Brightness ramp from the top (dark) to the bottom of the image
+        const unsigned int ramp = 8192 + static_cast<unsigned int>(40960ull * y / rows);
+
+        for (unsigned int x = 0; x < cols; x++)
+        {
+            const unsigned int sceneX = x + frame * PAN_PER_FRAME;
+            const unsigned int block = (sceneX / BLOCK_SIZE + y / BLOCK_SIZE + camera) % 3;
+            const int color = tileColors[(y & 1) * 2 + (x & 1)];
+
+            // Hash of the position and view, as sensor noise
+            uint32_t hash = sceneX * 73856093u ^ y * 19349663u ^ (frame * 6 + camera) * 83492791u;
+            hash ^= hash >> 13;
+            hash *= 0x5BD1E995u;
+            hash ^= hash >> 15;
+
+            const unsigned int value = ramp * BLOCK_GAINS[block][color] / 256 + (hash & 0x3FF);
+            out[static_cast<size_t>(y) * cols + x] = static_cast<uint16_t>(value > 0xFFFF ? 0xFFFF : value);
+        }
+    }
+}
+
+//=============================================================================
+// JPEG Plane Encoder
+//=============================================================================
+
+#ifdef USE_LIBJPEG
+
+/**
+ * @brief Encodes greyscale plane JPEGs, reusing one compressor
+ */
+class JpegPlaneEncoder
+{
+public:
+    JpegPlaneEncoder()
+    {
+        cinfo.err = InitJpegErrorManager(errorManager);
+        jpeg_create_compress(&cinfo);
+    }
+
+    ~JpegPlaneEncoder()
+    {
+        jpeg_destroy_compress(&cinfo);
+    }
+
+    JpegPlaneEncoder(const JpegPlaneEncoder&) = delete;
+    JpegPlaneEncoder& operator=(const JpegPlaneEncoder&) = delete;
+
+    /**
+     * @brief Encode one Bayer position (0-3) of a 16-bit mosaic as an 8- or 12-bit JPEG
+     */
+    bool Encode(const uint16_t* mosaic, unsigned int mosaicCols, unsigned int mosaicRows, int position,
+                unsigned int bits, int quality, std::vector<unsigned char>& out)
+    {
+        const unsigned int cols = mosaicCols / 2;
+        const unsigned int rows = mosaicRows / 2;
+        const unsigned int offsetX = position & 1;
+        const unsigned int offsetY = position >> 1;
+
+#ifndef SYNTH_JPEG12_SUPPORTED
+        (void)bits;
+#endif
+
+        // The destination buffer is a member so it survives the longjmp
+        buffer = nullptr;
+        bufferSize = 0;
+        if (setjmp(errorManager.jump))
+        {
+            jpeg_abort_compress(&cinfo);
+            free(buffer);
+            return false;
+        }
+
+        jpeg_mem_dest(&cinfo, &buffer, &bufferSize);
+        cinfo.image_width = cols;
+        cinfo.image_height = rows;
+        cinfo.input_components = 1;
+        cinfo.in_color_space = JCS_GRAYSCALE;
+        jpeg_set_defaults(&cinfo);
+#ifdef SYNTH_JPEG12_SUPPORTED
+        if (bits == 12)
+        {
+            // The standard Huffman tables do not cover 12-bit coefficients
+            cinfo.data_precision = 12;
+            cinfo.optimize_coding = TRUE;
+        }
+#endif
+        jpeg_set_quality(&cinfo, quality, TRUE);
+        jpeg_start_compress(&cinfo, TRUE);
+
+#ifdef SYNTH_JPEG12_SUPPORTED
+        if (bits == 12)
+        {
+            row12.resize(cols);
+            while (cinfo.next_scanline < cinfo.image_height)
+            {
+                const uint16_t* in = mosaic + static_cast<size_t>(cinfo.next_scanline * 2 + offsetY) * mosaicCols;
+                for (unsigned int x = 0; x < cols; x++)
+                {
+                    row12[x] = static_cast<J12SAMPLE>(in[x * 2 + offsetX] >> 4);
+                }
+                J12SAMPROW rowPointer = row12.data();
+                jpeg12_write_scanlines(&cinfo, &rowPointer, 1);
+            }
+        }
+        else
+#endif
+        {
+            row8.resize(cols);
+            while (cinfo.next_scanline < cinfo.image_height)
+            {
+                const uint16_t* in = mosaic + static_cast<size_t>(cinfo.next_scanline * 2 + offsetY) * mosaicCols;
+                for (unsigned int x = 0; x < cols; x++)
+                {
+                    row8[x] = static_cast<JSAMPLE>(in[x * 2 + offsetX] >> 8);
+                }
+                JSAMPROW rowPointer = row8.data();
+                jpeg_write_scanlines(&cinfo, &rowPointer, 1);
+            }
+        }
+        jpeg_finish_compress(&cinfo);
+
+        out.assign(buffer, buffer + bufferSize);
+        free(buffer);
+        return true;
+    }
+
+private:
+    jpeg_compress_struct cinfo;
+    JpegErrorManager errorManager;
+    unsigned char* buffer = nullptr;
+    unsigned long bufferSize = 0;
+    std::vector<JSAMPLE> row8;
+#ifdef SYNTH_JPEG12_SUPPORTED
+    std::vector<J12SAMPLE> row12;
+#endif
+};
+
+#endif
+
+//=============================================================================
+// Stream Writer
+//=============================================================================
+
+/**
+ * @brief Pack a 16-bit mosaic into the single plane of a RAW format
+ */
+static void PackRawPlane(const std::vector<uint16_t>& mosaic, unsigned int bits, std::vector<unsigned char>& out)
+{
+    const size_t samples = mosaic.size();
+    if (bits == 8)
+    {
+        out.resize(samples);
+        for (size_t i = 0; i < samples; i++)
+        {
+            out[i] = static_cast<unsigned char>(mosaic[i] >> 8);
+        }
+    }
+    else if (bits == 16)
+    {
+        out.resize(samples * 2);
+        for (size_t i = 0; i < samples; i++)
+        {
+            out[i * 2] = static_cast<unsigned char>(mosaic[i] >> 8);
+            out[i * 2 + 1] = static_cast<unsigned char>(mosaic[i]);
+        }
+    }
+    else
+    {
+        // 12-bit, two samples in three bytes: a[11:4], a[3:0] | b[3:0] << 4, b[11:4]
+        out.resize(samples / 2 * 3);
+        for (size_t i = 0, o = 0; i + 1 < samples; i += 2, o += 3)
+        {
+            const unsigned int a = mosaic[i] >> 4;
+            const unsigned int b = mosaic[i + 1] >> 4;
+            out[o] = static_cast<unsigned char>(a >> 4);
+            out[o + 1] = static_cast<unsigned char>((a & 0x0F) | ((b & 0x0F) << 4));
+            out[o + 2] = static_cast<unsigned char>(b >> 4);
+        }
+    }
+}
+
+bool WriteSyntheticStream(const std::string& path, const SyntheticStreamOptions& options)
+{
+    unsigned int bits;
+    bool colorSeparated;
+    bool halfHeight;
+    if (!DescribeSyntheticFormat(options.dataFormat, bits, colorSeparated, halfHeight))
+    {
+        printf("Error: Cannot generate streams of data format %u in this build\n", options.dataFormat);
+        return false;
+    }
+
+    unsigned int cols;
+    unsigned int rows;
+    if (!GetPgrResolutionSize(options.resolution, cols, rows))
+    {
+        printf("Error: Unknown stream resolution %u\n", options.resolution);
+        return false;
+    }
+    const unsigned int storedRows = halfHeight ? rows / 2 : rows;
+
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (fp == nullptr)
+    {
+        printf("Error: Could not create %s\n", path.c_str());
+        return false;
+    }
+
+    // Stream header, padded up to the first frame
+    std::vector<unsigned char> header(SYNTH_STREAM_DATA_OFFSET, 0);
+    memcpy(header.data(), PGR_SIGNATURE, PGR_SIGNATURE_SIZE);
+    WriteLE32(&header[PGR_OFFSET_VERSION], SYNTH_STREAM_VERSION);
+    WriteLE32(&header[PGR_OFFSET_SERIAL_BASE], options.serialBase);
+    WriteLE32(&header[PGR_OFFSET_SERIAL_HEAD], options.serialHead);
+    WriteLE32(&header[PGR_OFFSET_PADDING_BLOCK], SYNTH_PADDING_BLOCK);
+    WriteLE32(&header[PGR_OFFSET_DATA_FORMAT], options.dataFormat);
+    WriteLE32(&header[PGR_OFFSET_RESOLUTION], options.resolution);
+    WriteLE32(&header[PGR_OFFSET_STIPPLED_FORMAT], options.stippledFormat);
+    WriteLE32(&header[PGR_OFFSET_NUM_IMAGES], options.numFrames);
+    WriteLE32(&header[PGR_OFFSET_STREAM_DATA], SYNTH_STREAM_DATA_OFFSET);
+    uint32_t frameRateBits;
+    memcpy(&frameRateBits, &options.frameRate, sizeof(frameRateBits));
+    WriteLE32(&header[PGR_OFFSET_FRAME_RATE], frameRateBits);
+    bool ok = fwrite(header.data(), 1, header.size(), fp) == header.size();
+
+#ifdef USE_LIBJPEG
+    JpegPlaneEncoder encoder;
+#endif
+    std::vector<uint16_t> mosaic(static_cast<size_t>(cols) * storedRows);
+    std::vector<std::vector<unsigned char>> planes(PGR_NUM_PLANES);
+    std::vector<unsigned char> frame;
+
+    for (unsigned int frameNum = 0; ok && frameNum < options.numFrames; frameNum++)
+    {
+        for (int cam = 0; ok && cam < PGR_NUM_CAMERAS; cam++)
+        {
+            FillSyntheticMosaic(cols, storedRows, cam, frameNum, options.stippledFormat, mosaic.data());
+            if (!colorSeparated)
+            {
+                PackRawPlane(mosaic, bits, planes[cam * PGR_PLANES_PER_CAMERA]);
+                continue;
+            }
+#ifdef USE_LIBJPEG
+            for (int k = 0; ok && k < PGR_PLANES_PER_CAMERA; k++)
+            {
+                if (!encoder.Encode(mosaic.data(), cols, storedRows, k, bits, options.jpegQuality,
+                                    planes[cam * PGR_PLANES_PER_CAMERA + k]))
+                {
+                    printf("Error: Could not encode frame %u camera %d\n", frameNum, cam);
+                    ok = false;
+                }
+            }
+#endif
+        }
+        if (!ok)
+        {
+            break;
+        }
+
+        // Image header with the plane table, then the planes back to back
+        frame.assign(PGR_IMAGE_HEADER_SIZE, 0);
+        for (int i = 0; i < PGR_NUM_PLANES; i++)
+        {
+            const uint32_t offset = planes[i].empty() ? 0 : static_cast<uint32_t>(frame.size());
+            WriteBE32(&frame[PGR_PLANE_TABLE_OFFSET + i * 8], offset);
+            WriteBE32(&frame[PGR_PLANE_TABLE_OFFSET + i * 8 + 4], static_cast<uint32_t>(planes[i].size()));
+            frame.insert(frame.end(), planes[i].begin(), planes[i].end());
+        }
+        frame.resize((frame.size() + SYNTH_PADDING_BLOCK - 1) / SYNTH_PADDING_BLOCK * SYNTH_PADDING_BLOCK, 0);
+
+        ok = fwrite(frame.data(), 1, frame.size(), fp) == frame.size();
+    }
+
+    if (fclose(fp) != 0 || !ok)
+    {
+        printf("Error: Could not write stream %s\n", path.c_str());
+        remove(path.c_str());
+        return false;
+    }
+    return true;
+}
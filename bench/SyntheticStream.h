@@ -0,0 +1,51 @@
+//=============================================================================
+// SyntheticStream - Writes artificial Ladybug .pgr streams for benchmarking
+//
+// Produces streams in the container layout documented in PgrStreamReader.h,
+// so the exporter can be run end to end without a camera or the SDK. Every
+// camera image is a Bayer mosaic of a simple scene (a vertical brightness
+// ramp, coloured blocks and a little noise) that pans sideways from frame to
+// frame. The content is deterministic: the same options always give the
+// same file, and JPEG planes compress about as well as real footage.
+//
+// Supported data formats: RAW8, RAW12, RAW16 and their HALF_HEIGHT
+// variants; COLOR_SEP_JPEG8 (and half height) with libjpeg; COLOR_SEP_JPEG12
+// (and half height) with libjpeg-turbo 3 or later.
+//=============================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "PgrStreamReader.h"
+
+struct SyntheticStreamOptions
+{
+    uint32_t dataFormat = PGR_DATAFORMAT_RAW8;
+    uint32_t resolution = 4;                    // LadybugResolution (4 = 1024x768)
+    unsigned int numFrames = 10;
+    uint32_t stippledFormat = PGR_STIPPLED_RGGB;
+    int jpegQuality = 90;                       // COLOR_SEP_JPEG formats
+    uint32_t serialBase = 11100000;
+    uint32_t serialHead = 22200000;
+    float frameRate = 15.0f;
+};
+
+/**
+ * @brief Whether this build can write streams of a data format
+ */
+bool IsSyntheticFormatSupported(uint32_t dataFormat);
+
+/**
+ * @brief Fill a cols x rows Bayer mosaic of the synthetic scene with 16-bit samples
+ * @param camera, frame Select the view; the scene pans by a few pixels per frame
+ */
+void FillSyntheticMosaic(unsigned int cols, unsigned int rows, unsigned int camera, unsigned int frame,
+                         uint32_t stippledFormat, uint16_t* out);
+
+/**
+ * @brief Write a stream file
+ * @return false (with a message) for unsupported formats or I/O errors
+ */
+bool WriteSyntheticStream(const std::string& path, const SyntheticStreamOptions& options);
@@ -10,39 +10,78 @@
 // Usage (compatible with ladybugProcessStream.exe):
 //   LadybugExport.exe -i stream.pgr -o output_prefix [OPTIONS]
 //
-// Platform: Windows x64
+// Platform: Windows x64 (Ladybug SDK backend), Windows or Linux (CPU backend)
 //=============================================================================
 
+#ifdef _WIN32
 #include <windows.h>
 #include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include <sys/stat.h>
+#include <cerrno>
 #include <iostream>
 #include <string>
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
 #include <cmath>
 #include <sstream>
 #include <iomanip>
 #include <regex>
-
-//=============================================================================
-// Ladybug SDK headers
-//=============================================================================
-#include <ladybug.h>
-#include <ladybugrenderer.h>
-#include <ladybuggeom.h>
-#include <ladybugstream.h>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <future>
+
+#include "BoundedQueue.h"
+#include "ImageArchive.h"
+#include "ImagingBackend.h"
+#include "ImageFile.h"
+#include "PipeOutput.h"
+#include "PixelConvert.h"
+#include "RunStats.h"
+#include "SharedRing.h"
+#include "StreamSegments.h"
+#include "VideoOutput.h"
+#include "ShardCoordinator.h"
 
 //=============================================================================
 // Constants
 //=============================================================================
 
-// Pi constant for angle conversions
-constexpr double PI = 3.14159265358979323846;
-
 // Default panorama dimensions
 constexpr int DEFAULT_PANO_WIDTH = 2048;
 constexpr int DEFAULT_PANO_HEIGHT = 1024;
 
+// Default number of frames in flight through the processing pipeline
+constexpr int DEFAULT_PIPELINE_DEPTH = 4;
+
+// Encoded images queued per encoder thread before the write stage blocks
+constexpr int ENCODE_JOBS_PER_THREAD = 2;
+
+// Default number of frames the --shm-ring holds for its reader
+constexpr int DEFAULT_SHM_SLOTS = 4;
+
+// Default seconds the --shm-ring waits for a reader that shows no sign of life
+constexpr int DEFAULT_SHM_TIMEOUT = 10;
+
+// Separator between the output folder and file names
+#ifdef _WIN32
+constexpr char PATH_SEPARATOR = '\\';
+#else
+constexpr char PATH_SEPARATOR = '/';
+#endif
+
+#ifndef MAX_PATH
+#define MAX_PATH 4096
+#endif
+
 //=============================================================================
 // Command-Line Arguments Structure (matches ladybugProcessStream.exe)
 //=============================================================================
@@ -86,54 +125,122 @@ struct CommandLineArgs
     float rotY = 0.0f;                      // Euler rotation Y
     float rotZ = 0.0f;                      // Euler rotation Z
     
+    // --pipeline-depth N : Frames in flight between read/convert/render/write
+    int pipelineDepth = DEFAULT_PIPELINE_DEPTH;
+    
+    // --encode-threads N : Images encoded and written concurrently (0 = auto)
+    int encodeThreads = 0;
+    
+    // --backend sdk|cpu : Imaging backend for convert/render/write
+    std::string backend = GetDefaultBackendName();
+    
+    // --renderer gpu|cpu : Panorama renderer (cpu = remap table, no OpenGL)
+    bool cpuRenderer = false;
+    
+    // --render-threads N : Threads per panorama for the CPU renderer (0 = auto)
+    int renderThreads = 0;
+    
+    // --cache-dir DIR|none : Where CPU renderer remap tables are kept between runs
+    std::string cacheDir;                   // Empty = GetDefaultCacheDirectory()
+    bool useCache = true;
+    
+    // --decode-threads N : Threads decoding a frame's JPEG planes (0 = auto)
+    int decodeThreads = 0;
+    
+    // --demosaic-threads N : Threads debayering a frame's cameras (0 = auto)
+    int demosaicThreads = 0;
+    
+    // --convert-threads N : Cameras reduced from 16 to 8 bits at once (0 = auto)
+    int convertThreads = 0;
+    
+    // --tone-curve linear|gamma:G|srgb|FILE : 16 to 8 bit mapping of 6 camera exports
+    std::string toneCurveSpec = "linear";
+    std::shared_ptr<const ToneCurve> toneCurve;     // Created from toneCurveSpec, null = linear
+    
+    // --bit-depth 8|16 : Sample depth of 6 camera PNG/TIFF images of high bit depth streams
+    int bitDepth = 8;
+    
+    // --jpeg-passthrough true|false : Repack camera JPEGs instead of decoding (6 camera down4 JPG export)
+    bool jpegPassthrough = false;
+    
+    // --jpeg-quality N, --jpeg-subsampling 444|422|420, --jpeg-fast-dct true|false,
+    // --jpeg-optimize true|false : Native JPEG encoder settings
+    JpegOptions jpeg;
+    bool jpegOptionsGiven = false;      // Any of them was given (the sdk backend then encodes natively)
+    
+    // --zlib-level N, --zlib-strategy S, --png-filter F, --tiff-compression C :
+    // Native PNG/TIFF writer settings
+    LosslessOptions lossless;
+    bool losslessOptionsGiven = false;  // As jpegOptionsGiven, for PNG and TIFF
+    
+    // --strip-threads N : Threads compressing the row strips of one PNG/TIFF image (0 = auto)
+    int stripThreads = 1;
+    
+    // --reader sdk|native : Frame source for the read stage
+    bool nativeReader = false;
+    
+    // --segments all|single : Process the whole recording set or only -i
+    bool allSegments = true;
+    
+    // --shards N : Split the frame range across N worker processes
+    int numShards = 1;
+    int shardChunk = DEFAULT_SHARD_CHUNK;   // --shard-chunk N : Frames per work item
+    bool shardWorker = false;               // --shard-worker : Run as a coordinator's worker
+    
+    // --sessions N : Split the frame range across N export sessions in this process
+    int numSessions = 1;
+    
+    // --report FILE : Write per-stage timings and throughput as JSON
+    std::string reportPath;
+    
+    // --trace FILE : Write a Chrome trace-event timeline of the pipeline
+    std::string tracePath;
+    
+    // --archive FILE : Put every image into one tar file instead of the output directory
+    std::string archivePath;
+    
+    // --output-pipe FILE|- (or -o -) : Stream the images in frame order to a FIFO or stdout
+    std::string outputPipe;
+    
+    // --video FILE : Encode the panoramas (or each camera) into a Motion JPEG AVI file
+    std::string videoPath;
+    
+    // --shm-ring NAME : Publish the raw images to a shared-memory ring instead of encoding them
+    std::string shmRing;
+    int shmSlots = DEFAULT_SHM_SLOTS;       // --shm-slots N : Frames in the ring
+    int shmTimeout = DEFAULT_SHM_TIMEOUT;   // --shm-timeout SECONDS : Wait for an unresponsive reader
+    
     // Extracted base name from PGR file for output naming
     std::string pgrBaseName;                // Base name extracted from input PGR file
 };
 
 //=============================================================================
-// Global Variables (following SDK sample pattern)
-//=============================================================================
-
-LadybugContext context = nullptr;
-LadybugStreamContext streamContext = nullptr;
-LadybugStreamHeadInfo streamHeaderInfo;
-LadybugImage image;
-unsigned int textureWidth = 0;
-unsigned int textureHeight = 0;
-unsigned char* textureBuffers[LADYBUG_NUM_CAMERAS] = {nullptr};
-bool isHighBitDepth = false;  // True for 12/16-bit formats
-char tempConfigPath[MAX_PATH] = {0};
-
-//=============================================================================
-// Helper Macro for Error Checking
+// Export Session
+//
+// Everything an export needs besides its options: the imaging backend, the
+// stage objects it created and the stream geometry. Nothing is process-wide,
+// so several sessions (--sessions N) can run side by side in one process,
+// each with its own backend and buffers.
 //=============================================================================
 
-#define CHECK_ERROR(error, functionName) \
-    if (error != LADYBUG_OK) { \
-        printf("Error [%s]: %s\n", functionName, ladybugErrorToString(error)); \
-        return error; \
-    }
+struct ExportSession
+{
+    std::unique_ptr<ImagingBackend> backend;
+    std::unique_ptr<FrameStream> stream;        // Read stage
+    std::unique_ptr<FrameConverter> converter;  // Convert stage
+    StreamInfo info;
+    RunStats* stats = nullptr;                  // Stage timers (--report, --trace), shared by all sessions
+    ImageSink* sink = nullptr;                  // --archive, --output-pipe or --video, shared by all sessions
+    SharedRingWriter* ring = nullptr;           // --shm-ring (single session)
+
+    // Recording set (one entry per -NNNNNN.pgr segment, global frame numbers)
+    std::vector<StreamSegment> streamSegments;
+};
 
 //=============================================================================
 // Helper Functions
 //=============================================================================
 
-/**
- * @brief Check if data format is high bit depth (12/16 bit)
- */
-bool IsHighBitDepthFormat(LadybugDataFormat format)
-{
-    return (
-        format == LADYBUG_DATAFORMAT_RAW12 ||
-        format == LADYBUG_DATAFORMAT_HALF_HEIGHT_RAW12 ||
-        format == LADYBUG_DATAFORMAT_COLOR_SEP_JPEG12 ||
-        format == LADYBUG_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG12 ||
-        format == LADYBUG_DATAFORMAT_COLOR_SEP_JPEG12_PROCESSED ||
-        format == LADYBUG_DATAFORMAT_COLOR_SEP_HALF_HEIGHT_JPEG12_PROCESSED ||
-        format == LADYBUG_DATAFORMAT_RAW16 ||
-        format == LADYBUG_DATAFORMAT_HALF_HEIGHT_RAW16);
-}
-
 /**
  * @brief Extract base name from PGR file path for output naming
  * 
@@ -180,6 +287,35 @@ int strncmpCaseInsensitive(const char* s1, const char* s2, size_t n)
     return 0;
 }
 
+/**
+ * @brief Per-user cache location for remap tables
+ *
+ * %LOCALAPPDATA%\LadybugExport\Cache on Windows, $XDG_CACHE_HOME/LadybugExport
+ * or ~/.cache/LadybugExport elsewhere; empty if none of them is set.
+ */
+std::string GetDefaultCacheDirectory()
+{
+#ifdef _WIN32
+    const char* localAppData = getenv("LOCALAPPDATA");
+    if (localAppData != nullptr && localAppData[0] != '\0')
+    {
+        return std::string(localAppData) + "\\LadybugExport\\Cache";
+    }
+#else
+    const char* cacheHome = getenv("XDG_CACHE_HOME");
+    if (cacheHome != nullptr && cacheHome[0] != '\0')
+    {
+        return std::string(cacheHome) + "/LadybugExport";
+    }
+    const char* home = getenv("HOME");
+    if (home != nullptr && home[0] != '\0')
+    {
+        return std::string(home) + "/.cache/LadybugExport";
+    }
+#endif
+    return std::string();
+}
+
 /**
  * @brief Prints usage information (compatible with ladybugProcessStream.exe style)
  */
@@ -222,6 +358,105 @@ void PrintUsage(const char* programName)
     printf("  -b NNN             Blending width in pixel. Default is 100.\n");
     printf("  -s true/false      Enable software rendering. Default is false.\n");
     printf("  -k true/false      Enable anti-aliasing. Default is false.\n");
+    printf("  --pipeline-depth N Number of frames processed concurrently by the\n");
+    printf("                     read/convert/render/write stages. Default is %d.\n", DEFAULT_PIPELINE_DEPTH);
+    printf("  --encode-threads N Number of images encoded and written concurrently.\n");
+    printf("                     Default is half the logical processors.\n");
+    printf("  --backend BACKEND  Imaging backend (default is %s):\n", GetDefaultBackendName());
+    printf("              sdk      - Ladybug SDK (debayer, GPU panorama, save)\n");
+    printf("              cpu      - in-tree CPU code, no SDK required\n");
+    printf("  --renderer RENDERER Panorama renderer:\n");
+    printf("              gpu      - ladybugRenderOffScreenImage, needs OpenGL (default)\n");
+    printf("              cpu      - precomputed remap table, multithreaded, no GPU\n");
+    printf("                         (always used by the cpu backend)\n");
+    printf("  --render-threads N Threads per panorama for the CPU renderer.\n");
+    printf("                     Default is all logical processors.\n");
+    printf("  --cache-dir DIR    Directory the CPU renderer caches its remap tables in,\n");
+    printf("                     keyed by head serial, calibration, texture size and\n");
+    printf("                     blending width. 'none' disables the cache.\n");
+    printf("                     Default is %s.\n", GetDefaultCacheDirectory().c_str());
+    printf("  --decode-threads N Threads decoding the 24 JPEG planes of a frame\n");
+    printf("                     (cpu backend). Default is all logical processors.\n");
+    printf("  --demosaic-threads N Threads debayering the six cameras of a frame\n");
+    printf("                     (cpu backend). Default is all logical processors.\n");
+    printf("  --convert-threads N Cameras converted from 16 to 8 bits at once when\n");
+    printf("                     exporting high bit depth streams. Default is all\n");
+    printf("                     logical processors, at most 6.\n");
+    printf("  --tone-curve CURVE 16 to 8 bit mapping of high bit depth camera images:\n");
+    printf("              linear   - keep the high byte, as the SDK does (default)\n");
+    printf("              gamma:G  - encode with gamma G, e.g. gamma:2.2\n");
+    printf("              srgb     - sRGB transfer function\n");
+    printf("              FILE     - text file of 2 to 65536 output values (0-255)\n");
+    printf("  --bit-depth 8|16   Bits per sample of 6 camera PNG/TIFF images. 16 writes\n");
+    printf("                     the 12/16-bit textures of high bit depth streams as\n");
+    printf("                     they are, without the 8-bit conversion. Default is 8.\n");
+    printf("  --jpeg-passthrough true|false  With -x 6processed -f jpg -c down4 and no\n");
+    printf("                     falloff correction, repack the JPEG planes of each\n");
+    printf("                     camera into its image without decoding them (cpu\n");
+    printf("                     backend, Ladybug6 streams). Frames that cannot be\n");
+    printf("                     repacked are converted as usual. Default is false.\n");
+    printf("  --jpeg-quality N   JPEG quality, 1 to 100. Default is %d.\n", DEFAULT_JPEG_QUALITY);
+    printf("  --jpeg-subsampling 444|422|420  JPEG chroma resolution: full, half\n");
+    printf("                     width, or half width and height. Default is 420.\n");
+    printf("  --jpeg-fast-dct true|false  Use the fast integer DCT: quicker encoding,\n");
+    printf("                     slightly lower quality. Default is false.\n");
+    printf("  --jpeg-optimize true|false  Fit the Huffman tables to each image:\n");
+    printf("                     smaller files, slower encoding. Default is false.\n");
+    printf("                     With the sdk backend any --jpeg-* option encodes JPEG\n");
+    printf("                     with libjpeg instead of ladybugSaveImage.\n");
+    printf("  --zlib-level N     PNG and Deflate TIFF compression level, 0 (stored)\n");
+    printf("                     to 9. Default is %d; 1 is several times faster.\n", DEFAULT_ZLIB_LEVEL);
+    printf("  --zlib-strategy S  default, filtered, rle or huffman. rle with level 1\n");
+    printf("                     is the fastest compressed setting. Default is default.\n");
+    printf("  --png-filter F     PNG row filter: none, sub, up, average, paeth or\n");
+    printf("                     adaptive (best per row). Default is sub.\n");
+    printf("  --tiff-compression C  none, lzw, deflate or zstd (needs libzstd).\n");
+    printf("                     Compressed TIFFs use the horizontal predictor.\n");
+    printf("                     Default is none.\n");
+    printf("  --strip-threads N  Threads compressing the row strips of one PNG or\n");
+    printf("                     TIFF image, per encoder thread. 0 means all logical\n");
+    printf("                     processors. Default is 1.\n");
+    printf("                     With the sdk backend any of these options writes PNG\n");
+    printf("                     and TIFF in-tree instead of with ladybugSaveImage.\n");
+    printf("  --reader READER    Frame source for the read stage:\n");
+    printf("              sdk      - ladybugReadImageFromStream (default)\n");
+    printf("              native   - memory-mapped reader with a persisted frame index\n");
+    printf("                         (<stream>.pgr.idx) for fast -r seeks\n");
+    printf("                     The cpu backend always uses the native reader.\n");
+    printf("  --segments MODE    Segments of a split recording (NAME-000000.pgr, ...):\n");
+    printf("              all      - process every segment as one stream (default)\n");
+    printf("              single   - process only the -i file\n");
+    printf("  --shards N         Split the frames across N worker processes, each\n");
+    printf("                     with its own SDK context. Default is 1 (no workers).\n");
+    printf("  --shard-chunk N    Frames handed to a worker at a time. Default is %u.\n", DEFAULT_SHARD_CHUNK);
+    printf("  --sessions N       Split the frames across N export sessions in this\n");
+    printf("                     process, each with its own SDK contexts and buffers.\n");
+    printf("                     Default is 1.\n");
+    printf("  --report FILE      Write per-stage timings (p50/p95/p99), throughput and\n");
+    printf("                     bytes read/written to FILE as JSON.\n");
+    printf("  --trace FILE       Write a timeline of every stage and queue wait of every\n");
+    printf("                     frame to FILE (Chrome trace format, for chrome://tracing\n");
+    printf("                     or ui.perfetto.dev).\n");
+    printf("  --archive FILE     Write every image into one uncompressed tar file\n");
+    printf("                     instead of one file each in the output directory,\n");
+    printf("                     with an index for direct access by frame and camera.\n");
+    printf("                     'tar -xf FILE -C DIR' gives the usual layout.\n");
+    printf("  --output-pipe FILE Stream the images in frame order to FILE (a named\n");
+    printf("                     pipe) or '-' (stdout, same as -o -) instead of\n");
+    printf("                     writing files: one record per image with its frame\n");
+    printf("                     number, camera and size. Messages go to stderr.\n");
+    printf("  --video FILE       Encode the panoramas into FILE, a Motion JPEG AVI at\n");
+    printf("                     the recording's frame rate, instead of writing\n");
+    printf("                     images. With -x 6processed each camera goes into\n");
+    printf("                     its own file (FILE_Cam0.avi ...). Implies -f jpg.\n");
+    printf("  --shm-ring NAME    Publish the unencoded images of every frame (6 camera\n");
+    printf("                     textures or the panorama) to a ring buffer in shared\n");
+    printf("                     memory NAME (/NAME on Linux) for a reader process\n");
+    printf("                     (SharedRingReader) instead of writing files.\n");
+    printf("  --shm-slots N      Frames the ring holds. Default is %d.\n", DEFAULT_SHM_SLOTS);
+    printf("  --shm-timeout SECONDS  Give up on the ring's reader when it has not\n");
+    printf("                     attached or shown progress for this long.\n");
+    printf("                     Default is %d.\n", DEFAULT_SHM_TIMEOUT);
     printf("\n");
     printf("NEW OPTIONS (extended functionality):\n\n");
     printf("  -x EXPORT_TYPE     Export type for individual cameras:\n");
@@ -432,6 +667,347 @@ bool ParseCommandLine(int argc, char* argv[], CommandLineArgs& args)
                 args.rotationAngle = param;
                 ParseRotationAngle(param, args.rotFront, args.rotDown);
             }
+            else if (arg == "--encode-threads")
+            {
+                args.encodeThreads = std::stoi(param);
+                if (args.encodeThreads < 0)
+                {
+                    printf("Warning: Invalid encode thread count '%s'. Using default.\n", param);
+                    args.encodeThreads = 0;
+                }
+            }
+            else if (arg == "--backend")
+            {
+                args.backend = param;
+            }
+            else if (arg == "--renderer")
+            {
+                if (strncmpCaseInsensitive(param, "cpu", 4) == 0)
+                {
+                    args.cpuRenderer = true;
+                }
+                else if (strncmpCaseInsensitive(param, "gpu", 4) != 0)
+                {
+                    printf("Warning: Unknown renderer '%s'. Use 'gpu' or 'cpu'.\n", param);
+                }
+            }
+            else if (arg == "--render-threads")
+            {
+                args.renderThreads = std::stoi(param);
+                if (args.renderThreads < 0)
+                {
+                    printf("Warning: Invalid render thread count '%s'. Using default.\n", param);
+                    args.renderThreads = 0;
+                }
+            }
+            else if (arg == "--decode-threads")
+            {
+                args.decodeThreads = std::stoi(param);
+                if (args.decodeThreads < 0)
+                {
+                    printf("Warning: Invalid decode thread count '%s'. Using default.\n", param);
+                    args.decodeThreads = 0;
+                }
+            }
+            else if (arg == "--demosaic-threads")
+            {
+                args.demosaicThreads = std::stoi(param);
+                if (args.demosaicThreads < 0)
+                {
+                    printf("Warning: Invalid demosaic thread count '%s'. Using default.\n", param);
+                    args.demosaicThreads = 0;
+                }
+            }
+            else if (arg == "--convert-threads")
+            {
+                args.convertThreads = std::stoi(param);
+                if (args.convertThreads < 0)
+                {
+                    printf("Warning: Invalid convert thread count '%s'. Using default.\n", param);
+                    args.convertThreads = 0;
+                }
+            }
+            else if (arg == "--tone-curve")
+            {
+                args.toneCurveSpec = param;
+            }
+            else if (arg == "--bit-depth")
+            {
+                args.bitDepth = std::stoi(param);
+                if (args.bitDepth != 8 && args.bitDepth != 16)
+                {
+                    printf("Warning: Invalid bit depth '%s'. Using 8.\n", param);
+                    args.bitDepth = 8;
+                }
+            }
+            else if (arg == "--jpeg-passthrough")
+            {
+                args.jpegPassthrough = (strncmpCaseInsensitive(param, "true", 4) == 0);
+            }
+            else if (arg == "--jpeg-quality")
+            {
+                args.jpeg.quality = std::stoi(param);
+                if (args.jpeg.quality < 1 || args.jpeg.quality > 100)
+                {
+                    printf("Warning: Invalid JPEG quality '%s'. Using %d.\n", param, DEFAULT_JPEG_QUALITY);
+                    args.jpeg.quality = DEFAULT_JPEG_QUALITY;
+                }
+                args.jpegOptionsGiven = true;
+            }
+            else if (arg == "--jpeg-subsampling")
+            {
+                if (strncmpCaseInsensitive(param, "444", 4) == 0)
+                {
+                    args.jpeg.subsampling = JpegSubsampling::S444;
+                }
+                else if (strncmpCaseInsensitive(param, "422", 4) == 0)
+                {
+                    args.jpeg.subsampling = JpegSubsampling::S422;
+                }
+                else if (strncmpCaseInsensitive(param, "420", 4) == 0)
+                {
+                    args.jpeg.subsampling = JpegSubsampling::S420;
+                }
+                else
+                {
+                    printf("Warning: Invalid JPEG subsampling '%s'. Using 420.\n", param);
+                    args.jpeg.subsampling = JpegSubsampling::S420;
+                }
+                args.jpegOptionsGiven = true;
+            }
+            else if (arg == "--jpeg-fast-dct")
+            {
+                args.jpeg.fastDct = (strncmpCaseInsensitive(param, "true", 4) == 0);
+                args.jpegOptionsGiven = true;
+            }
+            else if (arg == "--jpeg-optimize")
+            {
+                args.jpeg.optimizeCoding = (strncmpCaseInsensitive(param, "true", 4) == 0);
+                args.jpegOptionsGiven = true;
+            }
+            else if (arg == "--zlib-level")
+            {
+                args.lossless.zlibLevel = std::stoi(param);
+                if (args.lossless.zlibLevel < 0 || args.lossless.zlibLevel > 9)
+                {
+                    printf("Warning: Invalid zlib level '%s'. Using %d.\n", param, DEFAULT_ZLIB_LEVEL);
+                    args.lossless.zlibLevel = DEFAULT_ZLIB_LEVEL;
+                }
+                args.losslessOptionsGiven = true;
+            }
+            else if (arg == "--zlib-strategy")
+            {
+                if (strncmpCaseInsensitive(param, "default", 8) == 0)
+                {
+                    args.lossless.zlibStrategy = ZlibStrategy::Default;
+                }
+                else if (strncmpCaseInsensitive(param, "filtered", 9) == 0)
+                {
+                    args.lossless.zlibStrategy = ZlibStrategy::Filtered;
+                }
+                else if (strncmpCaseInsensitive(param, "rle", 4) == 0)
+                {
+                    args.lossless.zlibStrategy = ZlibStrategy::Rle;
+                }
+                else if (strncmpCaseInsensitive(param, "huffman", 8) == 0)
+                {
+                    args.lossless.zlibStrategy = ZlibStrategy::HuffmanOnly;
+                }
+                else
+                {
+                    printf("Warning: Unknown zlib strategy '%s'. Using default.\n", param);
+                    args.lossless.zlibStrategy = ZlibStrategy::Default;
+                }
+                args.losslessOptionsGiven = true;
+            }
+            else if (arg == "--png-filter")
+            {
+                if (strncmpCaseInsensitive(param, "none", 5) == 0)
+                {
+                    args.lossless.pngFilter = PngFilter::None;
+                }
+                else if (strncmpCaseInsensitive(param, "sub", 4) == 0)
+                {
+                    args.lossless.pngFilter = PngFilter::Sub;
+                }
+                else if (strncmpCaseInsensitive(param, "up", 3) == 0)
+                {
+                    args.lossless.pngFilter = PngFilter::Up;
+                }
+                else if (strncmpCaseInsensitive(param, "average", 8) == 0)
+                {
+                    args.lossless.pngFilter = PngFilter::Average;
+                }
+                else if (strncmpCaseInsensitive(param, "paeth", 6) == 0)
+                {
+                    args.lossless.pngFilter = PngFilter::Paeth;
+                }
+                else if (strncmpCaseInsensitive(param, "adaptive", 9) == 0)
+                {
+                    args.lossless.pngFilter = PngFilter::Adaptive;
+                }
+                else
+                {
+                    printf("Warning: Unknown PNG filter '%s'. Using sub.\n", param);
+                    args.lossless.pngFilter = PngFilter::Sub;
+                }
+                args.losslessOptionsGiven = true;
+            }
+            else if (arg == "--tiff-compression")
+            {
+                if (strncmpCaseInsensitive(param, "none", 5) == 0)
+                {
+                    args.lossless.tiffCompression = TiffCompression::None;
+                }
+                else if (strncmpCaseInsensitive(param, "lzw", 4) == 0)
+                {
+                    args.lossless.tiffCompression = TiffCompression::Lzw;
+                }
+                else if (strncmpCaseInsensitive(param, "deflate", 8) == 0)
+                {
+                    args.lossless.tiffCompression = TiffCompression::Deflate;
+                }
+                else if (strncmpCaseInsensitive(param, "zstd", 5) == 0)
+                {
+#ifdef USE_ZSTD
+                    args.lossless.tiffCompression = TiffCompression::Zstd;
+#else
+                    printf("Warning: ZSTD TIFF needs a build with libzstd. Using deflate.\n");
+                    args.lossless.tiffCompression = TiffCompression::Deflate;
+#endif
+                }
+                else
+                {
+                    printf("Warning: Unknown TIFF compression '%s'. Using none.\n", param);
+                    args.lossless.tiffCompression = TiffCompression::None;
+                }
+                args.losslessOptionsGiven = true;
+            }
+            else if (arg == "--strip-threads")
+            {
+                args.stripThreads = std::stoi(param);
+                if (args.stripThreads < 0)
+                {
+                    printf("Warning: Invalid strip thread count '%s'. Using 1.\n", param);
+                    args.stripThreads = 1;
+                }
+                args.losslessOptionsGiven = true;
+            }
+            else if (arg == "--report")
+            {
+                args.reportPath = param;
+            }
+            else if (arg == "--trace")
+            {
+                args.tracePath = param;
+            }
+            else if (arg == "--archive")
+            {
+                args.archivePath = param;
+            }
+            else if (arg == "--output-pipe")
+            {
+                args.outputPipe = param;
+            }
+            else if (arg == "--video")
+            {
+                args.videoPath = param;
+            }
+            else if (arg == "--shm-ring")
+            {
+                args.shmRing = param;
+            }
+            else if (arg == "--shm-slots")
+            {
+                args.shmSlots = std::stoi(param);
+                if (args.shmSlots < 1)
+                {
+                    printf("Warning: Invalid ring slot count '%s'. Using %d.\n", param, DEFAULT_SHM_SLOTS);
+                    args.shmSlots = DEFAULT_SHM_SLOTS;
+                }
+            }
+            else if (arg == "--shm-timeout")
+            {
+                args.shmTimeout = std::stoi(param);
+                if (args.shmTimeout < 1)
+                {
+                    printf("Warning: Invalid ring timeout '%s'. Using %d s.\n", param, DEFAULT_SHM_TIMEOUT);
+                    args.shmTimeout = DEFAULT_SHM_TIMEOUT;
+                }
+            }
+            else if (arg == "--cache-dir")
+            {
+                if (strncmpCaseInsensitive(param, "none", 5) == 0)
+                {
+                    args.useCache = false;
+                }
+                else
+                {
+                    args.cacheDir = param;
+                }
+            }
+            else if (arg == "--reader")
+            {
+                if (strncmpCaseInsensitive(param, "native", 7) == 0)
+                {
+                    args.nativeReader = true;
+                }
+                else if (strncmpCaseInsensitive(param, "sdk", 4) != 0)
+                {
+                    printf("Warning: Unknown reader '%s'. Use 'sdk' or 'native'.\n", param);
+                }
+            }
+            else if (arg == "--segments")
+            {
+                if (strncmpCaseInsensitive(param, "single", 7) == 0)
+                {
+                    args.allSegments = false;
+                }
+                else if (strncmpCaseInsensitive(param, "all", 4) != 0)
+                {
+                    printf("Warning: Unknown segment mode '%s'. Use 'all' or 'single'.\n", param);
+                }
+            }
+            else if (arg == "--shards")
+            {
+                args.numShards = std::stoi(param);
+                if (args.numShards < 1)
+                {
+                    printf("Warning: Invalid shard count '%s'. Using 1.\n", param);
+                    args.numShards = 1;
+                }
+            }
+            else if (arg == "--shard-chunk")
+            {
+                args.shardChunk = std::stoi(param);
+                if (args.shardChunk < 1)
+                {
+                    printf("Warning: Invalid shard chunk '%s'. Using %u.\n", param, DEFAULT_SHARD_CHUNK);
+                    args.shardChunk = DEFAULT_SHARD_CHUNK;
+                }
+            }
+            else if (arg == "--sessions")
+            {
+                args.numSessions = std::stoi(param);
+                if (args.numSessions < 1)
+                {
+                    printf("Warning: Invalid session count '%s'. Using 1.\n", param);
+                    args.numSessions = 1;
+                }
+            }
+            else if (arg == "--shard-worker")
+            {
+                args.shardWorker = (strncmpCaseInsensitive(param, "true", 4) == 0);
+            }
+            else if (arg == "--pipeline-depth")
+            {
+                args.pipelineDepth = std::stoi(param);
+                if (args.pipelineDepth < 1)
+                {
+                    printf("Warning: Invalid pipeline depth '%s'. Using 1.\n", param);
+                    args.pipelineDepth = 1;
+                }
+            }
             else
             {
                 printf("Warning: Unknown option '%s' ignored.\n", arg.c_str());
@@ -451,53 +1027,163 @@ bool ParseCommandLine(int argc, char* argv[], CommandLineArgs& args)
         return false;
     }
 
+    // -o - streams to stdout
+    if (args.outputPrefix == "-")
+    {
+        args.outputPipe = "-";
+        args.outputPrefix.clear();
+    }
     if (args.outputPrefix.empty())
     {
         args.outputPrefix = "ladybugImageOutput";
     }
 
-    return true;
-}
-
-//=============================================================================
-// Helper Functions - File Format
-//=============================================================================
-
-LadybugSaveFileFormat GetSaveFormat(const std::string& format)
-{
-    if (format == "bmp")  return LADYBUG_FILEFORMAT_BMP;
-    if (format == "jpg")  return LADYBUG_FILEFORMAT_JPG;
-    if (format == "jpeg") return LADYBUG_FILEFORMAT_JPG;
-    if (format == "tiff") return LADYBUG_FILEFORMAT_TIFF;
-    if (format == "png")  return LADYBUG_FILEFORMAT_PNG;
-    return LADYBUG_FILEFORMAT_JPG; // Default to JPG like ladybugProcessStream
-}
+    // Built once and shared by every session
+    if (!ToneCurve::Create(args.toneCurveSpec, args.toneCurve))
+    {
+        return false;
+    }
 
-const char* GetFileExtension(const std::string& format)
-{
-    if (format == "bmp")  return "bmp";
-    if (format == "jpg")  return "jpg";
-    if (format == "jpeg") return "jpg";
-    if (format == "tiff") return "tiff";
-    if (format == "png")  return "png";
-    return "jpg";
-}
+    // A video holds JPEG frames
+    if (!args.videoPath.empty() && args.shmRing.empty() && args.format != "jpg" && args.format != "jpeg")
+    {
+        printf("Warning: --video stores JPEG frames. Using -f jpg.\n");
+        args.format = "jpg";
+    }
 
-LadybugColorProcessingMethod GetColorProcessingMethod(const std::string& method)
-{
-    if (method == "hq" || method == "hq-gpu") return LADYBUG_HQLINEAR;
-    if (method == "edge") return LADYBUG_EDGE_SENSING;
-    if (method == "near") return LADYBUG_NEAREST_NEIGHBOR_FAST;
-    if (method == "near-f") return LADYBUG_NEAREST_NEIGHBOR_FAST;
-    if (method == "down4") return LADYBUG_DOWNSAMPLE4;
-    if (method == "down16") return LADYBUG_DOWNSAMPLE16;
-    if (method == "mono") return LADYBUG_MONO;
-    return LADYBUG_HQLINEAR;
-}
+    // Only PNG and TIFF hold 16-bit samples (the shared-memory ring holds
+    // the textures as they are)
+    const bool jpegOutput = (args.format == "jpg" || args.format == "jpeg");
+    const bool deepOutput = (args.format == "png" || args.format == "tiff" || !args.shmRing.empty());
+    if (args.bitDepth == 16 && (!args.export6Cameras || !deepOutput))
+    {
+        printf("Warning: --bit-depth 16 needs -x 6processed with -f png, -f tiff or --shm-ring. Using 8.\n");
+        args.bitDepth = 8;
+    }
+    if (args.bitDepth == 16 && args.toneCurve != nullptr)
+    {
+        printf("Warning: --tone-curve has no effect with --bit-depth 16.\n");
+    }
 
-//=============================================================================
-// Helper Functions - Directory Creation
-//=============================================================================
+    // A repacked JPEG is the down4 camera image as stored, so any other
+    // output or processing needs the decoded frame
+    if (args.jpegPassthrough && (!args.export6Cameras || !jpegOutput || args.colorProcessing != "down4" ||
+                                 args.falloffEnabled))
+    {
+        printf("Warning: --jpeg-passthrough needs -x 6processed -f jpg -c down4 without -a. "
+               "Converting every frame.\n");
+        args.jpegPassthrough = false;
+    }
+    if (args.jpegPassthrough && !args.shmRing.empty())
+    {
+        printf("Warning: --shm-ring publishes decoded images. Ignoring --jpeg-passthrough.\n");
+        args.jpegPassthrough = false;
+    }
+    if (args.jpegOptionsGiven && !jpegOutput)
+    {
+        printf("Warning: --jpeg-* encoder options have no effect without -f jpg.\n");
+    }
+    if (args.losslessOptionsGiven && !deepOutput)
+    {
+        printf("Warning: PNG/TIFF encoder options have no effect without -f png or -f tiff.\n");
+    }
+
+    // Worker processes cannot append to the coordinator's archive, pipe,
+    // video or ring, and the frame order of all but the archive needs one
+    // session
+    if (!args.shmRing.empty() && (!args.archivePath.empty() || !args.outputPipe.empty() || !args.videoPath.empty()))
+    {
+        printf("Warning: --shm-ring replaces file output. Ignoring --archive, --output-pipe and --video.\n");
+        args.archivePath.clear();
+        args.outputPipe.clear();
+        args.videoPath.clear();
+    }
+    if (!args.videoPath.empty() && (!args.archivePath.empty() || !args.outputPipe.empty()))
+    {
+        printf("Warning: --video replaces file output. Ignoring --archive and --output-pipe.\n");
+        args.archivePath.clear();
+        args.outputPipe.clear();
+    }
+    if (!args.archivePath.empty() && !args.outputPipe.empty())
+    {
+        printf("Warning: --archive and --output-pipe exclude each other. Using --output-pipe.\n");
+        args.archivePath.clear();
+    }
+    if ((!args.archivePath.empty() || !args.outputPipe.empty()) && args.numShards > 1)
+    {
+        printf("Warning: %s needs a single process. Using --shards 1.\n",
+               args.archivePath.empty() ? "--output-pipe" : "--archive");
+        args.numShards = 1;
+    }
+    if (!args.outputPipe.empty() && args.numSessions > 1)
+    {
+        printf("Warning: --output-pipe writes frames in order from one session. Using --sessions 1.\n");
+        args.numSessions = 1;
+    }
+    if (!args.videoPath.empty() && (args.numShards > 1 || args.numSessions > 1))
+    {
+        printf("Warning: --video writes frames in order from one session. Using --shards 1 --sessions 1.\n");
+        args.numShards = 1;
+        args.numSessions = 1;
+    }
+    if (!args.shmRing.empty() && (args.numShards > 1 || args.numSessions > 1))
+    {
+        printf("Warning: --shm-ring has a single producer. Using --shards 1 --sessions 1.\n");
+        args.numShards = 1;
+        args.numSessions = 1;
+    }
+
+    return true;
+}
+
+//=============================================================================
+// Helper Functions - File Format
+//=============================================================================
+
+ImageFileFormat GetSaveFormat(const std::string& format)
+{
+    if (format == "bmp")  return ImageFileFormat::BMP;
+    if (format == "jpg")  return ImageFileFormat::JPG;
+    if (format == "jpeg") return ImageFileFormat::JPG;
+    if (format == "tiff") return ImageFileFormat::TIFF;
+    if (format == "png")  return ImageFileFormat::PNG;
+    return ImageFileFormat::JPG; // Default to JPG like ladybugProcessStream
+}
+
+const char* GetFileExtension(const std::string& format)
+{
+    if (format == "bmp")  return "bmp";
+    if (format == "jpg")  return "jpg";
+    if (format == "jpeg") return "jpg";
+    if (format == "tiff") return "tiff";
+    if (format == "png")  return "png";
+    return "jpg";
+}
+
+ColorMethod GetColorProcessingMethod(const std::string& method)
+{
+    if (method == "hq" || method == "hq-gpu") return ColorMethod::HqLinear;
+    if (method == "edge") return ColorMethod::EdgeSensing;
+    if (method == "near") return ColorMethod::NearestNeighbor;
+    if (method == "near-f") return ColorMethod::NearestNeighbor;
+    if (method == "down4") return ColorMethod::Downsample4;
+    if (method == "down16") return ColorMethod::Downsample16;
+    if (method == "mono") return ColorMethod::Mono;
+    return ColorMethod::HqLinear;
+}
+
+//=============================================================================
+// Helper Functions - Directory Creation
+//=============================================================================
+
+int MakeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+    return _mkdir(path.c_str());
+#else
+    return mkdir(path.c_str(), 0755);
+#endif
+}
 
 bool CreateDirectoryRecursive(const std::string& path)
 {
@@ -509,405 +1195,1307 @@ bool CreateDirectoryRecursive(const std::string& path)
         currentPath = path.substr(0, pos);
         if (!currentPath.empty())
         {
-            _mkdir(currentPath.c_str());
+            MakeDirectory(currentPath);
         }
     }
     
-    if (_mkdir(path.c_str()) == 0 || errno == EEXIST)
+    if (MakeDirectory(path) == 0 || errno == EEXIST)
     {
         return true;
     }
     
-    return GetFileAttributesA(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+    struct stat status;
+    return stat(path.c_str(), &status) == 0 && (status.st_mode & S_IFDIR) != 0;
+}
+
+std::string GetDirectoryFromPath(const std::string& path)
+{
+    size_t pos = path.find_last_of("\\/");
+    if (pos != std::string::npos)
+    {
+        return path.substr(0, pos);
+    }
+    return ".";
+}
+
+//=============================================================================
+// Session Initialization
+//=============================================================================
+
+/**
+ * @brief Create the session's backend, open the recording set and count its frames
+ */
+bool InitializeSession(ExportSession& session, const CommandLineArgs& args)
+{
+    session.backend = CreateImagingBackend(args.backend);
+    if (session.backend == nullptr)
+    {
+        return false;
+    }
+
+    BackendOptions options;
+    options.colorMethod = GetColorProcessingMethod(args.colorProcessing);
+    options.blendingWidth = args.blendingWidth;
+    options.nativeReader = args.nativeReader;
+    options.panoWidth = args.panoWidth;
+    options.panoHeight = args.panoHeight;
+    options.rotFront = args.rotFront;
+    options.rotDown = args.rotDown;
+    options.cpuRenderer = args.cpuRenderer;
+    options.renderThreads = static_cast<unsigned int>(args.renderThreads);
+    options.decodeThreads = static_cast<unsigned int>(args.decodeThreads);
+    options.demosaicThreads = static_cast<unsigned int>(args.demosaicThreads);
+    options.convertThreads = static_cast<unsigned int>(args.convertThreads);
+    options.toneCurve = args.toneCurve;
+    options.jpeg = args.jpeg;
+    options.nativeJpeg = args.jpegOptionsGiven;
+    options.lossless = args.lossless;
+    options.lossless.stripThreads = static_cast<unsigned int>(args.stripThreads);
+    options.nativeLossless = args.losslessOptionsGiven;
+    options.stats = session.stats;
+
+    // Only the CPU renderer builds remap tables; it blends with their
+    // weights, so the SDK's alpha masks are not needed for its panoramas.
+    // The SDK renderer builds them in its own context; the converter's
+    // context only needs them for the camera images it exports
+    const bool cpuRendering = !args.export6Cameras &&
+                              (args.cpuRenderer || strcmp(session.backend->Name(), "cpu") == 0);
+    options.alphaMasks = !args.export6Cameras && !cpuRendering;
+    options.cameraAlphaMasks = args.export6Cameras;
+    if (cpuRendering && args.useCache)
+    {
+        options.cacheDir = args.cacheDir.empty() ? GetDefaultCacheDirectory() : args.cacheDir;
+        if (!options.cacheDir.empty() && !CreateDirectoryRecursive(options.cacheDir))
+        {
+            printf("Warning: Could not create cache directory %s. Remap tables are not cached.\n",
+                   options.cacheDir.c_str());
+            options.cacheDir.clear();
+        }
+    }
+
+    if (!session.backend->Initialize(session.streamSegments, options, session.info))
+    {
+        return false;
+    }
+
+    const StreamInfo& info = session.info;
+    printf("\n--- Stream Information ---\n");
+    printf("Backend: %s\n", session.backend->Name());
+    printf("Base S/N: %u\n", info.serialBase);
+    printf("Head S/N: %u\n", info.serialHead);
+    printf("Frame rate : %.2f\n", info.frameRate);
+    printf("Data format: %u\n", info.dataFormat);
+    printf("Resolution: %u\n", info.resolution);
+    printf("Stream version: %u\n", info.streamVersion);
+    printf("--------------------------\n\n");
+
+    if (info.highBitDepth)
+    {
+        printf("Detected high bit depth format (12/16-bit)\n");
+        if (args.export6Cameras && args.bitDepth == 16)
+        {
+            printf("Camera images: 16 bits per sample\n");
+        }
+        else if (args.export6Cameras && args.toneCurve != nullptr)
+        {
+            printf("Tone curve: %s\n", args.toneCurve->Description().c_str());
+        }
+    }
+    printf("Image info: %ux%u, texture %ux%u\n", info.imageCols, info.imageRows, info.textureWidth, info.textureHeight);
+
+    if (session.streamSegments.size() > 1)
+    {
+        printf("Recording set: %zu segments\n", session.streamSegments.size());
+        for (const StreamSegment& segment : session.streamSegments)
+        {
+            printf("  %s: %u frames\n", segment.path.c_str(), segment.frameCount);
+        }
+        const StreamSegment& lastSegment = session.streamSegments.back();
+        printf("Recording set: %u frames in total\n", lastSegment.firstFrame + lastSegment.frameCount);
+    }
+
+    session.stream = session.backend->CreateStream();
+    session.converter = session.backend->CreateConverter();
+    return session.stream != nullptr && session.converter != nullptr;
+}
+
+//=============================================================================
+// Cleanup
+//=============================================================================
+
+void CleanupSession(ExportSession& session)
+{
+    // The stage objects may use the backend's resources, so they go first
+    session.stream.reset();
+    session.converter.reset();
+    session.backend.reset();
+}
+
+//=============================================================================
+// Export Functions
+//=============================================================================
+
+/**
+ * @brief Add the size of a written file to the run's byte count
+ */
+void CountWrittenFile(RunStats* stats, const char* path)
+{
+    struct stat status;
+    if (stats != nullptr && stat(path, &status) == 0)
+    {
+        stats->AddBytesWritten(static_cast<uint64_t>(status.st_size));
+    }
+}
+
+/**
+ * @brief Pixel format camera images are saved in: BGRU16 with --bit-depth 16
+ *        for high bit depth streams, BGRU otherwise (JPG/BMP are 8-bit only)
+ */
+PixelFormat GetCameraImageFormat(const ExportSession& session, const CommandLineArgs& args)
+{
+    return (session.info.highBitDepth && args.bitDepth == 16) ? PixelFormat::BGRU16 : PixelFormat::BGRU;
+}
+
+/**
+ * @brief File name of a camera image: BaseName_FrameNum_CamN.ext
+ */
+std::string GetCameraImageName(const CommandLineArgs& args, unsigned int frameNum, int cam)
+{
+    char filename[MAX_PATH];
+    snprintf(filename, sizeof(filename), "%s_%06u_Cam%d.%s", args.pgrBaseName.c_str(), frameNum, cam,
+             GetFileExtension(args.format));
+    return filename;
+}
+
+/**
+ * @brief Path of an output file: outputDir\Name
+ */
+std::string GetOutputPath(const CommandLineArgs& args, const std::string& name)
+{
+    return args.outputPrefix + PATH_SEPARATOR + name;
+}
+
+/**
+ * @brief Save an image as a file of its own, or encode it for the
+ *        --archive, --output-pipe or --video under the same name
+ * @param sequence Position of the image in the sink's output
+ * @param encoded Buffer for the encoded image, reused by the caller
+ */
+bool SaveImage(const ExportSession& session, ImageWriter& writer, const ImageView& image, const std::string& name,
+               unsigned int frameNum, int cam, uint64_t sequence, std::vector<unsigned char>& encoded,
+               const CommandLineArgs& args)
+{
+    const ImageFileFormat saveFormat = GetSaveFormat(args.format);
+    if (session.sink == nullptr)
+    {
+        const std::string path = GetOutputPath(args, name);
+        if (!writer.Save(image, path, saveFormat))
+        {
+            return false;
+        }
+        CountWrittenFile(session.stats, path.c_str());
+        return true;
+    }
+
+    if (!writer.Encode(image, name, saveFormat, encoded) ||
+        !session.sink->Add(sequence, name, frameNum, cam, encoded))
+    {
+        return false;
+    }
+    if (session.stats != nullptr)
+    {
+        session.stats->AddBytesWritten(encoded.size());
+    }
+    return true;
+}
+
+/**
+ * @brief Export one processed camera image of a frame
+ */
+bool ExportCameraImage(const ExportSession& session, ImageWriter& writer, unsigned int frameNum, int cam,
+                       uint64_t sequence, unsigned char* cameraBuffer, std::vector<unsigned char>& encoded,
+                       const CommandLineArgs& args)
+{
+    ImageView cameraImage;
+    cameraImage.data = cameraBuffer;
+    cameraImage.cols = session.info.textureWidth;
+    cameraImage.rows = session.info.textureHeight;
+    cameraImage.format = GetCameraImageFormat(session, args);
+
+    bool saved;
+    {
+        StageTimer encodeTimer(session.stats, Stage::Encode, frameNum);
+        saved = SaveImage(session, writer, cameraImage, GetCameraImageName(args, frameNum, cam), frameNum, cam,
+                          sequence, encoded, args);
+    }
+    if (!saved)
+    {
+        printf("Warning: Could not save camera %d image\n", cam);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Write a camera image that was passed through as JPEG (--jpeg-passthrough)
+ */
+bool SavePassedThroughImage(const ExportSession& session, unsigned int frameNum, int cam, uint64_t sequence,
+                            const std::vector<unsigned char>& jpeg, const CommandLineArgs& args)
+{
+    const std::string name = GetCameraImageName(args, frameNum, cam);
+    const std::string filename = GetOutputPath(args, name);
+    bool saved;
+    {
+        StageTimer encodeTimer(session.stats, Stage::Encode, frameNum);
+        saved = (session.sink != nullptr) ? session.sink->Add(sequence, name, frameNum, cam, jpeg)
+                                          : WriteEncodedFile(jpeg, filename);
+    }
+    if (!saved)
+    {
+        printf("Warning: Could not save camera %d image\n", cam);
+        return false;
+    }
+
+    if (session.sink != nullptr)
+    {
+        if (session.stats != nullptr)
+        {
+            session.stats->AddBytesWritten(jpeg.size());
+        }
+    }
+    else
+    {
+        CountWrittenFile(session.stats, filename.c_str());
+    }
+    return true;
+}
+
+/**
+ * @brief Save a rendered panoramic image for a single frame
+ */
+bool SavePanorama(const ExportSession& session, ImageWriter& writer, unsigned int frameNum, uint64_t sequence,
+                  const ImageView& panoImage, std::vector<unsigned char>& encoded, const CommandLineArgs& args)
+{
+    const char* ext = GetFileExtension(args.format);
+
+    // Generate filename: BaseName_FrameNum.ext (in outputDir or the sink)
+    char filename[MAX_PATH];
+    snprintf(filename, sizeof(filename), "%s_%06u.%s", args.pgrBaseName.c_str(), frameNum, ext);
+
+    bool saved;
+    {
+        StageTimer encodeTimer(session.stats, Stage::Encode, frameNum);
+        saved = SaveImage(session, writer, panoImage, filename, frameNum, -1, sequence, encoded, args);
+    }
+    if (!saved)
+    {
+        printf("Error: Could not save panorama\n");
+        return false;
+    }
+
+    if (session.sink != nullptr)
+    {
+        printf("Getting panoramic image and writing it to the output as %s...\n", filename);
+    }
+    else
+    {
+        printf("Getting panoramic image and writing it to %s...\n", GetOutputPath(args, filename).c_str());
+    }
+    return true;
+}
+
+//=============================================================================
+// Frame Pipeline
+//
+// ProcessStream runs each frame through four stages, each on its own thread:
+//
+//   read (FrameStream) -> convert (FrameConverter) -> render (PanoramaRenderer)
+//       -> write (--encode-threads workers, one ImageWriter each)
+//
+// The render stage is skipped for 6 camera export. Stages are connected by
+// bounded queues and frames live in a fixed pool of slots, so at most
+// --pipeline-depth frames are held in memory and a slow stage stalls the
+// ones before it instead of letting them run ahead. The write stage splits
+// each frame into one job per output image; a slot is recycled once all of
+// its images are written. Output names depend only on frame and camera
+// number, so they are identical to serial processing.
+//=============================================================================
+
+/**
+ * @brief One frame in flight through the pipeline
+ */
+struct FrameSlot
+{
+    unsigned int frameNum = 0;
+
+    std::unique_ptr<RawFrame> raw;          // Raw frame from the stream (created by FrameStream::CreateFrame)
+
+    std::unique_ptr<unsigned char[]> textures[NUM_CAMERAS];
+    unsigned char* textureBuffers[NUM_CAMERAS] = {nullptr};
+
+    std::vector<unsigned char> panoData;    // Rendered panorama (BGR)
+    ImageView panoImage;
+
+    bool passedThrough = false;             // Written from jpegs instead of the textures
+    std::vector<unsigned char> jpegs[NUM_CAMERAS];
+
+    std::atomic<int> pendingImages{0};      // Images not yet written by the encoders
+    std::atomic<bool> saveFailed{false};    // An image of this frame could not be written
+};
+
+/**
+ * @brief One image to encode and write
+ */
+struct EncodeJob
+{
+    FrameSlot* slot = nullptr;
+    int camera = -1;                        // Camera index, or -1 for the panorama
+    uint64_t sequence = 0;                  // Position in the output (--archive, --output-pipe, --video)
+};
+
+struct FramePipeline
+{
+    FramePipeline(ExportSession& session, size_t depth, size_t maxQueuedImages)
+        : session(session), freeSlots(depth), convertQueue(depth), renderQueue(depth), writeQueue(depth),
+          encodeQueue(maxQueuedImages)
+    {
+    }
+
+    ExportSession& session;                 // Backend and stream the stages work on
+
+    std::vector<std::unique_ptr<FrameSlot>> slots;
+
+    BoundedQueue<FrameSlot*> freeSlots;     // Recycled slots (source of backpressure)
+    BoundedQueue<FrameSlot*> convertQueue;  // read -> convert
+    BoundedQueue<FrameSlot*> renderQueue;   // convert -> render (panorama only)
+    BoundedQueue<FrameSlot*> writeQueue;    // convert/render -> write
+    BoundedQueue<EncodeJob> encodeQueue;    // write -> encoder threads
+
+    std::atomic<bool> abort{false};         // Set by a stage that cannot continue
+    std::atomic<unsigned int> framesFailed{0};
+    unsigned int framesPassedThrough = 0;   // --jpeg-passthrough counts (convert stage only)
+    unsigned int passthroughFallbacks = 0;
+};
+
+/**
+ * @brief Give up on a frame and return its slot to the pool
+ */
+void DropFrame(FramePipeline& pipeline, FrameSlot* slot)
+{
+    pipeline.framesFailed++;
+    pipeline.freeSlots.Push(slot);
+}
+
+/**
+ * @brief Timeline of the run (--trace), or null
+ */
+TraceRecorder* GetTrace(const ExportSession& session)
+{
+    return session.stats != nullptr ? session.stats->Trace() : nullptr;
+}
+
+/**
+ * @brief Pop from a pipeline queue, recording the wait in the timeline
+ */
+template <typename T>
+bool TracedPop(BoundedQueue<T>& queue, T& item, TraceRecorder* trace, const char* waitName)
+{
+    TraceSpan wait(trace, waitName, "wait");
+    return queue.Pop(item);
+}
+
+/**
+ * @brief Push to a pipeline queue, recording the wait (queue full) in the timeline
+ */
+template <typename T>
+bool TracedPush(BoundedQueue<T>& queue, T item, TraceRecorder* trace, const char* waitName)
+{
+    TraceSpan wait(trace, waitName, "wait");
+    return queue.Push(item);
+}
+
+PixelFormat GetTexturePixelFormat(const ExportSession& session)
+{
+    // Native format: BGRU16 for high bit depth, BGRU for 8-bit
+    return session.info.highBitDepth ? PixelFormat::BGRU16 : PixelFormat::BGRU;
+}
+
+/**
+ * @brief Allocate the slot pool (one slot per frame in flight)
+ */
+bool AllocateFrameSlots(FramePipeline& pipeline, size_t depth)
+{
+    const ExportSession& session = pipeline.session;
+    // Texture buffers are 2x size for 16-bit formats (BGRU16 vs BGRU)
+    const unsigned int bytesPerPixel = GetBytesPerPixel(GetTexturePixelFormat(session));
+    const size_t textureBytes = static_cast<size_t>(session.info.textureWidth) * session.info.textureHeight * bytesPerPixel;
+
+    for (size_t s = 0; s < depth; s++)
+    {
+        std::unique_ptr<FrameSlot> slot(new FrameSlot());
+        slot->raw = session.stream->CreateFrame();
+        for (int i = 0; i < NUM_CAMERAS; i++)
+        {
+            slot->textures[i].reset(new (std::nothrow) unsigned char[textureBytes]);
+            if (slot->textures[i] == nullptr)
+            {
+                printf("Error: Failed to allocate texture buffer for camera %d\n", i);
+                return false;
+            }
+            slot->textureBuffers[i] = slot->textures[i].get();
+        }
+
+        pipeline.freeSlots.Push(slot.get());
+        pipeline.slots.push_back(std::move(slot));
+    }
+
+    return true;
+}
+
+/**
+ * @brief Next frame range for the read stage; false when there is none
+ */
+using NextFrameRange = std::function<bool(unsigned int& startFrame, unsigned int& endFrame)>;
+
+/**
+ * @brief Called once every frame of a range is finished, with the number of
+ *        them that could not be exported
+ */
+using FrameRangeDone = std::function<void(unsigned int startFrame, unsigned int endFrame, unsigned int failedFrames)>;
+
+/**
+ * @brief Wait until every frame in flight is finished (all slots are free)
+ */
+void WaitForFreeSlots(FramePipeline& pipeline, TraceRecorder* trace)
+{
+    std::vector<FrameSlot*> freeSlots;
+    FrameSlot* slot = nullptr;
+    while (freeSlots.size() < pipeline.slots.size() && TracedPop(pipeline.freeSlots, slot, trace, "wait for range"))
+    {
+        freeSlots.push_back(slot);
+    }
+    for (FrameSlot* freeSlot : freeSlots)
+    {
+        pipeline.freeSlots.Push(freeSlot);
+    }
+}
+
+/**
+ * @brief Read stage: pulls frames from the stream into free slots
+ *
+ * Reads the ranges one after another into the same pipeline. With
+ * @p rangeDone, a range's frames are finished before the next range is
+ * asked for.
+ */
+void ReadStage(FramePipeline& pipeline, const NextFrameRange& nextRange, const FrameRangeDone& rangeDone)
+{
+    ExportSession& session = pipeline.session;
+    TraceRecorder* trace = GetTrace(session);
+    if (trace != nullptr)
+    {
+        trace->NameThread("read");
+    }
+
+    unsigned int startFrame = 0;
+    unsigned int endFrame = 0;
+    while (!pipeline.abort && nextRange(startFrame, endFrame))
+    {
+        // Go to start frame
+        if (!session.stream->Seek(startFrame))
+        {
+            printf("Error: Could not seek to frame %u\n", startFrame);
+            pipeline.abort = true;
+            break;
+        }
+
+        const unsigned int failedBefore = pipeline.framesFailed;
+        for (unsigned int frame = startFrame; frame <= endFrame && !pipeline.abort; frame++)
+        {
+            FrameSlot* slot = nullptr;
+            if (!TracedPop(pipeline.freeSlots, slot, trace, "wait free slot"))
+            {
+                break;
+            }
+
+            printf("Processing frame %u of %u\n", frame, endFrame);
+
+            // Read frame (the stream opens the next segment ahead of time)
+            slot->frameNum = frame;
+            bool read;
+            {
+                StageTimer readTimer(session.stats, Stage::Read, frame);
+                read = session.stream->Read(frame, *slot->raw);
+            }
+            if (!read)
+            {
+                DropFrame(pipeline, slot);
+                continue;
+            }
+            if (session.stats != nullptr)
+            {
+                session.stats->AddBytesRead(slot->raw->size);
+            }
+
+            TracedPush(pipeline.convertQueue, slot, trace, "wait convert queue");
+        }
+
+        if (rangeDone && !pipeline.abort)
+        {
+            WaitForFreeSlots(pipeline, trace);
+            rangeDone(startFrame, endFrame, pipeline.framesFailed - failedBefore);
+        }
+    }
+
+    pipeline.convertQueue.Close();
+}
+
+/**
+ * @brief Convert stage: debayers frames into the slot's texture buffers
+ */
+void ConvertStage(FramePipeline& pipeline, const CommandLineArgs& args)
+{
+    ExportSession& session = pipeline.session;
+    const PixelFormat pixelFormat = GetTexturePixelFormat(session);
+    BoundedQueue<FrameSlot*>& nextQueue = args.export6Cameras ? pipeline.writeQueue : pipeline.renderQueue;
+    TraceRecorder* trace = GetTrace(session);
+    if (trace != nullptr)
+    {
+        trace->NameThread("convert");
+    }
+
+    FrameSlot* slot = nullptr;
+    while (TracedPop(pipeline.convertQueue, slot, trace, "wait for read"))
+    {
+        // --jpeg-passthrough: repack the camera JPEGs if the frame allows it,
+        // otherwise convert it as usual
+        slot->passedThrough = false;
+        if (args.jpegPassthrough)
+        {
+            std::string reason;
+            {
+                StageTimer convertTimer(session.stats, Stage::Convert, slot->frameNum);
+                slot->passedThrough = session.converter->PassThrough(*slot->raw, slot->jpegs, reason);
+            }
+            if (session.stats != nullptr)
+            {
+                session.stats->AddPassthroughFrames(slot->passedThrough ? 1 : 0, slot->passedThrough ? 0 : 1);
+            }
+            if (slot->passedThrough)
+            {
+                pipeline.framesPassedThrough++;
+                TracedPush(nextQueue, slot, trace, "wait write queue");
+                continue;
+            }
+            pipeline.passthroughFallbacks++;
+            printf("Frame %u not passed through (%s); converting it\n", slot->frameNum, reason.c_str());
+        }
+
+        bool converted;
+        {
+            StageTimer convertTimer(session.stats, Stage::Convert, slot->frameNum);
+            converted = session.converter->Convert(*slot->raw, slot->textureBuffers, pixelFormat);
+        }
+        if (!converted)
+        {
+            DropFrame(pipeline, slot);
+            continue;
+        }
+
+        // For 6 camera export with high bit depth, convert BGRU16 to BGRU (in-place)
+        // unless the images are written with 16 bits per sample
+        if (args.export6Cameras && GetCameraImageFormat(session, args) != GetTexturePixelFormat(session))
+        {
+            bool reduced;
+            {
+                StageTimer reduceTimer(session.stats, Stage::PixelConvert, slot->frameNum);
+                reduced = session.converter->ReduceTo8Bit(slot->textureBuffers, session.info.textureWidth,
+                                                          session.info.textureHeight);
+            }
+            if (!reduced)
+            {
+                printf("Warning: Could not convert pixel format for frame %u\n", slot->frameNum);
+                DropFrame(pipeline, slot);
+                continue;
+            }
+        }
+
+        TracedPush(nextQueue, slot, trace, args.export6Cameras ? "wait write queue" : "wait render queue");
+    }
+
+    nextQueue.Close();
+}
+
+/**
+ * @brief Render stage: stitches converted frames into panoramas
+ *
+ * The renderer is created on this thread so backends can keep thread-bound
+ * resources (such as an off-screen OpenGL context) in it. @p rendererReady
+ * is set once it exists (or failed), before any frame is rendered.
+ */
+void RenderStage(FramePipeline& pipeline, std::promise<void>& rendererReady)
+{
+    ExportSession& session = pipeline.session;
+    const PixelFormat pixelFormat = GetTexturePixelFormat(session);
+    TraceRecorder* trace = GetTrace(session);
+    if (trace != nullptr)
+    {
+        trace->NameThread("render");
+    }
+
+    std::unique_ptr<PanoramaRenderer> renderer;
+    {
+        TraceSpan setup(trace, "create renderer", "setup");
+        renderer = session.backend->CreateRenderer();
+    }
+    if (renderer == nullptr)
+    {
+        printf("Error: Failed to initialize panorama rendering.\n");
+        pipeline.abort = true;
+    }
+    rendererReady.set_value();
+
+    FrameSlot* slot = nullptr;
+    while (TracedPop(pipeline.renderQueue, slot, trace, "wait for convert"))
+    {
+        if (pipeline.abort)
+        {
+            DropFrame(pipeline, slot);
+            continue;
+        }
+
+        bool rendered;
+        {
+            StageTimer renderTimer(session.stats, Stage::Render, slot->frameNum);
+            rendered = renderer->Render(slot->textureBuffers, pixelFormat, slot->panoData, slot->panoImage);
+        }
+        if (!rendered)
+        {
+            printf("Warning: Could not render frame %u\n", slot->frameNum);
+            DropFrame(pipeline, slot);
+            continue;
+        }
+
+        TracedPush(pipeline.writeQueue, slot, trace, "wait write queue");
+    }
+
+    pipeline.writeQueue.Close();
+}
+
+/**
+ * @brief Encoder thread: saves queued images with its own ImageWriter
+ */
+void EncodeWorker(FramePipeline& pipeline, const CommandLineArgs& args, unsigned int workerIndex)
+{
+    const ExportSession& session = pipeline.session;
+    TraceRecorder* trace = GetTrace(session);
+    if (trace != nullptr)
+    {
+        trace->NameThread("encode " + std::to_string(workerIndex));
+    }
+
+    std::unique_ptr<ImageWriter> writer = session.backend->CreateWriter();
+    if (writer == nullptr)
+    {
+        pipeline.abort = true;
+    }
+    std::vector<unsigned char> encoded;     // Image going to the --archive, --output-pipe or --video
+
+    EncodeJob job;
+    while (TracedPop(pipeline.encodeQueue, job, trace, "wait for write"))
+    {
+        FrameSlot* slot = job.slot;
+
+        bool saved = false;
+        if (writer != nullptr)
+        {
+            if (job.camera < 0)
+            {
+                saved = SavePanorama(session, *writer, slot->frameNum, job.sequence, slot->panoImage, encoded, args);
+            }
+            else if (slot->passedThrough)
+            {
+                saved = SavePassedThroughImage(session, slot->frameNum, job.camera, job.sequence,
+                                               slot->jpegs[job.camera], args);
+            }
+            else
+            {
+                saved = ExportCameraImage(session, *writer, slot->frameNum, job.camera, job.sequence,
+                                          slot->textureBuffers[job.camera], encoded, args);
+            }
+        }
+        if (!saved)
+        {
+            slot->saveFailed = true;
+            if (session.sink != nullptr)
+            {
+                // Nothing can be written once the output failed (e.g. the
+                // pipe's reader went away); otherwise the images after
+                // this one must not wait for it
+                session.sink->Skip(job.sequence, job.camera);
+                if (session.sink->Failed())
+                {
+                    pipeline.abort = true;
+                }
+            }
+        }
+
+        // The last image written for a frame releases its slot
+        if (--slot->pendingImages == 0)
+        {
+            if (slot->saveFailed)
+            {
+                pipeline.framesFailed++;
+            }
+            else if (session.stats != nullptr)
+            {
+                session.stats->AddFrames(1, 0);
+            }
+            pipeline.freeSlots.Push(slot);
+        }
+    }
+}
+
+/**
+ * @brief Write stage: fans finished frames out to the encoder threads
+ */
+void WriteStage(FramePipeline& pipeline, const CommandLineArgs& args, unsigned int encodeThreads)
+{
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < encodeThreads; i++)
+    {
+        workers.emplace_back(EncodeWorker, std::ref(pipeline), std::cref(args), i);
+    }
+
+    TraceRecorder* trace = GetTrace(pipeline.session);
+    if (trace != nullptr)
+    {
+        trace->NameThread("write");
+    }
+
+    // Frames arrive in order, so numbering the images here gives the
+    // output order of an ImageSink
+    uint64_t sequence = 0;
+    FrameSlot* slot = nullptr;
+    const char* waitName = args.export6Cameras ? "wait for convert" : "wait for render";
+    while (TracedPop(pipeline.writeQueue, slot, trace, waitName))
+    {
+        slot->saveFailed = false;
+        if (args.export6Cameras)
+        {
+            slot->pendingImages = NUM_CAMERAS;
+            for (int cam = 0; cam < NUM_CAMERAS; cam++)
+            {
+                TracedPush(pipeline.encodeQueue, EncodeJob{slot, cam, sequence++}, trace, "wait encode queue");
+            }
+        }
+        else
+        {
+            slot->pendingImages = 1;
+            TracedPush(pipeline.encodeQueue, EncodeJob{slot, -1, sequence++}, trace, "wait encode queue");
+        }
+    }
+
+    pipeline.encodeQueue.Close();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
 }
 
-std::string GetDirectoryFromPath(const std::string& path)
+/**
+ * @brief Publish stage: copies finished frames into the shared-memory ring
+ *        (--shm-ring) in place of the write stage
+ */
+void PublishStage(FramePipeline& pipeline, const CommandLineArgs& args)
 {
-    size_t pos = path.find_last_of("\\/");
-    if (pos != std::string::npos)
+    ExportSession& session = pipeline.session;
+    SharedRingWriter& ring = *session.ring;
+    const SharedRingHeader* header = ring.Header();
+    TraceRecorder* trace = GetTrace(session);
+    if (trace != nullptr)
     {
-        return path.substr(0, pos);
+        trace->NameThread("publish");
+    }
+
+    FrameSlot* slot = nullptr;
+    const char* waitName = args.export6Cameras ? "wait for convert" : "wait for render";
+    while (TracedPop(pipeline.writeQueue, slot, trace, waitName))
+    {
+        if (pipeline.abort)
+        {
+            DropFrame(pipeline, slot);
+            continue;
+        }
+
+        // The ring's images all have one size
+        if (!args.export6Cameras && (slot->panoImage.cols != header->cols || slot->panoImage.rows != header->rows))
+        {
+            printf("Warning: Panorama of frame %u is %ux%u, the ring holds %ux%u\n", slot->frameNum,
+                   slot->panoImage.cols, slot->panoImage.rows, header->cols, header->rows);
+            DropFrame(pipeline, slot);
+            continue;
+        }
+
+        // A slow reader holds the export up here
+        SharedRingSlot* ringSlot;
+        {
+            TraceSpan wait(trace, "wait for reader", "wait");
+            ringSlot = ring.BeginFrame(slot->frameNum);
+        }
+        if (ringSlot == nullptr)
+        {
+            // The reader is gone (BeginFrame said so)
+            pipeline.abort = true;
+            DropFrame(pipeline, slot);
+            continue;
+        }
+        {
+            StageTimer publishTimer(session.stats, Stage::Publish, slot->frameNum);
+            for (unsigned int i = 0; i < header->imageCount; i++)
+            {
+                const unsigned char* image = args.export6Cameras ? slot->textureBuffers[i] : slot->panoImage.data;
+                memcpy(ring.Image(ringSlot, i), image, header->imageBytes);
+            }
+        }
+        ring.EndFrame();
+
+        if (session.stats != nullptr)
+        {
+            session.stats->AddBytesWritten(header->imageBytes * header->imageCount);
+            session.stats->AddFrames(1, 0);
+        }
+        pipeline.freeSlots.Push(slot);
     }
-    return ".";
 }
 
 //=============================================================================
-// Ladybug SDK Initialization
+// Main Processing Function
 //=============================================================================
 
-LadybugError InitializeLadybug(const CommandLineArgs& args)
+/**
+ * @brief Total number of frames across all segments of the recording set
+ */
+unsigned int GetTotalFrames(const ExportSession& session)
 {
-    LadybugError error;
-
-    printf("Initializing Ladybug SDK...\n");
-
-    // Create contexts
-    error = ladybugCreateContext(&context);
-    CHECK_ERROR(error, "ladybugCreateContext");
-
-    error = ladybugCreateStreamContext(&streamContext);
-    CHECK_ERROR(error, "ladybugCreateStreamContext");
+    const StreamSegment& lastSegment = session.streamSegments.back();
+    return lastSegment.firstFrame + lastSegment.frameCount;
+}
 
-    // Open stream file
-    printf("Opening stream file: %s\n", args.inputFile.c_str());
-    error = ladybugInitializeStreamForReading(streamContext, args.inputFile.c_str(), true);
-    CHECK_ERROR(error, "ladybugInitializeStreamForReading");
+/**
+ * @brief Run the frame ranges of @p nextRange through one pipeline
+ * @param rangeDone Optional; reports each range once its frames are finished
+ * @param failedFrames Receives the number of frames that could not be exported
+ * @return 0 on success, -1 if the pipeline itself could not run
+ */
+int ProcessFrameRanges(ExportSession& session, const CommandLineArgs& args, const NextFrameRange& nextRange,
+                       const FrameRangeDone& rangeDone, unsigned int& failedFrames)
+{
+    failedFrames = 0;
 
-    // Extract config file
-    char* tempFile = _tempnam(NULL, "lb_cfg_");
-    if (tempFile != NULL)
+    // Set up the pipeline
+    const size_t depth = static_cast<size_t>(args.pipelineDepth);
+    unsigned int encodeThreads = static_cast<unsigned int>(args.encodeThreads);
+    if (encodeThreads == 0)
     {
-        strncpy_s(tempConfigPath, tempFile, MAX_PATH);
-        free(tempFile);
-        
-        error = ladybugGetStreamConfigFile(streamContext, tempConfigPath);
-        if (error != LADYBUG_OK)
-        {
-            printf("Warning: Could not extract config file: %s\n", ladybugErrorToString(error));
-            tempConfigPath[0] = '\0';
-        }
+        encodeThreads = std::max(1u, std::thread::hardware_concurrency() / 2);
     }
+    const size_t maxQueuedImages = static_cast<size_t>(encodeThreads) * ENCODE_JOBS_PER_THREAD;
 
-    // Load configuration
-    if (strlen(tempConfigPath) > 0)
+    FramePipeline pipeline(session, depth, maxQueuedImages);
+    if (!AllocateFrameSlots(pipeline, depth))
+    {
+        return -1;
+    }
+    printf("Pipeline depth: %zu frame(s) in flight\n", depth);
+    if (session.ring == nullptr)
     {
-        error = ladybugLoadConfig(context, tempConfigPath);
-        CHECK_ERROR(error, "ladybugLoadConfig");
-        remove(tempConfigPath);
+        printf("Encoder threads: %u (at most %zu images queued)\n", encodeThreads, maxQueuedImages);
     }
 
-    // Get stream header
-    error = ladybugGetStreamHeader(streamContext, &streamHeaderInfo);
-    CHECK_ERROR(error, "ladybugGetStreamHeader");
+    // The renderer (and the remap tables it builds) is setup, not processing
+    // time, so processing starts once the render stage has created it
+    std::promise<void> rendererReady;
+    std::thread renderThread;
+    if (!args.export6Cameras)
+    {
+        renderThread = std::thread(RenderStage, std::ref(pipeline), std::ref(rendererReady));
+        rendererReady.get_future().wait();
+    }
+    if (session.stats != nullptr)
+    {
+        session.stats->StartProcessing();
+    }
 
-    float frameRate = (streamHeaderInfo.ulLadybugStreamVersion < 7) 
-        ? (float)streamHeaderInfo.ulFrameRate 
-        : streamHeaderInfo.frameRate;
+    // Process frames (the read stage runs on this thread)
+    std::thread writeThread = (session.ring != nullptr)
+        ? std::thread(PublishStage, std::ref(pipeline), std::cref(args))
+        : std::thread(WriteStage, std::ref(pipeline), std::cref(args), encodeThreads);
+    std::thread convertThread(ConvertStage, std::ref(pipeline), std::cref(args));
 
-    printf("\n--- Stream Information ---\n");
-    printf("Base S/N: %d\n", streamHeaderInfo.serialBase);
-    printf("Head S/N: %d\n", streamHeaderInfo.serialHead);
-    printf("Frame rate : %.2f\n", frameRate);
-    printf("Data format: %d\n", streamHeaderInfo.dataFormat);
-    printf("Resolution: %d\n", streamHeaderInfo.resolution);
-    printf("Stream version: %lu\n", streamHeaderInfo.ulLadybugStreamVersion);
-    printf("--------------------------\n\n");
+    ReadStage(pipeline, nextRange, rangeDone);
 
-    // Check if this is a high bit depth format
-    isHighBitDepth = IsHighBitDepthFormat(streamHeaderInfo.dataFormat);
-    if (isHighBitDepth)
+    convertThread.join();
+    if (renderThread.joinable())
     {
-        printf("Detected high bit depth format (12/16-bit)\n");
+        renderThread.join();
     }
+    writeThread.join();
 
-    // Set color processing method
-    printf("Setting debayering method...\n");
-    LadybugColorProcessingMethod colorMethod = GetColorProcessingMethod(args.colorProcessing);
-    error = ladybugSetColorProcessingMethod(context, colorMethod);
-    CHECK_ERROR(error, "ladybugSetColorProcessingMethod");
+    failedFrames = pipeline.framesFailed;
+    if (args.jpegPassthrough)
+    {
+        printf("JPEG passthrough: %u frame(s) passed through, %u fell back to conversion\n", pipeline.framesPassedThrough,
+               pipeline.passthroughFallbacks);
+    }
+    if (session.stats != nullptr)
+    {
+        session.stats->AddFrames(0, failedFrames);
+    }
+    return pipeline.abort ? -1 : 0;
+}
 
-    // Read one image to get dimensions
-    error = ladybugReadImageFromStream(streamContext, &image);
-    CHECK_ERROR(error, "ladybugReadImageFromStream (initial)");
+/**
+ * @brief Run frames startFrame..endFrame through the pipeline
+ * @param failedFrames Receives the number of frames that could not be exported
+ * @return 0 on success, -1 if the pipeline itself could not run
+ */
+int ProcessFrameRange(ExportSession& session, const CommandLineArgs& args, unsigned int startFrame,
+                      unsigned int endFrame, unsigned int& failedFrames)
+{
+    bool pending = true;
+    auto nextRange = [&](unsigned int& rangeStart, unsigned int& rangeEnd) {
+        if (!pending)
+        {
+            return false;
+        }
+        pending = false;
+        rangeStart = startFrame;
+        rangeEnd = endFrame;
+        return true;
+    };
+    return ProcessFrameRanges(session, args, nextRange, nullptr, failedFrames);
+}
 
-    printf("Image info: %dx%d, format=%d\n", 
-           image.uiCols, image.uiRows, image.dataFormat);
+/**
+ * @brief Export frames startFrame..endFrame with a session of its own
+ *
+ * Runs on its own thread when --sessions splits the frame range. The session
+ * creates its own backend, which opens the recording set on its own (for the
+ * SDK: its own configuration and alpha masks), so it shares no imaging state
+ * with the other sessions.
+ */
+void RunExtraSession(const std::vector<StreamSegment>& segments, const CommandLineArgs& args, RunStats* stats,
+                     ImageSink* sink, unsigned int startFrame, unsigned int endFrame, int& result,
+                     unsigned int& failedFrames)
+{
+    ExportSession session;
+    session.streamSegments = segments;
+    session.stats = stats;
+    session.sink = sink;
 
-    // Set texture dimensions based on color processing method
-    if (colorMethod == LADYBUG_DOWNSAMPLE4)
-    {
-        textureWidth = image.uiCols / 2;
-        textureHeight = image.uiRows / 2;
-    }
-    else if (colorMethod == LADYBUG_DOWNSAMPLE16)
+    if (!InitializeSession(session, args))
     {
-        textureWidth = image.uiCols / 4;
-        textureHeight = image.uiRows / 4;
+        printf("Error: Could not initialize the session for frames %u-%u.\n", startFrame, endFrame);
+        failedFrames = endFrame - startFrame + 1;
+        result = -1;
     }
     else
     {
-        textureWidth = image.uiCols;
-        textureHeight = image.uiRows;
+        result = ProcessFrameRange(session, args, startFrame, endFrame, failedFrames);
     }
 
-    // Allocate texture buffers (2x size for 16-bit formats)
-    const unsigned int bytesPerPixel = isHighBitDepth ? 8 : 4;  // BGRU16 vs BGRU
-    for (int i = 0; i < LADYBUG_NUM_CAMERAS; i++)
+    CleanupSession(session);
+}
+
+/**
+ * @brief A thread count option and the logical processors per thread it
+ *        takes when left at 0 (auto)
+ */
+struct ThreadOption
+{
+    int CommandLineArgs::*threads;
+    const char* flag;
+    unsigned int processorsPerThread;
+};
+
+static const ThreadOption THREAD_OPTIONS[] =
+{
+    {&CommandLineArgs::encodeThreads, "--encode-threads", 2},
+    {&CommandLineArgs::renderThreads, "--render-threads", 1},
+    {&CommandLineArgs::decodeThreads, "--decode-threads", 1},
+    {&CommandLineArgs::demosaicThreads, "--demosaic-threads", 1},
+    {&CommandLineArgs::convertThreads, "--convert-threads", 1},
+    {&CommandLineArgs::stripThreads, "--strip-threads", 1}
+};
+
+/**
+ * @brief Share the automatic thread counts out between sessions or workers
+ *
+ * Options left at 0 get their share of the logical processors, so @p parts
+ * pipelines running side by side do not oversubscribe them.
+ */
+void SplitThreadOptions(CommandLineArgs& args, unsigned int parts)
+{
+    for (const ThreadOption& option : THREAD_OPTIONS)
     {
-        textureBuffers[i] = new unsigned char[textureWidth * textureHeight * bytesPerPixel];
-        if (textureBuffers[i] == nullptr)
+        if (args.*option.threads == 0)
         {
-            printf("Error: Failed to allocate texture buffer for camera %d\n", i);
-            return LADYBUG_MEMORY_ALLOC_ERROR;
+            args.*option.threads = static_cast<int>(
+                std::max(1u, std::thread::hardware_concurrency() / option.processorsPerThread / parts));
         }
     }
+}
 
-    // Set blending width
-    error = ladybugSetBlendingParams(context, args.blendingWidth);
-    if (error != LADYBUG_OK)
+int ProcessStream(ExportSession& session, const CommandLineArgs& args)
+{
+    // Get total frames (across all segments of the recording set)
+    unsigned int totalFrames = GetTotalFrames(session);
+    if (totalFrames == 0)
     {
-        printf("Warning: Could not set blending params: %s\n", ladybugErrorToString(error));
+        printf("Error: Could not get frame count: Stream has no frames\n");
+        return -1;
     }
 
-    // Initialize alpha masks
-    printf("Initializing alpha masks (this may take some time)...\n");
-    error = ladybugInitializeAlphaMasks(context, textureWidth, textureHeight);
-    if (error != LADYBUG_OK)
+    // Determine frame range
+    unsigned int startFrame = args.processAllFrames ? 0 : args.startFrame;
+    unsigned int endFrame = args.processAllFrames ? totalFrames - 1 : args.endFrame;
+    
+    if (endFrame >= totalFrames)
     {
-        printf("Warning: Could not initialize alpha masks: %s\n", ladybugErrorToString(error));
+        endFrame = totalFrames - 1;
     }
 
-    error = ladybugSetAlphaMasking(context, true);
-    if (error != LADYBUG_OK)
+    // Create output directory (-o is treated as the output folder)
+    if (session.sink == nullptr && session.ring == nullptr)
     {
-        printf("Warning: Could not enable alpha masking: %s\n", ladybugErrorToString(error));
+        CreateDirectoryRecursive(args.outputPrefix);
     }
 
-    // Configure panoramic output (for pano export)
-    if (!args.export6Cameras)
+    unsigned int failedFrames = 0;
+    const unsigned int rangeFrames = endFrame - startFrame + 1;
+    const unsigned int numSessions = std::min(static_cast<unsigned int>(args.numSessions), rangeFrames);
+    if (numSessions <= 1)
     {
-        printf("Configure output images in Ladybug library...\n");
-        error = ladybugConfigureOutputImages(context, LADYBUG_PANORAMIC);
-        CHECK_ERROR(error, "ladybugConfigureOutputImages");
-
-        printf("Set off-screen panoramic image size:%dx%d image.\n", args.panoWidth, args.panoHeight);
-        error = ladybugSetOffScreenImageSize(context, LADYBUG_PANORAMIC, args.panoWidth, args.panoHeight);
-        CHECK_ERROR(error, "ladybugSetOffScreenImageSize");
-
-        // Apply rotation for panoramic images using ladybugSet3dMapRotation
-        // This rotates the 3D mesh used for panorama stitching
-        // Front = pitch (rotation around X axis)
-        // Down = yaw (rotation around Y axis)
-        if (args.rotFront != 0.0 || args.rotDown != 0.0)
-        {
-            double rotX = args.rotFront * PI / 180.0;  // Pitch (Front) in radians
-            double rotY = args.rotDown * PI / 180.0;   // Yaw (Down) in radians
-            double rotZ = 0.0;  // Roll
-
-            error = ladybugSet3dMapRotation(context, rotX, rotY, rotZ);
-            if (error != LADYBUG_OK)
-            {
-                printf("Warning: Could not set 3D map rotation: %s\n", ladybugErrorToString(error));
-            }
-            else
-            {
-                printf("Applied rotation: Front=%.1f, Down=%.1f degrees\n", args.rotFront, args.rotDown);
-            }
-        }
+        return ProcessFrameRange(session, args, startFrame, endFrame, failedFrames);
     }
 
-    // Rewind stream
-    error = ladybugGoToImage(streamContext, 0);
-    CHECK_ERROR(error, "ladybugGoToImage (rewind)");
-
-    return LADYBUG_OK;
-}
-
-//=============================================================================
-// Cleanup
-//=============================================================================
+    // Several sessions: each exports a contiguous part of the range. The
+    // initialized session takes the first part; the others are created on
+    // their own threads. main() already split the thread options between
+    // the sessions, before the first one was initialized
+    std::vector<unsigned int> firstFrames(numSessions + 1);
+    for (unsigned int i = 0; i <= numSessions; i++)
+    {
+        firstFrames[i] = startFrame + static_cast<unsigned int>(static_cast<uint64_t>(rangeFrames) * i / numSessions);
+    }
 
-void CleanupLadybug()
-{
-    for (int i = 0; i < LADYBUG_NUM_CAMERAS; i++)
+    std::vector<StreamSegment> segments;
+    for (const StreamSegment& segment : session.streamSegments)
     {
-        if (textureBuffers[i] != nullptr)
-        {
-            delete[] textureBuffers[i];
-            textureBuffers[i] = nullptr;
-        }
+        StreamSegment copy;
+        copy.path = segment.path;
+        segments.push_back(copy);
     }
 
-    if (streamContext != nullptr)
+    std::vector<int> results(numSessions, 0);
+    std::vector<unsigned int> sessionFailures(numSessions, 0);
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < numSessions; i++)
     {
-        ladybugDestroyStreamContext(&streamContext);
-        streamContext = nullptr;
+        threads.emplace_back(RunExtraSession, std::cref(segments), std::cref(args), session.stats,
+                             session.sink, firstFrames[i], firstFrames[i + 1] - 1, std::ref(results[i]), std::ref(sessionFailures[i]));
     }
+    results[0] = ProcessFrameRange(session, args, firstFrames[0], firstFrames[1] - 1, sessionFailures[0]);
 
-    if (context != nullptr)
+    int result = 0;
+    for (unsigned int i = 0; i < numSessions; i++)
     {
-        ladybugDestroyContext(&context);
-        context = nullptr;
+        if (i > 0)
+        {
+            threads[i - 1].join();
+        }
+        failedFrames += sessionFailures[i];
+        if (results[i] != 0)
+        {
+            result = -1;
+        }
     }
 
-    if (strlen(tempConfigPath) > 0)
+    printf("\n--- Session Summary ---\n");
+    for (unsigned int i = 0; i < numSessions; i++)
     {
-        remove(tempConfigPath);
+        printf("Session %u: frames %u-%u, %u failed%s\n", i, firstFrames[i], firstFrames[i + 1] - 1,
+               sessionFailures[i], results[i] != 0 ? " (aborted)" : "");
     }
+    printf("-----------------------\n");
+
+    return result;
 }
 
 //=============================================================================
-// Export Functions
+// Sharding
 //=============================================================================
 
 /**
- * @brief Export 6 processed camera images for a single frame
+ * @brief Worker side of --shards: export the chunks the coordinator hands out
+ *
+ * All chunks go through one pipeline, so the stage threads and the renderer
+ * are set up once per worker.
  */
-LadybugError Export6CameraImages(unsigned int frameNum, const CommandLineArgs& args)
+int RunShardWorker(ExportSession& session, const CommandLineArgs& args)
 {
-    LadybugError error;
-    LadybugSaveFileFormat saveFormat = GetSaveFormat(args.format);
-    const char* ext = GetFileExtension(args.format);
-
-    for (int cam = 0; cam < LADYBUG_NUM_CAMERAS; cam++)
-    {
-        LadybugProcessedImage processedImage;
-        memset(&processedImage, 0, sizeof(processedImage));
-        processedImage.pData = textureBuffers[cam];
-        processedImage.uiCols = textureWidth;
-        processedImage.uiRows = textureHeight;
-        processedImage.pixelFormat = LADYBUG_BGRU;  // Always 8-bit for direct saving (JPG/BMP don't support 16-bit)
-
-        // Generate filename: outputDir\BaseName_FrameNum_CamN.ext
-        char filename[MAX_PATH];
-        sprintf_s(filename, "%s\\%s_%06u_Cam%d.%s", 
-                  args.outputPrefix.c_str(), args.pgrBaseName.c_str(), frameNum, cam, ext);
+    const unsigned int totalFrames = GetTotalFrames(session);
+    CreateDirectoryRecursive(args.outputPrefix);
+    SendShardReady(totalFrames);
 
-        error = ladybugSaveImage(context, &processedImage, filename, saveFormat, false);
-        if (error != LADYBUG_OK)
+    bool chunkOutsideStream = false;
+    unsigned int chunkLastFrame = 0;
+    auto nextChunk = [&](unsigned int& firstFrame, unsigned int& lastFrame) {
+        if (!ReceiveShardChunk(firstFrame, chunkLastFrame))
+        {
+            return false;
+        }
+        if (firstFrame >= totalFrames)
         {
-            printf("Warning: Could not save camera %d image: %s\n", cam, ladybugErrorToString(error));
+            chunkOutsideStream = true;
+            return false;
         }
+        lastFrame = std::min(chunkLastFrame, totalFrames - 1);
+        return true;
+    };
+    auto chunkDone = [&](unsigned int firstFrame, unsigned int, unsigned int failedFrames) {
+        SendShardDone(firstFrame, chunkLastFrame, failedFrames);
+    };
+
+    // Exiting hands an unfinished chunk back to the coordinator for another worker
+    unsigned int failedFrames = 0;
+    if (ProcessFrameRanges(session, args, nextChunk, chunkDone, failedFrames) != 0 || chunkOutsideStream)
+    {
+        return 1;
     }
-
-    return LADYBUG_OK;
+    return 0;
 }
 
 /**
- * @brief Export panoramic image for a single frame
+ * @brief Coordinator side of --shards: launch workers and split the frames
+ *
+ * Workers run this executable with the same options plus --shard-worker.
  */
-LadybugError ExportPanorama(unsigned int frameNum, const CommandLineArgs& args)
+int RunShards(int argc, char* argv[], const CommandLineArgs& args, RunStats* stats)
 {
-    LadybugError error;
-    LadybugSaveFileFormat saveFormat = GetSaveFormat(args.format);
-    const char* ext = GetFileExtension(args.format);
+    ShardOptions options;
+    options.numShards = static_cast<unsigned int>(args.numShards);
+    options.chunkFrames = static_cast<unsigned int>(args.shardChunk);
+    options.processAllFrames = args.processAllFrames;
+    options.startFrame = args.startFrame;
+    options.endFrame = args.endFrame;
+
+    options.workerCommand.push_back(argv[0]);
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if ((arg == "--shards" || arg == "--shard-chunk") && i + 1 < argc)
+        {
+            i++;
+            continue;
+        }
+        options.workerCommand.push_back(arg);
+    }
+    options.workerCommand.push_back("--shard-worker");
+    options.workerCommand.push_back("true");
 
-    LadybugProcessedImage processedImage;
-    error = ladybugRenderOffScreenImage(context, LADYBUG_PANORAMIC, LADYBUG_BGR, &processedImage);
-    if (error != LADYBUG_OK)
+    // Share the automatic thread counts out between the workers
+    CommandLineArgs workerArgs = args;
+    SplitThreadOptions(workerArgs, options.numShards);
+    for (const ThreadOption& option : THREAD_OPTIONS)
     {
-        printf("Error: Could not render panorama: %s\n", ladybugErrorToString(error));
-        return error;
+        if (args.*option.threads == 0)
+        {
+            options.workerCommand.push_back(option.flag);
+            options.workerCommand.push_back(std::to_string(workerArgs.*option.threads));
+        }
     }
 
-    // Generate filename: outputDir\BaseName_FrameNum.ext
-    char filename[MAX_PATH];
-    sprintf_s(filename, "%s\\%s_%06u.%s", args.outputPrefix.c_str(), args.pgrBaseName.c_str(), frameNum, ext);
+    if (stats != nullptr)
+    {
+        stats->StartProcessing();
+    }
 
-    error = ladybugSaveImage(context, &processedImage, filename, saveFormat, false);
-    if (error != LADYBUG_OK)
+    ShardResult result;
+    bool success = RunShardCoordinator(options, result);
+    if (stats != nullptr)
     {
-        printf("Error: Could not save panorama: %s\n", ladybugErrorToString(error));
-        return error;
+        stats->AddFrames(result.framesDone, result.framesFailed);
     }
 
-    printf("Getting panoramic image and writing it to %s...\n", filename);
-    return LADYBUG_OK;
+    printf("\n--- Shard Summary ---\n");
+    printf("Frames exported: %u of %u\n", result.framesDone, result.totalFrames);
+    printf("Frames failed: %u\n", result.framesFailed);
+    printf("Chunks reassigned: %u\n", result.chunksRetried);
+    printf("Workers failed: %u\n", result.workersFailed);
+    printf("---------------------\n");
+
+    return success ? 0 : -1;
 }
 
 //=============================================================================
-// Main Processing Function
+// Run Report
 //=============================================================================
 
-int ProcessStream(const CommandLineArgs& args)
+/**
+ * @brief Report or trace file of a shard worker: run.json -> run.worker-<pid>.json
+ *
+ * Workers get the coordinator's options, so each one adds its process id to
+ * keep the files apart. The coordinator's own report covers the whole run
+ * (frames and throughput) without stage timings; it writes no trace.
+ */
+std::string GetWorkerOutputPath(const std::string& reportPath)
 {
-    LadybugError error;
-
-    // Get total frames
-    unsigned int totalFrames = 0;
-    error = ladybugGetStreamNumOfImages(streamContext, &totalFrames);
-    if (error != LADYBUG_OK)
-    {
-        printf("Error: Could not get frame count: %s\n", ladybugErrorToString(error));
-        return -1;
-    }
-
-    // Determine frame range
-    unsigned int startFrame = args.processAllFrames ? 0 : args.startFrame;
-    unsigned int endFrame = args.processAllFrames ? totalFrames - 1 : args.endFrame;
-    
-    if (endFrame >= totalFrames)
+#ifdef _WIN32
+    const std::string suffix = ".worker-" + std::to_string(_getpid());
+#else
+    const std::string suffix = ".worker-" + std::to_string(getpid());
+#endif
+    const size_t dot = reportPath.find_last_of('.');
+    const size_t slash = reportPath.find_last_of("\\/");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
     {
-        endFrame = totalFrames - 1;
+        return reportPath + suffix;
     }
+    return reportPath.substr(0, dot) + suffix + reportPath.substr(dot);
+}
 
-    // Create output directory (-o is treated as the output folder)
-    CreateDirectoryRecursive(args.outputPrefix);
-
-    // Go to start frame
-    if (startFrame > 0)
+/**
+ * @brief Print the stage timings and write the --report and --trace files
+ */
+void FinishRunReport(const RunStats& stats, const CommandLineArgs& args, const std::string& backend, int exitCode)
+{
+    const bool coordinator = args.numShards > 1 && !args.shardWorker;
+    if (stats.Trace() != nullptr && !coordinator)
     {
-        error = ladybugGoToImage(streamContext, startFrame);
-        if (error != LADYBUG_OK)
-        {
-            printf("Error: Could not seek to frame %u: %s\n", startFrame, ladybugErrorToString(error));
-            return -1;
-        }
+        stats.Trace()->Write(args.shardWorker ? GetWorkerOutputPath(args.tracePath) : args.tracePath);
     }
-
-    // Process frames
-    for (unsigned int frame = startFrame; frame <= endFrame; frame++)
+    if (args.reportPath.empty())
     {
-        printf("Processing frame %u of %u\n", frame, endFrame);
-
-        // Read frame
-        error = ladybugReadImageFromStream(streamContext, &image);
-        if (error != LADYBUG_OK)
-        {
-            printf("Warning: Could not read frame %u: %s\n", frame, ladybugErrorToString(error));
-            continue;
-        }
-
-        // Convert to native format (BGRU16 for high bit depth, BGRU for 8-bit)
-        LadybugPixelFormat pixelFormat = isHighBitDepth ? LADYBUG_BGRU16 : LADYBUG_BGRU;
-        error = ladybugConvertImage(context, &image, textureBuffers, pixelFormat);
-        if (error != LADYBUG_OK)
-        {
-            printf("Warning: Could not convert frame %u: %s\n", frame, ladybugErrorToString(error));
-            continue;
-        }
-
-        if (args.export6Cameras)
-        {
-            // For 6 camera export with high bit depth, convert BGRU16 to BGRU (in-place)
-            // because JPG/BMP only support 8-bit
-            if (isHighBitDepth)
-            {
-                error = ladybugConvertImageBuffersPixelFormat(
-                    context,
-                    textureBuffers,         // input buffers
-                    textureBuffers,         // output buffers (in-place)
-                    LADYBUG_NUM_CAMERAS,
-                    textureWidth,
-                    textureHeight,
-                    LADYBUG_BGRU16,         // input format
-                    LADYBUG_BGRU);          // output format
-                if (error != LADYBUG_OK)
-                {
-                    printf("Warning: Could not convert pixel format for frame %u: %s\n", frame, ladybugErrorToString(error));
-                    continue;
-                }
-            }
-            // Export 6 camera images
-            Export6CameraImages(frame, args);
-        }
-        else
-        {
-            // Update textures for panorama
-            error = ladybugUpdateTextures(context, LADYBUG_NUM_CAMERAS, 
-                                          (const unsigned char**)textureBuffers, pixelFormat);
-            if (error != LADYBUG_OK)
-            {
-                printf("Warning: Could not update textures for frame %u: %s\n", frame, ladybugErrorToString(error));
-                continue;
-            }
-
-            // Export panorama
-            ExportPanorama(frame, args);
-        }
+        return;
     }
 
-    return 0;
+    stats.PrintSummary();
+
+    RunReportInfo info;
+    info.input = args.inputFile;
+    info.output = args.outputPrefix;
+    info.backend = backend;
+    info.exportType = args.export6Cameras ? "6processed" : "panorama";
+    info.format = args.format;
+    info.colorProcessing = args.colorProcessing;
+    info.pipelineDepth = static_cast<unsigned int>(args.pipelineDepth);
+    info.numSessions = static_cast<unsigned int>(args.numSessions);
+    info.numShards = static_cast<unsigned int>(args.numShards);
+    info.exitCode = exitCode;
+
+    const std::string path = args.shardWorker ? GetWorkerOutputPath(args.reportPath) : args.reportPath;
+    WriteRunReport(path, info, stats);
 }
 
 //=============================================================================
@@ -924,10 +2512,46 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    // --archive or --output-pipe: every session hands its images to one
+    // sink. stdout is taken over before anything is printed to it
+    std::unique_ptr<ImageSink> sink;
+    if (!args.outputPipe.empty())
+    {
+        std::unique_ptr<PipeWriter> pipe(new PipeWriter());
+        if (!pipe->Open(args.outputPipe))
+        {
+            return 1;
+        }
+        sink = std::move(pipe);
+    }
+    else if (!args.archivePath.empty())
+    {
+        std::unique_ptr<ArchiveWriter> archive(new ArchiveWriter());
+        if (!archive->Open(args.archivePath))
+        {
+            return 1;
+        }
+        sink = std::move(archive);
+    }
+
     // Extract base name from PGR file for output naming
     args.pgrBaseName = ExtractPgrBaseName(args.inputFile);
     printf("PGR base name: %s\n", args.pgrBaseName.c_str());
 
+    // Find the other segments of a split recording; frames are numbered
+    // contiguously across the whole set
+    ExportSession session;
+    session.sink = sink.get();
+    std::vector<std::string> segmentPaths = args.allSegments
+        ? FindStreamSegments(args.inputFile)
+        : std::vector<std::string>{ args.inputFile };
+    for (const std::string& path : segmentPaths)
+    {
+        StreamSegment segment;
+        segment.path = path;
+        session.streamSegments.push_back(segment);
+    }
+
     // Print configuration
     printf("\n");
     if (args.export6Cameras)
@@ -942,23 +2566,134 @@ int main(int argc, char* argv[])
             printf("Rotation: Front %.1f, Down %.1f degrees\n", args.rotFront, args.rotDown);
         }
     }
-    printf("Output format: %s\n", args.format.c_str());
+    if (!args.shmRing.empty())
+    {
+        printf("Output: shared memory ring %s (%d slots)\n", args.shmRing.c_str(), args.shmSlots);
+    }
+    else
+    {
+        printf("Output format: %s\n", args.format.c_str());
+    }
+    if (!args.archivePath.empty())
+    {
+        printf("Output archive: %s\n", args.archivePath.c_str());
+    }
+    if (!args.outputPipe.empty())
+    {
+        printf("Output pipe: %s\n", (args.outputPipe == "-") ? "stdout" : args.outputPipe.c_str());
+    }
+    if (!args.videoPath.empty())
+    {
+        printf("Output video: %s\n", args.videoPath.c_str());
+    }
     printf("Color processing: %s\n", args.colorProcessing.c_str());
+    if (args.jpegPassthrough)
+    {
+        printf("JPEG passthrough: on\n");
+    }
     printf("\n");
 
-    // Initialize SDK
-    if (InitializeLadybug(args) != LADYBUG_OK)
+    // Stage timers for --report and --trace (created before the backend so
+    // setup time is included)
+    std::unique_ptr<RunStats> stats;
+    std::unique_ptr<TraceRecorder> trace;
+    if (!args.reportPath.empty() || !args.tracePath.empty())
+    {
+        stats.reset(new RunStats());
+        session.stats = stats.get();
+    }
+    if (!args.tracePath.empty())
+    {
+        trace.reset(new TraceRecorder());
+        stats->SetTrace(trace.get());
+    }
+
+    // Coordinator: the workers do all imaging work
+    if (args.numShards > 1 && !args.shardWorker)
+    {
+        int result = RunShards(argc, argv, args, stats.get());
+        if (stats != nullptr)
+        {
+            FinishRunReport(*stats, args, args.backend, result);
+        }
+        if (result == 0)
+        {
+            printf("\nExport complete.\n");
+        }
+        return result;
+    }
+
+    // --sessions: every session gets its share of the automatic thread
+    // counts, the one initialized here included
+    if (args.numSessions > 1 && !args.shardWorker)
+    {
+        SplitThreadOptions(args, static_cast<unsigned int>(args.numSessions));
+    }
+
+    // Initialize the imaging backend
+    if (!InitializeSession(session, args))
     {
-        printf("Failed to initialize Ladybug SDK.\n");
-        CleanupLadybug();
+        printf("Failed to initialize the %s backend.\n", args.backend.c_str());
+        CleanupSession(session);
         return 1;
     }
 
+    // --video: the frame size and rate come from the stream
+    if (!args.videoPath.empty())
+    {
+        std::unique_ptr<VideoWriter> video(new VideoWriter());
+        const bool opened = args.export6Cameras
+            ? video->Open(args.videoPath, true, session.info.textureWidth, session.info.textureHeight,
+                          session.info.frameRate)
+            : video->Open(args.videoPath, false, args.panoWidth, args.panoHeight, session.info.frameRate);
+        if (!opened)
+        {
+            CleanupSession(session);
+            return 1;
+        }
+        sink = std::move(video);
+        session.sink = sink.get();
+    }
+
+    // --shm-ring: sized for the images the session produces
+    std::unique_ptr<SharedRingWriter> ring;
+    if (!args.shmRing.empty())
+    {
+        ring.reset(new SharedRingWriter());
+        const unsigned int timeoutMs = static_cast<unsigned int>(args.shmTimeout) * 1000;
+        const bool created = args.export6Cameras
+            ? ring->Create(args.shmRing, args.shmSlots, NUM_CAMERAS, session.info.textureWidth,
+                           session.info.textureHeight,
+                           (GetCameraImageFormat(session, args) == PixelFormat::BGRU16) ? SHARED_RING_BGRU16
+                                                                                        : SHARED_RING_BGRU,
+                           timeoutMs)
+            : ring->Create(args.shmRing, args.shmSlots, 1, args.panoWidth, args.panoHeight, SHARED_RING_BGR,
+                           timeoutMs);
+        if (!created)
+        {
+            CleanupSession(session);
+            return 1;
+        }
+        session.ring = ring.get();
+    }
+
     // Process stream
-    int result = ProcessStream(args);
+    int result = args.shardWorker ? RunShardWorker(session, args) : ProcessStream(session, args);
+    if (sink != nullptr && !sink->Close())
+    {
+        result = -1;
+    }
+    if (ring != nullptr)
+    {
+        ring->Close();
+    }
+    if (stats != nullptr)
+    {
+        FinishRunReport(*stats, args, session.backend->Name(), result);
+    }
 
     // Cleanup
-    CleanupLadybug();
+    CleanupSession(session);
 
     if (result == 0)
     {